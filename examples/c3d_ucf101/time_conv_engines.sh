@@ -0,0 +1,9 @@
+#!/usr/bin/env sh
+set -e
+
+./build/tools/caffe \
+  time \
+  --model=examples/c3d_ucf101/c3d_conv_benchmark.prototxt \
+  --iterations=10 \
+  $@ \
+  2>&1 | tee examples/c3d_ucf101/c3d_conv_benchmark.log
@@ -254,6 +254,9 @@ class Blob {
   const Dtype* cpu_diff() const;
   const Dtype* gpu_diff() const;
   Dtype* mutable_cpu_data();
+  /// @brief mutable_cpu_data for callers overwriting all of the data, which
+  ///        is not zero-filled if allocated by this call.
+  Dtype* mutable_cpu_data_for_overwrite();
   Dtype* mutable_gpu_data();
   Dtype* mutable_cpu_diff();
   Dtype* mutable_gpu_diff();
@@ -293,6 +296,14 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to a SyncedMemory holding at least count()
+   *        elements, which other Blob%s may share -- used by
+   *        Net::PlanInferenceMemory to let activations reuse memory.
+   *
+   * Reshaping beyond the size of that memory allocates this Blob its own.
+   */
+  void set_data(const shared_ptr<SyncedMemory>& data);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -138,6 +138,23 @@ class DataTransformer {
    */
   void Transform(Blob<Dtype>* input_blob, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation defined in the data layer's
+   * transform_param block to a video clip of uint8 pixels stored as
+   * channels x length x height x width, e.g. a clip read from a ClipCache.
+   * Crop, mirror and mean are picked as in Transform(mat_vector, ..., true).
+   *
+   * @param data
+   *    The clip's pixels.
+   * @param transformed_blob
+   *    This is destination blob of shape 1 x channels x length x crop x crop
+   *    (or x height x width without cropping). It can be part of top blob's
+   *    data.
+   */
+  void TransformVolume(const uint8_t* data, const int channels,
+                       const int length, const int height, const int width,
+                       Blob<Dtype>* transformed_blob);
+
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -192,6 +209,13 @@ class DataTransformer {
   virtual int Rand(const int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  // Checks the mean against video frames of channels x height x width and
+  // returns the mean file's data (NULL without one), whose channels are
+  // mean_channel_stride apart and frames, for a mean cube, height * width
+  // apart. Replicates a single mean_value across the channels.
+  const Dtype* VolumeMean(const int channels, const int length,
+      const int height, const int width, int* mean_channel_stride,
+      int* mean_frame_stride);
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -176,6 +176,22 @@ class Layer {
       const vector<bool>& propagate_down,
       const vector<Blob<Dtype>*>& bottom);
 
+  /**
+   * @brief Starts a new evaluation in the layers that accumulate statistics
+   *        over several forward passes, e.g. MultiLabelMetric. The solver
+   *        calls it before every test pass.
+   */
+  virtual void ResetStatistics() {}
+
+  /**
+   * @brief For inference in a 16-bit storage_precision, converts the weights
+   *        now and frees their float copy, returning the bytes freed. The
+   *        layer must not run Backward, be snapshotted or get new weights
+   *        afterwards. Layers without a 16-bit forward pass keep their
+   *        weights and return 0.
+   */
+  virtual size_t ReleaseFloatWeights() { return 0; }
+
   /**
    * @brief Returns the vector of learnable parameter blobs.
    */
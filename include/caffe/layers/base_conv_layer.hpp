@@ -6,7 +6,10 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
 #include "caffe/util/im2col.hpp"
+#include "caffe/util/int8.hpp"
+#include "caffe/util/vol2col.hpp"
 
 namespace caffe {
 
@@ -18,11 +21,13 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
  public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), int8_weights_version_(0),
+        half_weights_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  virtual size_t ReleaseFloatWeights();
 
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
@@ -40,6 +45,22 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
       weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  // The int8 forward pass of one input (see QuantizationParameter), with the
+  // bias, if any, and the fused ReLU if relu.
+  void forward_cpu_int8(const Dtype* input, const Dtype* bias,
+      const bool relu, Dtype* output);
+  inline bool is_quantized() const {
+    return this->layer_param_.quantization_param().input_range_size() > 0;
+  }
+  // forward_cpu_gemm with the weights and columns in 16 bits (see
+  // LayerParameter.storage_precision).
+  void forward_cpu_half_gemm(const Dtype* input, Dtype* output);
+  // Narrows the weights into half_weights_ if they changed since.
+  void narrow_weights();
+  inline bool is_half() const {
+    return this->layer_param_.storage_precision() !=
+        LayerParameter_StoragePrecision_FLOAT;
+  }
 
 #ifndef CPU_ONLY
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -96,7 +117,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
-  inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
+  template <typename T>
+  inline void conv_im2col_cpu(const T* data, T* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
       im2col_cpu(data, conv_in_channels_,
           conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
@@ -104,6 +126,16 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data()[0], pad_.cpu_data()[1],
           stride_.cpu_data()[0], stride_.cpu_data()[1],
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 3) {
+      vol2col_cpu(data, conv_in_channels_,
+          conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+          conv_input_shape_.cpu_data()[3],
+          kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+          kernel_shape_.cpu_data()[2],
+          pad_.cpu_data()[0], pad_.cpu_data()[1], pad_.cpu_data()[2],
+          stride_.cpu_data()[0], stride_.cpu_data()[1], stride_.cpu_data()[2],
+          dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+          dilation_.cpu_data()[2], col_buff);
     } else {
       im2col_nd_cpu(data, num_spatial_axes_, conv_input_shape_.cpu_data(),
           col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -118,6 +150,16 @@ class BaseConvolutionLayer : public Layer<Dtype> {
           pad_.cpu_data()[0], pad_.cpu_data()[1],
           stride_.cpu_data()[0], stride_.cpu_data()[1],
           dilation_.cpu_data()[0], dilation_.cpu_data()[1], data);
+    } else if (!force_nd_im2col_ && num_spatial_axes_ == 3) {
+      col2vol_cpu(col_buff, conv_in_channels_,
+          conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+          conv_input_shape_.cpu_data()[3],
+          kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+          kernel_shape_.cpu_data()[2],
+          pad_.cpu_data()[0], pad_.cpu_data()[1], pad_.cpu_data()[2],
+          stride_.cpu_data()[0], stride_.cpu_data()[1], stride_.cpu_data()[2],
+          dilation_.cpu_data()[0], dilation_.cpu_data()[1],
+          dilation_.cpu_data()[2], data);
     } else {
       col2im_nd_cpu(col_buff, num_spatial_axes_, conv_input_shape_.cpu_data(),
           col_buffer_shape_.data(), kernel_shape_.cpu_data(),
@@ -168,6 +210,21 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+
+  // Quantized on the int8 forward passes that follow a change of the weights
+  // (see SyncedMemory::version).
+  Int8Weights<Dtype> int8_weights_;
+  uint64_t int8_weights_version_;
+  vector<int8_t> int8_input_;
+  vector<int8_t> int8_col_buffer_;
+  vector<int32_t> int8_sums_;
+
+  // Narrowed on the 16-bit forward passes that follow a change of the
+  // weights.
+  vector<uint16_t> half_weights_;
+  uint64_t half_weights_version_;
+  vector<uint16_t> half_input_;
+  vector<uint16_t> half_col_buffer_;
 };
 
 }  // namespace caffe
@@ -9,6 +9,7 @@
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
@@ -55,7 +56,9 @@ template <typename Dtype>
 class BasePrefetchingDataLayer :
     public BaseDataLayer<Dtype>, public InternalThread {
  public:
-  explicit BasePrefetchingDataLayer(const LayerParameter& param);
+  // Keeps prefetch_count batches in flight.
+  explicit BasePrefetchingDataLayer(const LayerParameter& param,
+      int prefetch_count = PREFETCH_COUNT);
   // LayerSetUp: implements common data layer setup functionality, and calls
   // DataLayerSetUp to do special data layer setup for individual layer types.
   // This method may not be overridden.
@@ -74,9 +77,13 @@ class BasePrefetchingDataLayer :
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
 
-  Batch<Dtype> prefetch_[PREFETCH_COUNT];
-  BlockingQueue<Batch<Dtype>*> prefetch_free_;
-  BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  vector<shared_ptr<Batch<Dtype> > > prefetch_;
+  RingQueue<Batch<Dtype>*> prefetch_free_;
+  RingQueue<Batch<Dtype>*> prefetch_full_;
+  // The batch the tops point to after Forward_cpu with a single solver, kept
+  // from the prefetch thread until the next forward. Solvers sharing the
+  // layer get copies instead.
+  Batch<Dtype>* prefetch_current_;
 
   Blob<Dtype> transformed_data_;
 };
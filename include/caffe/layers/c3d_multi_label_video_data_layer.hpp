@@ -18,75 +18,76 @@
 #ifndef C3D_MULTI_LABEL_VIDEO_DATA_LAYER_HPP_
 #define C3D_MULTI_LABEL_VIDEO_DATA_LAYER_HPP_
 
+#include <stdint.h>
+
 #include <string>
 #include <utility>
 #include <vector>
 
-#include "pthread.h"
-#include "boost/scoped_ptr.hpp"
-
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/video_frame_reader.hpp"
 
 using std::string;
 
 namespace caffe {
 
 template <typename Dtype>
-void* C3DMultiLabelVideoDataLayerPrefetch(void* layer_pointer);
-
-template <typename Dtype>
-class C3DMultiLabelVideoDataLayer : public Layer<Dtype> {
-        // The function used to perform prefetching.
-        friend void* C3DMultiLabelVideoDataLayerPrefetch<Dtype>(void* layer_pointer);
-
+class C3DMultiLabelVideoDataLayer : public BasePrefetchingDataLayer<Dtype> {
     public:
         explicit C3DMultiLabelVideoDataLayer(const LayerParameter& param)
-        : Layer<Dtype>(param) {}
+        : BasePrefetchingDataLayer<Dtype>(param,
+                param.c3d_multi_label_video_data_param().prefetch()) {}
         virtual ~C3DMultiLabelVideoDataLayer();
-        virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+        virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
                 const vector<Blob<Dtype>*>& top);
-        virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
-                const vector<Blob<Dtype>*>& top) {}
 
         virtual inline const char* type() const { return "C3DMultiLabelVideoData"; }
         virtual inline int ExactNumBottomBlobs() const { return 0; }
         //virtual inline int ExactNumTopBlobs() const { return 2; }
         //virtual inline int MinNumTopBlobs() const { return 2; }
 
-    protected:
-        virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                const vector<Blob<Dtype>*> &top);
-        virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
-                const vector<Blob<Dtype>*>& top);
-        virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
-                const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) { return; }
-        virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
-                const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) { return; }
+        // With clip_stride, the videos of the source and the index in it of
+        // the video of every clip. Unless shuffled, clips are loaded in order.
+        const vector<string>& video_list() const { return video_list_; }
+        const vector<int>& clip_video() const { return clip_video_; }
 
-        virtual void CreatePrefetchThread();
-        virtual void JoinPrefetchThread();
-        virtual unsigned int PrefetchRand();
+    protected:
+        virtual void load_batch(Batch<Dtype>* batch);
+        virtual void ShuffleClips();
+        // Replaces the videos of the list by the clips covering them.
+        void ListStridedClips(int clip_stride);
 
         shared_ptr<Caffe::RNG> prefetch_rng_;
         vector<string> file_list_;
         vector<int> start_frm_list_;
         vector< vector<int> > label_list_;
         vector<int> shuffle_index_;
+        vector<string> video_list_;
+        vector<int> clip_video_;
         int lines_id_;
+        // Clip n loaded since setup draws from stream n of clip_rng_seed_
+        // (see CounterRng); clip_id_ is the next n.
+        unsigned int clip_rng_seed_;
+        uint64_t clip_id_;
+        // Keeps the current video open for sequential_decode.
+        shared_ptr<VideoFrameReader> frame_reader_;
 
         int datum_channels_;
         int datum_length_;
         int datum_height_;
         int datum_width_;
         int datum_size_;
-        pthread_t thread_;
-        shared_ptr<Blob<Dtype> > prefetch_data_;
-        shared_ptr<Blob<Dtype> > prefetch_label_;
         Blob<Dtype> data_mean_;
-        bool output_labels_;
+        // The mean (unless data_mean_ is given) and the scale of every frame
+        // of every channel, channel-major.
+        vector<Dtype> plane_mean_;
+        vector<Dtype> plane_scale_;
+        // The clip shown with show_data, as uint8 pixels.
+        vector<char> show_data_buffer_;
         //Phase phase_;     // we do not need phase_, Layer class has it.
 };
 
@@ -25,6 +25,8 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
+#include "caffe/util/int8.hpp"
 
 namespace caffe {
 
@@ -34,7 +36,8 @@ template <typename Dtype>
 class Convolution3DLayer : public Layer<Dtype> {
 public:
     explicit Convolution3DLayer(const LayerParameter& param)
-        : Layer<Dtype>(param) {}
+        : Layer<Dtype>(param), packed_weight_version_(0),
+          int8_weights_version_(0), half_weights_version_(0) {}
 //    virtual void SetUp(const vector<Blob<Dtype>*>& bottom,
 //                       vector<Blob<Dtype>*>* top);
     virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
@@ -45,6 +48,7 @@ public:
     virtual inline const char* type() const { return "Convolution3D"; }
     virtual inline int ExactNumBottomBlobs() const { return 1; }
     virtual inline int ExactNumTopBlobs() const { return 1; }
+    virtual size_t ReleaseFloatWeights();
 
 protected:
     virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -56,6 +60,22 @@ protected:
     virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
         const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
+    // DIRECT forward pass (see Convolution3DParameter.algorithm) for one
+    // sample and one block of output channels; index enumerates both.
+    void forward_cpu_direct(const Dtype* bottom_data, Dtype* top_data,
+        int index);
+    // GEMM passes over the samples of one batch slice (see
+    // Convolution3DParameter.batch_parallelism).
+    void forward_cpu_gemm_slice(const Dtype* bottom_data, Dtype* top_data,
+        int slice);
+    // int8 passes (see QuantizationParameter) over the samples of one batch
+    // slice.
+    void forward_cpu_int8_slice(const Dtype* bottom_data, Dtype* top_data,
+        int slice);
+    void backward_cpu_gemm_slice(const Dtype* top_diff,
+        const Dtype* bottom_data, Dtype* bottom_diff, bool propagate_down,
+        int slice);
+
     int kernel_size_;
     int kernel_depth_;
     int stride_;
@@ -70,6 +90,29 @@ protected:
     int num_output_;
     int filter_group_;
     Blob<Dtype> col_buffer_;
+    // filters interleaved for the DIRECT forward pass, and the version of the
+    // weights they were packed from (see SyncedMemory::version)
+    Blob<Dtype> packed_weight_;
+    uint64_t packed_weight_version_;
+    // column buffers and weight-gradient partials of batch slices 1, 2, ...
+    // (slice 0 uses col_buffer_ and the weight diff itself)
+    vector<shared_ptr<Blob<Dtype> > > slice_col_buffers_;
+    vector<shared_ptr<Blob<Dtype> > > slice_weight_diffs_;
+    // int8 weights, quantized again whenever the weights change, and the
+    // int8 input, column and sum buffers of every batch slice
+    Int8Weights<Dtype> int8_weights_;
+    uint64_t int8_weights_version_;
+    vector<vector<int8_t> > int8_inputs_;
+    vector<vector<int8_t> > int8_col_buffers_;
+    vector<vector<int32_t> > int8_sums_;
+    // 16-bit weights (see LayerParameter.storage_precision), narrowed again
+    // whenever the weights change, and the 16-bit input and column buffers
+    // of every batch slice
+    void narrow_weights();
+    vector<uint16_t> half_weights_;
+    uint64_t half_weights_version_;
+    vector<vector<uint16_t> > half_inputs_;
+    vector<vector<uint16_t> > half_col_buffers_;
     shared_ptr<SyncedMemory> bias_multiplier_;
     bool bias_term_;
     int M_;
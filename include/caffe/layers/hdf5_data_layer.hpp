@@ -7,23 +7,34 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 #include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/ring_queue.hpp"
 
 namespace caffe {
 
+/// @brief One prefetched batch of HDF5DataLayer, a blob per top.
+template <typename Dtype>
+class HDF5Batch {
+ public:
+  vector<shared_ptr<Blob<Dtype> > > blobs_;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
- * TODO(dox): thorough documentation for Forward and proto params.
+ * Files, or chunks of chunk_rows rows of them, are read on a loader thread
+ * while the previous one is being output, and the (shuffled) rows of every
+ * batch are gathered ahead of the net on the prefetch thread, so Forward
+ * only hands over a ready batch. See HDF5DataParameter.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
  public:
-  explicit HDF5DataLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+  explicit HDF5DataLayer(const LayerParameter& param);
   virtual ~HDF5DataLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -38,6 +49,12 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual inline int MinTopBlobs() const { return 1; }
 
  protected:
+  // Consecutive rows of a file and the order to output them in.
+  struct Chunk {
+    vector<shared_ptr<Blob<Dtype> > > blobs;
+    vector<unsigned int> permutation;
+  };
+
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
@@ -46,15 +63,39 @@ class HDF5DataLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {}
-  virtual void LoadHDF5FileData(const char* filename);
+  virtual void InternalThreadEntry();
+  // Moves on to the next chunk (of the next file if needed) and reads it;
+  // seed drives the shuffling of the files and chunks.
+  void LoadNextChunk(Chunk* chunk, unsigned int seed);
+  // Continues with the chunk loaded meanwhile and starts loading the next.
+  void NextChunk();
+  void StopLoader();
+  void ShuffleRows(Chunk* chunk);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
-  unsigned int current_file_;
-  hsize_t current_row_;
-  std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
-  std::vector<unsigned int> data_permutation_;
+  // Where the loader is: the file of file_permutation_, its open handle and
+  // the chunk of chunk_permutation_, the first rows of the chunks of the
+  // file.
+  int current_file_;
+  hid_t current_file_id_;
+  int current_file_rows_;
+  int current_chunk_;
   std::vector<unsigned int> file_permutation_;
+  std::vector<int> chunk_permutation_;
+  // Everything fits in one chunk, which is then kept.
+  bool single_chunk_;
+  // The chunk batches are gathered from, its next row, and the next chunk.
+  shared_ptr<Chunk> chunk_;
+  hsize_t current_row_;
+  shared_ptr<Chunk> next_chunk_;
+  shared_ptr<boost::thread> loader_;
+
+  vector<shared_ptr<HDF5Batch<Dtype> > > prefetch_;
+  RingQueue<HDF5Batch<Dtype>*> prefetch_free_;
+  RingQueue<HDF5Batch<Dtype>*> prefetch_full_;
+  // The batch the tops point to after Forward_cpu with a single solver.
+  HDF5Batch<Dtype>* prefetch_current_;
 };
 
 }  // namespace caffe
@@ -6,6 +6,8 @@
 #include "caffe/blob.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
+#include "caffe/util/int8.hpp"
 
 namespace caffe {
 
@@ -19,11 +21,13 @@ template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
  public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), int8_weights_version_(0),
+        half_weights_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  virtual size_t ReleaseFloatWeights();
 
   virtual inline const char* type() const { return "InnerProduct"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
@@ -45,6 +49,18 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+  /// int8 forward pass (see QuantizationParameter), with the weights
+  /// quantized again on the first call after they change
+  void forward_cpu_int8(const Blob<Dtype>& bottom, Dtype* top_data);
+  Int8Weights<Dtype> int8_weights_;
+  uint64_t int8_weights_version_;
+  vector<int8_t> int8_input_;
+  vector<int32_t> int8_sums_;
+  /// 16-bit weights (see LayerParameter.storage_precision), narrowed again
+  /// on the first 16-bit forward pass after the weights change
+  void narrow_weights();
+  vector<uint16_t> half_weights_;
+  uint64_t half_weights_version_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,98 @@
+#ifndef CAFFE_MULTI_LABEL_METRIC_LAYER_HPP_
+#define CAFFE_MULTI_LABEL_METRIC_LAYER_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Computes the mean average precision, the per-class average
+ *        precision and the micro and macro F1 score of multi-label
+ *        predictions over all the samples seen since the last
+ *        ResetStatistics, e.g. a whole test pass.
+ *
+ * The scores of every class are kept in a histogram of num_bins bins over
+ * [0, 1] per label value, so the memory is O(classes x bins) however many
+ * samples are evaluated, and samples whose scores share a bin count as
+ * tied. See MultiLabelMetricParameter.
+ */
+template <typename Dtype>
+class MultiLabelMetricLayer : public Layer<Dtype> {
+ public:
+  explicit MultiLabelMetricLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void ResetStatistics();
+
+  virtual inline const char* type() const { return "MultiLabelMetric"; }
+  virtual inline int ExactNumBottomBlobs() const { return 2; }
+  virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline int MaxTopBlobs() const { return 4; }
+
+  /// @brief The metrics over the samples seen so far: mAP, micro F1,
+  ///        macro F1, then the AP of every class.
+  vector<Dtype> Metrics() const;
+
+ protected:
+  /**
+   * @param bottom input Blob vector (length 2)
+   *   -# @f$ (N \times L \times ...) @f$
+   *      the scores of the @f$ L @f$ classes, logits unless
+   *      apply_sigmoid is false
+   *   -# @f$ (N \times L \times ...) @f$
+   *      the labels, 1 (or more than 0.5) for the classes present
+   * @param top output Blob vector (length 1 to 4)
+   *   -# @f$ () @f$ the mAP over the classes with a positive sample
+   *   -# @f$ () @f$ the micro F1 score at the threshold
+   *   -# @f$ () @f$ the macro F1 score at the threshold
+   *   -# @f$ (L) @f$ the AP of every class (0 without a positive sample)
+   *
+   * The outputs of the t-th pass since the reset are t times the metrics
+   * minus t - 1 times those of the pass before, so that their mean over the
+   * passes, as reported by the solver and caffe test, is the metric over
+   * all their samples. An output on its own is not a metric (it can even
+   * fall outside [0, 1]); only that mean is meaningful, and Metrics() gives
+   * the value after a pass.
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  /// @brief Not implemented -- MultiLabelMetricLayer cannot be used as a
+  ///        loss.
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    for (int i = 0; i < propagate_down.size(); ++i) {
+      if (propagate_down[i]) { NOT_IMPLEMENTED; }
+    }
+  }
+
+  int num_classes_;
+  int num_bins_;
+  /// Score histograms of the positive and negative samples of every class,
+  /// num_classes_ x num_bins_.
+  vector<int64_t> positives_;
+  vector<int64_t> negatives_;
+  /// Counts at the threshold of every class.
+  vector<int64_t> true_positives_;
+  vector<int64_t> false_positives_;
+  vector<int64_t> false_negatives_;
+  /// Forward passes since the reset and the metrics after the last one.
+  int passes_;
+  vector<double> last_metrics_;
+
+ private:
+  vector<double> ComputeMetrics() const;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_MULTI_LABEL_METRIC_LAYER_HPP_
@@ -1,6 +1,8 @@
 #ifndef MULTI_LABEL_VIDEO_DATA_LAYER_HPP_
 #define MULTI_LABEL_VIDEO_DATA_LAYER_HPP_
 
+#include <stdint.h>
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -11,6 +13,9 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/clip_cache.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/video_frame_reader.hpp"
 
 // an extension the std::pair which used to store image filename and
 // its label (int). now, a frame number associated with the video filename
@@ -44,10 +49,36 @@ class MultiLabelVideoDataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleVideos();
+  // Puts the clips of each video next to each other, for sequential_decode.
+  void GroupVideos();
+  // Shape of the transformed clip of line, for a batch of one.
+  vector<int> InferClipShape(const triplet& line);
   virtual void load_batch(Batch<Dtype>* batch);
+  // Decodes and transforms the batch items worker, worker + num_workers, ...
+  void load_batch_items(Batch<Dtype>* batch, Dtype* prefetch_data,
+      Dtype* prefetch_label, int worker);
 
   vector<triplet> lines_;
   int lines_id_;
+  // Set when reading from a clip_cache; lines_ then hold clip indices.
+  shared_ptr<ClipCache> clip_cache_;
+
+  // Decode workers (see MultiLabelVideoDataParameter.num_workers). Each one
+  // has its own transformer; the clips and transformer seeds of the batch
+  // being loaded are fixed up front on the prefetch thread, in item order.
+  // The seed of clip n loaded since setup comes from stream n of
+  // clip_rng_seed_ (see CounterRng); clip_id_ is the next n.
+  shared_ptr<ThreadPool> decode_pool_;
+  vector<shared_ptr<DataTransformer<Dtype> > > worker_transformers_;
+  vector<shared_ptr<Blob<Dtype> > > worker_transformed_data_;
+  vector<double> worker_read_time_;
+  vector<double> worker_trans_time_;
+  vector<triplet> batch_lines_;
+  vector<unsigned int> batch_seeds_;
+  unsigned int clip_rng_seed_;
+  uint64_t clip_id_;
+  // One per decode worker with sequential_decode.
+  vector<shared_ptr<VideoFrameReader> > worker_readers_;
 };
 
 
@@ -0,0 +1,38 @@
+#ifndef CAFFE_NDCONV_LAYER_HPP_
+#define CAFFE_NDCONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief CPU (CAFFE engine) implementation of the "NdConvolution" layer.
+ *
+ *   Accepts the same parameters as CudnnNdConvolutionLayer, i.e. the
+ *   kernel_shape / pad_shape / stride_shape BlobShapes of ConvolutionParameter,
+ *   and stores its weights in the same [num_output, channels / group, k_0, ...]
+ *   layout, so models trained with the cuDNN engine can be run on the CPU
+ *   unchanged. The shapes are translated to the repeated kernel_size / pad /
+ *   stride fields, and the work is done by ConvolutionLayer, which unrolls 3-D
+ *   inputs with vol2col and multiplies with BLAS gemm.
+ *
+ *   Unlike the cuDNN engine, output axes of size one are kept, so the top
+ *   always has as many axes as the bottom.
+ */
+template <typename Dtype>
+class NdConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit NdConvolutionLayer(const LayerParameter& param);
+
+  virtual inline const char* type() const { return "NdConvolution"; }
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NDCONV_LAYER_HPP_
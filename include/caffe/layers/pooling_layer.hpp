@@ -12,6 +12,11 @@ namespace caffe {
 /**
  * @brief Pools the input image by taking the max, average, etc. within regions.
  *
+ * 5-axis (num, channels, length, height, width) inputs are pooled frame by
+ * frame unless the kernel is given as a 3-D kernel_shape, in which case the
+ * regions also extend over length. The CPU implementation splits the
+ * num x channels planes over ThreadPool::Get().
+ *
  * TODO(dox): thorough documentation for Forward, Backward, and proto params.
  */
 template <typename Dtype>
@@ -44,17 +49,54 @@ class PoolingLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
 
-  int kernel_h_, kernel_w_;
-  int stride_h_, stride_w_;
-  int pad_h_, pad_w_;
+  // Per-plane CPU kernels, called from ThreadPool::Run.
+  void MaxPoolForwardPlane(const Dtype* bottom_data, Dtype* top_data,
+      int* mask, Dtype* top_mask, int plane);
+  void AvePoolForwardPlane(const Dtype* bottom_data, Dtype* top_data,
+      int plane);
+  void MaxPoolBackwardPlane(const Dtype* top_diff, const int* mask,
+      const Dtype* top_mask, Dtype* bottom_diff, int plane);
+  void AvePoolBackwardPlane(const Dtype* top_diff, Dtype* bottom_diff,
+      int plane);
+
+  int kernel_l_, kernel_h_, kernel_w_;
+  int stride_l_, stride_h_, stride_w_;
+  int pad_l_, pad_h_, pad_w_;
   int channels_;
-  int height_, width_;
-  int pooled_height_, pooled_width_;
+  int length_, height_, width_;
+  int pooled_length_, pooled_height_, pooled_width_;
   bool global_pooling_;
+  // Whether global pooling also covers the length axis of 5-axis inputs.
+  bool global_pooling_length_;
+  // The CPU kernels work on num_planes_ independent planes of
+  // plane_length_ x height_ x width_ inputs. When the length axis is not
+  // pooled, every frame is a plane of its own.
+  int num_planes_;
+  int plane_length_, pooled_plane_length_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
 };
 
+/**
+ * @brief CPU (CAFFE engine) implementation of the "NdPooling" layer.
+ *
+ * Takes its kernel from the kernel_shape / pad_shape / stride_shape
+ * BlobShapes of PoolingParameter, one entry per spatial axis, and computes
+ * the same output shape as CudnnNdPoolingLayer. AVE pooling counts padded
+ * elements in the pooling region, like CUDNN_POOLING_AVERAGE_COUNT_INCLUDE_
+ * PADDING. Global pooling covers all spatial axes, length included.
+ */
+template <typename Dtype>
+class NdPoolingLayer : public PoolingLayer<Dtype> {
+ public:
+  explicit NdPoolingLayer(const LayerParameter& param)
+      : PoolingLayer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "NdPooling"; }
+};
+
 }  // namespace caffe
 
 #endif  // CAFFE_POOLING_LAYER_HPP_
@@ -1,6 +1,8 @@
 #ifndef CAFFE_VIDEO_DATA_LAYER_HPP_
 #define CAFFE_VIDEO_DATA_LAYER_HPP_
 
+#include <stdint.h>
+
 #include <string>
 #include <utility>
 #include <vector>
@@ -47,6 +49,10 @@ class VideoDataLayer : public BasePrefetchingDataLayer<Dtype> {
 
   vector<triplet> lines_;
   int lines_id_;
+  // Clip n loaded since setup is transformed with stream n of
+  // clip_rng_seed_ (see CounterRng); clip_id_ is the next n.
+  unsigned int clip_rng_seed_;
+  uint64_t clip_id_;
 };
 
 
@@ -14,6 +14,8 @@
 
 namespace caffe {
 
+template <typename Dtype> class NetProfiler;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -65,6 +67,15 @@ class Net {
    */
   void ClearParamDiffs();
 
+  /// @brief Calls Layer::ResetStatistics on every layer.
+  void ResetStatistics();
+  /**
+   * @brief Calls Layer::ReleaseFloatWeights on every layer of a CPU
+   *        inference net, once its trained weights are loaded, and returns
+   *        the bytes freed.
+   */
+  size_t ReleaseFloatWeights();
+
   /**
    * The network backward should take no input and output, since it solely
    * computes the gradient w.r.t the parameters, and the data has already been
@@ -83,6 +94,19 @@ class Net {
    */
   void Reshape();
 
+  /**
+   * @brief For inference, lets the activations whose lifetimes do not overlap
+   *        share memory, and returns the bytes saved.
+   *
+   * A liveness pass over the layers assigns each blob the range of layers
+   * from its producer to its last consumer, and packs the blobs into shared
+   * buffers without overlapping ranges. The net inputs and outputs, the tops
+   * of layers without bottoms (data layers) and the preserved blobs keep
+   * their own memory, so only those are meaningful after Forward. Backward
+   * must not be run afterwards.
+   */
+  size_t PlanInferenceMemory(const vector<string>& preserved_blobs);
+
   Dtype ForwardBackward() {
     Dtype loss;
     Forward(&loss);
@@ -216,6 +240,12 @@ class Net {
   const shared_ptr<Layer<Dtype> > layer_by_name(const string& layer_name) const;
 
   void set_debug_info(const bool value) { debug_info_ = value; }
+  /**
+   * @brief Times and accounts every layer call of ForwardFromTo and
+   *        BackwardFromTo with the given profiler, or stops if NULL.
+   *        The profiler is not owned by the net.
+   */
+  void set_profiler(NetProfiler<Dtype>* profiler) { profiler_ = profiler; }
 
   // Helpers for Init.
   /**
@@ -224,6 +254,15 @@ class Net {
    */
   static void FilterNet(const NetParameter& param,
       NetParameter* param_filtered);
+  /**
+   * @brief Fold the BatchNorm and Scale layers that follow a convolution into
+   *        it, and fuse a following ReLU into its output pass, for inference
+   *        (see NetParameter.fuse_layers). The folded layers are kept in the
+   *        convolution's folded_layer so that CopyTrainedLayersFrom can fold
+   *        their trained weights.
+   */
+  static void FuseLayers(const NetParameter& param,
+      NetParameter* param_fused);
   /// @brief return whether NetState state meets NetStateRule rule
   static bool StateMeetsRule(const NetState& state, const NetStateRule& rule,
       const string& layer_name);
@@ -242,6 +281,11 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Folds the trained weights of the layers in folded_blobs, by
+  ///        name, into the convolutions FuseLayers folded them into.
+  void FoldTrainedLayers(
+      const map<string, vector<shared_ptr<Blob<Dtype> > > >& folded_blobs);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -257,6 +301,8 @@ class Net {
   vector<shared_ptr<Layer<Dtype> > > layers_;
   vector<string> layer_names_;
   map<string, int> layer_names_index_;
+  /// @brief The layer each layer removed by FuseLayers was folded into.
+  map<string, int> folded_layer_owners_;
   vector<bool> layer_need_backward_;
   /// @brief the blobs storing intermediate results between the layer.
   vector<shared_ptr<Blob<Dtype> > > blobs_;
@@ -306,6 +352,8 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// The profiler of the layer calls, if any.
+  NetProfiler<Dtype>* profiler_;
   /// The root net that actually holds the shared layers in data parallelism
   const Net* const root_net_;
   DISABLE_COPY_AND_ASSIGN(Net);
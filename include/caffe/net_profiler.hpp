@@ -0,0 +1,91 @@
+#ifndef CAFFE_NET_PROFILER_HPP_
+#define CAFFE_NET_PROFILER_HPP_
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/benchmark.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Times every layer run by Net::ForwardFromTo and Net::BackwardFromTo
+ *        once attached with Net::set_profiler, and accounts the work done:
+ *        analytic FLOPs for convolution, inner product and pooling layers,
+ *        and the bytes of blob data read and written, from the blob shapes at
+ *        the time of the call.
+ *
+ * Results are reported as per-layer time percentiles and achieved GFLOP/s and
+ * GB/s, logged or written as JSON, and as a Chrome trace (chrome://tracing)
+ * of the individual calls.
+ */
+template <typename Dtype>
+class NetProfiler {
+ public:
+  explicit NetProfiler(const Net<Dtype>& net);
+
+  /// @brief Called by the net around each layer call.
+  void StartLayer(int layer_id, bool backward);
+  void StopLayer();
+
+  /// @brief Drops all the samples recorded so far.
+  void Clear();
+
+  /// @brief Number of recorded calls of a layer.
+  int calls(int layer_id, bool backward) const;
+  /// @brief The q-th percentile (0 to 100) of the call times of a layer, in ms.
+  double Percentile(int layer_id, bool backward, double q) const;
+  /// @brief FLOPs and bytes summed over the recorded calls of a layer.
+  double flops(int layer_id, bool backward) const;
+  double bytes_read(int layer_id, bool backward) const;
+  double bytes_written(int layer_id, bool backward) const;
+
+  /// @brief The FLOPs of one call of a layer with its current shapes.
+  double LayerFlops(int layer_id, bool backward) const;
+
+  void LogSummary() const;
+  void WriteJSON(const string& filename) const;
+  void WriteChromeTrace(const string& filename) const;
+
+ protected:
+  struct Record {
+    Record() : flops(0), bytes_read(0), bytes_written(0) {}
+    vector<float> milliseconds;
+    double flops;
+    double bytes_read;
+    double bytes_written;
+  };
+  struct TraceEvent {
+    int layer_id;
+    bool backward;
+    double start_us;
+    double duration_us;
+  };
+
+  inline const Record& record(int layer_id, bool backward) const {
+    return records_[backward][layer_id];
+  }
+  void LayerBytes(int layer_id, bool backward, double* read,
+      double* written) const;
+  double total_milliseconds(bool backward) const;
+
+  const Net<Dtype>& net_;
+  vector<Record> records_[2];
+  vector<TraceEvent> events_;
+  Timer timer_;
+  boost::posix_time::ptime origin_;
+  boost::posix_time::ptime start_;
+  int layer_id_;
+  bool backward_;
+
+  DISABLE_COPY_AND_ASSIGN(NetProfiler);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_NET_PROFILER_HPP_
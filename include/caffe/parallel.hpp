@@ -14,6 +14,8 @@
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
+namespace boost { class barrier; }
+
 namespace caffe {
 
 // Represents a net parameters. Once a net is created, its parameter buffers can
@@ -59,6 +61,26 @@ class GPUParams : public Params<Dtype> {
   using Params<Dtype>::diff_;
 };
 
+// Params stored in host memory. Solvers on the same machine can share one
+// copy of the weights, while each keeps its own gradient.
+template<typename Dtype>
+class CPUParams : public Params<Dtype> {
+ public:
+  // Allocates weights initialized from root_solver, or uses shared_data.
+  CPUParams(shared_ptr<Solver<Dtype> > root_solver, Dtype* shared_data);
+  virtual ~CPUParams();
+
+  void configure(Solver<Dtype>* solver) const;
+
+ protected:
+  const bool owns_data_;
+  bool use_cuda_;
+
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
 class DevicePair {
  public:
   DevicePair(int parent, int device)
@@ -116,6 +138,48 @@ class P2PSync : public GPUParams<Dtype>, public Solver<Dtype>::Callback,
   using Params<Dtype>::diff_;
 };
 
+// Synchronous data parallelism between solvers running on CPU threads. The
+// solvers share the root's weights, so nothing is broadcast. Each computes
+// the gradient of its own batches, taken from the data layers shared with the
+// root net, then all of them sum a slice of the gradients into the root's
+// buffer at once (the reduce-scatter half of a ring all-reduce, without the
+// copies since memory is shared).
+template<typename Dtype>
+class CPUSync : public CPUParams<Dtype>, public Solver<Dtype>::Callback,
+    public InternalThread {
+ public:
+  explicit CPUSync(shared_ptr<Solver<Dtype> > root_solver);
+  virtual ~CPUSync();
+
+  inline const shared_ptr<Solver<Dtype> >& solver() const {
+    return solver_;
+  }
+
+  // Trains with solver_count() solvers, the root one on the calling thread.
+  void Run();
+
+ protected:
+  CPUSync(shared_ptr<Solver<Dtype> > root_solver, CPUSync<Dtype>* root,
+          int rank);
+
+  void on_start();
+  void on_gradients_ready();
+
+  void InternalThreadEntry();
+
+  CPUSync<Dtype>* root_;
+  const int rank_;
+  const int initial_iter_;
+  shared_ptr<Solver<Dtype> > solver_;
+  // Set up by the root and used by all solvers.
+  vector<CPUSync<Dtype>*> syncs_;
+  shared_ptr<boost::barrier> barrier_;
+
+  using Params<Dtype>::size_;
+  using Params<Dtype>::data_;
+  using Params<Dtype>::diff_;
+};
+
 }  // namespace caffe
 
 #endif
@@ -0,0 +1,73 @@
+#ifndef CAFFE_TEST_PRECISION_CHECK_UTIL_H_
+#define CAFFE_TEST_PRECISION_CHECK_UTIL_H_
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// Runs a float layer and a reduced precision one (int8 or 16 bits, as set in
+// reduced_param) with the same weights, and expects their outputs to agree
+// to within tolerance times the largest float output. The weights are then
+// scaled by -0.5 and both layers run again, so that a layer keeping weights
+// converted from the old values fails. Last, a 16-bit layer must give the
+// same output after releasing its float weights.
+template <template <typename> class LayerType, typename Dtype>
+void CheckReducedPrecisionForward(const LayerParameter& float_param,
+    const LayerParameter& reduced_param, const double tolerance,
+    const vector<Blob<Dtype>*>& bottom) {
+  Blob<Dtype> expected;
+  Blob<Dtype> actual;
+  vector<Blob<Dtype>*> expected_vec(1, &expected);
+  vector<Blob<Dtype>*> actual_vec(1, &actual);
+  LayerType<Dtype> float_layer(float_param);
+  float_layer.SetUp(bottom, expected_vec);
+  LayerType<Dtype> reduced_layer(reduced_param);
+  reduced_layer.SetUp(bottom, actual_vec);
+  ASSERT_EQ(float_layer.blobs().size(), reduced_layer.blobs().size());
+  for (int round = 0; round < 2; ++round) {
+    if (round > 0) {
+      caffe_scal(float_layer.blobs()[0]->count(), Dtype(-0.5),
+          float_layer.blobs()[0]->mutable_cpu_data());
+    }
+    for (int i = 0; i < float_layer.blobs().size(); ++i) {
+      reduced_layer.blobs()[i]->CopyFrom(*float_layer.blobs()[i]);
+    }
+    float_layer.Forward(bottom, expected_vec);
+    reduced_layer.Forward(bottom, actual_vec);
+    ASSERT_EQ(expected.shape(), actual.shape());
+    Dtype max_abs = 0;
+    for (int i = 0; i < expected.count(); ++i) {
+      max_abs = std::max(max_abs, std::fabs(expected.cpu_data()[i]));
+    }
+    for (int i = 0; i < expected.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], actual.cpu_data()[i],
+          tolerance * max_abs);
+    }
+  }
+  expected.CopyFrom(actual, false, true);
+  const bool half = reduced_param.quantization_param().input_range_size() == 0;
+  const size_t released = reduced_layer.ReleaseFloatWeights();
+  EXPECT_EQ(half ? reduced_layer.blobs()[0]->count() * sizeof(Dtype) : 0,
+      released);
+  reduced_layer.Forward(bottom, actual_vec);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], actual.cpu_data()[i]);
+  }
+  if (half) {
+    EXPECT_EQ(SyncedMemory::UNINITIALIZED,
+        reduced_layer.blobs()[0]->data()->head());
+  }
+}
+
+}  // namespace caffe
+
+#endif  // CAFFE_TEST_PRECISION_CHECK_UTIL_H_
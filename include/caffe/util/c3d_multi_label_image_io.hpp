@@ -43,8 +43,13 @@ void BufferToGrayImage(const char* buffer, const int h, const int w, cv::Mat* im
 void BufferToColorImage(const char* buffer, const int height, const int width, cv::Mat* img);
 
 
+class CounterRng;
+
+// With start_frm < 0 the clip starts at a random frame, drawn from rng if
+// given, else from caffe_rng_rand().
 bool ReadVideoToVolumeDatum(const char* filename, const int start_frm, const vector<int>& label,
-		const int length, const int height, const int width, const int sampling_rate, C3DMultiLabelVolumeDatum* datum);
+		const int length, const int height, const int width, const int sampling_rate, C3DMultiLabelVolumeDatum* datum,
+		CounterRng* rng = NULL);
 
 inline bool ReadVideoToVolumeDatum(const char* filename, const int start_frm, const vector<int>& label,
 		const int length, const int sampling_rate, C3DMultiLabelVolumeDatum* datum){
@@ -59,12 +64,25 @@ inline bool ReadImageSequenceToVolumeDatum(const char* img_dir, const int start_
 	return ReadImageSequenceToVolumeDatum(img_dir, start_frm, label, length, 0, 0, sampling_rate, datum);
 }
 
+class VideoFrameReader;
+
+// Reads the clip from a video or a folder of frames through reader, which
+// keeps it open between calls and reuses the frames shared with the previous
+// clip; the frame size is the reader's.
+bool ReadFramesToVolumeDatum(VideoFrameReader* reader, const char* filename, const int start_frm,
+		const vector<int>& label, const int length, const int sampling_rate, C3DMultiLabelVolumeDatum* datum);
+
 template <typename Dtype>
 bool load_blob_from_binary(const string fn_blob, Blob<Dtype>* blob);
 
 template <typename Dtype>
 bool load_blob_from_uint8_binary(const string fn_blob, Blob<Dtype>* blob);
 
+// Reads the files of save_blob_to_half_binary (caffe/util/image_io.hpp).
+template <typename Dtype>
+bool load_blob_from_half_binary(const string fn_blob, Blob<Dtype>* blob,
+		LayerParameter_StoragePrecision precision);
+
 //template <typename Dtype>
 //bool save_blob_to_binary(Blob<Dtype>* blob, const string fn_blob, int num_index);
 //
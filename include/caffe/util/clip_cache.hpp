@@ -0,0 +1,96 @@
+#ifndef CAFFE_UTIL_CLIP_CACHE_HPP_
+#define CAFFE_UTIL_CLIP_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Pre-decoded video clips in a single file, written by
+ *        tools/convert_clip_cache and read back memory-mapped by ClipCache.
+ *
+ * Each clip is stored as uint8 pixels in channels x length x height x width
+ * order (the layout of a video blob) together with its label vector, so
+ * reading a clip costs no decoding, resizing or copying. The layout, in native
+ * byte order, is
+ *
+ *   header  char[8] "C3DCLIPS", uint32 version, uint32 num_clips,
+ *           uint64 index_offset
+ *   clips   one record per clip, aligned to kAlignment bytes:
+ *           int32 labels[num_labels], then the pixels
+ *   index   one ClipCacheEntry per clip
+ */
+struct ClipCacheEntry {
+  uint64_t offset;  // of the clip record from the start of the file
+  int32_t channels;
+  int32_t length;
+  int32_t height;
+  int32_t width;
+  int32_t num_labels;
+  int32_t reserved;
+};
+
+class ClipCacheWriter {
+ public:
+  explicit ClipCacheWriter(const string& filename);
+  ~ClipCacheWriter();
+
+  /** Appends a clip of channels x length x height x width uint8 pixels. */
+  void Add(const uint8_t* data, int channels, int length, int height,
+      int width, const vector<int>& labels);
+  /** Writes the index and the header; called by the destructor if needed. */
+  void Close();
+
+  int size() const { return index_.size(); }
+
+ protected:
+  void Write(const void* data, size_t size);
+
+  string filename_;
+  FILE* file_;
+  uint64_t offset_;
+  vector<ClipCacheEntry> index_;
+
+  DISABLE_COPY_AND_ASSIGN(ClipCacheWriter);
+};
+
+class ClipCache {
+ public:
+  explicit ClipCache(const string& filename);
+  ~ClipCache();
+
+  int size() const { return num_clips_; }
+  const ClipCacheEntry& entry(int i) const {
+    CHECK_GE(i, 0);
+    CHECK_LT(i, num_clips_);
+    return index_[i];
+  }
+  /** The pixels of clip i, channels x length x height x width uint8. */
+  const uint8_t* data(int i) const {
+    return data_ + entry(i).offset + entry(i).num_labels * sizeof(int32_t);
+  }
+  const int32_t* labels(int i) const {
+    return reinterpret_cast<const int32_t*>(data_ + entry(i).offset);
+  }
+
+  static const uint32_t kVersion = 1;
+  static const int kAlignment = 64;
+
+ protected:
+  const uint8_t* data_;
+  size_t size_;
+  int num_clips_;
+  const ClipCacheEntry* index_;
+
+  DISABLE_COPY_AND_ASSIGN(ClipCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_CLIP_CACHE_HPP_
@@ -0,0 +1,42 @@
+#ifndef CAFFE_UTIL_HALF_HPP_
+#define CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+typedef LayerParameter_StoragePrecision StoragePrecision;
+
+// IEEE binary16 and bfloat16 bits of a float, rounded to nearest even, and
+// back. Overflows become infinities and NaNs stay NaNs.
+uint16_t caffe_float_to_fp16(float x);
+float caffe_fp16_to_float(uint16_t h);
+uint16_t caffe_float_to_bf16(float x);
+float caffe_bf16_to_float(uint16_t h);
+
+// y = x in the 16-bit format of precision (FP16 or BF16), and back.
+template <typename Dtype>
+void caffe_cpu_narrow(const StoragePrecision precision, const int n,
+    const Dtype* x, uint16_t* y);
+template <typename Dtype>
+void caffe_cpu_widen(const StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y);
+
+// C = A * B for row-major matrices, where B (K x N, or N x K if
+// TransB == CblasTrans) and A (M x K) if TA is uint16_t hold 16-bit values
+// of precision. Blocks of the 16-bit operands are widened into small
+// buffers that stay in cache and multiplied with the BLAS gemm, so the
+// 16-bit matrices are only read once per block of C. The blocks of columns
+// of C are split over the CPU thread pool.
+template <typename Dtype, typename TA>
+void caffe_cpu_gemm_half(const StoragePrecision precision,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const TA* A, const uint16_t* B, Dtype* C);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HALF_HPP_
@@ -1,7 +1,9 @@
 #ifndef CAFFE_UTIL_HDF5_H_
 #define CAFFE_UTIL_HDF5_H_
 
+#include <boost/thread/recursive_mutex.hpp>
 #include <string>
+#include <vector>
 
 #include "hdf5.h"
 #include "hdf5_hl.h"
@@ -10,6 +12,15 @@
 
 namespace caffe {
 
+// HDF5 is usually built without thread safety, so all calls into it take
+// turns under this lock, e.g. the HDF5Data loader threads and a snapshot of
+// the root solver. The helpers below take it; callers making HDF5 calls of
+// their own hold it for the whole file, which is why it is recursive.
+boost::recursive_mutex& hdf5_mutex();
+
+std::vector<int> hdf5_get_nd_dataset_shape(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim);
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -20,6 +31,14 @@ void hdf5_load_nd_dataset(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob);
 
+// Loads rows [row_begin, row_begin + num_rows) of the first axis through a
+// hyperslab selection, so that only those are read (and decompressed) even
+// if the dataset is much larger.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    int row_begin, int num_rows, Blob<Dtype>* blob);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
@@ -0,0 +1,112 @@
+#ifndef CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace boost { class mutex; }
+
+namespace caffe {
+
+/// @brief Counters of a HostAllocator, in bytes where applicable.
+struct HostAllocatorStats {
+  HostAllocatorStats()
+      : allocations(0), frees(0), bytes_in_use(0), high_water_mark(0),
+        bytes_reserved(0) {}
+  size_t allocations;
+  size_t frees;
+  /// Requested by the live allocations.
+  size_t bytes_in_use;
+  /// Maximum of bytes_in_use so far.
+  size_t high_water_mark;
+  /// Obtained from the system, including the memory cached for reuse.
+  size_t bytes_reserved;
+};
+
+/**
+ * @brief The allocator of the host memory of SyncedMemory (CaffeMallocHost
+ *        and CaffeFreeHost) when it is not pinned for CUDA.
+ *
+ * Memory must be freed with the size it was allocated with. The allocator is
+ * process-wide and may only be replaced while none of its memory is in use,
+ * typically at the start of main.
+ */
+class HostAllocator {
+ public:
+  HostAllocator();
+  virtual ~HostAllocator();
+
+  virtual void* Allocate(size_t size) = 0;
+  virtual void Free(void* ptr, size_t size) = 0;
+
+  HostAllocatorStats stats() const;
+  void LogStats() const;
+
+  /// @brief The allocator in use, malloc unless set otherwise.
+  static HostAllocator* Get();
+  /// @brief Replaces the allocator in use, which is not deleted.
+  static void Set(HostAllocator* allocator);
+  /// @brief The built-in allocators: "malloc" or "pool".
+  static HostAllocator* ByName(const string& name);
+
+ protected:
+  void CountAllocation(size_t size, size_t reserved);
+  void CountFree(size_t size, size_t released);
+
+  shared_ptr<boost::mutex> stats_mutex_;
+  HostAllocatorStats stats_;
+
+  DISABLE_COPY_AND_ASSIGN(HostAllocator);
+};
+
+/// @brief Plain malloc and free.
+class MallocHostAllocator : public HostAllocator {
+ public:
+  MallocHostAllocator() {}
+  virtual void* Allocate(size_t size);
+  virtual void Free(void* ptr, size_t size);
+};
+
+/**
+ * @brief Caches freed memory in size classes for reuse, so that blobs
+ *        reallocated by reshapes and per-batch buffers stop going through
+ *        malloc, mmap and page faults every time.
+ *
+ * Sizes are rounded up to classes of four steps per power of two (at most
+ * 25% slack). Classes up to kMaxSlabClass bytes are carved from slabs of
+ * kSlabSize bytes aligned to huge pages; larger ones get their own aligned
+ * block, backed by huge pages (madvise) from kSlabSize bytes on. Freed
+ * memory goes to the free list of its class; Trim() returns the free large
+ * blocks to the system. Thread-safe.
+ */
+class PoolHostAllocator : public HostAllocator {
+ public:
+  static const size_t kSlabSize = 2 << 20;
+  static const size_t kMaxSlabClass = 256 << 10;
+
+  PoolHostAllocator();
+  virtual ~PoolHostAllocator();
+  virtual void* Allocate(size_t size);
+  virtual void Free(void* ptr, size_t size);
+
+  /// @brief Releases the cached blocks larger than kMaxSlabClass.
+  void Trim();
+
+  /// @brief The size class of a size, and the bytes a class holds.
+  static int SizeClass(size_t size);
+  static size_t ClassSize(int size_class);
+
+ protected:
+  void* AllocateSlabBlock(int size_class);
+
+  shared_ptr<boost::mutex> mutex_;
+  std::vector<std::vector<void*> > free_lists_;
+  std::vector<void*> slabs_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -20,6 +20,12 @@ inline bool save_blob_to_binary(Blob<Dtype>* blob,
     return save_blob_to_binary(blob, fn_blob, -1);
 }
 
+// The same file with the values as FP16 or BF16 bits (see
+// LayerParameter.storage_precision), half the size of float.
+template <typename Dtype>
+bool save_blob_to_half_binary(Blob<Dtype>* blob, const string fn_blob,
+    int num_index, LayerParameter_StoragePrecision precision);
+
 
 }  // namespace caffe
 
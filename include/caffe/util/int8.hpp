@@ -0,0 +1,71 @@
+#ifndef CAFFE_UTIL_INT8_HPP_
+#define CAFFE_UTIL_INT8_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+// C = A * B for row-major int8 matrices with int32 sums, where A is M x K and
+// B is K x N (TransB == CblasNoTrans) or N x K (CblasTrans). The columns of C
+// are split over the CPU thread pool.
+void caffe_cpu_gemm_s8(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const int8_t* A, const int8_t* B, int32_t* C);
+
+/**
+ * @brief The int8 weights of a convolution or inner product layer, with the
+ *        per-channel quantization of its input (QuantizationParameter).
+ *
+ * Input channel c is quantized to q = round(x * 127 / input_range[c]),
+ * clamped to [-127, 127]. The weights of every output fold in the input
+ * scales of their columns and are quantized with a scale of their own, so
+ * output o is weight_scale[o] * sum_k w[o][k] * q[k], summed in int32.
+ */
+template <typename Dtype>
+class Int8Weights {
+ public:
+  Int8Weights() : channels_(0), num_output_(0), dim_(0) {}
+
+  /**
+   * @brief Quantizes num_output x dim weights (dim x num_output if
+   *        transposed), whose column k reads input channel
+   *        k / (dim / channels).
+   */
+  void Quantize(const QuantizationParameter& param, const int channels,
+      const int num_output, const int dim, const Dtype* weight,
+      const bool transposed = false);
+  bool empty() const { return weights_.empty(); }
+  const int8_t* data() const { return &weights_[0]; }
+  Dtype weight_scale(int o) const { return weight_scales_[o]; }
+
+  /// @brief Quantizes count inputs laid out as [...][channels][spatial].
+  void QuantizeInput(const int count, const int spatial, const Dtype* x,
+      int8_t* q) const;
+  /**
+   * @brief Writes the outputs of int32 sums laid out as
+   *        [num_output][spatial] (convolution), adding bias if not NULL and
+   *        clamping at zero if relu.
+   */
+  void DequantizeChannels(const int spatial, const int32_t* sums,
+      const Dtype* bias, const bool relu, Dtype* y) const;
+  /// @brief The same for sums laid out as [num][num_output] (inner product).
+  void DequantizeRows(const int num, const int32_t* sums, const Dtype* bias,
+      Dtype* y) const;
+
+ protected:
+  int channels_;
+  int num_output_;
+  int dim_;
+  vector<Dtype> input_multipliers_;
+  vector<int8_t> weights_;
+  vector<Dtype> weight_scales_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_INT8_HPP_
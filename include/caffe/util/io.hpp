@@ -150,6 +150,14 @@ void CVMatToDatum(const cv::Mat& cv_img, Datum* datum);
 bool ReadVideoToCVMat(const string& filename,
     const int frame_num, const int length, const int height, const int width,
     const bool is_color, std::vector<cv::Mat>* cv_imgs);
+
+class VideoFrameReader;
+
+// As above, but through reader, which keeps the video open between calls and
+// reuses the frames a clip shares with the previous one; height, width and
+// is_color are the reader's.
+bool ReadVideoToCVMat(VideoFrameReader* reader, const string& filename,
+    const int frame_num, const int length, std::vector<cv::Mat>* cv_imgs);
 #endif  // USE_OPENCV
 
 }  // namespace caffe
@@ -142,6 +142,13 @@ DEFINE_CAFFE_CPU_UNARY_FUNC(fabs, y[i] = std::fabs(x[i]));
 template <typename Dtype>
 void caffe_cpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+// Adds bias[c] (nothing if bias is NULL) to the dim values of each of the
+// channels of y and clamps them at zero, in one pass: the epilogue of a
+// convolution with a fused ReLU.
+template <typename Dtype>
+void caffe_cpu_bias_relu(const int channels, const int dim, const Dtype* bias,
+    Dtype* y);
+
 #ifndef CPU_ONLY  // GPU
 
 // Decaf gpu gemm provides an interface that is almost the same as the cpu
@@ -246,6 +253,10 @@ void caffe_gpu_fabs(const int n, const Dtype* x, Dtype* y);
 template <typename Dtype>
 void caffe_gpu_scale(const int n, const Dtype alpha, const Dtype *x, Dtype* y);
 
+template <typename Dtype>
+void caffe_gpu_bias_relu(const int channels, const int dim, const Dtype* bias,
+    Dtype* y);
+
 #define DEFINE_AND_INSTANTIATE_GPU_UNARY_FUNC(name, operation) \
 template<typename Dtype> \
 __global__ void name##_kernel(const int n, const Dtype* x, Dtype* y) { \
@@ -0,0 +1,65 @@
+#ifndef CAFFE_UTIL_RING_QUEUE_HPP_
+#define CAFFE_UTIL_RING_QUEUE_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A bounded multi-producer multi-consumer queue with the interface of
+ *        BlockingQueue, for the queues between data threads and layers.
+ *
+ * Elements sit in a ring of cells that carry a sequence number (D. Vyukov's
+ * bounded MPMC queue), so a push or a pop is a compare-and-swap on a shared
+ * position and no lock is taken while the queue is neither empty nor full.
+ * A thread that has to wait spins and yields for a while, then parks on a
+ * condition variable; the other side only takes the lock to wake parked
+ * threads. Parked waits are boost::thread interruption points, as with
+ * BlockingQueue, so InternalThread can stop a thread blocked on the queue.
+ *
+ * T must be trivially copyable and fit in an atomic, e.g. a pointer.
+ */
+template<typename T>
+class RingQueue {
+ public:
+  /// Holds up to capacity elements, rounded up to a power of two.
+  explicit RingQueue(size_t capacity);
+
+  /// Waits while the queue is full.
+  void push(const T& t);
+
+  bool try_push(const T& t);
+
+  bool try_pop(T* t);
+
+  // This logs a message if the threads needs to be blocked
+  // useful for detecting e.g. when data feeding is too slow
+  T pop(const string& log_on_wait = "");
+
+  bool try_peek(T* t);
+
+  // Return element without removing it
+  T peek();
+
+  /// The number of elements, which may be stale as soon as it returns.
+  size_t size() const;
+
+  size_t capacity() const;
+
+ protected:
+  /**
+   Keep the atomics and the synchronization fields out of the header to
+   avoid boost/NVCC issues (#1009, #1010), as BlockingQueue does.
+   */
+  class sync;
+
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(RingQueue);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_RING_QUEUE_HPP_
@@ -1,6 +1,8 @@
 #ifndef CAFFE_RNG_CPP_HPP_
 #define CAFFE_RNG_CPP_HPP_
 
+#include <stdint.h>
+
 #include <algorithm>
 #include <iterator>
 
@@ -38,6 +40,48 @@ template <class RandomAccessIterator>
 inline void shuffle(RandomAccessIterator begin, RandomAccessIterator end) {
   shuffle(begin, end, caffe_rng());
 }
+
+/**
+ * @brief A counter-based random number generator: the k-th number of stream
+ *        (seed, stream) is a hash of the three, so a stream has no state to
+ *        share and any thread can draw any stream.
+ *
+ * The video data layers draw the temporal jitter, crop and mirror of the n-th
+ * clip they load from stream n of a seed taken from caffe_rng_rand() at
+ * setup, so batches are the same whatever thread decodes each clip. Usable
+ * with shuffle() like rng_t.
+ */
+class CounterRng {
+ public:
+  typedef uint32_t result_type;
+
+  CounterRng(uint32_t seed, uint64_t stream)
+      : key_(Mix(Mix(seed) ^ stream)), counter_(0) {}
+
+  result_type operator()() {
+    return static_cast<result_type>(
+        Mix(key_ + ++counter_ * 0x9e3779b97f4a7c15ULL) >> 32);
+  }
+  /// A number in [0, n).
+  result_type Uniform(result_type n) {
+    CHECK_GT(n, 0);
+    return (*this)() % n;
+  }
+
+  static result_type min() { return 0; }
+  static result_type max() { return 0xffffffffu; }
+
+ private:
+  // The finalizer of SplitMix64.
+  static uint64_t Mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint64_t key_;
+  uint64_t counter_;
+};
 }  // namespace caffe
 
 #endif  // CAFFE_RNG_HPP_
@@ -0,0 +1,61 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+/**
+ Forward declare boost::thread instead of including boost/thread.hpp
+ to avoid a boost/NVCC issues (#1009, #1010) on OSX.
+ */
+namespace boost { class thread; }
+
+namespace caffe {
+
+/**
+ * @brief A fixed set of worker threads used to split the iterations of a
+ *        CPU loop, e.g. over the num x channels planes of a blob.
+ *
+ * The calling thread takes part in the work, so a pool of N threads keeps N
+ * cores busy with N - 1 workers. Run() falls back to a serial loop when it is
+ * called from inside one of the pool's own jobs, or while another thread is
+ * using the pool, so it can be called from anywhere without deadlocking.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(int num_threads);
+  virtual ~ThreadPool();
+
+  /** Total number of threads doing the work, the caller included. */
+  int num_threads() const { return workers_.size() + 1; }
+
+  /**
+   * Calls fn(i) for every i in [0, n) and returns once all calls are done.
+   * The order and the thread of the calls are unspecified, so fn must only
+   * write to state owned by iteration i.
+   */
+  void Run(int n, const boost::function<void(int)>& fn);
+
+  /**
+   * The process-wide pool used by the CPU layers, sized to the number of
+   * hardware threads.
+   */
+  static ThreadPool& Get();
+
+ protected:
+  class sync;
+
+  void WorkerEntry();
+  void RunChunks();
+
+  shared_ptr<sync> sync_;
+  std::vector<shared_ptr<boost::thread> > workers_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
@@ -0,0 +1,99 @@
+#ifndef CAFFE_UTIL_VIDEO_FRAME_READER_HPP_
+#define CAFFE_UTIL_VIDEO_FRAME_READER_HPP_
+
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Reads clips from a video while keeping the decoder open and the most
+ *        recently decoded frames in a ring buffer.
+ *
+ * Dense clip lists (start frames 1, 9, 17, ... of the same video) otherwise
+ * reopen the video and seek for every clip, decoding each frame once per
+ * clip that covers it. With a VideoFrameReader consecutive clips of the same
+ * video are served from the buffer where they overlap and the decoder only
+ * moves forward; it seeks only when a clip starts before the buffered frames
+ * or far beyond them.
+ *
+ * Paths to folders of extracted frames (images%04d.png) are supported too,
+ * which saves reading and resizing the overlapping images again.
+ */
+class VideoFrameReader {
+ public:
+  /**
+   * Frames are converted to color or grayscale and, if height and width are
+   * positive, resized. With pad_with_last, frames past the end of a video
+   * repeat the last decoded one instead of failing the read, as
+   * ReadVideoToCVMat does.
+   */
+  VideoFrameReader(int height, int width, bool is_color, bool pad_with_last);
+
+  /**
+   * Switches to path. Nothing happens if path is already open, which keeps
+   * the decoder position and the buffered frames.
+   */
+  bool Open(const string& path);
+  bool is_video_file() const { return is_video_file_; }
+  /** CV_CAP_PROP_FRAME_COUNT of the open video, 0 for frame folders. */
+  int num_frames() const { return num_frames_; }
+
+  /**
+   * Appends frames start, start + step, ... (length of them) of the open path
+   * to frames. Video frames are numbered from 0 in decoding order, folder
+   * frames by the number in their file name. The returned frames share data
+   * with the buffer and must not be modified.
+   */
+  bool Read(int start, int length, int step, std::vector<cv::Mat>* frames);
+
+  /** Frames decoded and seeks made since construction. */
+  int decoded_frames() const { return decoded_frames_; }
+  int seeks() const { return seeks_; }
+
+ protected:
+  bool ReadFrame(int frame, cv::Mat* img);
+  bool DecodeFrame(int frame, cv::Mat* img);
+  void Convert(const cv::Mat& origin, cv::Mat* img);
+
+  const int height_;
+  const int width_;
+  const bool is_color_;
+  const bool pad_with_last_;
+
+  string path_;
+  bool is_video_file_;
+  cv::VideoCapture cap_;
+  int num_frames_;
+  // The next frame the decoder returns and the first one it failed on.
+  int position_;
+  int end_of_stream_;
+  cv::Mat last_frame_;
+  // Frame f is buffered in slot f % ring_.size() if ring_frame_ says so.
+  std::vector<cv::Mat> ring_;
+  std::vector<int> ring_frame_;
+
+  int decoded_frames_;
+  int seeks_;
+
+  DISABLE_COPY_AND_ASSIGN(VideoFrameReader);
+};
+
+/**
+ * @brief Returns the order in which to visit clips so that the clips of each
+ *        file are consecutive and in increasing start frame order; files keep
+ *        the order of their first clip.
+ */
+std::vector<int> GroupClipsByFile(const std::vector<string>& files,
+    const std::vector<int>& start_frames);
+
+}  // namespace caffe
+
+#endif  // USE_OPENCV
+#endif  // CAFFE_UTIL_VIDEO_FRAME_READER_HPP_
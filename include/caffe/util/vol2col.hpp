@@ -31,6 +31,29 @@ void col2vol_cpu(const Dtype* data_col, const int channels, const int length,
     const int height, const int width, const int ksize, const int kdepth, const int pad,
     const int temporal_pad, const int stride, const int temporal_stride, Dtype* data_im);
 
+// Generalized vol2col/col2vol: kernel size, padding, stride and dilation are
+// given separately for the length, height and width axes. The column buffer
+// has the same layout as the square-kernel versions above, i.e.
+// (channels * kernel_l * kernel_h * kernel_w) x (length_col * height_col *
+// width_col).
+template <typename Dtype>
+void vol2col_cpu(const Dtype* data_im, const int channels, const int length,
+    const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    Dtype* data_col);
+
+template <typename Dtype>
+void col2vol_cpu(const Dtype* data_col, const int channels, const int length,
+    const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    Dtype* data_im);
+
 template <typename Dtype>
 void vol2col_gpu(const Dtype* data_im, const int channels, const int length,
 	    const int height, const int width, const int ksize, const int kdepth, const int pad,
@@ -0,0 +1,49 @@
+#ifndef CAFFE_UTIL_VOLUME_TRANSFORM_HPP_
+#define CAFFE_UTIL_VOLUME_TRANSFORM_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Converts one uint8 video frame, already offset to the top left
+ *        corner of its crop, into height x width planes of the output:
+ *
+ *   out[c * out_channel_stride + h * width + w] =
+ *       (in(c, h, w') - mean(c, h, w')) * scale,  w' = mirror ? width-1-w : w
+ *
+ * where in(c, h, w) is data[c * channel_stride + h * row_stride +
+ * w * pixel_stride], so both planar volumes (pixel_stride 1) and interleaved
+ * cv::Mat frames (channel_stride 1, pixel_stride channels) are handled.
+ * mean(c, h, w) is mean[c * mean_channel_stride + h * mean_row_stride + w]
+ * if mean is given, else mean_values[c] if given, else 0. Rows are widened,
+ * mean subtracted and scaled four floats at a time where SSE2 is available;
+ * the results are the same as the scalar expression above.
+ */
+template <typename Dtype>
+void transform_frame_cpu(const uint8_t* data, const int channels,
+    const int height, const int width, const int channel_stride,
+    const int row_stride, const int pixel_stride, const bool mirror,
+    const Dtype* mean, const int mean_channel_stride,
+    const int mean_row_stride, const Dtype* mean_values, const Dtype scale,
+    Dtype* out, const int out_channel_stride);
+
+/**
+ * @brief The mean and scale of every frame of every channel, channel-major,
+ *        of the clips of channels x length frames read with param: the
+ *        mean is channel_mean or else mean_value, and the scale is scale,
+ *        divided by channel_std if given. Without a mean cube, clips are
+ *        transformed plane by plane with these.
+ */
+template <typename Dtype>
+void GetPlaneMeanAndScale(const C3DMultiLabelVideoDataParameter& param,
+    const int channels, const int length, std::vector<Dtype>* plane_mean,
+    std::vector<Dtype>* plane_scale);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_VOLUME_TRANSFORM_HPP_
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <climits>
 #include <vector>
 
@@ -113,6 +114,12 @@ const Dtype* Blob<Dtype>::cpu_data() const {
 template <typename Dtype>
 void Blob<Dtype>::set_cpu_data(Dtype* data) {
   CHECK(data);
+  // Make sure CPU and GPU sizes remain equal
+  size_t size = count_ * sizeof(Dtype);
+  if (data_->size() != size) {
+    data_.reset(new SyncedMemory(size));
+    diff_.reset(new SyncedMemory(size));
+  }
   data_->set_cpu_data(data);
 }
 
@@ -140,6 +147,12 @@ Dtype* Blob<Dtype>::mutable_cpu_data() {
   return static_cast<Dtype*>(data_->mutable_cpu_data());
 }
 
+template <typename Dtype>
+Dtype* Blob<Dtype>::mutable_cpu_data_for_overwrite() {
+  CHECK(data_);
+  return static_cast<Dtype*>(data_->mutable_cpu_data_for_overwrite());
+}
+
 template <typename Dtype>
 Dtype* Blob<Dtype>::mutable_gpu_data() {
   CHECK(data_);
@@ -170,6 +183,16 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::set_data(const shared_ptr<SyncedMemory>& data) {
+  CHECK(data);
+  CHECK_GE(data->size(), count_ * sizeof(Dtype));
+  data_ = data;
+  // The capacity also bounds diff_, which keeps its own memory.
+  capacity_ = std::min(capacity_,
+      static_cast<int>(data->size() / sizeof(Dtype)));
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -9,6 +9,7 @@
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/volume_transform.hpp"
 
 namespace caffe {
 
@@ -230,31 +231,52 @@ void DataTransformer<Dtype>::Transform(const vector<cv::Mat> & mat_vector,
     CHECK_EQ(num, 1) << "First dimension (batch number) must be 1";
     CHECK_EQ(mat_num, length) <<
       "The size of mat_vector must be equals to transformed_blob->shape(2)";
-    vector<int> uni_blob_shape(5);
-    uni_blob_shape[0] = 1;
-    uni_blob_shape[1] = channels;
-    uni_blob_shape[2] = 1;
-    uni_blob_shape[3] = height;
-    uni_blob_shape[4] = width;
-    Blob<Dtype> uni_blob(uni_blob_shape);
-    int offset;
-    for (int item_id = 0; item_id < mat_num; ++item_id) {
-      Transform(mat_vector[item_id],
-                &uni_blob,
-                is_video,
-                item_id,
-                rand_mirror,
-                rand_h_off,
-                rand_w_off);
-      for (int c = 0; c < channels; ++c) {
-        for (int h = 0; h < height; ++h) {
-          for (int w = 0; w < width; ++w) {
-            Dtype value = uni_blob.data_at(0, c, 0, h, w);
-            offset = transformed_blob->offset(0, c, item_id, h, w);
-            *(transformed_blob->mutable_cpu_data() + offset) = value;
-          }
-        }
+    const int img_channels = mat_vector[0].channels();
+    CHECK_EQ(channels, img_channels);
+    CHECK_GE(img_height, crop_size);
+    CHECK_GE(img_width, crop_size);
+
+    const bool do_mirror = param_.mirror() && rand_mirror;
+    int h_off = 0;
+    int w_off = 0;
+    if (crop_size) {
+      CHECK_EQ(crop_size, height);
+      CHECK_EQ(crop_size, width);
+      // We only do random crop when we do training.
+      if (phase_ == TRAIN) {
+        h_off = rand_h_off;
+        w_off = rand_w_off;
+      } else {
+        h_off = (img_height - crop_size) / 2;
+        w_off = (img_width - crop_size) / 2;
       }
+    } else {
+      CHECK_EQ(img_height, height);
+      CHECK_EQ(img_width, width);
+    }
+    int mean_channel_stride, mean_frame_stride;
+    const Dtype* mean = VolumeMean(channels, length, img_height, img_width,
+        &mean_channel_stride, &mean_frame_stride);
+    const Dtype* mean_values = (!mean && mean_values_.size() > 0) ?
+        &mean_values_[0] : NULL;
+
+    // Each interleaved frame goes straight into its planes of the clip.
+    const Dtype scale = param_.scale();
+    Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+    for (int item_id = 0; item_id < mat_num; ++item_id) {
+      const cv::Mat& cv_img = mat_vector[item_id];
+      CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
+      CHECK_EQ(cv_img.channels(), img_channels);
+      CHECK_EQ(cv_img.rows, img_height);
+      CHECK_EQ(cv_img.cols, img_width);
+      transform_frame_cpu(cv_img.ptr<uchar>(h_off) + w_off * img_channels,
+          channels, height, width, 1, static_cast<int>(cv_img.step),
+          img_channels, do_mirror,
+          mean ? mean + item_id * mean_frame_stride + h_off * img_width + w_off
+               : NULL,
+          mean_channel_stride, img_width, mean_values, scale,
+          transformed_data + item_id * height * width,
+          length * height * width);
     }
   } else {
     const int mat_num = mat_vector.size();
@@ -608,6 +630,98 @@ vector<int> DataTransformer<Dtype>::InferBlobShape(
 }
 #endif  // USE_OPENCV
 
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformVolume(const uint8_t* data,
+                                             const int channels,
+                                             const int length,
+                                             const int height,
+                                             const int width,
+                                             Blob<Dtype>* transformed_blob) {
+  const int crop_size = param_.crop_size();
+  CHECK_EQ(transformed_blob->num_axes(), 5);
+  CHECK_EQ(transformed_blob->shape(0), 1);
+  CHECK_EQ(transformed_blob->shape(1), channels);
+  CHECK_EQ(transformed_blob->shape(2), length);
+  const int out_height = transformed_blob->shape(3);
+  const int out_width = transformed_blob->shape(4);
+
+  // Same draws, in the same order, as the cv::Mat video path.
+  const bool do_mirror = param_.mirror() ? static_cast<bool>(Rand(2)) : false;
+  int h_off = 0;
+  int w_off = 0;
+  if (crop_size) {
+    CHECK_EQ(crop_size, out_height);
+    CHECK_EQ(crop_size, out_width);
+    CHECK_GE(height, crop_size);
+    CHECK_GE(width, crop_size);
+    if (phase_ == TRAIN) {
+      h_off = Rand(height - crop_size + 1);
+      w_off = Rand(width - crop_size + 1);
+    } else {
+      h_off = (height - crop_size) / 2;
+      w_off = (width - crop_size) / 2;
+    }
+  } else {
+    CHECK_EQ(height, out_height);
+    CHECK_EQ(width, out_width);
+  }
+
+  int mean_channel_stride, mean_frame_stride;
+  const Dtype* mean = VolumeMean(channels, length, height, width,
+      &mean_channel_stride, &mean_frame_stride);
+  const Dtype* mean_values = (!mean && mean_values_.size() > 0) ?
+      &mean_values_[0] : NULL;
+
+  const Dtype scale = param_.scale();
+  const int plane = height * width;
+  const int out_plane = out_height * out_width;
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  for (int l = 0; l < length; ++l) {
+    const int crop_offset = h_off * width + w_off;
+    transform_frame_cpu(data + l * plane + crop_offset, channels, out_height,
+        out_width, length * plane, width, 1, do_mirror,
+        mean ? mean + l * mean_frame_stride + crop_offset : NULL,
+        mean_channel_stride, width, mean_values, scale,
+        transformed_data + l * out_plane, length * out_plane);
+  }
+}
+
+template <typename Dtype>
+const Dtype* DataTransformer<Dtype>::VolumeMean(const int channels,
+    const int length, const int height, const int width,
+    int* mean_channel_stride, int* mean_frame_stride) {
+  const Dtype* mean = NULL;
+  *mean_channel_stride = 0;
+  *mean_frame_stride = 0;
+  if (param_.has_mean_file()) {
+    if (data_mean_.shape().size() == 5) {
+      CHECK_EQ(channels, data_mean_.shape(1));
+      CHECK_GE(data_mean_.shape(2), length);
+      CHECK_EQ(height, data_mean_.shape(3));
+      CHECK_EQ(width, data_mean_.shape(4));
+      *mean_channel_stride = data_mean_.shape(2) * height * width;
+      *mean_frame_stride = height * width;
+    } else {
+      CHECK_EQ(channels, data_mean_.channels());
+      CHECK_EQ(height, data_mean_.height());
+      CHECK_EQ(width, data_mean_.width());
+      *mean_channel_stride = height * width;
+    }
+    mean = data_mean_.cpu_data();
+  }
+  if (mean_values_.size() > 0) {
+    CHECK(mean_values_.size() == 1 || mean_values_.size() == channels) <<
+     "Specify either 1 mean_value or as many as channels: " << channels;
+    if (channels > 1 && mean_values_.size() == 1) {
+      // Replicate the mean_value for simplicity
+      for (int c = 1; c < channels; ++c) {
+        mean_values_.push_back(mean_values_[0]);
+      }
+    }
+  }
+  return mean;
+}
+
 template <typename Dtype>
 void DataTransformer<Dtype>::InitRand() {
   const bool needs_rand = param_.mirror() ||
@@ -9,6 +9,7 @@
 #include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
 #include "caffe/layers/lrn_layer.hpp"
+#include "caffe/layers/ndconv_layer.hpp"
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/layers/relu_layer.hpp"
 #include "caffe/layers/sigmoid_layer.hpp"
@@ -74,27 +75,30 @@ shared_ptr<Layer<Dtype> > GetConvolutionLayer(
 
 REGISTER_LAYER_CREATOR(Convolution, GetConvolutionLayer);
 
-// Get NdConvolution layer if CUDNN is available
-
-#ifdef USE_CUDNN
+// Get NdConvolution layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetNdConvolutionLayer(
   const LayerParameter& param) {
   ConvolutionParameter_Engine engine = param.convolution_param().engine();
   if (engine == ConvolutionParameter_Engine_DEFAULT) {
+    engine = ConvolutionParameter_Engine_CAFFE;
+#ifdef USE_CUDNN
     engine = ConvolutionParameter_Engine_CUDNN;
+#endif
   }
   if (engine == ConvolutionParameter_Engine_CAFFE) {
-    NOT_IMPLEMENTED;
+    return shared_ptr<Layer<Dtype> >(new NdConvolutionLayer<Dtype>(param));
+#ifdef USE_CUDNN
   } else if (engine == ConvolutionParameter_Engine_CUDNN) {
     return shared_ptr<Layer<Dtype> >(new CudnnNdConvolutionLayer<Dtype>(param));
+#endif
   } else {
     LOG(FATAL) << "Layer " << param.name() << " has unknown engine.";
+    throw;  // Avoids missing return warning
   }
 }
 
 REGISTER_LAYER_CREATOR(NdConvolution, GetNdConvolutionLayer);
-#endif
 
 // Get pooling layer according to engine.
 template <typename Dtype>
@@ -173,25 +177,34 @@ shared_ptr<Layer<Dtype> > GetLRNLayer(const LayerParameter& param) {
 REGISTER_LAYER_CREATOR(LRN, GetLRNLayer);
 
 
-// Get NdPooling layer if CUDNN is available
-#ifdef USE_CUDNN
+// Get NdPooling layer according to engine.
 template <typename Dtype>
 shared_ptr<Layer<Dtype> > GetNdPoolingLayer(const LayerParameter& param) {
   PoolingParameter_Engine engine = param.pooling_param().engine();
   if (engine == PoolingParameter_Engine_DEFAULT) {
+    engine = PoolingParameter_Engine_CAFFE;
+#ifdef USE_CUDNN
     engine = PoolingParameter_Engine_CUDNN;
+#endif
   }
   if (engine == PoolingParameter_Engine_CAFFE) {
-    NOT_IMPLEMENTED;
+    return shared_ptr<Layer<Dtype> >(new NdPoolingLayer<Dtype>(param));
+#ifdef USE_CUDNN
   } else if (engine == PoolingParameter_Engine_CUDNN) {
+    if (param.top_size() > 1) {
+      LOG(INFO) << "cuDNN does not support multiple tops. "
+                << "Using Caffe's own pooling layer.";
+      return shared_ptr<Layer<Dtype> >(new NdPoolingLayer<Dtype>(param));
+    }
     return shared_ptr<Layer<Dtype> >(new CudnnNdPoolingLayer<Dtype>(param));
+#endif
   } else {
     LOG(FATAL) << "Layer " << param.name() << " has unknown engine.";
+    throw;  // Avoids missing return warning
   }
 }
 
 REGISTER_LAYER_CREATOR(NdPooling, GetNdPoolingLayer);
-#endif
 
 
 // Get relu layer according to engine.
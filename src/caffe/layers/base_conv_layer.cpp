@@ -279,7 +279,7 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   const Dtype* col_buff = input;
   if (!is_1x1_) {
     if (!skip_im2col) {
-      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+      conv_im2col_cpu(input, col_buffer_.mutable_cpu_data_for_overwrite());
     }
     col_buff = col_buffer_.cpu_data();
   }
@@ -299,10 +299,81 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
       (Dtype)1., output);
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_int8(const Dtype* input,
+    const Dtype* bias, const bool relu, Dtype* output) {
+  CHECK(!reverse_dimensions()) << "Deconvolution has no int8 forward pass.";
+  CHECK_EQ(group_, 1) << "The int8 convolution takes a single group.";
+  if (int8_weights_version_ != this->blobs_[0]->data()->version()) {
+    int8_weights_.Quantize(this->layer_param_.quantization_param(),
+        conv_in_channels_, conv_out_channels_, kernel_dim_,
+        this->blobs_[0]->cpu_data());
+    int8_weights_version_ = this->blobs_[0]->data()->version();
+  }
+  int8_input_.resize(bottom_dim_);
+  int8_weights_.QuantizeInput(bottom_dim_, bottom_dim_ / channels_, input,
+      &int8_input_[0]);
+  const int8_t* col_buff = &int8_input_[0];
+  if (!is_1x1_) {
+    int8_col_buffer_.resize(kernel_dim_ * conv_out_spatial_dim_);
+    conv_im2col_cpu(&int8_input_[0], &int8_col_buffer_[0]);
+    col_buff = &int8_col_buffer_[0];
+  }
+  int8_sums_.resize(conv_out_channels_ * conv_out_spatial_dim_);
+  caffe_cpu_gemm_s8(CblasNoTrans, conv_out_channels_, conv_out_spatial_dim_,
+      kernel_dim_, int8_weights_.data(), col_buff, &int8_sums_[0]);
+  int8_weights_.DequantizeChannels(conv_out_spatial_dim_, &int8_sums_[0],
+      bias, relu, output);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::narrow_weights() {
+  if (half_weights_version_ != this->blobs_[0]->data()->version()) {
+    half_weights_.resize(this->blobs_[0]->count());
+    caffe_cpu_narrow(this->layer_param_.storage_precision(),
+        this->blobs_[0]->count(), this->blobs_[0]->cpu_data(),
+        &half_weights_[0]);
+    half_weights_version_ = this->blobs_[0]->data()->version();
+  }
+}
+
+template <typename Dtype>
+size_t BaseConvolutionLayer<Dtype>::ReleaseFloatWeights() {
+  if (!is_half() || is_quantized() || reverse_dimensions()) {
+    return 0;
+  }
+  narrow_weights();
+  // The weights get a new, unallocated memory, which is already narrowed.
+  Blob<Dtype> released(this->blobs_[0]->shape());
+  this->blobs_[0]->ShareData(released);
+  half_weights_version_ = this->blobs_[0]->data()->version();
+  return released.count() * sizeof(Dtype);
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_half_gemm(const Dtype* input,
+    Dtype* output) {
+  const StoragePrecision precision = this->layer_param_.storage_precision();
+  narrow_weights();
+  half_input_.resize(bottom_dim_);
+  caffe_cpu_narrow(precision, bottom_dim_, input, &half_input_[0]);
+  const uint16_t* col_buff = &half_input_[0];
+  if (!is_1x1_) {
+    half_col_buffer_.resize(col_buffer_.count());
+    conv_im2col_cpu(&half_input_[0], &half_col_buffer_[0]);
+    col_buff = &half_col_buffer_[0];
+  }
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm_half(precision, CblasNoTrans, conv_out_channels_ / group_,
+        conv_out_spatial_dim_, kernel_dim_, &half_weights_[weight_offset_ * g],
+        col_buff + col_offset_ * g, output + output_offset_ * g);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::backward_cpu_gemm(const Dtype* output,
     const Dtype* weights, Dtype* input) {
-  Dtype* col_buff = col_buffer_.mutable_cpu_data();
+  Dtype* col_buff = col_buffer_.mutable_cpu_data_for_overwrite();
   if (is_1x1_) {
     col_buff = input;
   }
@@ -322,7 +393,7 @@ void BaseConvolutionLayer<Dtype>::weight_cpu_gemm(const Dtype* input,
     const Dtype* output, Dtype* weights) {
   const Dtype* col_buff = input;
   if (!is_1x1_) {
-    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data());
+    conv_im2col_cpu(input, col_buffer_.mutable_cpu_data_for_overwrite());
     col_buff = col_buffer_.cpu_data();
   }
   for (int g = 0; g < group_; ++g) {
@@ -35,11 +35,15 @@ void BaseDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
-        const LayerParameter& param)
+        const LayerParameter& param, int prefetch_count)
         : BaseDataLayer<Dtype>(param),
-          prefetch_free_(), prefetch_full_() {
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-        prefetch_free_.push(&prefetch_[i]);
+          prefetch_(prefetch_count),
+          prefetch_free_(prefetch_count), prefetch_full_(prefetch_count),
+          prefetch_current_(NULL) {
+    CHECK_GT(prefetch_count, 0) << "At least one batch must be prefetched.";
+    for (int i = 0; i < prefetch_.size(); ++i) {
+        prefetch_[i].reset(new Batch<Dtype>());
+        prefetch_free_.push(prefetch_[i].get());
     }
 }
 
@@ -52,18 +56,18 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     // cudaMalloc calls when the main thread is running. In some GPUs this
     // seems to cause failures if we do not so.
 
-    for (int i = 0; i < PREFETCH_COUNT; ++i) {
-        prefetch_[i].data_.mutable_cpu_data();
+    for (int i = 0; i < prefetch_.size(); ++i) {
+        prefetch_[i]->data_.mutable_cpu_data();
         if (this->output_labels_) {
-            prefetch_[i].label_.mutable_cpu_data();
+            prefetch_[i]->label_.mutable_cpu_data();
         }
     }
 #ifndef CPU_ONLY
     if (Caffe::mode() == Caffe::GPU) {
-        for (int i = 0; i < PREFETCH_COUNT; ++i) {
-            prefetch_[i].data_.mutable_gpu_data();
+        for (int i = 0; i < prefetch_.size(); ++i) {
+            prefetch_[i]->data_.mutable_gpu_data();
             if (this->output_labels_) {
-                prefetch_[i].label_.mutable_gpu_data();
+                prefetch_[i]->label_.mutable_gpu_data();
             }
         }
     }
@@ -90,6 +94,9 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #ifndef CPU_ONLY
             if (Caffe::mode() == Caffe::GPU) {
                 batch->data_.data().get()->async_gpu_push(stream);
+                if (this->output_labels_) {
+                    batch->label_.data().get()->async_gpu_push(stream);
+                }
                 CUDA_CHECK(cudaStreamSynchronize(stream));
             }
 #endif
@@ -108,22 +115,36 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
         const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
-    Batch<Dtype>* batch = prefetch_full_.pop("Data layer prefetch queue empty");
-    // Reshape to loaded data.
-    top[0]->ReshapeLike(batch->data_);
-    // Copy the data
-    caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
-            top[0]->mutable_cpu_data());
-    DLOG(INFO) << "Prefetch copied";
+    if (Caffe::solver_count() > 1) {
+        // The layer is shared by the solvers, each of which may still be
+        // using its last batch: copy, and leave prefetch_current_ alone.
+        Batch<Dtype>* batch =
+                prefetch_full_.pop("Data layer prefetch queue empty");
+        top[0]->ReshapeLike(batch->data_);
+        caffe_copy(batch->data_.count(), batch->data_.cpu_data(),
+                top[0]->mutable_cpu_data_for_overwrite());
+        if (this->output_labels_) {
+            top[1]->ReshapeLike(batch->label_);
+            caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
+                    top[1]->mutable_cpu_data_for_overwrite());
+        }
+        prefetch_free_.push(batch);
+        return;
+    }
+    // The previous batch is no longer used once the net runs forward again;
+    // give it back first, so that a single prefetched batch does not stall.
+    if (prefetch_current_) {
+        prefetch_free_.push(prefetch_current_);
+    }
+    prefetch_current_ = prefetch_full_.pop("Data layer prefetch queue empty");
+    // Point the tops to the loaded batch instead of copying it.
+    top[0]->ReshapeLike(prefetch_current_->data_);
+    top[0]->set_cpu_data(prefetch_current_->data_.mutable_cpu_data());
+    DLOG(INFO) << "Prefetch handed over";
     if (this->output_labels_) {
-        // Reshape to loaded labels.
-        top[1]->ReshapeLike(batch->label_);
-        // Copy the labels.
-        caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
-                top[1]->mutable_cpu_data());
+        top[1]->ReshapeLike(prefetch_current_->label_);
+        top[1]->set_cpu_data(prefetch_current_->label_.mutable_cpu_data());
     }
-
-    prefetch_free_.push(batch);
 }
 
 #ifdef CPU_ONLY
@@ -17,14 +17,12 @@
 
 
 #include <stdint.h>
-#include <pthread.h>
 
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
-#include <time.h>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -41,103 +39,108 @@
 #include "caffe/util/c3d_multi_label_image_io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/volume_transform.hpp"
 #include "caffe/layers/c3d_multi_label_video_data_layer.hpp"
 
 using std::string;
 
 namespace caffe {
 
-// prefetch and transform the data
+// prefetch and transform the data; called on the prefetch thread
 template <typename Dtype>
-void* C3DMultiLabelVideoDataLayerPrefetch(void* layer_pointer) {
-    CHECK(layer_pointer);
-    C3DMultiLabelVideoDataLayer<Dtype>* layer = static_cast<C3DMultiLabelVideoDataLayer<Dtype>*>(layer_pointer);
-    CHECK(layer);
-
+void C3DMultiLabelVideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
     C3DMultiLabelVolumeDatum datum;
-    CHECK(layer->prefetch_data_);
-    Dtype* top_data = layer->prefetch_data_->mutable_cpu_data();
+    CHECK(batch->data_.count());
+    Dtype* top_data = batch->data_.mutable_cpu_data_for_overwrite();
     Dtype* top_label;
-    if (layer->output_labels_) {
-        top_label = layer->prefetch_label_->mutable_cpu_data();
+    if (this->output_labels_) {
+        top_label = batch->label_.mutable_cpu_data();
     }
-    const Dtype scale = layer->layer_param_.c3d_multi_label_video_data_param().scale();
-    const int batch_size = layer->layer_param_.c3d_multi_label_video_data_param().batch_size();
-    const int crop_size = layer->layer_param_.c3d_multi_label_video_data_param().crop_size();
-    const bool mirror = layer->layer_param_.c3d_multi_label_video_data_param().mirror();
-    const int new_length  = layer->layer_param_.c3d_multi_label_video_data_param().new_length();
-    const int new_height  = layer->layer_param_.c3d_multi_label_video_data_param().new_height();
-    const int new_width  = layer->layer_param_.c3d_multi_label_video_data_param().new_width();
-    const bool use_image = layer->layer_param_.c3d_multi_label_video_data_param().use_image();
-    const int sampling_rate = layer->layer_param_.c3d_multi_label_video_data_param().sampling_rate();
-    const bool use_temporal_jitter = layer->layer_param_.c3d_multi_label_video_data_param().use_temporal_jitter();
-    //char label_separator = layer->layer_param_.video_data_param().label_separator().at(0);
+    const int batch_size = this->layer_param_.c3d_multi_label_video_data_param().batch_size();
+    const int crop_size = this->layer_param_.c3d_multi_label_video_data_param().crop_size();
+    const bool mirror = this->layer_param_.c3d_multi_label_video_data_param().mirror();
+    const int new_length  = this->layer_param_.c3d_multi_label_video_data_param().new_length();
+    const int new_height  = this->layer_param_.c3d_multi_label_video_data_param().new_height();
+    const int new_width  = this->layer_param_.c3d_multi_label_video_data_param().new_width();
+    const bool use_image = this->layer_param_.c3d_multi_label_video_data_param().use_image();
+    const int sampling_rate = this->layer_param_.c3d_multi_label_video_data_param().sampling_rate();
+    const bool use_temporal_jitter = this->layer_param_.c3d_multi_label_video_data_param().use_temporal_jitter();
+    //char label_separator = this->layer_param_.video_data_param().label_separator().at(0);
 
     if (mirror && crop_size == 0) {
         LOG(FATAL) << "Current implementation requires mirror and crop_size to be "
                    << "set at the same time.";
     }
     // datum scales
-    const int channels = layer->datum_channels_;
-    const int length = layer->datum_length_;
-    const int height = layer->datum_height_;
-    const int width = layer->datum_width_;
-    const int size = layer->datum_size_;
-    const int chunks_size = layer->shuffle_index_.size();
-    const Dtype* mean = layer->data_mean_.cpu_data();
-    const int show_data = layer->layer_param_.c3d_multi_label_video_data_param().show_data();
-    char *data_buffer;
-    if (show_data)
-        data_buffer = new char[size];
+    const int channels = this->datum_channels_;
+    const int length = this->datum_length_;
+    const int height = this->datum_height_;
+    const int width = this->datum_width_;
+    const int size = this->datum_size_;
+    const int chunks_size = this->shuffle_index_.size();
+    // The mean cube, if any; else the mean of every frame of every channel,
+    // like its scale, is a constant of the transform.
+    const Dtype* mean = this->data_mean_.count() ? this->data_mean_.cpu_data() : NULL;
+    const Dtype* plane_mean = &this->plane_mean_[0];
+    const Dtype* plane_scale = &this->plane_scale_[0];
+    const int show_data = this->layer_param_.c3d_multi_label_video_data_param().show_data();
+    char* data_buffer = show_data ? &this->show_data_buffer_[0] : NULL;
     for (int item_id = 0; item_id < batch_size; ++item_id) {
         // get a blob
-        CHECK_GT(chunks_size, layer->lines_id_);
+        CHECK_GT(chunks_size, this->lines_id_);
         bool read_status;
-        int id = layer->shuffle_index_[layer->lines_id_];
-        if (!use_image){
+        int id = this->shuffle_index_[this->lines_id_];
+        // The jitter, crop and mirror of the clip, whichever thread loads it.
+        CounterRng rng(this->clip_rng_seed_, this->clip_id_++);
+        if (this->frame_reader_) {
+            read_status = ReadFramesToVolumeDatum(this->frame_reader_.get(), this->file_list_[id].c_str(),
+                                                  this->start_frm_list_[id], this->label_list_[id], new_length,
+                                                  sampling_rate, &datum);
+        } else if (!use_image){
             if (!use_temporal_jitter){
-                read_status = ReadVideoToVolumeDatum(layer->file_list_[id].c_str(), layer->start_frm_list_[id],
-                                                     layer->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
+                read_status = ReadVideoToVolumeDatum(this->file_list_[id].c_str(), this->start_frm_list_[id],
+                                                     this->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
             }else{
-                read_status = ReadVideoToVolumeDatum(layer->file_list_[id].c_str(), -1,
-                                                     layer->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
+                read_status = ReadVideoToVolumeDatum(this->file_list_[id].c_str(), -1,
+                                                     this->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum,
+                                                     &rng);
             }
         }
         else {
             if (!use_temporal_jitter) {
-                read_status = ReadImageSequenceToVolumeDatum(layer->file_list_[id].c_str(), layer->start_frm_list_[id],
-                                                             layer->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
+                read_status = ReadImageSequenceToVolumeDatum(this->file_list_[id].c_str(), this->start_frm_list_[id],
+                                                             this->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
             } else {
-                int num_of_frames = layer->start_frm_list_[id];
+                int num_of_frames = this->start_frm_list_[id];
                 int use_start_frame;
                 if (num_of_frames<new_length*sampling_rate){
                     LOG(INFO) << "not enough frames; having " << num_of_frames;
                     read_status = false;
                 } else {
-                    if (layer->phase_ == caffe::TRAIN)
-                        use_start_frame = layer->PrefetchRand()%(num_of_frames-new_length*sampling_rate+1)+1;
+                    if (this->phase_ == caffe::TRAIN)
+                        use_start_frame = rng.Uniform(num_of_frames-new_length*sampling_rate+1)+1;
                     else
                         use_start_frame = 0;
 
-                    read_status = ReadImageSequenceToVolumeDatum(layer->file_list_[id].c_str(), use_start_frame,
-                                                                 layer->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
+                    read_status = ReadImageSequenceToVolumeDatum(this->file_list_[id].c_str(), use_start_frame,
+                                                                 this->label_list_[id], new_length, new_height, new_width, sampling_rate, &datum);
                 }
             }
         }
 
-        if (layer->phase_ == caffe::TEST){
+        if (this->phase_ == caffe::TEST){
             CHECK(read_status) << "Testing must not miss any example";
         }
 
         if (!read_status) {
-            //LOG(ERROR) << "cannot read " << layer->file_list_[id];
-            layer->lines_id_++;
-            if (layer->lines_id_ >= chunks_size) {
+            //LOG(ERROR) << "cannot read " << this->file_list_[id];
+            this->lines_id_++;
+            if (this->lines_id_ >= chunks_size) {
                 // We have reached the end. Restart from the first.
                 DLOG(INFO) << "Restarting data prefetching from start.";
-                layer->lines_id_ = 0;
-                if (layer->layer_param_.video_data_param().shuffle()){
-                    std::random_shuffle(layer->shuffle_index_.begin(), layer->shuffle_index_.end());
+                this->lines_id_ = 0;
+                if (this->layer_param_.c3d_multi_label_video_data_param().shuffle()){
+                    this->ShuffleClips();
                 }
             }
             item_id--;
@@ -146,71 +149,56 @@ void* C3DMultiLabelVideoDataLayerPrefetch(void* layer_pointer) {
         //LOG(INFO) << "--> " << item_id;
         //LOG(INFO) << "label " << datum.label();
         const string& data = datum.data();
-        if (crop_size) {
-            CHECK(data.size()) << "Image cropping only support uint8 data";
-            int h_off, w_off;
-            // We only do random crop when we do training.
-            if (layer->phase_ == caffe::TRAIN) {
-                h_off = layer->PrefetchRand() % (height - crop_size);
-                w_off = layer->PrefetchRand() % (width - crop_size);
-            } else {
-                h_off = (height - crop_size) / 2;
-                w_off = (width - crop_size) / 2;
-            }
-            if (mirror && layer->PrefetchRand() % 2) {
-                // Copy mirrored version
-                for (int c = 0; c < channels; ++c) {
-                    for (int l = 0; l < length; ++l) {
-                        for (int h = 0; h < crop_size; ++h) {
-                            for (int w = 0; w < crop_size; ++w) {
-                                int top_index = (((item_id * channels + c) * length + l) * crop_size + h)
-                                        * crop_size + (crop_size - 1 - w);
-                                int data_index = ((c * length + l) * height + h + h_off) * width + w + w_off;
-                                Dtype datum_element =
-                                        static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-                                top_data[top_index] = (datum_element - mean[data_index]) * scale;
-                                if (show_data)
-                                    data_buffer[((c * length + l) * crop_size + h)
-                                            * crop_size + (crop_size - 1 - w)] = static_cast<uint8_t>(data[data_index]);
-                            }
-                        }
-                    }
+        if (data.size()) {
+            int h_off = 0;
+            int w_off = 0;
+            int out_height = height;
+            int out_width = width;
+            bool do_mirror = false;
+            if (crop_size) {
+                // We only do random crop when we do training.
+                if (this->phase_ == caffe::TRAIN) {
+                    h_off = rng.Uniform(height - crop_size);
+                    w_off = rng.Uniform(width - crop_size);
+                } else {
+                    h_off = (height - crop_size) / 2;
+                    w_off = (width - crop_size) / 2;
                 }
-            } else {
-                // Normal copy
+                do_mirror = mirror && rng.Uniform(2);
+                out_height = crop_size;
+                out_width = crop_size;
+            }
+            const uint8_t* pixels = reinterpret_cast<const uint8_t*>(data.data());
+            const int frame_size = height * width;
+            const int out_size = out_height * out_width;
+            const int crop_offset = h_off * width + w_off;
+            for (int plane = 0; plane < channels * length; ++plane) {
+                transform_frame_cpu<Dtype>(pixels + plane * frame_size + crop_offset, 1, out_height, out_width,
+                                           0, width, 1, do_mirror,
+                                           mean ? mean + plane * frame_size + crop_offset : NULL, 0, width,
+                                           plane_mean + plane, plane_scale[plane],
+                                           top_data + (item_id * channels * length + plane) * out_size, 0);
+            }
+            if (show_data) {
                 for (int c = 0; c < channels; ++c) {
                     for (int l = 0; l < length; ++l) {
-                        for (int h = 0; h < crop_size; ++h) {
-                            for (int w = 0; w < crop_size; ++w) {
-                                int top_index = (((item_id * channels + c) * length + l) * crop_size + h)
-                                        * crop_size + w;
-                                int data_index = ((c * length + l) * height + h + h_off) * width + w + w_off;
-                                Dtype datum_element =
-                                        static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-                                top_data[top_index] = (datum_element - mean[data_index]) * scale;
-                                if (show_data)
-                                    data_buffer[((c * length + l) * crop_size + h)
-                                            * crop_size + w] = static_cast<uint8_t>(data[data_index]);
+                        for (int h = 0; h < out_height; ++h) {
+                            for (int w = 0; w < out_width; ++w) {
+                                data_buffer[((c * length + l) * out_height + h) * out_width
+                                        + (do_mirror ? out_width - 1 - w : w)] =
+                                        data[((c * length + l) * height + h + h_off) * width + w + w_off];
                             }
                         }
                     }
                 }
             }
         } else {
-            // we will prefer to use data() first, and then try float_data()
-            if (data.size()) {
-                for (int j = 0; j < size; ++j) {
-                    Dtype datum_element =
-                            static_cast<Dtype>(static_cast<uint8_t>(data[j]));
-                    top_data[item_id * size + j] = (datum_element - mean[j]) * scale;
-                    if (show_data)
-                        data_buffer[j] = static_cast<uint8_t>(data[j]);
-                }
-            } else {
-                for (int j = 0; j < size; ++j) {
-                    top_data[item_id * size + j] =
-                            (datum.float_data(j) - mean[j]) * scale;
-                }
+            CHECK(!crop_size) << "Image cropping only support uint8 data";
+            const int frame_size = height * width;
+            for (int j = 0; j < size; ++j) {
+                const int plane = j / frame_size;
+                top_data[item_id * size + j] =
+                        (datum.float_data(j) - (mean ? mean[j] : plane_mean[plane])) * plane_scale[plane];
             }
         }
 
@@ -237,44 +225,36 @@ void* C3DMultiLabelVideoDataLayerPrefetch(void* layer_pointer) {
                 cv::waitKey(100);
             }
         }
-        if (layer->output_labels_) {
+        if (this->output_labels_) {
             for (int i=0; i< datum.label_size(); ++i){
                 top_label[item_id *  datum.label_size() + i] = datum.label(i);
                 //LOG(INFO) << "fetching label for item_id " << item_id << " labeli " << i << " = "<< datum.label(i) << std::endl;
             }
         }
 
-        layer->lines_id_++;
-        if (layer->lines_id_ >= chunks_size) {
+        this->lines_id_++;
+        if (this->lines_id_ >= chunks_size) {
             // We have reached the end. Restart from the first.
             DLOG(INFO) << "Restarting data prefetching from start.";
-            layer->lines_id_ = 0;
-            if (layer->layer_param_.video_data_param().shuffle()){
-                std::random_shuffle(layer->shuffle_index_.begin(), layer->shuffle_index_.end());
+            this->lines_id_ = 0;
+            if (this->layer_param_.c3d_multi_label_video_data_param().shuffle()){
+                this->ShuffleClips();
             }
         }
     }
-    if (show_data & data_buffer!=NULL)
-        delete []data_buffer;
-    return static_cast<void*>(NULL);
 }
 
 template <typename Dtype>
 C3DMultiLabelVideoDataLayer<Dtype>::~C3DMultiLabelVideoDataLayer<Dtype>() {
-    JoinPrefetchThread();
+    this->StopInternalThread();
 }
 
 template <typename Dtype>
-void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+void C3DMultiLabelVideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                        const vector<Blob<Dtype>*>& top) {
     CHECK_EQ(bottom.size(), 0) << "Data Layer takes no input blobs.";
 //    CHECK_GE(top.size(), 1) << "Data Layer takes at least one blob as output.";
 // CHECK_GE(top.size(), 2) << "Data Layer takes at least two blobs as output.";
-    if (top.size() == 1) {
-        output_labels_ = false;
-    } else {
-        output_labels_ = true;
-    }
     const int new_length  = this->layer_param_.c3d_multi_label_video_data_param().new_length();
     const int new_height  = this->layer_param_.c3d_multi_label_video_data_param().new_height();
     const int new_width  = this->layer_param_.c3d_multi_label_video_data_param().new_width();
@@ -288,6 +268,8 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
     const string& source = this->layer_param_.c3d_multi_label_video_data_param().source();
     const bool use_temporal_jitter = this->layer_param_.c3d_multi_label_video_data_param().use_temporal_jitter();
     const bool use_image = this->layer_param_.c3d_multi_label_video_data_param().use_image();
+    const int clip_stride = this->layer_param_.c3d_multi_label_video_data_param().clip_stride();
+    CHECK(!(clip_stride && use_temporal_jitter)) << "clip_stride and use_temporal_jitter are exclusive.";
     LOG(INFO) << "Opening file " << source;
     std::ifstream infile(source.c_str());
     int count = 0;
@@ -296,7 +278,7 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
     string label;
 
 
-    if ((!use_image) && use_temporal_jitter){
+    if ((!use_image) && (use_temporal_jitter || clip_stride)){
         while (infile >> filename >> label) {
             file_list_.push_back(filename);
             std::istringstream iss(label);
@@ -336,11 +318,39 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
         LOG(INFO) << "failed to read chunk list" << std::endl;
     }
 
+    if (clip_stride) {
+        ListStridedClips(clip_stride);
+        count = file_list_.size();
+        CHECK_GT(count, 0) << "No clip fits in the videos of " << source;
+    }
+
+    if ((this->layer_param_.c3d_multi_label_video_data_param().sequential_decode() || clip_stride)
+            && !use_temporal_jitter){
+        if (this->layer_param_.c3d_multi_label_video_data_param().shuffle()){
+            LOG(WARNING) << "sequential_decode does not pay off on shuffled lists.";
+        } else if (!clip_stride) {
+            // Visit the clips of each video one after the other.
+            const vector<int> order = GroupClipsByFile(file_list_, start_frm_list_);
+            int moved = 0;
+            for (int i = 0; i < order.size(); ++i) {
+                moved += (order[i] != i);
+            }
+            // Test outputs are paired with the list lines by position.
+            CHECK(!moved || this->phase_ != caffe::TEST) << "sequential_decode "
+                << "would reorder " << moved << " clips of " << source
+                << "; sort the list by video and start frame.";
+            shuffle_index_ = order;
+        }
+        // Frame counts of videos are estimates; strided clips that run past
+        // the real end repeat the last frame rather than fail.
+        frame_reader_.reset(new VideoFrameReader(new_height, new_width, true, clip_stride > 0));
+    }
+
     if (this->layer_param_.c3d_multi_label_video_data_param().shuffle()){
         LOG(INFO) << "Shuffling data";
         const unsigned int prefetch_rng_seed = caffe_rng_rand();
         prefetch_rng_.reset(new Caffe::RNG(prefetch_rng_seed));
-        std::random_shuffle(shuffle_index_.begin(), shuffle_index_.end());
+        ShuffleClips();
     }
     LOG(INFO) << "A total of " << shuffle_index_.size() << " video chunks.";
 
@@ -359,14 +369,13 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
     C3DMultiLabelVolumeDatum datum;
     int id = shuffle_index_[lines_id_];
     if (!use_image){
-        if (use_temporal_jitter){
-            srand (time(NULL));
-         //   CHECK(ReadVideoToVolumeDatum(file_list_[0].c_str(), 0, label_list_[0],
-         //           new_length, new_height, new_width, sampling_rate, &datum));
-        }
-     //   else
-         //   CHECK(ReadVideoToVolumeDatum(file_list_[id].c_str(), start_frm_list_[id], label_list_[id],
-         //                                new_length, new_height, new_width, sampling_rate, &datum));
+        // With temporal jitter the clip of a line starts anywhere; the
+        // first frames give the same shape.
+        const int start_frm = use_temporal_jitter ? 0 : start_frm_list_[id];
+        LOG(INFO) << "read video from " << file_list_[id].c_str();
+        CHECK(ReadVideoToVolumeDatum(file_list_[id].c_str(), start_frm, label_list_[id],
+                                     new_length, new_height, new_width, sampling_rate, &datum))
+            << "Could not read a clip of " << file_list_[id];
     }
     else{
         LOG(INFO) << "read video from " << file_list_[id].c_str();
@@ -384,17 +393,16 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
         newshape[3] = crop_size;
         newshape[4] = crop_size;
 
-        top[0]->Reshape(newshape);
-        prefetch_data_.reset(new Blob<Dtype>(newshape));
     } else {
         newshape[0] = this->layer_param_.c3d_multi_label_video_data_param().batch_size();
         newshape[1] = datum.channels();
         newshape[2] = datum.length();
         newshape[3] = datum.height();
         newshape[4] = datum.width();
-
-        top[0]->Reshape(newshape);
-        prefetch_data_.reset(new Blob<Dtype>(newshape));
+    }
+    top[0]->Reshape(newshape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+        this->prefetch_[i]->data_.Reshape(newshape);
     }
     vector<int> shape = top[0]->shape();
     LOG(INFO) << "output data size: " << shape[0] << ","
@@ -403,7 +411,7 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
 
     LOG(INFO) << "  count=" << count << " label_list_.size" << label_list_[0].size();
     // label
-    if (output_labels_) {
+    if (this->output_labels_) {
         LOG(INFO) << "    count=" << count << " label_list_.size" << label_list_[0].size();
         newshape[0] = this->layer_param_.c3d_multi_label_video_data_param().batch_size();
         newshape[1] = label_list_[0].size();
@@ -412,7 +420,9 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
         newshape[4] = 1;
 
         top[1]->Reshape(newshape);
-        prefetch_label_.reset(new Blob<Dtype>(newshape));
+        for (int i = 0; i < this->prefetch_.size(); ++i) {
+            this->prefetch_[i]->label_.Reshape(newshape);
+        }
     }
 
 
@@ -425,7 +435,8 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
     CHECK_GT(datum_height_, crop_size);
     CHECK_GT(datum_width_, crop_size);
     // check if we want to have mean
-    if (this->layer_param_.c3d_multi_label_video_data_param().has_mean_file()) {
+    const C3DMultiLabelVideoDataParameter& video_param = this->layer_param_.c3d_multi_label_video_data_param();
+    if (video_param.has_mean_file()) {
         const string& mean_file = this->layer_param_.c3d_multi_label_video_data_param().mean_file();
         LOG(INFO) << "Loading mean file from " << mean_file;
         BlobProto blob_proto;
@@ -438,88 +449,76 @@ void C3DMultiLabelVideoDataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>&
         CHECK_EQ(shape[2], datum_length_);
         CHECK_EQ(shape[3], datum_height_);
         CHECK_EQ(shape[4], datum_width_);
-    } else {
-        // Simply initialize an all-empty mean.
-        newshape[0] = 1;
-        newshape[1] = datum_channels_;
-        newshape[2] = datum_length_;
-        newshape[3] = datum_height_;
-        newshape[4] = datum_width_;
-        data_mean_.Reshape(newshape);
-        if (this->layer_param_.c3d_multi_label_video_data_param().has_mean_value()){
-            LOG(INFO) << "Using mean value of " << this->layer_param_.c3d_multi_label_video_data_param().mean_value();
-            caffe::caffe_set(data_mean_.count(), (Dtype)this->layer_param_.c3d_multi_label_video_data_param().mean_value(),
-                             (Dtype*)data_mean_.mutable_cpu_data());
-        }
     }
-
-
-    // Now, start the prefetch thread. Before calling prefetch, we make two
-    // cpu_data calls so that the prefetch thread does not accidentally make
-    // simultaneous cudaMalloc calls when the main thread is running. In some
-    // GPUs this seems to cause failures if we do not so.
-    prefetch_data_->mutable_cpu_data();
-    if (output_labels_) {
-        prefetch_label_->mutable_cpu_data();
+    // Without a mean cube the mean is constant over each frame of each
+    // channel, and so is the scale, so no mean is streamed from memory.
+    GetPlaneMeanAndScale(video_param, datum_channels_, datum_length_, &plane_mean_, &plane_scale_);
+    if (!video_param.has_mean_file() && video_param.has_mean_value()) {
+        LOG(INFO) << "Using mean value of " << video_param.mean_value();
     }
-    data_mean_.cpu_data();
-    DLOG(INFO) << "Initializing prefetch";
-    CreatePrefetchThread();
-    DLOG(INFO) << "Prefetch initialized.";
-}
 
-template <typename Dtype>
-void C3DMultiLabelVideoDataLayer<Dtype>::CreatePrefetchThread() {
-    //phase_ = caffe::phase();
-    const bool prefetch_needs_rand = (this->phase_ == caffe::TRAIN) &&
-            (this->layer_param_.c3d_multi_label_video_data_param().mirror() ||
-             this->layer_param_.c3d_multi_label_video_data_param().crop_size());
-    if (prefetch_needs_rand) {
-        const unsigned int prefetch_rng_seed = caffe_rng_rand();
-        prefetch_rng_.reset(new Caffe::RNG(prefetch_rng_seed));
-    } else {
-        prefetch_rng_.reset();
+    if (this->layer_param_.c3d_multi_label_video_data_param().show_data()) {
+        show_data_buffer_.resize(datum_size_);
+    }
+    clip_rng_seed_ = caffe_rng_rand();
+    clip_id_ = 0;
+    // The prefetch thread reads the mean, make sure it is on the CPU.
+    if (data_mean_.count()) {
+        data_mean_.cpu_data();
     }
-    // Create the thread.
-    CHECK(!pthread_create(&thread_, NULL, C3DMultiLabelVideoDataLayerPrefetch<Dtype>,
-                          static_cast<void*>(this))) << "Pthread execution failed.";
 }
 
 template <typename Dtype>
-void C3DMultiLabelVideoDataLayer<Dtype>::JoinPrefetchThread() {
-    CHECK(!pthread_join(thread_, NULL)) << "Pthread joining failed.";
+void C3DMultiLabelVideoDataLayer<Dtype>::ListStridedClips(int clip_stride) {
+    const C3DMultiLabelVideoDataParameter& param = this->layer_param_.c3d_multi_label_video_data_param();
+    const int span = param.new_length() * param.sampling_rate();
+    VideoFrameReader reader(param.new_height(), param.new_width(), true, false);
+    video_list_ = file_list_;
+    clip_video_.clear();
+    vector<string> files;
+    vector<int> start_frms;
+    vector< vector<int> > labels;
+    for (int v = 0; v < video_list_.size(); ++v) {
+        // Video frames count from 0, extracted ones from 1; the list gives
+        // the number of extracted frames.
+        int first_frm = 0;
+        int num_frames = 0;
+        if (param.use_image()) {
+            first_frm = 1;
+            num_frames = start_frm_list_[v];
+        } else if (reader.Open(video_list_[v])) {
+            num_frames = reader.num_frames();
+        }
+        const size_t num_clips = files.size();
+        for (int start = 0; start + span <= num_frames; start += clip_stride) {
+            files.push_back(video_list_[v]);
+            start_frms.push_back(first_frm + start);
+            labels.push_back(label_list_[v]);
+            clip_video_.push_back(v);
+        }
+        if (files.size() == num_clips) {
+            LOG(WARNING) << "No clip of " << span << " frames fits in the " << num_frames
+                         << " frames of " << video_list_[v];
+        }
+    }
+    file_list_.swap(files);
+    start_frm_list_.swap(start_frms);
+    label_list_.swap(labels);
+    shuffle_index_.resize(file_list_.size());
+    for (int i = 0; i < shuffle_index_.size(); ++i) {
+        shuffle_index_[i] = i;
+    }
+    LOG(INFO) << "Covered " << video_list_.size() << " videos with " << file_list_.size()
+              << " clips every " << clip_stride << " frames.";
 }
 
 template <typename Dtype>
-unsigned int C3DMultiLabelVideoDataLayer<Dtype>::PrefetchRand() {
-    CHECK(prefetch_rng_);
+void C3DMultiLabelVideoDataLayer<Dtype>::ShuffleClips() {
     caffe::rng_t* prefetch_rng =
             static_cast<caffe::rng_t*>(prefetch_rng_->generator());
-    return (*prefetch_rng)();
-}
-
-template <typename Dtype>
-void C3DMultiLabelVideoDataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                        const vector<Blob<Dtype>*>& top) {
-    // First, join the thread
-    JoinPrefetchThread();
-    // Copy the data
-    caffe_copy(prefetch_data_->count(), prefetch_data_->cpu_data(),
-               top[0]->mutable_cpu_data());
-    if (output_labels_) {
-        //for (int i=0; i<4;++i){
-        caffe_copy(prefetch_label_->count(), prefetch_label_->cpu_data(),
-                   top[1]->mutable_cpu_data());
-        //}
-    }
-    // Start a new prefetch thread
-    CreatePrefetchThread();
+    shuffle(shuffle_index_.begin(), shuffle_index_.end(), prefetch_rng);
 }
 
-#ifdef CPU_ONLY
-STUB_GPU(C3DMultiLabelVideoDataLayer);
-#endif
-
 INSTANTIATE_CLASS(C3DMultiLabelVideoDataLayer);
 REGISTER_LAYER_CLASS(C3DMultiLabelVideoData);
 
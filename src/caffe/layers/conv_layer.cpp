@@ -24,14 +24,32 @@ void ConvolutionLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const Dtype* weight = this->blobs_[0]->cpu_data();
+  // The 16-bit pass may have released the float weights.
+  const Dtype* weight = this->is_half() ? NULL : this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
-      if (this->bias_term_) {
+      if (this->is_quantized()) {
+        this->forward_cpu_int8(bottom_data + n * this->bottom_dim_,
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+            this->layer_param_.convolution_param().fused_relu(),
+            top_data + n * this->top_dim_);
+        continue;
+      }
+      if (this->is_half()) {
+        this->forward_cpu_half_gemm(bottom_data + n * this->bottom_dim_,
+            top_data + n * this->top_dim_);
+      } else {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
+      if (this->layer_param_.convolution_param().fused_relu()) {
+        // Bias and ReLU in one pass over the output.
+        caffe_cpu_bias_relu(this->num_output_, this->out_spatial_dim_,
+            this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+            top_data + n * this->top_dim_);
+      } else if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
         this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
       }
@@ -42,6 +60,9 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.convolution_param().fused_relu())
+      << "Layer " << this->layer_param_.name()
+      << " has a fused ReLU, which is inference only.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
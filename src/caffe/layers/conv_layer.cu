@@ -14,7 +14,12 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     for (int n = 0; n < this->num_; ++n) {
       this->forward_gpu_gemm(bottom_data + n * this->bottom_dim_, weight,
           top_data + n * this->top_dim_);
-      if (this->bias_term_) {
+      if (this->layer_param_.convolution_param().fused_relu()) {
+        // Bias and ReLU in one pass over the output.
+        caffe_gpu_bias_relu(this->num_output_, this->out_spatial_dim_,
+            this->bias_term_ ? this->blobs_[1]->gpu_data() : NULL,
+            top_data + n * this->top_dim_);
+      } else if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->gpu_data();
         this->forward_gpu_bias(top_data + n * this->top_dim_, bias);
       }
@@ -25,6 +30,9 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->layer_param_.convolution_param().fused_relu())
+      << "Layer " << this->layer_param_.name()
+      << " has a fused ReLU, which is inference only.";
   const Dtype* weight = this->blobs_[0]->gpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_gpu_diff();
   for (int i = 0; i < top.size(); ++i) {
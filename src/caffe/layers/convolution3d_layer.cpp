@@ -14,7 +14,12 @@
  *
  */
 
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#endif
 
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layer.hpp"
@@ -22,9 +27,212 @@
 #include "caffe/util/vol2col.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The DIRECT algorithm keeps a kDirectTile x kDirectBlock tile of outputs
+// (output columns x output channels) in registers while it walks the filter.
+static const int kDirectBlock = 16;
+static const int kDirectTile = 6;
+
+// Accumulates one kDirectTile x kDirectBlock output tile whose receptive
+// field starts at (l0, h0) and covers output columns [wo0, wo0 + tile) into
+// result, starting from init. Interior tiles read only inside the input rows,
+// so their loops have constant bounds and acc lives in registers; the other
+// tiles clip each kernel column to [w_begin[kw], w_end[kw]).
+template <typename Dtype, bool kInterior>
+inline void conv3d_direct_tile(const Dtype* input, const Dtype* packed_weight,
+    const Dtype* init, const int channels, const int length, const int height,
+    const int width, const int ksize, const int kdepth, const int pad,
+    const int stride, const int l0, const int h0, const int wo0,
+    const int tile, const int* w_begin, const int* w_end, Dtype* result) {
+    Dtype acc[kDirectTile][kDirectBlock];
+    for (int j = 0; j < kDirectTile; ++j) {
+        for (int o = 0; o < kDirectBlock; ++o) {
+            acc[j][o] = init[o];
+        }
+    }
+    for (int kd = std::max(-l0, 0); kd < std::min(kdepth, length - l0); ++kd) {
+        for (int kh = std::max(-h0, 0); kh < std::min(ksize, height - h0); ++kh) {
+            for (int c = 0; c < channels; ++c) {
+                const Dtype* in_row = input + ((c * length + l0 + kd) * height + h0 + kh) * width
+                    + wo0 * stride - pad;
+                const Dtype* w = packed_weight
+                    + ((c * kdepth + kd) * ksize + kh) * ksize * kDirectBlock;
+                for (int kw = 0; kw < ksize; ++kw, w += kDirectBlock) {
+                    const Dtype* in = in_row + kw;
+                    const int j_begin = kInterior ? 0 : std::max(w_begin[kw] - wo0, 0);
+                    const int j_end = kInterior ? kDirectTile : std::min(w_end[kw] - wo0, tile);
+                    for (int j = j_begin; j < j_end; ++j) {
+                        const Dtype x = in[j * stride];
+                        for (int o = 0; o < kDirectBlock; ++o) {
+                            acc[j][o] += x * w[o];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (int j = 0; j < kDirectTile; ++j) {
+        for (int o = 0; o < kDirectBlock; ++o) {
+            result[j * kDirectBlock + o] = acc[j][o];
+        }
+    }
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+// The same for float with AVX2 and FMA, for kDirectTile == 6 and
+// kDirectBlock == 16: output column j accumulates its 16 output channels in
+// the vectors lo##j and hi##j, and every filter tap is one broadcast input
+// times two weight vectors. The columns are spelled out so that the twelve
+// accumulators stay in registers.
+#define CONV3D_DIRECT_TAP(j) \
+    if (kInterior || (j >= j_begin && j < j_end)) { \
+        const __m256 x = _mm256_set1_ps(in[j * stride]); \
+        lo##j = _mm256_fmadd_ps(x, w_lo, lo##j); \
+        hi##j = _mm256_fmadd_ps(x, w_hi, hi##j); \
+    }
+template <bool kInterior>
+inline void conv3d_direct_tile_avx2(const float* input,
+    const float* packed_weight, const float* init, const int channels,
+    const int length, const int height, const int width, const int ksize,
+    const int kdepth, const int pad, const int stride, const int l0,
+    const int h0, const int wo0, const int tile, const int* w_begin,
+    const int* w_end, float* result) {
+    __m256 lo0 = _mm256_loadu_ps(init);
+    __m256 hi0 = _mm256_loadu_ps(init + 8);
+    __m256 lo1 = lo0, lo2 = lo0, lo3 = lo0, lo4 = lo0, lo5 = lo0;
+    __m256 hi1 = hi0, hi2 = hi0, hi3 = hi0, hi4 = hi0, hi5 = hi0;
+    for (int kd = std::max(-l0, 0); kd < std::min(kdepth, length - l0); ++kd) {
+        for (int kh = std::max(-h0, 0); kh < std::min(ksize, height - h0); ++kh) {
+            for (int c = 0; c < channels; ++c) {
+                const float* in_row = input + ((c * length + l0 + kd) * height + h0 + kh) * width
+                    + wo0 * stride - pad;
+                const float* w = packed_weight
+                    + ((c * kdepth + kd) * ksize + kh) * ksize * kDirectBlock;
+                for (int kw = 0; kw < ksize; ++kw, w += kDirectBlock) {
+                    const float* in = in_row + kw;
+                    const __m256 w_lo = _mm256_loadu_ps(w);
+                    const __m256 w_hi = _mm256_loadu_ps(w + 8);
+                    const int j_begin = kInterior ? 0 : std::max(w_begin[kw] - wo0, 0);
+                    const int j_end = kInterior ? kDirectTile : std::min(w_end[kw] - wo0, tile);
+                    CONV3D_DIRECT_TAP(0);
+                    CONV3D_DIRECT_TAP(1);
+                    CONV3D_DIRECT_TAP(2);
+                    CONV3D_DIRECT_TAP(3);
+                    CONV3D_DIRECT_TAP(4);
+                    CONV3D_DIRECT_TAP(5);
+                }
+            }
+        }
+    }
+    _mm256_storeu_ps(result, lo0);
+    _mm256_storeu_ps(result + 8, hi0);
+    _mm256_storeu_ps(result + kDirectBlock, lo1);
+    _mm256_storeu_ps(result + kDirectBlock + 8, hi1);
+    _mm256_storeu_ps(result + 2 * kDirectBlock, lo2);
+    _mm256_storeu_ps(result + 2 * kDirectBlock + 8, hi2);
+    _mm256_storeu_ps(result + 3 * kDirectBlock, lo3);
+    _mm256_storeu_ps(result + 3 * kDirectBlock + 8, hi3);
+    _mm256_storeu_ps(result + 4 * kDirectBlock, lo4);
+    _mm256_storeu_ps(result + 4 * kDirectBlock + 8, hi4);
+    _mm256_storeu_ps(result + 5 * kDirectBlock, lo5);
+    _mm256_storeu_ps(result + 5 * kDirectBlock + 8, hi5);
+}
+#undef CONV3D_DIRECT_TAP
+
+template <>
+inline void conv3d_direct_tile<float, true>(const float* input,
+    const float* packed_weight, const float* init, const int channels,
+    const int length, const int height, const int width, const int ksize,
+    const int kdepth, const int pad, const int stride, const int l0,
+    const int h0, const int wo0, const int tile, const int* w_begin,
+    const int* w_end, float* result) {
+    conv3d_direct_tile_avx2<true>(input, packed_weight, init, channels,
+        length, height, width, ksize, kdepth, pad, stride, l0, h0, wo0, tile,
+        w_begin, w_end, result);
+}
+
+template <>
+inline void conv3d_direct_tile<float, false>(const float* input,
+    const float* packed_weight, const float* init, const int channels,
+    const int length, const int height, const int width, const int ksize,
+    const int kdepth, const int pad, const int stride, const int l0,
+    const int h0, const int wo0, const int tile, const int* w_begin,
+    const int* w_end, float* result) {
+    conv3d_direct_tile_avx2<false>(input, packed_weight, init, channels,
+        length, height, width, ksize, kdepth, pad, stride, l0, h0, wo0, tile,
+        w_begin, w_end, result);
+}
+#endif  // __AVX2__ && __FMA__
+
+// Direct 3-D convolution of one input volume with num_filters <= kDirectBlock
+// consecutive filters, overwriting their output volumes. packed_weight holds
+// the filters interleaved as [channels][kdepth][ksize][ksize][kDirectBlock],
+// zero padded past num_filters, so each filter tap is one contiguous vector
+// of kDirectBlock weights that is reused for kDirectTile output columns.
+template <typename Dtype>
+void conv3d_direct_block(const Dtype* input, const Dtype* packed_weight,
+    const Dtype* bias, const int num_filters, const int channels,
+    const int length, const int height, const int width, const int ksize,
+    const int kdepth, const int pad, const int temporal_pad, const int stride,
+    const int temporal_stride, const int length_out, const int height_out,
+    const int width_out, const bool relu, Dtype* output) {
+    const int out_volume = length_out * height_out * width_out;
+    // Output columns [w_begin[kw], w_end[kw]) read inside the input row for
+    // kernel column kw.
+    vector<int> w_begin(ksize), w_end(ksize);
+    int interior_begin = 0;
+    int interior_end = width_out;
+    for (int kw = 0; kw < ksize; ++kw) {
+        const int offset = kw - pad;
+        w_begin[kw] = std::min(offset < 0 ? (-offset + stride - 1) / stride : 0,
+                               width_out);
+        w_end[kw] = std::max(std::min(offset < width ?
+            (width - offset + stride - 1) / stride : 0, width_out), w_begin[kw]);
+        interior_begin = std::max(interior_begin, w_begin[kw]);
+        interior_end = std::min(interior_end, w_end[kw]);
+    }
+    Dtype init[kDirectBlock];
+    for (int o = 0; o < kDirectBlock; ++o) {
+        init[o] = (bias && o < num_filters) ? bias[o] : Dtype(0);
+    }
+    Dtype result[kDirectTile * kDirectBlock];
+    for (int lo = 0; lo < length_out; ++lo) {
+        const int l0 = lo * temporal_stride - temporal_pad;
+        for (int ho = 0; ho < height_out; ++ho) {
+            const int h0 = ho * stride - pad;
+            const int out_offset = (lo * height_out + ho) * width_out;
+            for (int wo0 = 0; wo0 < width_out; wo0 += kDirectTile) {
+                const int tile = std::min(kDirectTile, width_out - wo0);
+                if (wo0 >= interior_begin && wo0 + kDirectTile <= interior_end) {
+                    conv3d_direct_tile<Dtype, true>(input, packed_weight, init,
+                        channels, length, height, width, ksize, kdepth, pad,
+                        stride, l0, h0, wo0, tile, &w_begin[0], &w_end[0], result);
+                } else {
+                    conv3d_direct_tile<Dtype, false>(input, packed_weight, init,
+                        channels, length, height, width, ksize, kdepth, pad,
+                        stride, l0, h0, wo0, tile, &w_begin[0], &w_end[0], result);
+                }
+                for (int o = 0; o < num_filters; ++o) {
+                    Dtype* out = output + o * out_volume + out_offset + wo0;
+                    if (relu) {
+                        for (int j = 0; j < tile; ++j) {
+                            out[j] = std::max(result[j * kDirectBlock + o],
+                                              Dtype(0));
+                        }
+                    } else {
+                        for (int j = 0; j < tile; ++j) {
+                            out[j] = result[j * kDirectBlock + o];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 template <typename Dtype>
 void Convolution3DLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                            const vector<Blob<Dtype>*>& top)
@@ -72,6 +280,29 @@ void Convolution3DLayer<Dtype>::Reshape(const vector<Blob<Dtype> *> &bottom, con
     shape[4] = width_out;
     col_buffer_.Reshape(shape);
 
+    // One more column buffer for every extra batch slice run concurrently.
+    num_ = bottom[0]->shape(0);
+    int num_slices = this->layer_param_.convolution3d_param().batch_parallelism();
+    if (num_slices == 0) {
+        // A 3x3x3 column buffer is 27 times the input volume, so one per
+        // thread of a large host would not fit: keep them within the budget.
+        const uint64_t budget = static_cast<uint64_t>(this->layer_param_
+            .convolution3d_param().col_buffer_budget_mb()) << 20;
+        const uint64_t col_bytes = col_buffer_.count() * sizeof(Dtype);
+        num_slices = static_cast<int>(std::min<uint64_t>(
+            ThreadPool::Get().num_threads(), budget / col_bytes));
+    }
+    num_slices = std::max(1, std::min(num_slices, num_));
+    slice_col_buffers_.resize(num_slices - 1);
+    slice_weight_diffs_.resize(num_slices - 1);
+    for (int i = 0; i < num_slices - 1; ++i) {
+        if (!slice_col_buffers_[i]) {
+            slice_col_buffers_[i].reset(new Blob<Dtype>());
+            slice_weight_diffs_[i].reset(new Blob<Dtype>());
+        }
+        slice_col_buffers_[i]->Reshape(shape);
+    }
+
 
     bias_term_ = this->layer_param_.convolution3d_param().bias_term();
 
@@ -136,49 +367,227 @@ void Convolution3DLayer<Dtype>::Reshape(const vector<Blob<Dtype> *> &bottom, con
 
 }
 
+template <typename Dtype>
+void Convolution3DLayer<Dtype>::narrow_weights() {
+    if (half_weights_version_ != this->blobs_[0]->data()->version()) {
+        half_weights_.resize(this->blobs_[0]->count());
+        caffe_cpu_narrow(this->layer_param_.storage_precision(),
+            this->blobs_[0]->count(), this->blobs_[0]->cpu_data(),
+            &half_weights_[0]);
+        half_weights_version_ = this->blobs_[0]->data()->version();
+    }
+}
+
+template <typename Dtype>
+size_t Convolution3DLayer<Dtype>::ReleaseFloatWeights() {
+    if (this->layer_param_.storage_precision() == LayerParameter_StoragePrecision_FLOAT
+            || this->layer_param_.quantization_param().input_range_size() > 0) {
+        return 0;
+    }
+    narrow_weights();
+    // The weights get a new, unallocated memory, which is already narrowed.
+    Blob<Dtype> released(this->blobs_[0]->shape());
+    this->blobs_[0]->ShareData(released);
+    half_weights_version_ = this->blobs_[0]->data()->version();
+    return released.count() * sizeof(Dtype);
+}
+
 template <typename Dtype>
 void Convolution3DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                              const vector<Blob<Dtype>*>& top) {
     const Dtype* bottom_data = bottom[0]->cpu_data();
     Dtype* top_data = top[0]->mutable_cpu_data();
-    Dtype* col_data = col_buffer_.mutable_cpu_data();
-    const Dtype* weight = this->blobs_[0]->cpu_data();
+    if (this->layer_param_.quantization_param().input_range_size() > 0) {
+        if (int8_weights_version_ != this->blobs_[0]->data()->version()) {
+            int8_weights_.Quantize(this->layer_param_.quantization_param(),
+                channels_, num_output_, K_, this->blobs_[0]->cpu_data());
+            int8_weights_version_ = this->blobs_[0]->data()->version();
+        }
+        const int num_slices = slice_col_buffers_.size() + 1;
+        int8_inputs_.resize(num_slices);
+        int8_col_buffers_.resize(num_slices);
+        int8_sums_.resize(num_slices);
+        for (int i = 0; i < num_slices; ++i) {
+            int8_inputs_[i].resize(channels_ * length_ * height_ * width_);
+            int8_col_buffers_[i].resize(K_ * N_);
+            int8_sums_[i].resize(num_output_ * N_);
+        }
+        if (bias_term_) {
+            this->blobs_[1]->cpu_data();
+        }
+        ThreadPool::Get().Run(num_slices,
+            boost::bind(&Convolution3DLayer<Dtype>::forward_cpu_int8_slice,
+                this, bottom_data, top_data, _1));
+        return;
+    }
+    const StoragePrecision precision = this->layer_param_.storage_precision();
+    if (precision != LayerParameter_StoragePrecision_FLOAT) {
+        narrow_weights();
+        const int num_slices = slice_col_buffers_.size() + 1;
+        half_inputs_.resize(num_slices);
+        half_col_buffers_.resize(num_slices);
+        for (int i = 0; i < num_slices; ++i) {
+            half_inputs_[i].resize(channels_ * length_ * height_ * width_);
+            half_col_buffers_[i].resize(K_ * N_);
+        }
+    }
+    if (precision == LayerParameter_StoragePrecision_FLOAT &&
+            this->layer_param_.convolution3d_param().algorithm() ==
+            Convolution3DParameter_Algorithm_DIRECT) {
+        // Interleave each block of kDirectBlock filters tap by tap, again
+        // only when the weights may have changed since.
+        const int num_blocks = (num_output_ + kDirectBlock - 1) / kDirectBlock;
+        if (packed_weight_version_ != this->blobs_[0]->data()->version()) {
+            vector<int> shape(2);
+            shape[0] = num_blocks * K_;
+            shape[1] = kDirectBlock;
+            packed_weight_.Reshape(shape);
+            const Dtype* weight = this->blobs_[0]->cpu_data();
+            Dtype* packed = packed_weight_.mutable_cpu_data();
+            caffe_set(packed_weight_.count(), Dtype(0), packed);
+            for (int o = 0; o < num_output_; ++o) {
+                Dtype* block = packed + (o / kDirectBlock) * K_ * kDirectBlock;
+                for (int k = 0; k < K_; ++k) {
+                    block[k * kDirectBlock + o % kDirectBlock] = weight[o * K_ + k];
+                }
+            }
+            packed_weight_version_ = this->blobs_[0]->data()->version();
+        }
+        ThreadPool::Get().Run(num_ * num_blocks,
+            boost::bind(&Convolution3DLayer<Dtype>::forward_cpu_direct, this,
+                bottom_data, top_data, _1));
+        return;
+    }
+    // Touch the parameters once here so the slices only read them.
+    if (precision == LayerParameter_StoragePrecision_FLOAT) {
+        this->blobs_[0]->cpu_data();
+    }
+    if (bias_term_) {
+        this->blobs_[1]->cpu_data();
+        bias_multiplier_->cpu_data();
+    }
+    ThreadPool::Get().Run(slice_col_buffers_.size() + 1,
+        boost::bind(&Convolution3DLayer<Dtype>::forward_cpu_gemm_slice, this,
+            bottom_data, top_data, _1));
+}
+
+template <typename Dtype>
+void Convolution3DLayer<Dtype>::forward_cpu_gemm_slice(const Dtype* bottom_data,
+                                                       Dtype* top_data, int slice) {
+    const int num_slices = slice_col_buffers_.size() + 1;
+    const StoragePrecision precision = this->layer_param_.storage_precision();
+    const bool half = precision != LayerParameter_StoragePrecision_FLOAT;
+    // The float column buffers stay unallocated in 16 bits.
+    Dtype* col_data = half ? NULL
+                           : slice == 0 ? col_buffer_.mutable_cpu_data_for_overwrite()
+                                        : slice_col_buffers_[slice - 1]->mutable_cpu_data_for_overwrite();
+    const Dtype* weight = half ? NULL : this->blobs_[0]->cpu_data();
+    const int bottom_dim = channels_ * length_ * height_ * width_;
+    const int top_dim = num_output_ * N_;
 
     int weight_offset = M_ * K_;
     int top_offset = M_ * N_;
 
-    for (int n = 0; n < num_; ++n) {
-        // First, im2col
-        vol2col_cpu(bottom_data + bottom[0]->offset(n), channels_, length_, height_,
-                width_, kernel_size_, kernel_depth_, pad_, temporal_pad_, stride_, temporal_stride_, col_data);
-
-        // Second, inner-product without filter groups
-        for (int g=0 ; g < filter_group_; ++g) {
-            caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, K_,
-                                  (Dtype)1., weight + g * weight_offset, col_data,
-                                  (Dtype)0., top_data + top[0]->offset(n) + g * top_offset);
+    for (int n = slice * num_ / num_slices; n < (slice + 1) * num_ / num_slices; ++n) {
+        if (half) {
+            // The same in 16 bits: narrow the input, vol2col it and widen
+            // the blocks of weights and columns inside the product.
+            uint16_t* input = &half_inputs_[slice][0];
+            uint16_t* half_col_data = &half_col_buffers_[slice][0];
+            caffe_cpu_narrow(precision, bottom_dim,
+                bottom_data + n * bottom_dim, input);
+            vol2col_cpu(input, channels_, length_, height_, width_,
+                kernel_size_, kernel_depth_, pad_, temporal_pad_, stride_,
+                temporal_stride_, half_col_data);
+            for (int g = 0; g < filter_group_; ++g) {
+                caffe_cpu_gemm_half(precision, CblasNoTrans, M_, N_, K_,
+                    &half_weights_[g * weight_offset], half_col_data,
+                    top_data + n * top_dim + g * top_offset);
+            }
+        } else {
+            // First, im2col
+            vol2col_cpu(bottom_data + n * bottom_dim, channels_, length_, height_,
+                    width_, kernel_size_, kernel_depth_, pad_, temporal_pad_, stride_, temporal_stride_, col_data);
+
+            // Second, inner-product without filter groups
+            for (int g=0 ; g < filter_group_; ++g) {
+                caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, K_,
+                                      (Dtype)1., weight + g * weight_offset, col_data,
+                                      (Dtype)0., top_data + n * top_dim + g * top_offset);
+            }
         }
-        // third, add bias
-        if (bias_term_) {
+        // third, add bias, and apply the fused ReLU in the same pass
+        if (this->layer_param_.convolution3d_param().fused_relu()) {
+            caffe_cpu_bias_relu(num_output_, N_,
+                bias_term_ ? this->blobs_[1]->cpu_data() : NULL,
+                top_data + n * top_dim);
+        } else if (bias_term_) {
             caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
                                   N_, 1, (Dtype)1., this->blobs_[1]->cpu_data(),
                     reinterpret_cast<const Dtype*>(bias_multiplier_->cpu_data()),
-                    (Dtype)1., top_data + top[0]->offset(n));
+                    (Dtype)1., top_data + n * top_dim);
         }
 
     }
 }
 
+template <typename Dtype>
+void Convolution3DLayer<Dtype>::forward_cpu_int8_slice(const Dtype* bottom_data,
+                                                       Dtype* top_data, int slice) {
+    const int num_slices = slice_col_buffers_.size() + 1;
+    int8_t* input = &int8_inputs_[slice][0];
+    int8_t* col_data = &int8_col_buffers_[slice][0];
+    int32_t* sums = &int8_sums_[slice][0];
+    const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    const bool relu = this->layer_param_.convolution3d_param().fused_relu();
+    const int bottom_dim = channels_ * length_ * height_ * width_;
+    const int top_dim = num_output_ * N_;
+
+    for (int n = slice * num_ / num_slices; n < (slice + 1) * num_ / num_slices; ++n) {
+        // Quantize per channel, then vol2col and multiply in int8; the filter
+        // groups share the columns, so one product covers them all.
+        int8_weights_.QuantizeInput(bottom_dim, length_ * height_ * width_,
+                bottom_data + n * bottom_dim, input);
+        vol2col_cpu(input, channels_, length_, height_, width_, kernel_size_,
+                kernel_depth_, pad_, temporal_pad_, stride_, temporal_stride_,
+                col_data);
+        caffe_cpu_gemm_s8(CblasNoTrans, num_output_, N_, K_,
+                int8_weights_.data(), col_data, sums);
+        int8_weights_.DequantizeChannels(N_, sums, bias, relu,
+                top_data + n * top_dim);
+    }
+}
+
+template <typename Dtype>
+void Convolution3DLayer<Dtype>::forward_cpu_direct(const Dtype* bottom_data,
+                                                   Dtype* top_data, int index) {
+    const int num_blocks = (num_output_ + kDirectBlock - 1) / kDirectBlock;
+    const int n = index / num_blocks;
+    const int o_begin = (index % num_blocks) * kDirectBlock;
+    const int o_end = std::min(o_begin + kDirectBlock, num_output_);
+    const int length_out = (length_ + 2 * temporal_pad_ - kernel_depth_) / temporal_stride_ + 1;
+    const int height_out = (height_ + 2 * pad_ - kernel_size_) / stride_ + 1;
+    const int width_out = (width_ + 2 * pad_ - kernel_size_) / stride_ + 1;
+    const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    conv3d_direct_block(bottom_data + n * channels_ * length_ * height_ * width_,
+        packed_weight_.cpu_data() + (o_begin / kDirectBlock) * K_ * kDirectBlock,
+        bias ? bias + o_begin : NULL, o_end - o_begin, channels_, length_,
+        height_, width_, kernel_size_, kernel_depth_, pad_, temporal_pad_,
+        stride_, temporal_stride_, length_out, height_out, width_out,
+        this->layer_param_.convolution3d_param().fused_relu(),
+        top_data + (n * num_output_ + o_begin) * N_);
+}
+
 template <typename Dtype>
 void Convolution3DLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                              const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+    CHECK(!this->layer_param_.convolution3d_param().fused_relu())
+        << "Layer " << this->layer_param_.name()
+        << " has a fused ReLU, which is inference only.";
     const Dtype* top_diff = top[0]->cpu_diff();
-    const Dtype* weight = this->blobs_[0]->cpu_data();
     Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
     const Dtype* bottom_data = bottom[0]->cpu_data();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-    Dtype* col_data = col_buffer_.mutable_cpu_data();
-    Dtype* col_diff = col_buffer_.mutable_cpu_diff();
     // bias gradient if necessary
     Dtype* bias_diff = NULL;
 
@@ -193,44 +602,76 @@ void Convolution3DLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         }
     }
 
+    // Every batch slice accumulates its weight gradient separately: slice 0
+    // straight into weight_diff, the others into their own partials, which
+    // are then added in slice order so the sum does not depend on scheduling.
+    memset(weight_diff, 0, sizeof(Dtype) * this->blobs_[0]->count());
+    for (int i = 0; i < slice_weight_diffs_.size(); ++i) {
+        slice_weight_diffs_[i]->ReshapeLike(*this->blobs_[0]);
+    }
+    ThreadPool::Get().Run(slice_col_buffers_.size() + 1,
+        boost::bind(&Convolution3DLayer<Dtype>::backward_cpu_gemm_slice, this,
+            top_diff, bottom_data, bottom_diff, propagate_down[0], _1));
+    for (int i = 0; i < slice_weight_diffs_.size(); ++i) {
+        caffe_axpy<Dtype>(this->blobs_[0]->count(), (Dtype)1.,
+                          slice_weight_diffs_[i]->cpu_diff(), weight_diff);
+    }
+}
+
+template <typename Dtype>
+void Convolution3DLayer<Dtype>::backward_cpu_gemm_slice(const Dtype* top_diff,
+        const Dtype* bottom_data, Dtype* bottom_diff, bool propagate_down,
+        int slice) {
+    const int num_slices = slice_col_buffers_.size() + 1;
+    Blob<Dtype>* col_buffer = slice == 0 ? &col_buffer_ : slice_col_buffers_[slice - 1].get();
+    Dtype* col_data = col_buffer->mutable_cpu_data_for_overwrite();
+    Dtype* col_diff = col_buffer->mutable_cpu_diff();
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
+    if (slice > 0) {
+        weight_diff = slice_weight_diffs_[slice - 1]->mutable_cpu_diff();
+        caffe_set(this->blobs_[0]->count(), Dtype(0), weight_diff);
+    }
+    const int bottom_dim = channels_ * length_ * height_ * width_;
+    const int top_dim = num_output_ * N_;
+
     int weight_offset = M_ * K_;
     int top_offset = M_ * N_;
 
-    memset(weight_diff, 0, sizeof(Dtype) * this->blobs_[0]->count());
-    for (int n = 0; n < num_; ++n) {
+    for (int n = slice * num_ / num_slices; n < (slice + 1) * num_ / num_slices; ++n) {
         // since we saved memory in the forward pass by not storing all col data,
         // we will need to recompute them.
-        vol2col_cpu(bottom_data + bottom[0]->offset(n), channels_, length_, height_,
+        vol2col_cpu(bottom_data + n * bottom_dim, channels_, length_, height_,
                 width_, kernel_size_, kernel_depth_, pad_, temporal_pad_, stride_,
                 temporal_stride_, col_data);
 
         // gradient w.r.t. weight. Note that we will accumulate diffs.
         for (int g=0; g<filter_group_; ++g){
             caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, M_, K_, N_,
-                                  (Dtype)1., top_diff + top[0]->offset(n) + g * top_offset,
+                                  (Dtype)1., top_diff + n * top_dim + g * top_offset,
                     col_data, (Dtype)1.,
                     weight_diff + g * weight_offset);
         }
 
         // gradient w.r.t. bottom data, if necessary
-        if (propagate_down[0]) {
+        if (propagate_down) {
             // compute first filter group -> col_diff
             caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, K_, N_, M_,
                                   (Dtype)1., weight,
-                                  top_diff + top[0]->offset(n),
+                                  top_diff + n * top_dim,
                     (Dtype)0., col_diff);
 
             // accumulate the other filter groups -> col_diff
             for (int g=1; g<filter_group_; ++g){
                 caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, K_, N_, M_,
                                       (Dtype)1., weight + g * weight_offset,
-                                      top_diff + top[0]->offset(n) + g * top_offset,
+                                      top_diff + n * top_dim + g * top_offset,
                         (Dtype)1., col_diff);
             }
 
             // vol2im back to the data
             col2vol_cpu(col_diff, channels_, length_, height_, width_, kernel_size_, kernel_depth_, pad_,
-                        temporal_pad_, stride_, temporal_stride_, bottom_diff + bottom[0]->offset(n));
+                        temporal_pad_, stride_, temporal_stride_, bottom_diff + n * bottom_dim);
         }
 
     }
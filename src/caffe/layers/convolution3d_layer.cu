@@ -55,8 +55,12 @@ void Convolution3DLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
                                   (Dtype)1., weight + g * weight_offset, col_data,
                                   (Dtype)0., top_data + top[0]->offset(indices) + g * top_offset);
         }
-        // third, add bias
-        if (bias_term_) {
+        // third, add bias, and apply the fused ReLU in the same pass
+        if (this->layer_param_.convolution3d_param().fused_relu()) {
+            caffe_gpu_bias_relu(num_output_, N_,
+                bias_term_ ? this->blobs_[1]->gpu_data() : NULL,
+                top_data + top[0]->offset(indices));
+        } else if (bias_term_) {
             caffe_gpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, num_output_,
                                   N_, 1, (Dtype)1., this->blobs_[1]->gpu_data(),
                     reinterpret_cast<const Dtype*>(bias_multiplier_->gpu_data()),
@@ -69,6 +73,9 @@ template <typename Dtype>
 void Convolution3DLayer<Dtype>::Backward_gpu (const vector<Blob<Dtype>*>& top,
                                               const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom)
 {
+    CHECK(!this->layer_param_.convolution3d_param().fused_relu())
+        << "Layer " << this->layer_param_.name()
+        << " has a fused ReLU, which is inference only.";
     const Dtype* top_diff = top[0]->gpu_diff();
     const Dtype* weight = this->blobs_[0]->gpu_data();
     Dtype* weight_diff = this->blobs_[0]->mutable_gpu_diff();
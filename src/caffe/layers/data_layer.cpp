@@ -35,8 +35,8 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     // Reshape top[0] and prefetch_data according to the batch_size.
     top_shape[0] = batch_size;
     top[0]->Reshape(top_shape);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-        this->prefetch_[i].data_.Reshape(top_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+        this->prefetch_[i]->data_.Reshape(top_shape);
     }
     LOG(INFO) << "output data size: " << top[0]->num() << ","
             << top[0]->channels() << "," << top[0]->height() << ","
@@ -45,8 +45,8 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     if (this->output_labels_) {
         vector<int> label_shape(1, batch_size);
         top[1]->Reshape(label_shape);
-        for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-            this->prefetch_[i].label_.Reshape(label_shape);
+        for (int i = 0; i < this->prefetch_.size(); ++i) {
+            this->prefetch_[i]->label_.Reshape(label_shape);
         }
     }
 }
@@ -1,11 +1,6 @@
-/*
-TODO:
-- load file in a separate thread ("prefetch")
-- can be smarter about the memcpy call instead of doing it row-by-row
-  :: use util functions caffe_copy, and Blob->offset()
-  :: don't forget to update hdf5_daa_layer.cu accordingly
-- add ability to shuffle filenames if flag is set
-*/
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <climits>
 #include <fstream>  // NOLINT(readability/streams)
 #include <string>
 #include <vector>
@@ -16,55 +11,119 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() { }
+HDF5DataLayer<Dtype>::HDF5DataLayer(const LayerParameter& param)
+    : Layer<Dtype>(param),
+      current_file_id_(-1),
+      prefetch_(BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT),
+      prefetch_free_(BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT),
+      prefetch_full_(BasePrefetchingDataLayer<Dtype>::PREFETCH_COUNT),
+      prefetch_current_(NULL) {
+  for (int i = 0; i < prefetch_.size(); ++i) {
+    prefetch_[i].reset(new HDF5Batch<Dtype>());
+  }
+}
 
-// Load data and label from HDF5 filename into the class property blobs.
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
-  DLOG(INFO) << "Loading HDF5 file: " << filename;
-  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
-  if (file_id < 0) {
-    LOG(FATAL) << "Failed opening HDF5 file: " << filename;
-  }
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+  StopLoader();
+}
 
-  int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::StopLoader() {
+  if (loader_) {
+    loader_->join();
+    loader_.reset();
+  }
+  if (current_file_id_ >= 0) {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    herr_t status = H5Fclose(current_file_id_);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file";
+    current_file_id_ = -1;
+  }
+}
 
+// Load the rows of the next chunk from the HDF5 files into chunk.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::LoadNextChunk(Chunk* chunk, unsigned int seed) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  const int top_size = this->layer_param_.top_size();
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
+  rng_t rng(seed);
 
-  for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-        MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get());
+  if (++current_chunk_ == static_cast<int>(chunk_permutation_.size())) {
+    if (++current_file_ == static_cast<int>(num_files_)) {
+      current_file_ = 0;
+      if (param.shuffle()) {
+        shuffle(file_permutation_.begin(), file_permutation_.end(), &rng);
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+    const string& filename = hdf_filenames_[file_permutation_[current_file_]];
+    DLOG(INFO) << "Loading HDF5 file: " << filename;
+    if (current_file_id_ >= 0) {
+      herr_t status = H5Fclose(current_file_id_);
+      CHECK_GE(status, 0) << "Failed to close HDF5 file";
+    }
+    current_file_id_ = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (current_file_id_ < 0) {
+      LOG(FATAL) << "Failed opening HDF5 file: " << filename;
+    }
+    // MinTopBlobs==1 guarantees at least one top blob
+    current_file_rows_ = hdf5_get_nd_dataset_shape(current_file_id_,
+        this->layer_param_.top(0).c_str(), MIN_DATA_DIM, MAX_DATA_DIM)[0];
+    CHECK_GT(current_file_rows_, 0) << "No rows in " << filename;
+    for (int i = 1; i < top_size; ++i) {
+      CHECK_EQ(hdf5_get_nd_dataset_shape(current_file_id_,
+          this->layer_param_.top(i).c_str(), MIN_DATA_DIM, MAX_DATA_DIM)[0],
+          current_file_rows_);
+    }
+    const int chunk_rows = param.chunk_rows() ? param.chunk_rows() :
+        current_file_rows_;
+    chunk_permutation_.clear();
+    for (int row = 0; row < current_file_rows_; row += chunk_rows) {
+      chunk_permutation_.push_back(row);
+    }
+    if (param.shuffle()) {
+      shuffle(chunk_permutation_.begin(), chunk_permutation_.end(), &rng);
+    }
+    current_chunk_ = 0;
   }
 
-  herr_t status = H5Fclose(file_id);
-  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
-
-  // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
-  for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
+  const int row_begin = chunk_permutation_[current_chunk_];
+  const int num_rows = param.chunk_rows() ?
+      std::min<int>(param.chunk_rows(), current_file_rows_ - row_begin) :
+      current_file_rows_;
+  chunk->blobs.resize(top_size);
+  for (int i = 0; i < top_size; ++i) {
+    if (!chunk->blobs[i]) {
+      chunk->blobs[i].reset(new Blob<Dtype>());
+    }
+    hdf5_load_nd_dataset_rows(current_file_id_,
+        this->layer_param_.top(i).c_str(), MIN_DATA_DIM, MAX_DATA_DIM,
+        row_begin, num_rows, chunk->blobs[i].get());
   }
+  DLOG(INFO) << "Successfully loaded " << num_rows << " rows";
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::ShuffleRows(Chunk* chunk) {
   // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++)
-    data_permutation_[i] = i;
+  chunk->permutation.resize(chunk->blobs[0]->shape(0));
+  for (int i = 0; i < chunk->permutation.size(); i++)
+    chunk->permutation[i] = i;
 
   // Shuffle if needed.
   if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
-  } else {
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+    shuffle(chunk->permutation.begin(), chunk->permutation.end());
   }
 }
 
@@ -74,6 +133,8 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Refuse transformation parameters since HDF5 is totally generic.
   CHECK(!this->layer_param_.has_transform_param()) <<
       this->type() << " does not transform data.";
+  this->StopInternalThread();
+  StopLoader();
   // Read the source to parse the filenames.
   const string& source = this->layer_param_.hdf5_data_param().source();
   LOG(INFO) << "Loading list of HDF5 filenames from: " << source;
@@ -89,7 +150,6 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   source_file.close();
   num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
   LOG(INFO) << "Number of HDF5 files: " << num_files_;
   CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
     << source;
@@ -103,56 +163,120 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
   // Shuffle if needed.
   if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
+    shuffle(file_permutation_.begin(), file_permutation_.end());
   }
 
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
+  // Load the first chunk and initialize the line counter; the next one is
+  // loaded in the background unless there is only one.
+  current_file_ = -1;
+  current_chunk_ = -1;
+  chunk_permutation_.clear();
+  chunk_.reset(new Chunk());
+  next_chunk_.reset(new Chunk());
+  LoadNextChunk(chunk_.get(), caffe_rng_rand());
+  single_chunk_ = num_files_ == 1 && chunk_permutation_.size() == 1;
+  ShuffleRows(chunk_.get());
   current_row_ = 0;
+  if (!single_chunk_) {
+    loader_.reset(new boost::thread(&HDF5DataLayer<Dtype>::LoadNextChunk,
+        this, next_chunk_.get(), caffe_rng_rand()));
+  }
 
   // Reshape blobs.
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   const int top_size = this->layer_param_.top_size();
   vector<int> top_shape;
   for (int i = 0; i < top_size; ++i) {
-    top_shape.resize(hdf_blobs_[i]->num_axes());
+    top_shape = chunk_->blobs[i]->shape();
     top_shape[0] = batch_size;
-    for (int j = 1; j < top_shape.size(); ++j) {
-      top_shape[j] = hdf_blobs_[i]->shape(j);
-    }
     top[i]->Reshape(top_shape);
   }
+  HDF5Batch<Dtype>* batch;
+  while (prefetch_full_.try_pop(&batch)) {}
+  while (prefetch_free_.try_pop(&batch)) {}
+  prefetch_current_ = NULL;
+  for (int k = 0; k < prefetch_.size(); ++k) {
+    vector<shared_ptr<Blob<Dtype> > >& blobs = prefetch_[k]->blobs_;
+    blobs.resize(top_size);
+    for (int i = 0; i < top_size; ++i) {
+      if (!blobs[i]) {
+        blobs[i].reset(new Blob<Dtype>());
+      }
+      blobs[i]->ReshapeLike(*top[i]);
+    }
+    prefetch_free_.push(prefetch_[k].get());
+  }
+  this->StartInternalThread();
 }
 
 template <typename Dtype>
-void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-      const vector<Blob<Dtype>*>& top) {
+void HDF5DataLayer<Dtype>::NextChunk() {
+  if (!single_chunk_) {
+    loader_->join();
+    chunk_.swap(next_chunk_);
+    loader_.reset(new boost::thread(&HDF5DataLayer<Dtype>::LoadNextChunk,
+        this, next_chunk_.get(), caffe_rng_rand()));
+    for (int j = 0; j < chunk_->blobs.size(); ++j) {
+      CHECK_EQ(chunk_->blobs[j]->count(1), prefetch_[0]->blobs_[j]->count(1))
+          << "The rows of " << this->layer_param_.top(j)
+          << " differ between files";
+    }
+  }
+  ShuffleRows(chunk_.get());
+  current_row_ = 0;
+}
+
+// Gathers the rows of the batches on the prefetch thread.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
-  for (int i = 0; i < batch_size; ++i, ++current_row_) {
-    if (current_row_ == hdf_blobs_[0]->shape(0)) {
-      if (num_files_ > 1) {
-        ++current_file_;
-        if (current_file_ == num_files_) {
-          current_file_ = 0;
-          if (this->layer_param_.hdf5_data_param().shuffle()) {
-            std::random_shuffle(file_permutation_.begin(),
-                                file_permutation_.end());
-          }
-          DLOG(INFO) << "Looping around to first file.";
+  const int top_size = this->layer_param_.top_size();
+  try {
+    while (!must_stop()) {
+      HDF5Batch<Dtype>* batch = prefetch_free_.pop();
+      for (int i = 0; i < batch_size; ++i, ++current_row_) {
+        if (current_row_ == chunk_->blobs[0]->shape(0)) {
+          NextChunk();
+        }
+        for (int j = 0; j < top_size; ++j) {
+          Blob<Dtype>* blob = batch->blobs_[j].get();
+          const int data_dim = blob->count(1);
+          caffe_copy(data_dim, chunk_->blobs[j]->cpu_data() +
+              chunk_->permutation[current_row_] * data_dim,
+              blob->mutable_cpu_data() + i * data_dim);
         }
-        LoadHDF5FileData(
-            hdf_filenames_[file_permutation_[current_file_]].c_str());
       }
-      current_row_ = 0;
-      if (this->layer_param_.hdf5_data_param().shuffle())
-        std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
+      prefetch_full_.push(batch);
     }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  if (Caffe::solver_count() > 1) {
+    // Shared by the solvers: copy, as BasePrefetchingDataLayer does.
+    HDF5Batch<Dtype>* batch =
+        prefetch_full_.pop("Data layer prefetch queue empty");
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
-      int data_dim = top[j]->count() / top[j]->shape(0);
-      caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-            * data_dim], &top[j]->mutable_cpu_data()[i * data_dim]);
+      const Blob<Dtype>* blob = batch->blobs_[j].get();
+      top[j]->ReshapeLike(*blob);
+      caffe_copy(blob->count(), blob->cpu_data(),
+          top[j]->mutable_cpu_data_for_overwrite());
     }
+    prefetch_free_.push(batch);
+    return;
+  }
+  if (prefetch_current_) {
+    prefetch_free_.push(prefetch_current_);
+  }
+  prefetch_current_ = prefetch_full_.pop("Data layer prefetch queue empty");
+  for (int j = 0; j < this->layer_param_.top_size(); ++j) {
+    Blob<Dtype>* blob = prefetch_current_->blobs_[j].get();
+    top[j]->ReshapeLike(*blob);
+    top[j]->set_cpu_data(blob->mutable_cpu_data());
   }
 }
 
@@ -47,8 +47,8 @@ void Im2VoxelDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom
     voxel_shape[4] = top_shape[3];
 
     top[0]->Reshape(voxel_shape);
-    for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-        this->prefetch_[i].data_.Reshape(voxel_shape);
+    for (int i = 0; i < this->prefetch_.size(); ++i) {
+        this->prefetch_[i]->data_.Reshape(voxel_shape);
     }
 
     voxel_shape[0] = 1;
@@ -94,9 +94,9 @@ void Im2VoxelDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom
 
         top[1]->Reshape(label_shape);
         LOG(INFO) << "reshaped label ";
-        for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
+        for (int i = 0; i < this->prefetch_.size(); ++i) {
             LOG(INFO) << "fetching label ";
-            this->prefetch_[i].label_.Reshape(label_shape);
+            this->prefetch_[i]->label_.Reshape(label_shape);
         }
         LOG(INFO) << "fetched label ";
 
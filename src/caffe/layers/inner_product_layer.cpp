@@ -80,15 +80,52 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void InnerProductLayer<Dtype>::narrow_weights() {
+  if (half_weights_version_ != this->blobs_[0]->data()->version()) {
+    half_weights_.resize(this->blobs_[0]->count());
+    caffe_cpu_narrow(this->layer_param_.storage_precision(),
+        this->blobs_[0]->count(), this->blobs_[0]->cpu_data(),
+        &half_weights_[0]);
+    half_weights_version_ = this->blobs_[0]->data()->version();
+  }
+}
+
+template <typename Dtype>
+size_t InnerProductLayer<Dtype>::ReleaseFloatWeights() {
+  if (this->layer_param_.storage_precision() ==
+      LayerParameter_StoragePrecision_FLOAT ||
+      this->layer_param_.quantization_param().input_range_size() > 0) {
+    return 0;
+  }
+  narrow_weights();
+  // The weights get a new, unallocated memory, which is already narrowed.
+  Blob<Dtype> released(this->blobs_[0]->shape());
+  this->blobs_[0]->ShareData(released);
+  half_weights_version_ = this->blobs_[0]->data()->version();
+  return released.count() * sizeof(Dtype);
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const Dtype* weight = this->blobs_[0]->cpu_data();
-  caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
-      M_, N_, K_, (Dtype)1.,
-      bottom_data, weight, (Dtype)0., top_data);
+  if (this->layer_param_.quantization_param().input_range_size() > 0) {
+    forward_cpu_int8(*bottom[0], top_data);
+    return;
+  }
+  const StoragePrecision precision = this->layer_param_.storage_precision();
+  if (precision != LayerParameter_StoragePrecision_FLOAT) {
+    narrow_weights();
+    caffe_cpu_gemm_half(precision, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, bottom_data, &half_weights_[0], top_data);
+  } else {
+    const Dtype* weight = this->blobs_[0]->cpu_data();
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
+        M_, N_, K_, (Dtype)1.,
+        bottom_data, weight, (Dtype)0., top_data);
+  }
   if (bias_term_) {
     caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, M_, N_, 1, (Dtype)1.,
         bias_multiplier_.cpu_data(),
@@ -96,6 +133,28 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void InnerProductLayer<Dtype>::forward_cpu_int8(const Blob<Dtype>& bottom,
+    Dtype* top_data) {
+  // The input channels are the first of the flattened axes.
+  const int axis = bottom.CanonicalAxisIndex(
+      this->layer_param_.inner_product_param().axis());
+  const int channels = bottom.shape(axis);
+  if (int8_weights_version_ != this->blobs_[0]->data()->version()) {
+    int8_weights_.Quantize(this->layer_param_.quantization_param(), channels,
+        N_, K_, this->blobs_[0]->cpu_data(), transpose_);
+    int8_weights_version_ = this->blobs_[0]->data()->version();
+  }
+  int8_input_.resize(M_ * K_);
+  int8_sums_.resize(M_ * N_);
+  int8_weights_.QuantizeInput(M_ * K_, K_ / channels, bottom.cpu_data(),
+      &int8_input_[0]);
+  caffe_cpu_gemm_s8(CblasTrans, M_, N_, K_, &int8_input_[0],
+      int8_weights_.data(), &int8_sums_[0]);
+  int8_weights_.DequantizeRows(M_, &int8_sums_[0],
+      bias_term_ ? this->blobs_[1]->cpu_data() : NULL, top_data);
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down,
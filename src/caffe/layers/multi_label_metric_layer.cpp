@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/layers/multi_label_metric_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void MultiLabelMetricLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const MultiLabelMetricParameter& param =
+      this->layer_param_.multi_label_metric_param();
+  CHECK_GT(param.num_bins(), 0);
+  CHECK_GE(param.threshold(), 0);
+  CHECK_LE(param.threshold(), 1);
+  num_bins_ = param.num_bins();
+  num_classes_ = bottom[0]->count(1);
+  ResetStatistics();
+}
+
+template <typename Dtype>
+void MultiLabelMetricLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  CHECK_EQ(bottom[0]->count(), bottom[1]->count())
+      << "The scores and the labels must have the same count.";
+  CHECK_EQ(bottom[0]->count(1), num_classes_)
+      << "The number of classes can't change between passes.";
+  vector<int> scalar_shape(0);
+  for (int i = 0; i < top.size() && i < 3; ++i) {
+    top[i]->Reshape(scalar_shape);
+  }
+  if (top.size() > 3) {
+    top[3]->Reshape(vector<int>(1, num_classes_));
+  }
+}
+
+template <typename Dtype>
+void MultiLabelMetricLayer<Dtype>::ResetStatistics() {
+  positives_.assign(num_classes_ * num_bins_, 0);
+  negatives_.assign(num_classes_ * num_bins_, 0);
+  true_positives_.assign(num_classes_, 0);
+  false_positives_.assign(num_classes_, 0);
+  false_negatives_.assign(num_classes_, 0);
+  passes_ = 0;
+  last_metrics_.assign(3 + num_classes_, 0);
+}
+
+template <typename Dtype>
+vector<Dtype> MultiLabelMetricLayer<Dtype>::Metrics() const {
+  const vector<double> metrics = ComputeMetrics();
+  return vector<Dtype>(metrics.begin(), metrics.end());
+}
+
+template <typename Dtype>
+vector<double> MultiLabelMetricLayer<Dtype>::ComputeMetrics() const {
+  vector<double> metrics(3 + num_classes_, 0);
+  double ap_sum = 0;
+  int ap_classes = 0;
+  double f1_sum = 0;
+  int f1_classes = 0;
+  int64_t tp = 0, fp = 0, fn = 0;
+  for (int c = 0; c < num_classes_; ++c) {
+    // Lower the threshold bin by bin; a bin's samples tie.
+    const int64_t* pos = &positives_[c * num_bins_];
+    const int64_t* neg = &negatives_[c * num_bins_];
+    int64_t retrieved = 0, relevant = 0;
+    double ap = 0;
+    for (int b = num_bins_ - 1; b >= 0; --b) {
+      relevant += pos[b];
+      retrieved += pos[b] + neg[b];
+      if (pos[b] > 0) {
+        ap += pos[b] * static_cast<double>(relevant) / retrieved;
+      }
+    }
+    if (relevant > 0) {
+      metrics[3 + c] = ap / relevant;
+      ap_sum += ap / relevant;
+      ++ap_classes;
+    }
+    const int64_t f1_denominator =
+        2 * true_positives_[c] + false_positives_[c] + false_negatives_[c];
+    if (f1_denominator > 0) {
+      f1_sum += 2. * true_positives_[c] / f1_denominator;
+      ++f1_classes;
+    }
+    tp += true_positives_[c];
+    fp += false_positives_[c];
+    fn += false_negatives_[c];
+  }
+  metrics[0] = ap_classes ? ap_sum / ap_classes : 0;
+  metrics[1] = tp + fp + fn ? 2. * tp / (2 * tp + fp + fn) : 0;
+  metrics[2] = f1_classes ? f1_sum / f1_classes : 0;
+  return metrics;
+}
+
+template <typename Dtype>
+void MultiLabelMetricLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const MultiLabelMetricParameter& param =
+      this->layer_param_.multi_label_metric_param();
+  const Dtype* score = bottom[0]->cpu_data();
+  const Dtype* label = bottom[1]->cpu_data();
+  const int num = bottom[0]->shape(0);
+  for (int i = 0; i < num; ++i) {
+    for (int c = 0; c < num_classes_; ++c) {
+      const int index = i * num_classes_ + c;
+      Dtype p = score[index];
+      if (param.apply_sigmoid()) {
+        p = 1. / (1. + exp(-p));
+      }
+      const int bin = std::min(num_bins_ - 1,
+          std::max(0, static_cast<int>(p * num_bins_)));
+      const bool positive = label[index] > 0.5;
+      const bool predicted = p >= param.threshold();
+      if (positive) {
+        ++positives_[c * num_bins_ + bin];
+        ++(predicted ? true_positives_[c] : false_negatives_[c]);
+      } else {
+        ++negatives_[c * num_bins_ + bin];
+        false_positives_[c] += predicted;
+      }
+    }
+  }
+  // Telescope the outputs so that their mean is the current metric. The
+  // difference of two large multiples is taken in double, or a float would
+  // lose the digits of the metric after a few hundred passes.
+  ++passes_;
+  const vector<double> metrics = ComputeMetrics();
+  vector<Dtype> outputs(metrics.size());
+  for (int i = 0; i < metrics.size(); ++i) {
+    outputs[i] = passes_ * metrics[i] - (passes_ - 1.) * last_metrics_[i];
+  }
+  last_metrics_ = metrics;
+  for (int i = 0; i < top.size() && i < 3; ++i) {
+    top[i]->mutable_cpu_data()[0] = outputs[i];
+  }
+  if (top.size() > 3) {
+    std::copy(outputs.begin() + 3, outputs.end(), top[3]->mutable_cpu_data());
+  }
+}
+
+INSTANTIATE_CLASS(MultiLabelMetricLayer);
+REGISTER_LAYER_CLASS(MultiLabelMetric);
+
+}  // namespace caffe
@@ -1,6 +1,8 @@
 #ifdef USE_OPENCV
+#include <boost/bind.hpp>
 #include <opencv2/core/core.hpp>
 
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
@@ -11,6 +13,7 @@
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/layers/multi_label_video_data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/clip_cache.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
@@ -25,51 +28,73 @@ MultiLabelVideoDataLayer<Dtype>::~MultiLabelVideoDataLayer<Dtype>() {
 template <typename Dtype>
 void MultiLabelVideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 		bottom, const vector<Blob<Dtype>*>& top) {
-	const int new_length = this->layer_param_.multi_label_video_data_param().new_length();
 	const int new_height = this->layer_param_.multi_label_video_data_param().new_height();
 	const int new_width  = this->layer_param_.multi_label_video_data_param().new_width();
-	const bool is_color  = this->layer_param_.multi_label_video_data_param().is_color();
-	string root_folder = this->layer_param_.multi_label_video_data_param().root_folder();
 
 	CHECK((new_height == 0 && new_width == 0) ||
 			(new_height > 0 && new_width > 0)) << "Current implementation requires "
 					"new_height and new_width to be set at the same time.";
-	// Read the file with filenames and labels
-	const string& source = this->layer_param_.multi_label_video_data_param().source();
-	LOG(INFO) << "Opening file " << source;
+	const string& clip_cache =
+			this->layer_param_.multi_label_video_data_param().clip_cache();
+	int count = 0;
+	if (!clip_cache.empty()) {
+		// Clips and labels come pre-decoded from the cache; each line refers to
+		// a clip by its index in the cache.
+		clip_cache_.reset(new ClipCache(clip_cache));
+		for (int i = 0; i < clip_cache_->size(); ++i) {
+			triplet video_and_label;
+			video_and_label.first = clip_cache;
+			video_and_label.second = i;
+			const int32_t* labels = clip_cache_->labels(i);
+			video_and_label.third.assign(labels,
+					labels + clip_cache_->entry(i).num_labels);
+			lines_.push_back(video_and_label);
+			count++;
+		}
+	} else {
+		// Read the file with filenames and labels
+		const string& source = this->layer_param_.multi_label_video_data_param().source();
+		LOG(INFO) << "Opening file " << source;
 
-	std::ifstream infile(source.c_str());
-	string filename;
-	int frame_num;
-    int count = 0;
-    string multilabel;
+		std::ifstream infile(source.c_str());
+		string filename;
+		int frame_num;
+		string multilabel;
 
 
-	LOG(INFO) << " here we go " << std::endl;
-	while (infile >> filename >> frame_num >> multilabel) {
-		triplet video_and_label;
-		video_and_label.first = filename;
-		video_and_label.second = frame_num;
-		//file_list_.push_back(filename);
-		//start_frm_list_.push_back(start_frm);
-		std::istringstream iss(multilabel);
-		std::string l;
-		vector<int> ls;
-		//LOG(INFO) << "reading label for lines_id_read " << count <<" ";
-		while (!iss.eof()) {
-			std::getline(iss,l,',');
-			//LOG(INFO) <<  l.c_str() << "," ;
-			ls.push_back(atoi(l.c_str()));
-		}
-		video_and_label.third = ls;
+		LOG(INFO) << " here we go " << std::endl;
+		while (infile >> filename >> frame_num >> multilabel) {
+			triplet video_and_label;
+			video_and_label.first = filename;
+			video_and_label.second = frame_num;
+			//file_list_.push_back(filename);
+			//start_frm_list_.push_back(start_frm);
+			std::istringstream iss(multilabel);
+			std::string l;
+			vector<int> ls;
+			//LOG(INFO) << "reading label for lines_id_read " << count <<" ";
+			while (!iss.eof()) {
+				std::getline(iss,l,',');
+				//LOG(INFO) <<  l.c_str() << "," ;
+				ls.push_back(atoi(l.c_str()));
+			}
+			video_and_label.third = ls;
 
-		lines_.push_back(video_and_label);
-		//LOG(INFO)  << std::endl;
-		//if (count == 50){
-		//    return;
-		//}
-		//shuffle_index_.push_back(count);
-		count++;
+			lines_.push_back(video_and_label);
+			//LOG(INFO)  << std::endl;
+			//if (count == 50){
+			//    return;
+			//}
+			//shuffle_index_.push_back(count);
+			count++;
+		}
+		if (this->layer_param_.multi_label_video_data_param().sequential_decode()) {
+			if (this->layer_param_.multi_label_video_data_param().shuffle()) {
+				LOG(WARNING) << "sequential_decode does not pay off on shuffled lists.";
+			} else {
+				GroupVideos();
+			}
+		}
 	}
 
 	if (this->layer_param_.multi_label_video_data_param().shuffle()) {
@@ -82,6 +107,8 @@ void MultiLabelVideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 	LOG(INFO) << "A total of " << lines_.size() << " video chunks.";
 
 	lines_id_ = 0;
+	clip_rng_seed_ = caffe_rng_rand();
+	clip_id_ = 0;
 	// Check if we would need to randomly skip a few data points
 	if (this->layer_param_.multi_label_video_data_param().rand_skip()) {
 		unsigned int skip = caffe_rng_rand() %
@@ -91,31 +118,14 @@ void MultiLabelVideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 		lines_id_ = skip;
 	}
 	// Read a video clip, and use it to initialize the top blob.
-	std::vector<cv::Mat> cv_imgs;
-	bool read_video_result = ReadVideoToCVMat(root_folder +
-			lines_[lines_id_].first,
-			lines_[lines_id_].second,
-			new_length, new_height, new_width,
-			is_color,
-			&cv_imgs);
-	CHECK(read_video_result) << "Could not load " << lines_[lines_id_].first <<
-			" at frame " << lines_[lines_id_].second << ".";
-	CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " <<
-			lines_[lines_id_].first <<
-			" at frame " <<
-			lines_[lines_id_].second <<
-			" correctly.";
-	// Use data_transformer to infer the expected blob shape from a cv_image.
-	const bool is_video = true;
-	vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_imgs,
-			is_video);
+	vector<int> top_shape = InferClipShape(lines_[lines_id_]);
 	this->transformed_data_.Reshape(top_shape);
 	// Reshape prefetch_data and top[0] according to the batch_size.
 	const int batch_size = this->layer_param_.multi_label_video_data_param().batch_size();
 	CHECK_GT(batch_size, 0) << "Positive batch size required";
 	top_shape[0] = batch_size;
-	for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-		this->prefetch_[i].data_.Reshape(top_shape);
+	for (int i = 0; i < this->prefetch_.size(); ++i) {
+		this->prefetch_[i]->data_.Reshape(top_shape);
 	}
 	top[0]->Reshape(top_shape);
 
@@ -137,11 +147,96 @@ void MultiLabelVideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 
 	//vector<int> label_shape(1, batch_size);
 	top[1]->Reshape(label_shape);
-	for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-		this->prefetch_[i].label_.Reshape(label_shape);
+	for (int i = 0; i < this->prefetch_.size(); ++i) {
+		this->prefetch_[i]->label_.Reshape(label_shape);
+	}
+
+	const int num_workers = std::max(1, std::min(batch_size, static_cast<int>(
+			this->layer_param_.multi_label_video_data_param().num_workers())));
+	LOG(INFO) << "Decoding with " << num_workers << " worker(s).";
+	decode_pool_.reset(new ThreadPool(num_workers));
+	worker_transformers_.resize(num_workers);
+	worker_transformed_data_.resize(num_workers);
+	worker_read_time_.resize(num_workers);
+	worker_trans_time_.resize(num_workers);
+	for (int i = 0; i < num_workers; ++i) {
+		worker_transformers_[i].reset(
+				new DataTransformer<Dtype>(this->transform_param_, this->phase_));
+		worker_transformed_data_[i].reset(new Blob<Dtype>());
+	}
+	if (this->layer_param_.multi_label_video_data_param().sequential_decode() &&
+			!clip_cache_) {
+		const MultiLabelVideoDataParameter& multi_label_video_data_param =
+				this->layer_param_.multi_label_video_data_param();
+		worker_readers_.resize(num_workers);
+		for (int i = 0; i < num_workers; ++i) {
+			worker_readers_[i].reset(new VideoFrameReader(
+					multi_label_video_data_param.new_height(),
+					multi_label_video_data_param.new_width(),
+					multi_label_video_data_param.is_color(), true));
+		}
 	}
 
+}
+
+template <typename Dtype>
+vector<int> MultiLabelVideoDataLayer<Dtype>::InferClipShape(
+		const triplet& line) {
+	if (clip_cache_) {
+		const ClipCacheEntry& entry = clip_cache_->entry(line.second);
+		const int crop_size = this->layer_param_.transform_param().crop_size();
+		vector<int> shape(5);
+		shape[0] = 1;
+		shape[1] = entry.channels;
+		shape[2] = entry.length;
+		shape[3] = crop_size ? crop_size : entry.height;
+		shape[4] = crop_size ? crop_size : entry.width;
+		return shape;
+	}
+	const MultiLabelVideoDataParameter& multi_label_video_data_param =
+			this->layer_param_.multi_label_video_data_param();
+	const int new_length = multi_label_video_data_param.new_length();
+	std::vector<cv::Mat> cv_imgs;
+	bool read_video_result = ReadVideoToCVMat(
+			multi_label_video_data_param.root_folder() + line.first,
+			line.second, new_length,
+			multi_label_video_data_param.new_height(),
+			multi_label_video_data_param.new_width(),
+			multi_label_video_data_param.is_color(), &cv_imgs);
+	CHECK(read_video_result) << "Could not load " << line.first <<
+			" at frame " << line.second << ".";
+	CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " <<
+			line.first << " at frame " << line.second << " correctly.";
+	// Use data_transformer to infer the expected blob shape from a cv_imgs.
+	const bool is_video = true;
+	return this->data_transformer_->InferBlobShape(cv_imgs, is_video);
+}
 
+template <typename Dtype>
+void MultiLabelVideoDataLayer<Dtype>::GroupVideos() {
+	vector<string> files(lines_.size());
+	vector<int> start_frames(lines_.size());
+	for (int i = 0; i < lines_.size(); ++i) {
+		files[i] = lines_[i].first;
+		start_frames[i] = lines_[i].second;
+	}
+	const vector<int> order = GroupClipsByFile(files, start_frames);
+	vector<triplet> grouped(lines_.size());
+	int moved = 0;
+	for (int i = 0; i < order.size(); ++i) {
+		grouped[i] = lines_[order[i]];
+		moved += (order[i] != i);
+	}
+	// Test outputs are paired with the list lines by position.
+	CHECK(!moved || this->phase_ != caffe::TEST) << "sequential_decode would "
+			<< "reorder " << moved << " clips of "
+			<< this->layer_param_.multi_label_video_data_param().source()
+			<< "; sort the list by video and start frame.";
+	lines_.swap(grouped);
+	if (moved) {
+		LOG(INFO) << "Grouped the clips by video, " << moved << " of "
+				<< lines_.size() << " changed position.";
+	}
 }
 
 template <typename Dtype>
@@ -158,80 +253,30 @@ void MultiLabelVideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 	batch_timer.Start();
 	double read_time = 0;
 	double trans_time = 0;
-	CPUTimer timer;
 	CHECK(batch->data_.count());
 	CHECK(this->transformed_data_.count());
 	MultiLabelVideoDataParameter multi_label_video_data_param = this->layer_param_.multi_label_video_data_param();
 	const int batch_size = multi_label_video_data_param.batch_size();
-	const int new_length = multi_label_video_data_param.new_length();
-	const int new_height = multi_label_video_data_param.new_height();
-	const int new_width = multi_label_video_data_param.new_width();
-	const bool is_color = multi_label_video_data_param.is_color();
-	string root_folder = multi_label_video_data_param.root_folder();
 
 	// Reshape according to the first image of each batch
 	// on single input batches allows for inputs of varying dimension.
-	std::vector<cv::Mat> cv_imgs;
-	bool read_video_result = ReadVideoToCVMat(root_folder +
-			lines_[lines_id_].first,
-			lines_[lines_id_].second,
-			new_length, new_height, new_width,
-			is_color,
-			&cv_imgs);
-	CHECK(read_video_result) << "Could not load " << lines_[lines_id_].first <<
-			" at frame " << lines_[lines_id_].second << ".";
-	CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " <<
-			lines_[lines_id_].first <<
-			" at frame " <<
-			lines_[lines_id_].second <<
-			" correctly.";
-	// Use data_transformer to infer the expected blob shape from a cv_imgs.
-	bool is_video = true;
-	vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_imgs,
-			is_video);
+	vector<int> top_shape = InferClipShape(lines_[lines_id_]);
 	this->transformed_data_.Reshape(top_shape);
 	// Reshape batch according to the batch_size.
 	top_shape[0] = batch_size;
 	batch->data_.Reshape(top_shape);
 
-	Dtype* prefetch_data = batch->data_.mutable_cpu_data();
+	Dtype* prefetch_data = batch->data_.mutable_cpu_data_for_overwrite();
 	Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
-	// datum scales
+	// Pick the clips of this batch and their transformer seeds in order.
 	const int lines_size = lines_.size();
+	batch_lines_.resize(batch_size);
+	batch_seeds_.resize(batch_size);
 	for (int item_id = 0; item_id < batch_size; ++item_id) {
-		// get a blob
-		timer.Start();
 		CHECK_GT(lines_size, lines_id_);
-		std::vector<cv::Mat> cv_imgs;
-		bool read_video_result = ReadVideoToCVMat(root_folder +
-				lines_[lines_id_].first,
-				lines_[lines_id_].second,
-				new_length, new_height,
-				new_width, is_color, &cv_imgs);
-		CHECK(read_video_result) << "Could not load " << lines_[lines_id_].first <<
-				" at frame " << lines_[lines_id_].second << ".";
-		CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " <<
-				lines_[lines_id_].first <<
-				" at frame " <<
-				lines_[lines_id_].second <<
-				" correctly.";
-		read_time += timer.MicroSeconds();
-		timer.Start();
-		// Apply transformations (mirror, crop...) to the image
-		int offset = batch->data_.offset(item_id);
-		this->transformed_data_.set_cpu_data(prefetch_data + offset);
-		const bool is_video = true;
-		this->data_transformer_->Transform(cv_imgs, &(this->transformed_data_),
-				is_video);
-		trans_time += timer.MicroSeconds();
-
-		//prefetch_label[item_id] = lines_[lines_id_].third;
-
-		for (int i=0; i< lines_[lines_id_].third.size(); ++i){
-			prefetch_label[item_id *  lines_[lines_id_].third.size() + i] = lines_[lines_id_].third[i];
-			//LOG(INFO) << "fetching label for lines_id_ " << lines_id_ << " labeli " << i << " = "<< lines_[lines_id_].third[i] << std::endl;
-		}
+		batch_lines_[item_id] = lines_[lines_id_];
+		batch_seeds_[item_id] = CounterRng(clip_rng_seed_, clip_id_++)();
 
 		// go to the next iter
 		lines_id_++;
@@ -244,12 +289,97 @@ void MultiLabelVideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 			}
 		}
 	}
+	decode_pool_->Run(decode_pool_->num_threads(),
+			boost::bind(&MultiLabelVideoDataLayer<Dtype>::load_batch_items, this,
+					batch, prefetch_data, prefetch_label, _1));
+	for (int i = 0; i < worker_read_time_.size(); ++i) {
+		read_time += worker_read_time_[i];
+		trans_time += worker_trans_time_[i];
+	}
 	batch_timer.Stop();
 	DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
 	DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
 	DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// This function is called on the decode workers
+template <typename Dtype>
+void MultiLabelVideoDataLayer<Dtype>::load_batch_items(Batch<Dtype>* batch,
+		Dtype* prefetch_data, Dtype* prefetch_label, int worker) {
+	CPUTimer timer;
+	const MultiLabelVideoDataParameter& multi_label_video_data_param =
+			this->layer_param_.multi_label_video_data_param();
+	const int batch_size = multi_label_video_data_param.batch_size();
+	const int new_length = multi_label_video_data_param.new_length();
+	const int new_height = multi_label_video_data_param.new_height();
+	const int new_width = multi_label_video_data_param.new_width();
+	const bool is_color = multi_label_video_data_param.is_color();
+	const string& root_folder = multi_label_video_data_param.root_folder();
+	const int num_workers = decode_pool_->num_threads();
+	DataTransformer<Dtype>* transformer = worker_transformers_[worker].get();
+	Blob<Dtype>* transformed_data = worker_transformed_data_[worker].get();
+	transformed_data->Reshape(this->transformed_data_.shape());
+	worker_read_time_[worker] = 0;
+	worker_trans_time_[worker] = 0;
+
+	// With sequential_decode every worker takes a contiguous run of the batch,
+	// so that it sees consecutive clips of the same video.
+	int item_begin = worker;
+	int item_end = batch_size;
+	int item_step = num_workers;
+	if (!worker_readers_.empty()) {
+		item_begin = worker * batch_size / num_workers;
+		item_end = (worker + 1) * batch_size / num_workers;
+		item_step = 1;
+	}
+	for (int item_id = item_begin; item_id < item_end; item_id += item_step) {
+		const triplet& line = batch_lines_[item_id];
+		if (clip_cache_) {
+			// Transform straight out of the mapped cache.
+			timer.Start();
+			const ClipCacheEntry& entry = clip_cache_->entry(line.second);
+			transformer->SetRandFromSeed(batch_seeds_[item_id]);
+			transformed_data->set_cpu_data(prefetch_data + batch->data_.offset(item_id));
+			transformer->TransformVolume(clip_cache_->data(line.second),
+					entry.channels, entry.length, entry.height, entry.width,
+					transformed_data);
+			worker_trans_time_[worker] += timer.MicroSeconds();
+			for (int i = 0; i < line.third.size(); ++i) {
+				prefetch_label[item_id * line.third.size() + i] = line.third[i];
+			}
+			continue;
+		}
+		// get a blob
+		timer.Start();
+		std::vector<cv::Mat> cv_imgs;
+		bool read_video_result;
+		if (worker_readers_.empty()) {
+			read_video_result = ReadVideoToCVMat(root_folder + line.first,
+					line.second, new_length, new_height,
+					new_width, is_color, &cv_imgs);
+		} else {
+			read_video_result = ReadVideoToCVMat(worker_readers_[worker].get(),
+					root_folder + line.first, line.second, new_length, &cv_imgs);
+		}
+		CHECK(read_video_result) << "Could not load " << line.first <<
+				" at frame " << line.second << ".";
+		CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " <<
+				line.first << " at frame " << line.second << " correctly.";
+		worker_read_time_[worker] += timer.MicroSeconds();
+		timer.Start();
+		// Apply transformations (mirror, crop...) to the image
+		transformer->SetRandFromSeed(batch_seeds_[item_id]);
+		transformed_data->set_cpu_data(prefetch_data + batch->data_.offset(item_id));
+		const bool is_video = true;
+		transformer->Transform(cv_imgs, transformed_data, is_video);
+		worker_trans_time_[worker] += timer.MicroSeconds();
+
+		for (int i = 0; i < line.third.size(); ++i) {
+			prefetch_label[item_id * line.third.size() + i] = line.third[i];
+		}
+	}
+}
+
 INSTANTIATE_CLASS(MultiLabelVideoDataLayer);
 REGISTER_LAYER_CLASS(MultiLabelVideoData);
 
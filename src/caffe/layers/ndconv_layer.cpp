@@ -0,0 +1,43 @@
+#include <vector>
+
+#include "caffe/layers/ndconv_layer.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NdConvolutionLayer<Dtype>::NdConvolutionLayer(const LayerParameter& param)
+    : ConvolutionLayer<Dtype>(param) {
+  ConvolutionParameter* conv_param =
+      this->layer_param_.mutable_convolution_param();
+  if (conv_param->has_kernel_shape()) {
+    CHECK_EQ(0, conv_param->kernel_size_size())
+        << "Either kernel_shape or kernel_size should be specified; not both.";
+    for (int i = 0; i < conv_param->kernel_shape().dim_size(); ++i) {
+      conv_param->add_kernel_size(conv_param->kernel_shape().dim(i));
+    }
+  }
+  if (conv_param->has_pad_shape()) {
+    CHECK_EQ(conv_param->kernel_shape().dim_size(),
+             conv_param->pad_shape().dim_size())
+        << "Kernel and Pad shape don't match !";
+    CHECK_EQ(0, conv_param->pad_size())
+        << "Either pad_shape or pad should be specified; not both.";
+    for (int i = 0; i < conv_param->pad_shape().dim_size(); ++i) {
+      conv_param->add_pad(conv_param->pad_shape().dim(i));
+    }
+  }
+  if (conv_param->has_stride_shape()) {
+    CHECK_EQ(conv_param->kernel_shape().dim_size(),
+             conv_param->stride_shape().dim_size())
+        << "Kernel and Stride shape don't match !";
+    CHECK_EQ(0, conv_param->stride_size())
+        << "Either stride_shape or stride should be specified; not both.";
+    for (int i = 0; i < conv_param->stride_shape().dim_size(); ++i) {
+      conv_param->add_stride(conv_param->stride_shape().dim(i));
+    }
+  }
+}
+
+INSTANTIATE_CLASS(NdConvolutionLayer);
+
+}  // namespace caffe
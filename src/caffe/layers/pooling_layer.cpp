@@ -1,75 +1,161 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <cfloat>
 #include <vector>
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 using std::min;
 using std::max;
 
+// Number of pooling regions along an axis of the given size.
+inline int pooled_size(const int size, const int kernel, const int pad,
+    const int stride, const bool padded) {
+  int pooled = static_cast<int>(ceil(static_cast<float>(
+      size + 2 * pad - kernel) / stride)) + 1;
+  if (padded) {
+    // If we have padding, ensure that the last pooling starts strictly
+    // inside the image (instead of at the padding); otherwise clip the last.
+    if ((pooled - 1) * stride >= size + pad) {
+      --pooled;
+    }
+    CHECK_LT((pooled - 1) * stride, size + pad);
+  }
+  return pooled;
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   PoolingParameter pool_param = this->layer_param_.pooling_param();
-  if (pool_param.global_pooling()) {
-    CHECK(!(pool_param.has_kernel_size() ||
-      pool_param.has_kernel_h() || pool_param.has_kernel_w()))
-      << "With Global_pooling: true Filter size cannot specified";
-  } else {
-    CHECK(!pool_param.has_kernel_size() !=
-      !(pool_param.has_kernel_h() && pool_param.has_kernel_w()))
-      << "Filter size is kernel_size OR kernel_h and kernel_w; not both";
-    CHECK(pool_param.has_kernel_size() ||
-      (pool_param.has_kernel_h() && pool_param.has_kernel_w()))
-      << "For non-square filters both kernel_h and kernel_w are required.";
-  }
-  CHECK((!pool_param.has_pad() && pool_param.has_pad_h()
-      && pool_param.has_pad_w())
-      || (!pool_param.has_pad_h() && !pool_param.has_pad_w()))
-      << "pad is pad OR pad_h and pad_w are required.";
-  CHECK((!pool_param.has_stride() && pool_param.has_stride_h()
-      && pool_param.has_stride_w())
-      || (!pool_param.has_stride_h() && !pool_param.has_stride_w()))
-      << "Stride is stride OR stride_h and stride_w are required.";
   global_pooling_ = pool_param.global_pooling();
-  if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+  global_pooling_length_ = false;
+  kernel_l_ = stride_l_ = 1;
+  pad_l_ = 0;
+  if (pool_param.has_kernel_shape() || pool_param.has_pad_shape() ||
+      pool_param.has_stride_shape()) {
+    // N-d parameters: one entry per spatial axis, (length,) height, width.
+    CHECK(!(pool_param.has_kernel_size() || pool_param.has_kernel_h() ||
+      pool_param.has_kernel_w() || pool_param.has_pad() ||
+      pool_param.has_pad_h() || pool_param.has_pad_w() ||
+      pool_param.has_stride() || pool_param.has_stride_h() ||
+      pool_param.has_stride_w()))
+      << "kernel_shape, pad_shape and stride_shape can't be combined with "
+      << "kernel_size, pad or stride";
+    // A 4-axis input may be given a 3-D kernel with an implicit length of 1.
+    int num_spatial_axes = bottom[0]->num_axes() - 2;
+    if (pool_param.has_kernel_shape()) {
+      num_spatial_axes = pool_param.kernel_shape().dim_size();
+    }
+    CHECK(num_spatial_axes == 2 || num_spatial_axes == 3)
+      << "Only 2-D and 3-D pooling are implemented.";
+    CHECK_GE(num_spatial_axes, bottom[0]->num_axes() - 2)
+      << "kernel_shape must have one entry per spatial axis.";
+    vector<int> kernel(3, 1), pad(3, 0), stride(3, 1);
+    const int first = 3 - num_spatial_axes;
+    if (global_pooling_) {
+      CHECK(!pool_param.has_kernel_shape())
+        << "With Global_pooling: true Filter size cannot specified";
+    } else {
+      CHECK(pool_param.has_kernel_shape()) << "Kernel shape is required.";
+      for (int i = 0; i < num_spatial_axes; ++i) {
+        kernel[first + i] = pool_param.kernel_shape().dim(i);
+      }
+    }
+    if (pool_param.has_pad_shape()) {
+      CHECK_EQ(num_spatial_axes, pool_param.pad_shape().dim_size())
+        << "Kernel and Pad shape don't match !";
+      for (int i = 0; i < num_spatial_axes; ++i) {
+        pad[first + i] = pool_param.pad_shape().dim(i);
+      }
+    }
+    if (pool_param.has_stride_shape()) {
+      CHECK_EQ(num_spatial_axes, pool_param.stride_shape().dim_size())
+        << "Kernel and Stride shape don't match !";
+      for (int i = 0; i < num_spatial_axes; ++i) {
+        stride[first + i] = pool_param.stride_shape().dim(i);
+      }
+    }
+    kernel_l_ = kernel[0];
+    kernel_h_ = kernel[1];
+    kernel_w_ = kernel[2];
+    pad_l_ = pad[0];
+    pad_h_ = pad[1];
+    pad_w_ = pad[2];
+    stride_l_ = stride[0];
+    stride_h_ = stride[1];
+    stride_w_ = stride[2];
+    if (global_pooling_) {
+      kernel_h_ = bottom[0]->height();
+      kernel_w_ = bottom[0]->width();
+    }
   } else {
-    if (pool_param.has_kernel_size()) {
-      kernel_h_ = kernel_w_ = pool_param.kernel_size();
+    if (global_pooling_) {
+      CHECK(!(pool_param.has_kernel_size() ||
+        pool_param.has_kernel_h() || pool_param.has_kernel_w()))
+        << "With Global_pooling: true Filter size cannot specified";
+    } else {
+      CHECK(!pool_param.has_kernel_size() !=
+        !(pool_param.has_kernel_h() && pool_param.has_kernel_w()))
+        << "Filter size is kernel_size OR kernel_h and kernel_w; not both";
+      CHECK(pool_param.has_kernel_size() ||
+        (pool_param.has_kernel_h() && pool_param.has_kernel_w()))
+        << "For non-square filters both kernel_h and kernel_w are required.";
+    }
+    CHECK((!pool_param.has_pad() && pool_param.has_pad_h()
+        && pool_param.has_pad_w())
+        || (!pool_param.has_pad_h() && !pool_param.has_pad_w()))
+        << "pad is pad OR pad_h and pad_w are required.";
+    CHECK((!pool_param.has_stride() && pool_param.has_stride_h()
+        && pool_param.has_stride_w())
+        || (!pool_param.has_stride_h() && !pool_param.has_stride_w()))
+        << "Stride is stride OR stride_h and stride_w are required.";
+    if (global_pooling_) {
+      kernel_h_ = bottom[0]->height();
+      kernel_w_ = bottom[0]->width();
+    } else {
+      if (pool_param.has_kernel_size()) {
+        kernel_h_ = kernel_w_ = pool_param.kernel_size();
+      } else {
+        kernel_h_ = pool_param.kernel_h();
+        kernel_w_ = pool_param.kernel_w();
+      }
+    }
+    if (!pool_param.has_pad_h()) {
+      pad_h_ = pad_w_ = pool_param.pad();
     } else {
-      kernel_h_ = pool_param.kernel_h();
-      kernel_w_ = pool_param.kernel_w();
+      pad_h_ = pool_param.pad_h();
+      pad_w_ = pool_param.pad_w();
+    }
+    if (!pool_param.has_stride_h()) {
+      stride_h_ = stride_w_ = pool_param.stride();
+    } else {
+      stride_h_ = pool_param.stride_h();
+      stride_w_ = pool_param.stride_w();
     }
   }
+  CHECK_GT(kernel_l_, 0) << "Filter dimensions cannot be zero.";
   CHECK_GT(kernel_h_, 0) << "Filter dimensions cannot be zero.";
   CHECK_GT(kernel_w_, 0) << "Filter dimensions cannot be zero.";
-  if (!pool_param.has_pad_h()) {
-    pad_h_ = pad_w_ = pool_param.pad();
-  } else {
-    pad_h_ = pool_param.pad_h();
-    pad_w_ = pool_param.pad_w();
-  }
-  if (!pool_param.has_stride_h()) {
-    stride_h_ = stride_w_ = pool_param.stride();
-  } else {
-    stride_h_ = pool_param.stride_h();
-    stride_w_ = pool_param.stride_w();
-  }
+  CHECK_GT(stride_l_, 0) << "Stride dimensions cannot be zero.";
+  CHECK_GT(stride_h_, 0) << "Stride dimensions cannot be zero.";
+  CHECK_GT(stride_w_, 0) << "Stride dimensions cannot be zero.";
   if (global_pooling_) {
-    CHECK(pad_h_ == 0 && pad_w_ == 0 && stride_h_ == 1 && stride_w_ == 1)
+    CHECK(pad_l_ == 0 && pad_h_ == 0 && pad_w_ == 0 && stride_l_ == 1 &&
+      stride_h_ == 1 && stride_w_ == 1)
       << "With Global_pooling: true; only pad = 0 and stride = 1";
   }
-  if (pad_h_ != 0 || pad_w_ != 0) {
+  if (pad_l_ != 0 || pad_h_ != 0 || pad_w_ != 0) {
     CHECK(this->layer_param_.pooling_param().pool()
         == PoolingParameter_PoolMethod_AVE
         || this->layer_param_.pooling_param().pool()
         == PoolingParameter_PoolMethod_MAX)
         << "Padding implemented only for average and max pooling.";
+    CHECK_LT(pad_l_, kernel_l_);
     CHECK_LT(pad_h_, kernel_h_);
     CHECK_LT(pad_w_, kernel_w_);
   }
@@ -83,44 +169,200 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       << "must have 4 or 5 axes, corresponding to (num, channels, [optional "
       << "length,] height, width)";
   channels_ = bottom[0]->channels();
+  length_ = bottom[0]->length();
   height_ = bottom[0]->height();
   width_ = bottom[0]->width();
   if (global_pooling_) {
+    if (global_pooling_length_) {
+      kernel_l_ = length_;
+    }
     kernel_h_ = bottom[0]->height();
     kernel_w_ = bottom[0]->width();
   }
-  pooled_height_ = static_cast<int>(ceil(static_cast<float>(
-      height_ + 2 * pad_h_ - kernel_h_) / stride_h_)) + 1;
-  pooled_width_ = static_cast<int>(ceil(static_cast<float>(
-      width_ + 2 * pad_w_ - kernel_w_) / stride_w_)) + 1;
-  if (pad_h_ || pad_w_) {
-    // If we have padding, ensure that the last pooling starts strictly
-    // inside the image (instead of at the padding); otherwise clip the last.
-    if ((pooled_height_ - 1) * stride_h_ >= height_ + pad_h_) {
-      --pooled_height_;
-    }
-    if ((pooled_width_ - 1) * stride_w_ >= width_ + pad_w_) {
-      --pooled_width_;
-    }
-    CHECK_LT((pooled_height_ - 1) * stride_h_, height_ + pad_h_);
-    CHECK_LT((pooled_width_ - 1) * stride_w_, width_ + pad_w_);
+  // Padding on any axis clips the last region on every axis, as the 2-D
+  // layer always did.
+  const bool padded = pad_l_ || pad_h_ || pad_w_;
+  pooled_length_ = pooled_size(length_, kernel_l_, pad_l_, stride_l_, padded);
+  pooled_height_ = pooled_size(height_, kernel_h_, pad_h_, stride_h_, padded);
+  pooled_width_ = pooled_size(width_, kernel_w_, pad_w_, stride_w_, padded);
+  if (bottom[0]->num_axes() == 5) {
+    top[0]->Reshape(bottom[0]->num(), channels_, pooled_length_,
+        pooled_height_, pooled_width_);
+  } else {
+    CHECK_EQ(1, pooled_length_) << "Pooling over length needs a 5-axis input.";
+    top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
+        pooled_width_);
   }
-  top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
-      pooled_width_);
   if (top.size() > 1) {
     top[1]->ReshapeLike(*top[0]);
   }
   // If max pooling, we will initialize the vector index part.
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_MAX && top.size() == 1) {
-    max_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
-        pooled_width_);
+    max_idx_.Reshape(top[0]->shape());
   }
   // If stochastic pooling, we will initialize the random index part.
   if (this->layer_param_.pooling_param().pool() ==
       PoolingParameter_PoolMethod_STOCHASTIC) {
-    rand_idx_.Reshape(bottom[0]->num(), channels_, pooled_height_,
-      pooled_width_);
+    rand_idx_.Reshape(top[0]->shape());
+  }
+  if (kernel_l_ == 1 && stride_l_ == 1 && pad_l_ == 0) {
+    num_planes_ = bottom[0]->num() * channels_ * length_;
+    plane_length_ = pooled_plane_length_ = 1;
+  } else {
+    num_planes_ = bottom[0]->num() * channels_;
+    plane_length_ = length_;
+    pooled_plane_length_ = pooled_length_;
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::MaxPoolForwardPlane(const Dtype* bottom_data,
+    Dtype* top_data, int* mask, Dtype* top_mask, int plane) {
+  const int pooled_count =
+      pooled_plane_length_ * pooled_height_ * pooled_width_;
+  bottom_data += plane * plane_length_ * height_ * width_;
+  top_data += plane * pooled_count;
+  if (top_mask) {
+    top_mask += plane * pooled_count;
+  } else {
+    mask += plane * pooled_count;
+  }
+  int pool_index = 0;
+  for (int pl = 0; pl < pooled_plane_length_; ++pl) {
+    int lstart = pl * stride_l_ - pad_l_;
+    const int lend = min(lstart + kernel_l_, plane_length_);
+    lstart = max(lstart, 0);
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      int hstart = ph * stride_h_ - pad_h_;
+      const int hend = min(hstart + kernel_h_, height_);
+      hstart = max(hstart, 0);
+      for (int pw = 0; pw < pooled_width_; ++pw, ++pool_index) {
+        int wstart = pw * stride_w_ - pad_w_;
+        const int wend = min(wstart + kernel_w_, width_);
+        wstart = max(wstart, 0);
+        Dtype maxval = -FLT_MAX;
+        int maxidx = -1;
+        for (int l = lstart; l < lend; ++l) {
+          for (int h = hstart; h < hend; ++h) {
+            const int row = (l * height_ + h) * width_;
+            for (int w = wstart; w < wend; ++w) {
+              if (bottom_data[row + w] > maxval) {
+                maxval = bottom_data[row + w];
+                maxidx = row + w;
+              }
+            }
+          }
+        }
+        top_data[pool_index] = maxval;
+        if (top_mask) {
+          top_mask[pool_index] = static_cast<Dtype>(maxidx);
+        } else {
+          mask[pool_index] = maxidx;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::AvePoolForwardPlane(const Dtype* bottom_data,
+    Dtype* top_data, int plane) {
+  bottom_data += plane * plane_length_ * height_ * width_;
+  top_data += plane * pooled_plane_length_ * pooled_height_ * pooled_width_;
+  int pool_index = 0;
+  for (int pl = 0; pl < pooled_plane_length_; ++pl) {
+    int lstart = pl * stride_l_ - pad_l_;
+    int lend = min(lstart + kernel_l_, plane_length_ + pad_l_);
+    const int pool_length = lend - lstart;
+    lstart = max(lstart, 0);
+    lend = min(lend, plane_length_);
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      int hstart = ph * stride_h_ - pad_h_;
+      int hend = min(hstart + kernel_h_, height_ + pad_h_);
+      const int pool_height = hend - hstart;
+      hstart = max(hstart, 0);
+      hend = min(hend, height_);
+      for (int pw = 0; pw < pooled_width_; ++pw, ++pool_index) {
+        int wstart = pw * stride_w_ - pad_w_;
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        const int pool_size = pool_length * pool_height * (wend - wstart);
+        wstart = max(wstart, 0);
+        wend = min(wend, width_);
+        Dtype aveval = 0;
+        for (int l = lstart; l < lend; ++l) {
+          for (int h = hstart; h < hend; ++h) {
+            const int row = (l * height_ + h) * width_;
+            for (int w = wstart; w < wend; ++w) {
+              aveval += bottom_data[row + w];
+            }
+          }
+        }
+        top_data[pool_index] = aveval / pool_size;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::MaxPoolBackwardPlane(const Dtype* top_diff,
+    const int* mask, const Dtype* top_mask, Dtype* bottom_diff, int plane) {
+  const int count = plane_length_ * height_ * width_;
+  const int pooled_count =
+      pooled_plane_length_ * pooled_height_ * pooled_width_;
+  bottom_diff += plane * count;
+  top_diff += plane * pooled_count;
+  caffe_set(count, Dtype(0), bottom_diff);
+  if (top_mask) {
+    top_mask += plane * pooled_count;
+    for (int index = 0; index < pooled_count; ++index) {
+      bottom_diff[static_cast<int>(top_mask[index])] += top_diff[index];
+    }
+  } else {
+    mask += plane * pooled_count;
+    for (int index = 0; index < pooled_count; ++index) {
+      bottom_diff[mask[index]] += top_diff[index];
+    }
+  }
+}
+
+template <typename Dtype>
+void PoolingLayer<Dtype>::AvePoolBackwardPlane(const Dtype* top_diff,
+    Dtype* bottom_diff, int plane) {
+  const int count = plane_length_ * height_ * width_;
+  bottom_diff += plane * count;
+  top_diff += plane * pooled_plane_length_ * pooled_height_ * pooled_width_;
+  caffe_set(count, Dtype(0), bottom_diff);
+  int pool_index = 0;
+  for (int pl = 0; pl < pooled_plane_length_; ++pl) {
+    int lstart = pl * stride_l_ - pad_l_;
+    int lend = min(lstart + kernel_l_, plane_length_ + pad_l_);
+    const int pool_length = lend - lstart;
+    lstart = max(lstart, 0);
+    lend = min(lend, plane_length_);
+    for (int ph = 0; ph < pooled_height_; ++ph) {
+      int hstart = ph * stride_h_ - pad_h_;
+      int hend = min(hstart + kernel_h_, height_ + pad_h_);
+      const int pool_height = hend - hstart;
+      hstart = max(hstart, 0);
+      hend = min(hend, height_);
+      for (int pw = 0; pw < pooled_width_; ++pw, ++pool_index) {
+        int wstart = pw * stride_w_ - pad_w_;
+        int wend = min(wstart + kernel_w_, width_ + pad_w_);
+        const int pool_size = pool_length * pool_height * (wend - wstart);
+        wstart = max(wstart, 0);
+        wend = min(wend, width_);
+        const Dtype diff = top_diff[pool_index] / pool_size;
+        for (int l = lstart; l < lend; ++l) {
+          for (int h = hstart; h < hend; ++h) {
+            const int row = (l * height_ + h) * width_;
+            for (int w = wstart; w < wend; ++w) {
+              bottom_diff[row + w] += diff;
+            }
+          }
+        }
+      }
+    }
   }
 }
 
@@ -131,7 +373,6 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   int* mask = NULL;  // suppress warnings about uninitalized variables
@@ -140,85 +381,19 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
     if (use_top_mask) {
       top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
     } else {
       mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
     }
+    ThreadPool::Get().Run(num_planes_,
+        boost::bind(&PoolingLayer<Dtype>::MaxPoolForwardPlane, this,
+            bottom_data, top_data, mask, top_mask, _1));
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
+    ThreadPool::Get().Run(num_planes_,
+        boost::bind(&PoolingLayer<Dtype>::AvePoolForwardPlane, this,
+            bottom_data, top_data, _1));
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -236,69 +411,26 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  // Different pooling methods. We explicitly do the switch outside the for
-  // loop to save time, although this results in more codes.
-  caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
   const int* mask = NULL;  // suppress warnings about uninitialized variables
   const Dtype* top_mask = NULL;
+  // Each plane clears its own part of bottom_diff before accumulating.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
     if (use_top_mask) {
       top_mask = top[1]->cpu_data();
     } else {
       mask = max_idx_.cpu_data();
     }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
-          }
-        }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
-    }
+    ThreadPool::Get().Run(num_planes_,
+        boost::bind(&PoolingLayer<Dtype>::MaxPoolBackwardPlane, this,
+            top_diff, mask, top_mask, bottom_diff, _1));
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
-              }
-            }
-          }
-        }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-      }
-    }
+    ThreadPool::Get().Run(num_planes_,
+        boost::bind(&PoolingLayer<Dtype>::AvePoolBackwardPlane, this,
+            top_diff, bottom_diff, _1));
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -308,11 +440,21 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void NdPoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const PoolingParameter& pool_param = this->layer_param_.pooling_param();
+  CHECK(pool_param.global_pooling() || pool_param.has_kernel_shape())
+      << "Kernel shape is required.";
+  PoolingLayer<Dtype>::LayerSetUp(bottom, top);
+  this->global_pooling_length_ = this->global_pooling_;
+}
 
 #ifdef CPU_ONLY
 STUB_GPU(PoolingLayer);
 #endif
 
 INSTANTIATE_CLASS(PoolingLayer);
+INSTANTIATE_CLASS(NdPoolingLayer);
 
 }  // namespace caffe
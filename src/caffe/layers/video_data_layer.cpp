@@ -58,6 +58,8 @@ void VideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 	LOG(INFO) << "A total of " << lines_.size() << " video chunks.";
 
 	lines_id_ = 0;
+	clip_rng_seed_ = caffe_rng_rand();
+	clip_id_ = 0;
 	// Check if we would need to randomly skip a few data points
 	if (this->layer_param_.video_data_param().rand_skip()) {
 		unsigned int skip = caffe_rng_rand() %
@@ -90,8 +92,8 @@ void VideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 	const int batch_size = this->layer_param_.video_data_param().batch_size();
 	CHECK_GT(batch_size, 0) << "Positive batch size required";
 	top_shape[0] = batch_size;
-	for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-		this->prefetch_[i].data_.Reshape(top_shape);
+	for (int i = 0; i < this->prefetch_.size(); ++i) {
+		this->prefetch_[i]->data_.Reshape(top_shape);
 	}
 	top[0]->Reshape(top_shape);
 
@@ -101,8 +103,8 @@ void VideoDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>&
 	// label
 	vector<int> label_shape(1, batch_size);
 	top[1]->Reshape(label_shape);
-	for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
-		this->prefetch_[i].label_.Reshape(label_shape);
+	for (int i = 0; i < this->prefetch_.size(); ++i) {
+		this->prefetch_[i]->label_.Reshape(label_shape);
 	}
 }
 
@@ -156,7 +158,7 @@ void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 	top_shape[0] = batch_size;
 	batch->data_.Reshape(top_shape);
 
-	Dtype* prefetch_data = batch->data_.mutable_cpu_data();
+	Dtype* prefetch_data = batch->data_.mutable_cpu_data_for_overwrite();
 	Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
 	// datum scales
@@ -180,7 +182,10 @@ void VideoDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
 				" correctly.";
 		read_time += timer.MicroSeconds();
 		timer.Start();
-		// Apply transformations (mirror, crop...) to the image
+		// Apply transformations (mirror, crop...) to the image, drawn from the
+		// stream of the clip.
+		this->data_transformer_->SetRandFromSeed(
+				CounterRng(clip_rng_seed_, clip_id_++)());
 		int offset = batch->data_.offset(item_id);
 		this->transformed_data_.set_cpu_data(prefetch_data + offset);
 		const bool is_video = true;
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <set>
 #include <string>
@@ -10,6 +11,7 @@
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/net.hpp"
+#include "caffe/net_profiler.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/hdf5.hpp"
@@ -23,7 +25,7 @@ namespace caffe {
 
 template <typename Dtype>
 Net<Dtype>::Net(const NetParameter& param, const Net* root_net)
-    : root_net_(root_net) {
+    : profiler_(NULL), root_net_(root_net) {
   Init(param);
 }
 
@@ -31,7 +33,7 @@ template <typename Dtype>
 Net<Dtype>::Net(const string& param_file, Phase phase,
     const int level, const vector<string>* stages,
     const Net* root_net)
-    : root_net_(root_net) {
+    : profiler_(NULL), root_net_(root_net) {
   NetParameter param;
   ReadNetParamsFromTextFileOrDie(param_file, &param);
   // Set phase, stages and level
@@ -56,6 +58,20 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  if (filtered_param.fuse_layers() && phase_ == TEST) {
+    NetParameter fused_param;
+    FuseLayers(filtered_param, &fused_param);
+    filtered_param.Swap(&fused_param);
+  }
+  if (filtered_param.storage_precision() !=
+      LayerParameter_StoragePrecision_FLOAT && phase_ == TEST) {
+    for (int i = 0; i < filtered_param.layer_size(); ++i) {
+      LayerParameter* layer = filtered_param.mutable_layer(i);
+      if (!layer->has_storage_precision()) {
+        layer->set_storage_precision(filtered_param.storage_precision());
+      }
+    }
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -98,6 +114,9 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
       layers_.push_back(LayerRegistry<Dtype>::CreateLayer(layer_param));
     }
     layer_names_.push_back(layer_param.name());
+    for (int i = 0; i < layer_param.folded_layer_size(); ++i) {
+      folded_layer_owners_[layer_param.folded_layer(i).name()] = layer_id;
+    }
     LOG_IF(INFO, Caffe::root_solver())
         << "Creating Layer " << layer_param.name();
     bool need_backward = false;
@@ -316,6 +335,106 @@ void Net<Dtype>::FilterNet(const NetParameter& param,
   }
 }
 
+// Whether FuseLayers may fold into or fuse with a layer: a convolution that
+// computes with Caffe's own kernels and owns its weights.
+static bool IsFusableConvolution(const LayerParameter& layer_param) {
+  if (layer_param.bottom_size() != 1 || layer_param.top_size() != 1) {
+    return false;
+  }
+  for (int i = 0; i < layer_param.param_size(); ++i) {
+    if (layer_param.param(i).has_name()) {
+      return false;
+    }
+  }
+  if (layer_param.type() == "Convolution3D") {
+    return true;
+  }
+  if (layer_param.type() != "Convolution" &&
+      layer_param.type() != "NdConvolution") {
+    return false;
+  }
+  const ConvolutionParameter& conv_param = layer_param.convolution_param();
+  if (conv_param.axis() != 1) {
+    return false;
+  }
+#ifdef USE_CUDNN
+  return conv_param.engine() == ConvolutionParameter_Engine_CAFFE;
+#else
+  return conv_param.engine() != ConvolutionParameter_Engine_CUDNN;
+#endif
+}
+
+template <typename Dtype>
+void Net<Dtype>::FuseLayers(const NetParameter& param,
+    NetParameter* param_fused) {
+  map<string, int> num_readers;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    for (int j = 0; j < param.layer(i).bottom_size(); ++j) {
+      ++num_readers[param.layer(i).bottom(j)];
+    }
+  }
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer_param = param_fused->add_layer();
+    layer_param->CopyFrom(param.layer(i));
+    if (!IsFusableConvolution(*layer_param)) {
+      continue;
+    }
+    // Absorb the chain [BatchNorm] [Scale] [ReLU] reading the output.
+    string top = layer_param->top(0);
+    bool folded_batch_norm = false;
+    bool folded_scale = false;
+    bool fused_relu = false;
+    while (!fused_relu && i + 1 < param.layer_size()) {
+      const LayerParameter& next = param.layer(i + 1);
+      if (next.bottom_size() != 1 || next.top_size() != 1 ||
+          next.bottom(0) != top || next.loss_weight_size() > 0) {
+        break;
+      }
+      // Unless the next layer works in place, the output disappears, so
+      // nothing else may read it.
+      if (next.top(0) != top && num_readers[top] != 1) {
+        break;
+      }
+      if (next.type() == "BatchNorm" && !folded_batch_norm && !folded_scale &&
+          (!next.batch_norm_param().has_use_global_stats() ||
+           next.batch_norm_param().use_global_stats())) {
+        folded_batch_norm = true;
+      } else if (next.type() == "Scale" && !folded_scale &&
+          next.scale_param().axis() == 1 &&
+          next.scale_param().num_axes() == 1) {
+        folded_scale = true;
+      } else if (next.type() == "ReLU" &&
+          next.relu_param().negative_slope() == 0) {
+        fused_relu = true;
+      } else {
+        break;
+      }
+      if (!fused_relu) {
+        layer_param->add_folded_layer()->CopyFrom(next);
+      }
+      LOG_IF(INFO, Caffe::root_solver()) << "Fusing layer " << next.name()
+          << " into " << layer_param->name();
+      top = next.top(0);
+      ++i;
+    }
+    layer_param->set_top(0, top);
+    const bool add_bias = layer_param->folded_layer_size() > 0;
+    if (layer_param->type() == "Convolution3D") {
+      Convolution3DParameter* conv_param =
+          layer_param->mutable_convolution3d_param();
+      conv_param->set_bias_term(conv_param->bias_term() || add_bias);
+      conv_param->set_fused_relu(fused_relu);
+    } else {
+      ConvolutionParameter* conv_param =
+          layer_param->mutable_convolution_param();
+      conv_param->set_bias_term(conv_param->bias_term() || add_bias);
+      conv_param->set_fused_relu(fused_relu);
+    }
+  }
+}
+
 template <typename Dtype>
 bool Net<Dtype>::StateMeetsRule(const NetState& state,
     const NetStateRule& rule, const string& layer_name) {
@@ -550,7 +669,9 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
+    if (profiler_) { profiler_->StartLayer(i, false); }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
+    if (profiler_) { profiler_->StopLayer(); }
     loss += layer_loss;
     if (debug_info_) { ForwardDebugInfo(i); }
   }
@@ -595,8 +716,10 @@ void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_LT(start, layers_.size());
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
+      if (profiler_) { profiler_->StartLayer(i, true); }
       layers_[i]->Backward(
           top_vecs_[i], bottom_need_backward_[i], bottom_vecs_[i]);
+      if (profiler_) { profiler_->StopLayer(); }
       if (debug_info_) { BackwardDebugInfo(i); }
     }
   }
@@ -699,6 +822,10 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
+    CHECK_EQ(layers_[target_layer_id]->layer_param().folded_layer_size(),
+        source_layer->layer_param().folded_layer_size())
+        << "Cannot share the weights of layer " << source_layer_name
+        << " between nets with and without its layers fused.";
     CHECK_EQ(target_blobs.size(), source_layer->blobs().size())
         << "Incompatible number of blobs for layer " << source_layer_name;
     for (int j = 0; j < target_blobs.size(); ++j) {
@@ -749,9 +876,125 @@ void Net<Dtype>::Reshape() {
   }
 }
 
+template <typename Dtype>
+size_t Net<Dtype>::PlanInferenceMemory(const vector<string>& preserved_blobs) {
+  CHECK_EQ(phase_, TEST) << "Memory planning is for inference only.";
+  vector<bool> pinned(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    pinned[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    pinned[net_output_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < preserved_blobs.size(); ++i) {
+    CHECK(has_blob(preserved_blobs[i])) << "Unknown blob "
+        << preserved_blobs[i];
+    pinned[blob_names_index_[preserved_blobs[i]]] = true;
+  }
+  // The range of layers from the producer to the last consumer of each blob.
+  vector<int> first(blobs_.size(), layers_.size());
+  vector<int> last(blobs_.size(), -1);
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < bottom_id_vecs_[i].size(); ++j) {
+      last[bottom_id_vecs_[i][j]] = i;
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      const int blob_id = top_id_vecs_[i][j];
+      first[blob_id] = std::min(first[blob_id], i);
+      last[blob_id] = i;
+      if (bottom_id_vecs_[i].empty()) {
+        pinned[blob_id] = true;
+      }
+    }
+  }
+  // Blobs whose data is already shared (split, flatten, reshape...) form one
+  // buffer, live over the union of their ranges.
+  struct Buffer {
+    vector<int> blob_ids;
+    int first, last;
+    size_t size;
+    bool pinned;
+  };
+  vector<Buffer> buffers;
+  map<SyncedMemory*, int> buffer_index;
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    if (blobs_[blob_id]->count() == 0) {
+      continue;
+    }
+    SyncedMemory* memory = blobs_[blob_id]->data().get();
+    if (!buffer_index.count(memory)) {
+      buffer_index[memory] = buffers.size();
+      Buffer buffer;
+      buffer.first = first[blob_id];
+      buffer.last = last[blob_id];
+      buffer.size = 0;
+      buffer.pinned = false;
+      buffers.push_back(buffer);
+    }
+    Buffer& buffer = buffers[buffer_index[memory]];
+    buffer.blob_ids.push_back(blob_id);
+    buffer.first = std::min(buffer.first, first[blob_id]);
+    buffer.last = std::max(buffer.last, last[blob_id]);
+    buffer.size = std::max(buffer.size,
+        blobs_[blob_id]->count() * sizeof(Dtype));
+    buffer.pinned = buffer.pinned || pinned[blob_id];
+  }
+  // Greedy by size: the largest buffers are placed first (the earliest on
+  // ties), each in the first arena slot whose buffers all have disjoint
+  // ranges.
+  vector<pair<size_t, int> > order;
+  size_t bytes_before = 0;
+  for (int i = 0; i < buffers.size(); ++i) {
+    if (!buffers[i].pinned) {
+      order.push_back(std::make_pair(buffers[i].size, -i));
+      bytes_before += buffers[i].size;
+    }
+  }
+  std::sort(order.rbegin(), order.rend());
+  vector<vector<int> > slots;
+  vector<size_t> slot_sizes;
+  for (int k = 0; k < order.size(); ++k) {
+    const Buffer& buffer = buffers[-order[k].second];
+    int slot = 0;
+    for (; slot < slots.size(); ++slot) {
+      bool overlaps = false;
+      for (int j = 0; j < slots[slot].size() && !overlaps; ++j) {
+        const Buffer& other = buffers[slots[slot][j]];
+        overlaps = buffer.first <= other.last && other.first <= buffer.last;
+      }
+      if (!overlaps) {
+        break;
+      }
+    }
+    if (slot == slots.size()) {
+      slots.push_back(vector<int>());
+      slot_sizes.push_back(buffer.size);
+    }
+    slots[slot].push_back(-order[k].second);
+  }
+  size_t bytes_after = 0;
+  for (int slot = 0; slot < slots.size(); ++slot) {
+    shared_ptr<SyncedMemory> memory(new SyncedMemory(slot_sizes[slot]));
+    for (int j = 0; j < slots[slot].size(); ++j) {
+      const Buffer& buffer = buffers[slots[slot][j]];
+      for (int i = 0; i < buffer.blob_ids.size(); ++i) {
+        blobs_[buffer.blob_ids[i]]->set_data(memory);
+      }
+    }
+    bytes_after += slot_sizes[slot];
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Inference memory plan: " << order.size() << " activation buffers in "
+      << slots.size() << " shared buffers, " << bytes_before / 1048576.
+      << " MB -> " << bytes_after / 1048576. << " MB ("
+      << (bytes_before - bytes_after) / 1048576. << " MB saved)";
+  return bytes_before - bytes_after;
+}
+
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
   int num_source_layers = param.layer_size();
+  map<string, vector<shared_ptr<Blob<Dtype> > > > folded_blobs;
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
     const string& source_layer_name = source_layer.name();
@@ -761,15 +1004,31 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       ++target_layer_id;
     }
     if (target_layer_id == layer_names_.size()) {
+      if (folded_layer_owners_.count(source_layer_name)) {
+        vector<shared_ptr<Blob<Dtype> > >& blobs =
+            folded_blobs[source_layer_name];
+        for (int j = 0; j < source_layer.blobs_size(); ++j) {
+          blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+          blobs.back()->FromProto(source_layer.blobs(j));
+        }
+        continue;
+      }
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
     DLOG(INFO) << "Copying source layer " << source_layer_name;
     vector<shared_ptr<Blob<Dtype> > >& target_blobs =
         layers_[target_layer_id]->blobs();
-    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
-        << "Incompatible number of blobs for layer " << source_layer_name;
-    for (int j = 0; j < target_blobs.size(); ++j) {
+    if (source_layer.blobs_size() == 1 && target_blobs.size() == 2 &&
+        layers_[target_layer_id]->layer_param().folded_layer_size() > 0) {
+      // The bias was added to take the folded layers.
+      caffe_set(target_blobs[1]->count(), Dtype(0),
+          target_blobs[1]->mutable_cpu_data());
+    } else {
+      CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+          << "Incompatible number of blobs for layer " << source_layer_name;
+    }
+    for (int j = 0; j < source_layer.blobs_size(); ++j) {
       if (!target_blobs[j]->ShapeEquals(source_layer.blobs(j))) {
         Blob<Dtype> source_blob;
         const bool kReshape = true;
@@ -785,6 +1044,7 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  FoldTrainedLayers(folded_blobs);
 }
 
 template <typename Dtype>
@@ -807,15 +1067,35 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
   hid_t data_hid = H5Gopen2(file_hid, "data", H5P_DEFAULT);
   CHECK_GE(data_hid, 0) << "Error reading weights from " << trained_filename;
   int num_layers = hdf5_get_num_links(data_hid);
+  map<string, vector<shared_ptr<Blob<Dtype> > > > folded_blobs;
   for (int i = 0; i < num_layers; ++i) {
     string source_layer_name = hdf5_get_name_by_idx(data_hid, i);
     if (!layer_names_index_.count(source_layer_name)) {
+      if (folded_layer_owners_.count(source_layer_name)) {
+        hid_t layer_hid = H5Gopen2(data_hid, source_layer_name.c_str(),
+            H5P_DEFAULT);
+        CHECK_GE(layer_hid, 0)
+            << "Error reading weights from " << trained_filename;
+        vector<shared_ptr<Blob<Dtype> > >& blobs =
+            folded_blobs[source_layer_name];
+        const int num_source_params = hdf5_get_num_links(layer_hid);
+        for (int j = 0; j < num_source_params; ++j) {
+          ostringstream oss;
+          oss << j;
+          blobs.push_back(shared_ptr<Blob<Dtype> >(new Blob<Dtype>()));
+          hdf5_load_nd_dataset(layer_hid, oss.str().c_str(), 0, kMaxBlobAxes,
+              blobs.back().get());
+        }
+        H5Gclose(layer_hid);
+        continue;
+      }
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
     }
@@ -841,6 +1121,12 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
         if (param_owners_[target_net_param_id] != -1) {
           // ...but it's weight-shared in target, so that's fine.
           continue;
+        } else if (j == 1 && layers_[target_layer_id]->layer_param()
+                   .folded_layer_size() > 0) {
+          // ...but the bias was added to take the folded layers.
+          caffe_set(target_blobs[1]->count(), Dtype(0),
+              target_blobs[1]->mutable_cpu_data());
+          continue;
         } else {
           LOG(FATAL) << "Incompatible number of blobs for layer "
               << source_layer_name;
@@ -853,6 +1139,70 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  FoldTrainedLayers(folded_blobs);
+}
+
+template <typename Dtype>
+void Net<Dtype>::FoldTrainedLayers(
+    const map<string, vector<shared_ptr<Blob<Dtype> > > >& folded_blobs) {
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const LayerParameter& layer_param = layers_[layer_id]->layer_param();
+    int num_copied = 0;
+    for (int i = 0; i < layer_param.folded_layer_size(); ++i) {
+      num_copied += folded_blobs.count(layer_param.folded_layer(i).name());
+    }
+    // Without any, the weights are either folded already (saved from a net
+    // with fused layers) or copied later.
+    if (num_copied == 0) {
+      continue;
+    }
+    CHECK_EQ(layer_param.folded_layer_size(), num_copied)
+        << "The layers folded into " << layer_param.name()
+        << " must be copied together.";
+    Blob<Dtype>* weight = layers_[layer_id]->blobs()[0].get();
+    Blob<Dtype>* bias = layers_[layer_id]->blobs()[1].get();
+    const int num_output = weight->shape(0);
+    const int dim = weight->count(1);
+    CHECK_EQ(num_output, bias->count());
+    // Each folded layer computes a[c] * x + b[c] on output channel c.
+    vector<Dtype> a(num_output), b(num_output);
+    for (int i = 0; i < layer_param.folded_layer_size(); ++i) {
+      const LayerParameter& folded_param = layer_param.folded_layer(i);
+      const vector<shared_ptr<Blob<Dtype> > >& blobs =
+          folded_blobs.find(folded_param.name())->second;
+      if (folded_param.type() == "BatchNorm") {
+        CHECK_EQ(3, blobs.size())
+            << "Incompatible number of blobs for layer " << folded_param.name();
+        CHECK_EQ(num_output, blobs[0]->count());
+        const Dtype moving_average = blobs[2]->cpu_data()[0];
+        const Dtype scale = moving_average == 0 ? 0 : 1 / moving_average;
+        const Dtype eps = folded_param.batch_norm_param().eps();
+        for (int c = 0; c < num_output; ++c) {
+          const Dtype mean = blobs[0]->cpu_data()[c] * scale;
+          const Dtype variance = blobs[1]->cpu_data()[c] * scale;
+          a[c] = 1 / std::sqrt(variance + eps);
+          b[c] = -mean * a[c];
+        }
+      } else {
+        const bool bias_term = folded_param.scale_param().bias_term();
+        CHECK_EQ(bias_term ? 2 : 1, blobs.size())
+            << "Incompatible number of blobs for layer " << folded_param.name();
+        CHECK_EQ(num_output, blobs[0]->count());
+        for (int c = 0; c < num_output; ++c) {
+          a[c] = blobs[0]->cpu_data()[c];
+          b[c] = bias_term ? blobs[1]->cpu_data()[c] : Dtype(0);
+        }
+      }
+      Dtype* weight_data = weight->mutable_cpu_data();
+      Dtype* bias_data = bias->mutable_cpu_data();
+      for (int c = 0; c < num_output; ++c) {
+        caffe_scal(dim, a[c], weight_data + c * dim);
+        bias_data[c] = a[c] * bias_data[c] + b[c];
+      }
+      LOG_IF(INFO, Caffe::root_solver()) << "Folded the weights of "
+          << folded_param.name() << " into " << layer_param.name();
+    }
+  }
 }
 
 template <typename Dtype>
@@ -869,6 +1219,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -931,6 +1282,25 @@ void Net<Dtype>::Update() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ResetStatistics() {
+  for (int i = 0; i < layers_.size(); ++i) {
+    layers_[i]->ResetStatistics();
+  }
+}
+
+template <typename Dtype>
+size_t Net<Dtype>::ReleaseFloatWeights() {
+  CHECK_EQ(phase_, TEST) << "Only inference can release the float weights.";
+  CHECK_EQ(Caffe::mode(), Caffe::CPU)
+      << "The 16-bit forward passes are CPU only.";
+  size_t bytes = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    bytes += layers_[i]->ReleaseFloatWeights();
+  }
+  return bytes;
+}
+
 template <typename Dtype>
 void Net<Dtype>::ClearParamDiffs() {
   for (int i = 0; i < learnable_params_.size(); ++i) {
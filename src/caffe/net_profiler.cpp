@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "caffe/net_profiler.hpp"
+
+namespace caffe {
+
+namespace {
+
+const char* const kDirections[2] = {"forward", "backward"};
+
+string JSONString(const string& s) {
+  string out("\"");
+  for (int i = 0; i < s.size(); ++i) {
+    const char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out += escaped;
+    } else {
+      out += c;
+    }
+  }
+  return out + "\"";
+}
+
+// Multiply-adds per output element of a convolution or inner product: the
+// weight count divided by the number of outputs, groups included.
+template <typename Dtype>
+double ForwardMacs(Layer<Dtype>& layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const string type = layer.type();
+  double macs = 0;
+  if (type == "Convolution" || type == "Convolution3D" ||
+      type == "NdConvolution") {
+    const Blob<Dtype>& weight = *layer.blobs()[0];
+    for (int i = 0; i < top.size(); ++i) {
+      macs += static_cast<double>(top[i]->count()) * weight.count() /
+          weight.shape(0);
+    }
+  } else if (type == "Deconvolution") {
+    // Deconvolution is the backward pass of a convolution, with the weight
+    // blob indexed by input channels.
+    const Blob<Dtype>& weight = *layer.blobs()[0];
+    for (int i = 0; i < bottom.size(); ++i) {
+      macs += static_cast<double>(bottom[i]->count()) * weight.count() /
+          weight.shape(0);
+    }
+  } else if (type == "InnerProduct") {
+    const Blob<Dtype>& weight = *layer.blobs()[0];
+    macs = static_cast<double>(top[0]->count()) * weight.count() /
+        layer.layer_param().inner_product_param().num_output();
+  }
+  return macs;
+}
+
+// One comparison or addition per pooling window element.
+template <typename Dtype>
+double PoolingOps(Layer<Dtype>& layer,
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const PoolingParameter& param = layer.layer_param().pooling_param();
+  double window = 1;
+  if (param.global_pooling()) {
+    window = bottom[0]->count(2);
+  } else if (param.has_kernel_shape()) {
+    for (int i = 0; i < param.kernel_shape().dim_size(); ++i) {
+      window *= param.kernel_shape().dim(i);
+    }
+  } else if (param.has_kernel_size()) {
+    window = static_cast<double>(param.kernel_size()) * param.kernel_size();
+  } else {
+    window = static_cast<double>(param.kernel_h()) * param.kernel_w();
+  }
+  return window * top[0]->count();
+}
+
+}  // namespace
+
+template <typename Dtype>
+NetProfiler<Dtype>::NetProfiler(const Net<Dtype>& net)
+    : net_(net), layer_id_(-1), backward_(false) {
+  Clear();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::Clear() {
+  for (int d = 0; d < 2; ++d) {
+    records_[d].clear();
+    records_[d].resize(net_.layers().size());
+  }
+  events_.clear();
+  origin_ = boost::posix_time::microsec_clock::local_time();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::StartLayer(int layer_id, bool backward) {
+  CHECK_EQ(layer_id_, -1) << "Layer " << net_.layer_names()[layer_id_]
+      << " is still being profiled.";
+  layer_id_ = layer_id;
+  backward_ = backward;
+  start_ = boost::posix_time::microsec_clock::local_time();
+  timer_.Start();
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::StopLayer() {
+  CHECK_GE(layer_id_, 0) << "StopLayer called without StartLayer.";
+  timer_.Stop();
+  const float ms = timer_.MilliSeconds();
+  Record& r = records_[backward_][layer_id_];
+  r.milliseconds.push_back(ms);
+  r.flops += LayerFlops(layer_id_, backward_);
+  double read, written;
+  LayerBytes(layer_id_, backward_, &read, &written);
+  r.bytes_read += read;
+  r.bytes_written += written;
+  TraceEvent event;
+  event.layer_id = layer_id_;
+  event.backward = backward_;
+  event.start_us = (start_ - origin_).total_microseconds();
+  event.duration_us = ms * 1000.;
+  events_.push_back(event);
+  layer_id_ = -1;
+}
+
+template <typename Dtype>
+int NetProfiler<Dtype>::calls(int layer_id, bool backward) const {
+  return record(layer_id, backward).milliseconds.size();
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::Percentile(int layer_id, bool backward,
+    double q) const {
+  vector<float> ms(record(layer_id, backward).milliseconds);
+  if (ms.empty()) {
+    return 0;
+  }
+  // Nearest rank.
+  int rank = static_cast<int>(std::ceil(q / 100. * ms.size())) - 1;
+  rank = std::min(std::max(rank, 0), static_cast<int>(ms.size()) - 1);
+  std::nth_element(ms.begin(), ms.begin() + rank, ms.end());
+  return ms[rank];
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::flops(int layer_id, bool backward) const {
+  return record(layer_id, backward).flops;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::bytes_read(int layer_id, bool backward) const {
+  return record(layer_id, backward).bytes_read;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::bytes_written(int layer_id, bool backward) const {
+  return record(layer_id, backward).bytes_written;
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::LayerFlops(int layer_id, bool backward) const {
+  Layer<Dtype>& layer = *net_.layers()[layer_id];
+  const vector<Blob<Dtype>*>& bottom = net_.bottom_vecs()[layer_id];
+  const vector<Blob<Dtype>*>& top = net_.top_vecs()[layer_id];
+  const string type = layer.type();
+  if (type == "Pooling" || type == "NdPooling") {
+    const double ops = PoolingOps(layer, bottom, top);
+    return backward ? (net_.bottom_need_backward()[layer_id][0] ? ops : 0)
+        : ops;
+  }
+  const double forward = 2 * ForwardMacs(layer, bottom, top);
+  if (!backward) {
+    return forward;
+  }
+  // The gradient with respect to the bottom and to the weights each cost as
+  // much as the forward pass.
+  double flops = 0;
+  const vector<bool>& need_backward = net_.bottom_need_backward()[layer_id];
+  if (std::find(need_backward.begin(), need_backward.end(), true) !=
+      need_backward.end()) {
+    flops += forward;
+  }
+  if (layer.param_propagate_down(0)) {
+    flops += forward;
+  }
+  return flops;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LayerBytes(int layer_id, bool backward,
+    double* read, double* written) const {
+  Layer<Dtype>& layer = *net_.layers()[layer_id];
+  const vector<Blob<Dtype>*>& bottom = net_.bottom_vecs()[layer_id];
+  const vector<Blob<Dtype>*>& top = net_.top_vecs()[layer_id];
+  const vector<bool>& need_backward = net_.bottom_need_backward()[layer_id];
+  double r = 0, w = 0;
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    const int count = layer.blobs()[i]->count();
+    r += count;
+    // The parameter gradients are accumulated: read and written.
+    if (backward && layer.param_propagate_down(i)) {
+      r += count;
+      w += count;
+    }
+  }
+  if (!backward) {
+    for (int i = 0; i < bottom.size(); ++i) {
+      r += bottom[i]->count();
+    }
+    for (int i = 0; i < top.size(); ++i) {
+      w += top[i]->count();
+    }
+  } else {
+    for (int i = 0; i < top.size(); ++i) {
+      r += top[i]->count();
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      r += bottom[i]->count();
+      if (need_backward[i]) {
+        w += bottom[i]->count();
+      }
+    }
+  }
+  *read = r * sizeof(Dtype);
+  *written = w * sizeof(Dtype);
+}
+
+template <typename Dtype>
+double NetProfiler<Dtype>::total_milliseconds(bool backward) const {
+  double total = 0;
+  for (int i = 0; i < records_[backward].size(); ++i) {
+    const vector<float>& ms = records_[backward][i].milliseconds;
+    for (int j = 0; j < ms.size(); ++j) {
+      total += ms[j];
+    }
+  }
+  return total;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::LogSummary() const {
+  LOG(INFO) << std::setw(20) << "layer" << std::setw(10) << "pass"
+      << std::setw(10) << "mean ms" << std::setw(10) << "p50 ms"
+      << std::setw(10) << "p99 ms" << std::setw(10) << "GFLOP/s"
+      << std::setw(10) << "GB/s";
+  for (int d = 0; d < 2; ++d) {
+    double flops = 0, bytes = 0;
+    for (int i = 0; i < records_[d].size(); ++i) {
+      const Record& r = records_[d][i];
+      if (r.milliseconds.empty()) {
+        continue;
+      }
+      double ms = 0;
+      for (int j = 0; j < r.milliseconds.size(); ++j) {
+        ms += r.milliseconds[j];
+      }
+      flops += r.flops;
+      bytes += r.bytes_read + r.bytes_written;
+      LOG(INFO) << std::setw(20) << net_.layer_names()[i]
+          << std::setw(10) << kDirections[d]
+          << std::setw(10) << ms / r.milliseconds.size()
+          << std::setw(10) << Percentile(i, d, 50)
+          << std::setw(10) << Percentile(i, d, 99)
+          << std::setw(10) << (ms > 0 ? r.flops / ms / 1e6 : 0)
+          << std::setw(10)
+          << (ms > 0 ? (r.bytes_read + r.bytes_written) / ms / 1e6 : 0);
+    }
+    const double ms = total_milliseconds(d);
+    LOG(INFO) << "Total " << kDirections[d] << ": " << ms << " ms, "
+        << flops / 1e9 << " GFLOP, " << bytes / 1e9 << " GB, "
+        << (ms > 0 ? flops / ms / 1e6 : 0) << " GFLOP/s, "
+        << (ms > 0 ? bytes / ms / 1e6 : 0) << " GB/s";
+  }
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteJSON(const string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  out << std::setprecision(9);
+  out << "{\n  \"net\": " << JSONString(net_.name()) << ",\n";
+  out << "  \"layers\": [";
+  double flops[2] = {0, 0}, bytes[2] = {0, 0};
+  for (int i = 0; i < net_.layers().size(); ++i) {
+    out << (i ? ",\n" : "\n") << "    {\"name\": "
+        << JSONString(net_.layer_names()[i]) << ", \"type\": "
+        << JSONString(net_.layers()[i]->type());
+    for (int d = 0; d < 2; ++d) {
+      const Record& r = records_[d][i];
+      if (r.milliseconds.empty()) {
+        continue;
+      }
+      double ms = 0, min_ms = r.milliseconds[0], max_ms = r.milliseconds[0];
+      for (int j = 0; j < r.milliseconds.size(); ++j) {
+        ms += r.milliseconds[j];
+        min_ms = std::min<double>(min_ms, r.milliseconds[j]);
+        max_ms = std::max<double>(max_ms, r.milliseconds[j]);
+      }
+      const int n = r.milliseconds.size();
+      flops[d] += r.flops;
+      bytes[d] += r.bytes_read + r.bytes_written;
+      out << ",\n     " << JSONString(kDirections[d]) << ": {"
+          << "\"calls\": " << n
+          << ", \"mean_ms\": " << ms / n
+          << ", \"min_ms\": " << min_ms
+          << ", \"p50_ms\": " << Percentile(i, d, 50)
+          << ", \"p90_ms\": " << Percentile(i, d, 90)
+          << ", \"p99_ms\": " << Percentile(i, d, 99)
+          << ", \"max_ms\": " << max_ms
+          << ", \"flops\": " << r.flops / n
+          << ", \"bytes_read\": " << r.bytes_read / n
+          << ", \"bytes_written\": " << r.bytes_written / n
+          << ", \"gflops_per_s\": " << (ms > 0 ? r.flops / ms / 1e6 : 0)
+          << ", \"gbytes_per_s\": "
+          << (ms > 0 ? (r.bytes_read + r.bytes_written) / ms / 1e6 : 0)
+          << "}";
+    }
+    out << "}";
+  }
+  out << "\n  ]";
+  for (int d = 0; d < 2; ++d) {
+    const double ms = total_milliseconds(d);
+    out << ",\n  " << JSONString(kDirections[d]) << ": {"
+        << "\"total_ms\": " << ms
+        << ", \"flops\": " << flops[d]
+        << ", \"bytes\": " << bytes[d]
+        << ", \"gflops_per_s\": " << (ms > 0 ? flops[d] / ms / 1e6 : 0)
+        << ", \"gbytes_per_s\": " << (ms > 0 ? bytes[d] / ms / 1e6 : 0)
+        << "}";
+  }
+  out << "\n}\n";
+  CHECK(out) << "Failed to write " << filename;
+}
+
+template <typename Dtype>
+void NetProfiler<Dtype>::WriteChromeTrace(const string& filename) const {
+  std::ofstream out(filename.c_str());
+  CHECK(out) << "Failed to open " << filename;
+  out << std::setprecision(15);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  for (int i = 0; i < events_.size(); ++i) {
+    const TraceEvent& e = events_[i];
+    out << (i ? ",\n" : "\n") << "{\"name\": "
+        << JSONString(net_.layer_names()[e.layer_id])
+        << ", \"cat\": " << JSONString(kDirections[e.backward])
+        << ", \"ph\": \"X\", \"ts\": " << e.start_us
+        << ", \"dur\": " << e.duration_us
+        << ", \"pid\": 0, \"tid\": 0, \"args\": {\"type\": "
+        << JSONString(net_.layers()[e.layer_id]->type()) << "}}";
+  }
+  out << "\n]}\n";
+  CHECK(out) << "Failed to write " << filename;
+}
+
+INSTANTIATE_CLASS(NetProfiler);
+
+}  // namespace caffe
@@ -114,6 +114,41 @@ void GPUParams<Dtype>::configure(Solver<Dtype>* solver) const {
   apply_buffers(net, diff_, size_, replace_gpu_diff);
 }
 
+template<typename Dtype>
+CPUParams<Dtype>::CPUParams(shared_ptr<Solver<Dtype> > root_solver,
+                            Dtype* shared_data)
+    : Params<Dtype>(root_solver),
+      owns_data_(shared_data == NULL) {
+  if (owns_data_) {
+    CaffeMallocHost(reinterpret_cast<void**>(&data_), size_ * sizeof(Dtype),
+        &use_cuda_);
+    const vector<Blob<Dtype>*>& net =
+        root_solver->net()->learnable_params();
+    apply_buffers(net, data_, size_, copy);
+  } else {
+    data_ = shared_data;
+  }
+  CaffeMallocHost(reinterpret_cast<void**>(&diff_), size_ * sizeof(Dtype),
+      &use_cuda_);
+  caffe_set(size_, Dtype(0), diff_);
+}
+
+template<typename Dtype>
+CPUParams<Dtype>::~CPUParams() {
+  if (owns_data_) {
+    CaffeFreeHost(data_, size_ * sizeof(Dtype), use_cuda_);
+  }
+  CaffeFreeHost(diff_, size_ * sizeof(Dtype), use_cuda_);
+}
+
+template<typename Dtype>
+void CPUParams<Dtype>::configure(Solver<Dtype>* solver) const {
+  const vector<Blob<Dtype>*>& net =
+      solver->net()->learnable_params();
+  apply_buffers(net, data_, size_, replace_cpu);
+  apply_buffers(net, diff_, size_, replace_cpu_diff);
+}
+
 void DevicePair::compute(const vector<int> devices, vector<DevicePair>* pairs) {
 #ifndef CPU_ONLY
   vector<int> remaining(devices);
@@ -436,8 +471,121 @@ void P2PSync<Dtype>::Run(const vector<int>& gpus) {
   }
 }
 
+//
+
+template<typename Dtype>
+CPUSync<Dtype>::CPUSync(shared_ptr<Solver<Dtype> > root_solver)
+    : CPUParams<Dtype>(root_solver, NULL),
+      root_(this),
+      rank_(0),
+      initial_iter_(root_solver->iter()),
+      solver_(root_solver) {
+  this->configure(solver_.get());
+  solver_->add_callback(this);
+}
+
+template<typename Dtype>
+CPUSync<Dtype>::CPUSync(shared_ptr<Solver<Dtype> > root_solver,
+                        CPUSync<Dtype>* root, int rank)
+    : CPUParams<Dtype>(root_solver, root->data_),
+      root_(root),
+      rank_(rank),
+      initial_iter_(root_solver->iter()),
+      solver_() {
+  Caffe::set_root_solver(false);
+  solver_.reset(new WorkerSolver<Dtype>(root_solver->param(),
+      root_solver.get()));
+  Caffe::set_root_solver(true);
+  this->configure(solver_.get());
+  solver_->add_callback(this);
+}
+
+template<typename Dtype>
+CPUSync<Dtype>::~CPUSync() {
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::InternalThreadEntry() {
+  CHECK(Caffe::root_solver());
+  Caffe::set_root_solver(false);
+  // See if there is a defined seed and reset random state if so
+  if (solver_->param().random_seed() >= 0) {
+    // Modulate the seed by rank so that the solvers differ.
+    Caffe::set_random_seed(solver_->param().random_seed() + rank_);
+  }
+  solver_->Step(solver_->param().max_iter() - initial_iter_);
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_start() {
+  // The root has applied the last update once every solver is here.
+  root_->barrier_->wait();
+  if (rank_ > 0) {
+    // The update went through the root's blobs, so mark the workers' views
+    // of the shared buffer as written too: layers keeping copies of their
+    // weights (packed, int8 or 16-bit) compare the data versions.
+    const vector<Blob<Dtype>*>& params = solver_->net()->learnable_params();
+    for (int i = 0; i < params.size(); ++i) {
+      params[i]->mutable_cpu_data();
+    }
+  }
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::on_gradients_ready() {
+  const vector<CPUSync<Dtype>*>& syncs = root_->syncs_;
+  root_->barrier_->wait();
+
+  // Every solver sums its slice of the gradients into the root's. Loss
+  // functions divide gradients by the batch size, so to compensate for split
+  // batch, the sum is divided by the number of solvers.
+  const size_t begin = size_ * rank_ / syncs.size();
+  const size_t end = size_ * (rank_ + 1) / syncs.size();
+  Dtype* dst = root_->diff_ + begin;
+  for (int i = 1; i < syncs.size(); ++i) {
+    caffe_axpy<Dtype>(end - begin, Dtype(1), syncs[i]->diff_ + begin, dst);
+  }
+  caffe_scal<Dtype>(end - begin, Dtype(1.0 / syncs.size()), dst);
+
+  // Gradients must not be cleared for the next iteration before all slices
+  // are summed.
+  root_->barrier_->wait();
+}
+
+template<typename Dtype>
+void CPUSync<Dtype>::Run() {
+  CHECK_EQ(root_, this) << "Run is called on the root solver's CPUSync";
+  const int count = Caffe::solver_count();
+  CHECK_GT(count, 1);
+  vector<shared_ptr<CPUSync<Dtype> > > workers;
+  syncs_.push_back(this);
+  for (int i = 1; i < count; ++i) {
+    workers.push_back(shared_ptr<CPUSync<Dtype> >(
+        new CPUSync<Dtype>(solver_, this, i)));
+    syncs_.push_back(workers.back().get());
+  }
+  barrier_.reset(new boost::barrier(count));
+
+  LOG(INFO)<< "Starting Optimization on " << count << " CPU solvers";
+
+  for (int i = 0; i < workers.size(); ++i) {
+    workers[i]->StartInternalThread();
+  }
+
+  // Run root solver on current thread
+  solver_->Solve();
+
+  // Workers left waiting for an early stopped root are interrupted.
+  for (int i = 0; i < workers.size(); ++i) {
+    workers[i]->StopInternalThread();
+  }
+  syncs_.clear();
+}
+
 INSTANTIATE_CLASS(Params);
 INSTANTIATE_CLASS(GPUParams);
+INSTANTIATE_CLASS(CPUParams);
 INSTANTIATE_CLASS(P2PSync);
+INSTANTIATE_CLASS(CPUSync);
 
 }  // namespace caffe
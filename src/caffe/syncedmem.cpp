@@ -1,12 +1,24 @@
+#include <boost/atomic.hpp>
+
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+namespace {
+
+boost::atomic<uint64_t> last_version(0);
+
+}  // namespace
+
+uint64_t SyncedMemory::NextVersion() {
+  return ++last_version;
+}
+
 SyncedMemory::~SyncedMemory() {
   if (cpu_ptr_ && own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_);
   }
 
 #ifndef CPU_ONLY
@@ -22,11 +34,13 @@ SyncedMemory::~SyncedMemory() {
 #endif  // CPU_ONLY
 }
 
-inline void SyncedMemory::to_cpu() {
+inline void SyncedMemory::to_cpu(bool zero_fill) {
   switch (head_) {
   case UNINITIALIZED:
     CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
-    caffe_memset(size_, 0, cpu_ptr_);
+    if (zero_fill) {
+      caffe_memset(size_, 0, cpu_ptr_);
+    }
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
     break;
@@ -84,11 +98,12 @@ const void* SyncedMemory::cpu_data() {
 void SyncedMemory::set_cpu_data(void* data) {
   CHECK(data);
   if (own_cpu_data_) {
-    CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
+    CaffeFreeHost(cpu_ptr_, size_, cpu_malloc_use_cuda_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  version_ = NextVersion();
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -116,6 +131,7 @@ void SyncedMemory::set_gpu_data(void* data) {
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  version_ = NextVersion();
 #else
   NO_GPU;
 #endif
@@ -124,6 +140,14 @@ void SyncedMemory::set_gpu_data(void* data) {
 void* SyncedMemory::mutable_cpu_data() {
   to_cpu();
   head_ = HEAD_AT_CPU;
+  version_ = NextVersion();
+  return cpu_ptr_;
+}
+
+void* SyncedMemory::mutable_cpu_data_for_overwrite() {
+  to_cpu(false);
+  head_ = HEAD_AT_CPU;
+  version_ = NextVersion();
   return cpu_ptr_;
 }
 
@@ -131,6 +155,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifndef CPU_ONLY
   to_gpu();
   head_ = HEAD_AT_GPU;
+  version_ = NextVersion();
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -0,0 +1,171 @@
+#ifdef USE_OPENCV
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/c3d_multi_label_video_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class C3DMultiLabelVideoDataLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  C3DMultiLabelVideoDataLayerTest()
+      : blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    // Create test input file.
+    MakeTempFilename(&filename_);
+    std::ofstream outfile(filename_.c_str(), std::ofstream::out);
+    LOG(INFO) << "Using temporary file " << filename_;
+    for (int i = 0; i < 2; ++i) {
+      outfile <<
+        CMAKE_SOURCE_DIR "caffe/test/test_data/UCF-101_Rowing_g16_c03.avi " <<
+        4 * i << " " << i << "," << 1 - i << "\n";
+    }
+    outfile.close();
+    // The whole video, for clip_stride.
+    MakeTempFilename(&video_filename_);
+    std::ofstream videofile(video_filename_.c_str(), std::ofstream::out);
+    videofile <<
+      CMAKE_SOURCE_DIR "caffe/test/test_data/UCF-101_Rowing_g16_c03.avi " <<
+      "0,1\n";
+    videofile.close();
+  }
+
+  virtual ~C3DMultiLabelVideoDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // The parameters of a test batch of both clips, center cropped.
+  LayerParameter MakeParam() {
+    LayerParameter param;
+    param.set_phase(TEST);
+    C3DMultiLabelVideoDataParameter* video_param =
+        param.mutable_c3d_multi_label_video_data_param();
+    video_param->set_source(filename_.c_str());
+    video_param->set_batch_size(2);
+    video_param->set_new_length(4);
+    video_param->set_new_height(48);
+    video_param->set_new_width(64);
+    video_param->set_crop_size(32);
+    return param;
+  }
+
+  string filename_;
+  string video_filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(C3DMultiLabelVideoDataLayerTest, TestDtypes);
+
+TYPED_TEST(C3DMultiLabelVideoDataLayerTest, TestChannelMeanStd) {
+  // The raw pixels first.
+  Blob<TypeParam> pixels;
+  {
+    C3DMultiLabelVideoDataLayer<TypeParam> layer(this->MakeParam());
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    pixels.CopyFrom(*this->blob_top_data_, false, true);
+  }
+  // Then normalized per channel, and scaled.
+  LayerParameter param = this->MakeParam();
+  C3DMultiLabelVideoDataParameter* video_param =
+      param.mutable_c3d_multi_label_video_data_param();
+  const float mean[] = {90, 100, 110};
+  const float stddev[] = {50, 60, 70};
+  for (int c = 0; c < 3; ++c) {
+    video_param->add_channel_mean(mean[c]);
+    video_param->add_channel_std(stddev[c]);
+  }
+  video_param->set_scale(0.5);
+  C3DMultiLabelVideoDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(pixels.shape(), this->blob_top_data_->shape());
+  const int channels = pixels.shape(1);
+  const int dim = pixels.count(2);
+  for (int i = 0; i < pixels.count(); ++i) {
+    const int c = i / dim % channels;
+    EXPECT_NEAR((pixels.cpu_data()[i] - mean[c]) * 0.5 / stddev[c],
+        this->blob_top_data_->cpu_data()[i], 1e-5);
+  }
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(i, this->blob_top_label_->cpu_data()[2 * i]);
+    EXPECT_EQ(1 - i, this->blob_top_label_->cpu_data()[2 * i + 1]);
+  }
+}
+
+TYPED_TEST(C3DMultiLabelVideoDataLayerTest, TestClipStride) {
+  // The clips of the list, at frames 0 and 4.
+  Blob<TypeParam> expected;
+  {
+    C3DMultiLabelVideoDataLayer<TypeParam> layer(this->MakeParam());
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    expected.CopyFrom(*this->blob_top_data_, false, true);
+  }
+  // The first clips of the whole video, every 4 frames.
+  LayerParameter param = this->MakeParam();
+  C3DMultiLabelVideoDataParameter* video_param =
+      param.mutable_c3d_multi_label_video_data_param();
+  video_param->set_source(this->video_filename_.c_str());
+  video_param->set_clip_stride(4);
+  C3DMultiLabelVideoDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_GT(layer.clip_video().size(), 2);
+  for (int i = 0; i < layer.clip_video().size(); ++i) {
+    EXPECT_EQ(0, layer.clip_video()[i]);
+  }
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(expected.shape(), this->blob_top_data_->shape());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_data_->cpu_data()[i]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(0, this->blob_top_label_->cpu_data()[2 * i]);
+    EXPECT_EQ(1, this->blob_top_label_->cpu_data()[2 * i + 1]);
+  }
+}
+
+TYPED_TEST(C3DMultiLabelVideoDataLayerTest, TestSequentialDecode) {
+  // The clips of the list, each read with its own seek.
+  Blob<TypeParam> expected;
+  {
+    C3DMultiLabelVideoDataLayer<TypeParam> layer(this->MakeParam());
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    expected.CopyFrom(*this->blob_top_data_, false, true);
+  }
+  // The same clips decoded one after the other.
+  LayerParameter param = this->MakeParam();
+  param.mutable_c3d_multi_label_video_data_param()->set_sequential_decode(
+      true);
+  C3DMultiLabelVideoDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(expected.shape(), this->blob_top_data_->shape());
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_data_->cpu_data()[i]);
+  }
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(i, this->blob_top_label_->cpu_data()[2 * i]);
+    EXPECT_EQ(1 - i, this->blob_top_label_->cpu_data()[2 * i + 1]);
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
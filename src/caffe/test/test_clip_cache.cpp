@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/clip_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ClipCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempFilename(&filename_);
+  }
+
+  // Writes num_clips clips of growing size whose pixels and labels encode
+  // the clip index.
+  void WriteClips(int num_clips) {
+    ClipCacheWriter writer(filename_);
+    for (int i = 0; i < num_clips; ++i) {
+      vector<uint8_t> data(3 * 2 * (4 + i) * 5);
+      for (int j = 0; j < data.size(); ++j) {
+        data[j] = static_cast<uint8_t>(i * 7 + j);
+      }
+      vector<int> labels(i + 1, i);
+      writer.Add(&data[0], 3, 2, 4 + i, 5, labels);
+    }
+    EXPECT_EQ(writer.size(), num_clips);
+  }
+
+  string filename_;
+};
+
+TEST_F(ClipCacheTest, TestRoundTrip) {
+  const int num_clips = 4;
+  WriteClips(num_clips);
+  ClipCache cache(filename_);
+  ASSERT_EQ(cache.size(), num_clips);
+  for (int i = 0; i < num_clips; ++i) {
+    const ClipCacheEntry& entry = cache.entry(i);
+    EXPECT_EQ(entry.channels, 3);
+    EXPECT_EQ(entry.length, 2);
+    EXPECT_EQ(entry.height, 4 + i);
+    EXPECT_EQ(entry.width, 5);
+    EXPECT_EQ(entry.offset % ClipCache::kAlignment, 0);
+    ASSERT_EQ(entry.num_labels, i + 1);
+    for (int j = 0; j < entry.num_labels; ++j) {
+      EXPECT_EQ(cache.labels(i)[j], i);
+    }
+    const uint8_t* data = cache.data(i);
+    for (int j = 0; j < 3 * 2 * (4 + i) * 5; ++j) {
+      EXPECT_EQ(data[j], static_cast<uint8_t>(i * 7 + j));
+    }
+  }
+}
+
+TEST_F(ClipCacheTest, TestEmpty) {
+  WriteClips(0);
+  ClipCache cache(filename_);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+}  // namespace caffe
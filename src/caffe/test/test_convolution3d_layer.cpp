@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/convolution3d_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+#include "caffe/test/test_precision_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class Convolution3DLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  Convolution3DLayerTest()
+      : blob_bottom_(new Blob<Dtype>()),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_direct_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    vector<int> shape(5);
+    shape[0] = 2;
+    shape[1] = 3;
+    shape[2] = 5;
+    shape[3] = 6;
+    shape[4] = 7;
+    blob_bottom_->Reshape(shape);
+    FillerParameter filler_param;
+    filler_param.set_value(1.);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~Convolution3DLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_direct_;
+  }
+
+  void SetConvParam(LayerParameter* layer_param, int num_output,
+      int kernel_size, int kernel_depth, int stride, int temporal_stride,
+      int pad, int temporal_pad) {
+    Convolution3DParameter* conv_param =
+        layer_param->mutable_convolution3d_param();
+    conv_param->set_num_output(num_output);
+    conv_param->set_kernel_size(kernel_size);
+    conv_param->set_kernel_depth(kernel_depth);
+    conv_param->set_stride(stride);
+    conv_param->set_temporal_stride(temporal_stride);
+    conv_param->set_pad(pad);
+    conv_param->set_temporal_pad(temporal_pad);
+    conv_param->mutable_weight_filler()->set_type("gaussian");
+    conv_param->mutable_bias_filler()->set_type("gaussian");
+  }
+
+  // Runs the GEMM and the DIRECT forward pass with the same weights and
+  // checks that they agree, then again with new weights, which the DIRECT
+  // layer must pack again.
+  void TestDirectForward(LayerParameter layer_param) {
+    layer_param.mutable_convolution3d_param()->set_algorithm(
+        Convolution3DParameter_Algorithm_GEMM);
+    Convolution3DLayer<Dtype> gemm_layer(layer_param);
+    gemm_layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+
+    layer_param.mutable_convolution3d_param()->set_algorithm(
+        Convolution3DParameter_Algorithm_DIRECT);
+    vector<Blob<Dtype>*> top_direct_vec(1, blob_top_direct_);
+    Convolution3DLayer<Dtype> direct_layer(layer_param);
+    direct_layer.SetUp(blob_bottom_vec_, top_direct_vec);
+    ASSERT_EQ(gemm_layer.blobs().size(), direct_layer.blobs().size());
+    for (int round = 0; round < 2; ++round) {
+      if (round > 0) {
+        caffe_scal(gemm_layer.blobs()[0]->count(), Dtype(-0.5),
+            gemm_layer.blobs()[0]->mutable_cpu_data());
+      }
+      for (int i = 0; i < gemm_layer.blobs().size(); ++i) {
+        direct_layer.blobs()[i]->CopyFrom(*gemm_layer.blobs()[i]);
+      }
+      gemm_layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      direct_layer.Forward(blob_bottom_vec_, top_direct_vec);
+
+      ASSERT_EQ(blob_top_->shape(), blob_top_direct_->shape());
+      const Dtype* expected = blob_top_->cpu_data();
+      const Dtype* actual = blob_top_direct_->cpu_data();
+      for (int i = 0; i < blob_top_->count(); ++i) {
+        EXPECT_NEAR(expected[i], actual[i], 1e-4);
+      }
+    }
+  }
+
+  // Runs the float and the int8 forward pass, calibrated on the bottom with
+  // one range per channel or a single one, and checks that they agree to
+  // within the quantization error.
+  void TestInt8Forward(const LayerParameter& layer_param, bool per_channel) {
+    const int channels = blob_bottom_->shape(1);
+    const int spatial = blob_bottom_->count(2);
+    vector<Dtype> ranges(per_channel ? channels : 1, 0);
+    for (int i = 0; i < blob_bottom_->count(); ++i) {
+      Dtype* range = &ranges[per_channel ? i / spatial % channels : 0];
+      *range = std::max(*range, std::fabs(blob_bottom_->cpu_data()[i]));
+    }
+    LayerParameter int8_param(layer_param);
+    for (int i = 0; i < ranges.size(); ++i) {
+      int8_param.mutable_quantization_param()->add_input_range(ranges[i]);
+    }
+    CheckReducedPrecisionForward<Convolution3DLayer>(layer_param, int8_param,
+        0.02, blob_bottom_vec_);
+  }
+
+  // Runs the float and the 16-bit forward pass and checks that they agree
+  // to within a tolerance relative to the largest output.
+  void TestHalfForward(LayerParameter layer_param,
+      LayerParameter_StoragePrecision precision, Dtype tolerance) {
+    LayerParameter half_param(layer_param);
+    half_param.set_storage_precision(precision);
+    CheckReducedPrecisionForward<Convolution3DLayer>(layer_param, half_param,
+        tolerance, blob_bottom_vec_);
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_direct_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(Convolution3DLayerTest, TestDtypes);
+
+TYPED_TEST(Convolution3DLayerTest, TestSetup) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 4, 3, 3, 2, 1, 1, 0);
+  Convolution3DLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num_axes(), 5);
+  EXPECT_EQ(this->blob_top_->shape(0), 2);
+  EXPECT_EQ(this->blob_top_->shape(1), 4);
+  EXPECT_EQ(this->blob_top_->shape(2), 3);
+  EXPECT_EQ(this->blob_top_->shape(3), 3);
+  EXPECT_EQ(this->blob_top_->shape(4), 4);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestDirectForward) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 8, 3, 3, 1, 1, 1, 1);
+  this->TestDirectForward(layer_param);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestDirectForwardStrided) {
+  // 6 outputs leaves a partial block of output channels.
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 6, 3, 2, 2, 2, 1, 0);
+  this->TestDirectForward(layer_param);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestDirectForwardNoBiasGroup) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 3, 2, 3, 1, 1, 0, 1);
+  layer_param.mutable_convolution3d_param()->set_bias_term(false);
+  layer_param.mutable_convolution3d_param()->set_filter_group(3);
+  this->TestDirectForward(layer_param);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestDirectForwardWide) {
+  // Rows wide enough for tiles that read no padding, and two blocks of
+  // output channels.
+  vector<int> shape = this->blob_bottom_->shape();
+  shape[4] = 20;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 20, 3, 3, 1, 1, 1, 1);
+  this->TestDirectForward(layer_param);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestInt8Forward) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 8, 3, 3, 1, 1, 1, 1);
+  this->TestInt8Forward(layer_param, true);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestInt8ForwardOneRangeGroup) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 6, 3, 2, 2, 2, 1, 0);
+  layer_param.mutable_convolution3d_param()->set_filter_group(2);
+  layer_param.mutable_convolution3d_param()->set_batch_parallelism(2);
+  this->TestInt8Forward(layer_param, false);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestFP16Forward) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 6, 3, 2, 2, 2, 1, 0);
+  layer_param.mutable_convolution3d_param()->set_filter_group(2);
+  layer_param.mutable_convolution3d_param()->set_batch_parallelism(2);
+  this->TestHalfForward(layer_param, LayerParameter_StoragePrecision_FP16,
+      0.005);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestBF16Forward) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 8, 3, 3, 1, 1, 1, 1);
+  layer_param.mutable_convolution3d_param()->set_fused_relu(true);
+  this->TestHalfForward(layer_param, LayerParameter_StoragePrecision_BF16,
+      0.03);
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestBatchParallelism) {
+  typedef TypeParam Dtype;
+  vector<int> shape = this->blob_bottom_->shape();
+  shape[0] = 5;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 4, 3, 3, 1, 1, 1, 1);
+  layer_param.mutable_convolution3d_param()->set_filter_group(2);
+  Convolution3DLayer<Dtype> serial_layer(layer_param);
+  serial_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  serial_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top(this->blob_top_->shape());
+  filler.Fill(&top);
+  caffe_copy(top.count(), top.cpu_data(), this->blob_top_->mutable_cpu_diff());
+  top.CopyFrom(*this->blob_top_);
+  vector<bool> propagate_down(1, true);
+  serial_layer.Backward(this->blob_top_vec_, propagate_down,
+      this->blob_bottom_vec_);
+  Blob<Dtype> bottom_diff(shape);
+  bottom_diff.CopyFrom(*this->blob_bottom_, true);
+
+  // 3 slices of 1, 2 and 2 samples; 0 uses the pool size, or one slice
+  // when no column buffer fits the budget.
+  const int parallelism[] = {3, 0, 0};
+  const int budget_mb[] = {1024, 1024, 0};
+  for (int p = 0; p < 3; ++p) {
+    layer_param.mutable_convolution3d_param()->set_batch_parallelism(
+        parallelism[p]);
+    layer_param.mutable_convolution3d_param()->set_col_buffer_budget_mb(
+        budget_mb[p]);
+    Convolution3DLayer<Dtype> layer(layer_param);
+    vector<Blob<Dtype>*> top_vec(1, this->blob_top_direct_);
+    layer.SetUp(this->blob_bottom_vec_, top_vec);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      layer.blobs()[i]->CopyFrom(*serial_layer.blobs()[i]);
+    }
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    for (int i = 0; i < top.count(); ++i) {
+      EXPECT_NEAR(top.cpu_data()[i], this->blob_top_direct_->cpu_data()[i],
+          1e-4);
+    }
+    this->blob_top_direct_->CopyFrom(*this->blob_top_, true);
+    layer.Backward(top_vec, propagate_down, this->blob_bottom_vec_);
+    for (int i = 0; i < bottom_diff.count(); ++i) {
+      EXPECT_NEAR(bottom_diff.cpu_diff()[i],
+          this->blob_bottom_->cpu_diff()[i], 1e-4);
+    }
+    for (int b = 0; b < layer.blobs().size(); ++b) {
+      const Blob<Dtype>& expected = *serial_layer.blobs()[b];
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_diff()[i], layer.blobs()[b]->cpu_diff()[i],
+            1e-3);
+      }
+    }
+  }
+}
+
+TYPED_TEST(Convolution3DLayerTest, TestGradient) {
+  LayerParameter layer_param;
+  this->SetConvParam(&layer_param, 2, 3, 3, 2, 1, 1, 1);
+  layer_param.mutable_convolution3d_param()->set_batch_parallelism(2);
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 2;
+  shape[2] = 3;
+  shape[3] = 4;
+  shape[4] = 5;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  Convolution3DLayer<TypeParam> layer(layer_param);
+  GradientChecker<TypeParam> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+}  // namespace caffe
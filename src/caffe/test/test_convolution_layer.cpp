@@ -1,3 +1,4 @@
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -6,6 +7,7 @@
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/ndconv_layer.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -13,6 +15,7 @@
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
+#include "caffe/test/test_precision_check_util.hpp"
 
 namespace caffe {
 
@@ -473,6 +476,64 @@ TYPED_TEST(ConvolutionLayerTest, Test1x1Convolution) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestInt8Convolution) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;  // The int8 forward pass is CPU only.
+  }
+  // 2-D 3x3, 2-D 1x1 and 3-D 3x3x3 through the N-d im2col.
+  for (int test = 0; test < 3; ++test) {
+    if (test == 2) {
+      vector<int> bottom_shape = this->blob_bottom_->shape();
+      bottom_shape.insert(bottom_shape.begin() + 2, 5);
+      this->blob_bottom_->Reshape(bottom_shape);
+      FillerParameter filler_param;
+      GaussianFiller<Dtype> filler(filler_param);
+      filler.Fill(this->blob_bottom_);
+    }
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(test == 1 ? 1 : 3);
+    convolution_param->add_pad(test == 1 ? 0 : 1);
+    convolution_param->set_num_output(4);
+    convolution_param->set_force_nd_im2col(test == 2);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    const int spatial = this->blob_bottom_->count(2);
+    vector<Dtype> ranges(3, 0);
+    for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+      Dtype* range = &ranges[i / spatial % 3];
+      *range = std::max(*range, std::fabs(this->blob_bottom_->cpu_data()[i]));
+    }
+    LayerParameter int8_param(layer_param);
+    for (int c = 0; c < 3; ++c) {
+      int8_param.mutable_quantization_param()->add_input_range(ranges[c]);
+    }
+    CheckReducedPrecisionForward<ConvolutionLayer>(layer_param, int8_param,
+        0.02, this->blob_bottom_vec_);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestHalfConvolutionGroup) {
+  if (Caffe::mode() != Caffe::CPU) {
+    return;  // The 16-bit forward pass is CPU only.
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->set_num_output(3);
+  convolution_param->set_group(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  LayerParameter half_param(layer_param);
+  half_param.set_storage_precision(LayerParameter_StoragePrecision_FP16);
+  CheckReducedPrecisionForward<ConvolutionLayer>(layer_param, half_param,
+      0.005, this->blob_bottom_vec_);
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -822,6 +883,134 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestNdConvolutionAgainstND) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = 2;
+  bottom_shape[1] = 4;
+  bottom_shape[2] = 5;
+  bottom_shape[3] = 7;
+  bottom_shape[4] = 6;
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < this->blob_bottom_vec_.size(); ++i) {
+    this->blob_bottom_vec_[i]->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_vec_[i]);
+  }
+  // Anisotropic kernel, pad and stride, given as NdConvolution shapes.
+  const int kernel[] = {3, 3, 2};
+  const int pad[] = {1, 0, 1};
+  const int stride[] = {1, 2, 1};
+  LayerParameter nd_layer_param;
+  ConvolutionParameter* nd_param = nd_layer_param.mutable_convolution_param();
+  nd_param->set_num_output(6);
+  nd_param->set_group(2);
+  nd_param->mutable_weight_filler()->set_type("gaussian");
+  nd_param->mutable_bias_filler()->set_type("gaussian");
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->CopyFrom(*nd_param);
+  convolution_param->set_force_nd_im2col(true);
+  for (int i = 0; i < 3; ++i) {
+    nd_param->mutable_kernel_shape()->add_dim(kernel[i]);
+    nd_param->mutable_pad_shape()->add_dim(pad[i]);
+    nd_param->mutable_stride_shape()->add_dim(stride[i]);
+    convolution_param->add_kernel_size(kernel[i]);
+    convolution_param->add_pad(pad[i]);
+    convolution_param->add_stride(stride[i]);
+  }
+  vector<bool> propagate_down(1, true);
+  bool copy_diff;
+  bool reshape;
+  // NdConvolution (vol2col) result.
+  NdConvolutionLayer<Dtype> nd_layer(nd_layer_param);
+  EXPECT_STREQ("NdConvolution", nd_layer.type());
+  nd_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(5, this->blob_top_->num_axes());
+  EXPECT_EQ(2, this->blob_top_->shape(0));
+  EXPECT_EQ(6, this->blob_top_->shape(1));
+  EXPECT_EQ(5, this->blob_top_->shape(2));
+  EXPECT_EQ(3, this->blob_top_->shape(3));
+  EXPECT_EQ(7, this->blob_top_->shape(4));
+  Blob<Dtype> top_diff;
+  top_diff.ReshapeLike(*this->blob_top_);
+  filler.Fill(&top_diff);
+  nd_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> result;
+  copy_diff = false; reshape = true;
+  result.CopyFrom(*this->blob_top_, copy_diff, reshape);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+             this->blob_top_->mutable_cpu_diff());
+  for (int i = 0; i < nd_layer.blobs().size(); ++i) {
+    caffe_set(nd_layer.blobs()[i]->count(), Dtype(0),
+              nd_layer.blobs()[i]->mutable_cpu_diff());
+  }
+  nd_layer.Backward(this->blob_top_vec_, propagate_down,
+                    this->blob_bottom_vec_);
+  Blob<Dtype> backward_result;
+  copy_diff = true; reshape = true;
+  backward_result.CopyFrom(*this->blob_bottom_, copy_diff, reshape);
+  // Reference: general ND im2col with the same weights.
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(nd_layer.blobs().size(), layer.blobs().size());
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    copy_diff = false; reshape = false;
+    layer.blobs()[i]->CopyFrom(*nd_layer.blobs()[i], copy_diff, reshape);
+    caffe_set(layer.blobs()[i]->count(), Dtype(0),
+              layer.blobs()[i]->mutable_cpu_diff());
+  }
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(result.count(), this->blob_top_->count());
+  for (int i = 0; i < result.count(); ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], result.cpu_data()[i], 1e-4);
+  }
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+             this->blob_top_->mutable_cpu_diff());
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < backward_result.count(); ++i) {
+    EXPECT_NEAR(this->blob_bottom_->cpu_diff()[i],
+                backward_result.cpu_diff()[i], 1e-4);
+  }
+  for (int b = 0; b < layer.blobs().size(); ++b) {
+    for (int i = 0; i < layer.blobs()[b]->count(); ++i) {
+      EXPECT_NEAR(layer.blobs()[b]->cpu_diff()[i],
+                  nd_layer.blobs()[b]->cpu_diff()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestNdConvolutionGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape(5);
+  bottom_shape[0] = this->blob_bottom_vec_[0]->shape(0);
+  bottom_shape[1] = this->blob_bottom_vec_[0]->shape(1);
+  bottom_shape[2] = 4;
+  bottom_shape[3] = this->blob_bottom_vec_[0]->shape(2);
+  bottom_shape[4] = this->blob_bottom_vec_[0]->shape(3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < this->blob_bottom_vec_.size(); ++i) {
+    this->blob_bottom_vec_[i]->Reshape(bottom_shape);
+    filler.Fill(this->blob_bottom_vec_[i]);
+  }
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  for (int i = 0; i < 3; ++i) {
+    convolution_param->mutable_kernel_shape()->add_dim(3);
+    convolution_param->mutable_pad_shape()->add_dim(1);
+  }
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  NdConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -340,5 +340,85 @@ TYPED_TEST(DataTransformTest, TestMeanFile) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestVolumeCropMeanValues) {
+  TransformationParameter transform_param;
+  const int channels = 3;
+  const int length = 2;
+  const int height = 6;
+  const int width = 5;
+  const int crop_size = 3;
+  transform_param.set_crop_size(crop_size);
+  transform_param.set_scale(0.5);
+  transform_param.add_mean_value(1);
+  transform_param.add_mean_value(2);
+  transform_param.add_mean_value(3);
+  vector<uint8_t> volume(channels * length * height * width);
+  for (int j = 0; j < volume.size(); ++j) {
+    volume[j] = j;
+  }
+  vector<int> shape(5);
+  shape[0] = 1;
+  shape[1] = channels;
+  shape[2] = length;
+  shape[3] = crop_size;
+  shape[4] = crop_size;
+  Blob<TypeParam> blob(shape);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  transformer.TransformVolume(&volume[0], channels, length, height, width,
+      &blob);
+  // TEST crops the center: offsets (6 - 3) / 2 = 1 and (5 - 3) / 2 = 1.
+  for (int c = 0; c < channels; ++c) {
+    for (int l = 0; l < length; ++l) {
+      for (int h = 0; h < crop_size; ++h) {
+        for (int w = 0; w < crop_size; ++w) {
+          const int pixel =
+              volume[((c * length + l) * height + h + 1) * width + w + 1];
+          EXPECT_EQ(blob.data_at(0, c, l, h, w), (pixel - (c + 1)) * 0.5);
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(DataTransformTest, TestVolumeMirror) {
+  TransformationParameter transform_param;
+  const int channels = 2;
+  const int length = 3;
+  const int height = 4;
+  const int width = 5;
+  transform_param.set_mirror(true);
+  vector<uint8_t> volume(channels * length * height * width);
+  for (int j = 0; j < volume.size(); ++j) {
+    volume[j] = j;
+  }
+  vector<int> shape(5);
+  shape[0] = 1;
+  shape[1] = channels;
+  shape[2] = length;
+  shape[3] = height;
+  shape[4] = width;
+  Blob<TypeParam> blob(shape);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  int num_mirrored = 0;
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    transformer.TransformVolume(&volume[0], channels, length, height, width,
+        &blob);
+    // The whole clip is mirrored, or none of it.
+    const bool mirrored = blob.cpu_data()[0] == volume[width - 1];
+    num_mirrored += mirrored;
+    for (int j = 0; j < blob.count(); ++j) {
+      const int w = j % width;
+      const int row = j - w;
+      EXPECT_EQ(blob.cpu_data()[j],
+          volume[row + (mirrored ? width - 1 - w : w)]);
+    }
+  }
+  EXPECT_GT(num_mirrored, 0);
+  EXPECT_LT(num_mirrored, this->num_iter_);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -26,7 +26,7 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
  protected:
   GradientBasedSolverTest() :
       seed_(1701), num_(4), channels_(3), height_(10), width_(10),
-      share_(false) {
+      share_(false), direct_conv3d_(false) {
         input_file_ = new string(
         CMAKE_SOURCE_DIR "caffe/test/test_data/solver_data_list.txt" CMAKE_EXT);
       }
@@ -37,11 +37,14 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
   string snapshot_prefix_;
   shared_ptr<SGDSolver<Dtype> > solver_;
   shared_ptr<P2PSync<Dtype> > sync_;
+  shared_ptr<CPUSync<Dtype> > cpu_sync_;
   int seed_;
   // Dimensions are determined by generate_sample_data.py
   // TODO this is brittle and the hdf5 file should be checked instead.
   int num_, channels_, height_, width_;
   bool share_;
+  // Puts a DIRECT Convolution3D layer on the data, before the inner product.
+  bool direct_conv3d_;
   Dtype delta_;  // Stability constant for RMSProp, AdaGrad, AdaDelta and Adam
 
   // Test data: check out generate_sample_data.py in the same directory.
@@ -110,6 +113,39 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
          "    } "
          "  } ";
     }
+    if (direct_conv3d_) {
+      proto <<
+         "  layer { "
+         "    name: 'volume' "
+         "    type: 'Reshape' "
+         "    bottom: 'data' "
+         "    top: 'volume' "
+         "    reshape_param { "
+         "      shape { dim: 0 dim: 1 dim: " << channels_ << " "
+         "              dim: " << height_ << " dim: " << width_ << " } "
+         "    } "
+         "  } "
+         "  layer { "
+         "    name: 'conv3d' "
+         "    type: 'Convolution3D' "
+         "    convolution3D_param { "
+         "      num_output: 2 "
+         "      kernel_size: 3 "
+         "      kernel_depth: 3 "
+         "      algorithm: DIRECT "
+         "      weight_filler { "
+         "        type: 'gaussian' "
+         "        std: 0.1 "
+         "      } "
+         "      bias_filler { "
+         "        type: 'gaussian' "
+         "        std: 0.1 "
+         "      } "
+         "    } "
+         "    bottom: 'volume' "
+         "    top: 'conv3d' "
+         "  } ";
+    }
     proto <<
        "  layer { "
        "    name: 'innerprod' "
@@ -127,7 +163,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
        "        std: 1.0 "
        "      } "
        "    } "
-       "    bottom: '" << string(share_ ? "data1": "data") << "' "
+       "    bottom: '" << string(share_ ? "data1" :
+           (direct_conv3d_ ? "conv3d" : "data")) << "' "
        "    top: '" << string(share_ ? "innerprod1": "innerprod") << "' "
        "  } ";
     if (share_) {
@@ -191,6 +228,12 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
     }
     if (devices == 1) {
       this->solver_->Solve();
+    } else if (Caffe::mode() == Caffe::CPU) {
+      LOG(INFO) << "Multi-CPU test on " << devices << " solvers";
+      Caffe::set_solver_count(devices);
+      this->cpu_sync_.reset(new CPUSync<Dtype>(this->solver_));
+      this->cpu_sync_->Run();
+      Caffe::set_solver_count(1);
     } else {
       LOG(INFO) << "Multi-GPU test on " << devices << " devices";
       vector<int> gpus;
@@ -455,8 +498,8 @@ class GradientBasedSolverTest : public MultiDeviceTest<TypeParam> {
       const int iter_to_check = 0) {
     const int kNum = num_;
     const int kIterSize = 1;
-    // Test over all numbers of devices.
-    int available_devices = 1;
+    // Test over all numbers of devices, or of solvers on CPU threads.
+    int available_devices = 2;
 #ifndef CPU_ONLY
     if (Caffe::mode() == Caffe::GPU) {
       CUDA_CHECK(cudaGetDeviceCount(&available_devices));
@@ -694,6 +737,42 @@ TYPED_TEST(SGDSolverTest, TestSnapshotShare) {
   }
 }
 
+TYPED_TEST(SGDSolverTest, TestDirectConvolution3DWorkersMatchSingle) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // Workers read the weights through their own views of the root's buffer,
+  // so their DIRECT layers must repack them after every update.
+  const Dtype kLearningRate = 0.01;
+  const int kNumIters = 3;
+  const int kDevices = 2;
+  const int kNum = this->num_;
+  this->direct_conv3d_ = true;
+  this->num_ = kNum * kDevices;
+  this->RunLeastSquaresSolver(kLearningRate, 0, 0, kNumIters);
+  const vector<Blob<Dtype>*>& single_params =
+      this->solver_->net()->learnable_params();
+  vector<shared_ptr<Blob<Dtype> > > expected(single_params.size());
+  for (int i = 0; i < single_params.size(); ++i) {
+    expected[i].reset(new Blob<Dtype>());
+    expected[i]->CopyFrom(*single_params[i], false, true);
+  }
+  this->num_ = kNum;
+  this->RunLeastSquaresSolver(kLearningRate, 0, 0, kNumIters, 1, kDevices);
+  const vector<Blob<Dtype>*>& params =
+      this->solver_->net()->learnable_params();
+  ASSERT_EQ(expected.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    for (int j = 0; j < params[i]->count(); ++j) {
+      const Dtype expected_param = expected[i]->cpu_data()[j];
+      EXPECT_NEAR(expected_param, params[i]->cpu_data()[j],
+          std::max(Dtype(1e-5), Dtype(1e-3) * fabs(expected_param)))
+          << "param " << i << " differed at dim " << j;
+    }
+  }
+}
+
 
 template <typename TypeParam>
 class AdaGradSolverTest : public GradientBasedSolverTest<TypeParam> {
@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+TEST(HalfTest, TestFP16Conversion) {
+  EXPECT_EQ(0x0000, caffe_float_to_fp16(0.f));
+  EXPECT_EQ(0x8000, caffe_float_to_fp16(-0.f));
+  EXPECT_EQ(0x3c00, caffe_float_to_fp16(1.f));
+  EXPECT_EQ(0xc000, caffe_float_to_fp16(-2.f));
+  EXPECT_EQ(0x7bff, caffe_float_to_fp16(65504.f));
+  EXPECT_EQ(0x7c00, caffe_float_to_fp16(65520.f));
+  EXPECT_EQ(0x7c00, caffe_float_to_fp16(1e10f));
+  EXPECT_EQ(0x0001, caffe_float_to_fp16(std::pow(2.f, -24)));
+  EXPECT_EQ(0x0000, caffe_float_to_fp16(std::pow(2.f, -26)));
+  EXPECT_EQ(0x0400, caffe_float_to_fp16(std::pow(2.f, -14)));
+  // Ties round to even: 1 + 2^-11 is halfway between 1 and 1 + 2^-10.
+  EXPECT_EQ(0x3c00, caffe_float_to_fp16(1.f + std::pow(2.f, -11)));
+  EXPECT_EQ(0x3c02, caffe_float_to_fp16(1.f + 3 * std::pow(2.f, -11)));
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float fp16_nan = caffe_fp16_to_float(caffe_float_to_fp16(nan));
+  EXPECT_NE(fp16_nan, fp16_nan);
+  // Every value other than NaN survives the round trip.
+  for (int h = 0; h < 65536; ++h) {
+    if ((h & 0x7c00) == 0x7c00 && (h & 0x3ff)) {
+      continue;
+    }
+    EXPECT_EQ(h, caffe_float_to_fp16(caffe_fp16_to_float(h)));
+  }
+  EXPECT_EQ(std::pow(2.f, -24), caffe_fp16_to_float(0x0001));
+  EXPECT_EQ(-65504.f, caffe_fp16_to_float(0xfbff));
+}
+
+TEST(HalfTest, TestBF16Conversion) {
+  EXPECT_EQ(0x3f80, caffe_float_to_bf16(1.f));
+  EXPECT_EQ(0xc000, caffe_float_to_bf16(-2.f));
+  EXPECT_EQ(1.f, caffe_bf16_to_float(0x3f80));
+  // Ties round to even.
+  EXPECT_EQ(0x3f80, caffe_float_to_bf16(1.f + std::pow(2.f, -8)));
+  EXPECT_EQ(0x3f82, caffe_float_to_bf16(1.f + 3 * std::pow(2.f, -8)));
+  EXPECT_EQ(0x7f80, caffe_float_to_bf16(std::numeric_limits<float>::max()));
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float bf16_nan = caffe_bf16_to_float(caffe_float_to_bf16(nan));
+  EXPECT_NE(bf16_nan, bf16_nan);
+  for (int h = 0; h < 65536; ++h) {
+    if ((h & 0x7f80) == 0x7f80 && (h & 0x7f)) {
+      continue;
+    }
+    EXPECT_EQ(h, caffe_float_to_bf16(caffe_bf16_to_float(h)));
+  }
+}
+
+template <typename Dtype>
+class HalfGemmTest : public ::testing::Test {};
+
+TYPED_TEST_CASE(HalfGemmTest, TestDtypes);
+
+// The 16-bit product equals the BLAS one on the widened matrices, also for
+// sizes that end within a block.
+TYPED_TEST(HalfGemmTest, TestGemm) {
+  const int M = 5;
+  const int N = 300;
+  const int K = 270;
+  const LayerParameter_StoragePrecision precisions[] = {
+      LayerParameter_StoragePrecision_FP16,
+      LayerParameter_StoragePrecision_BF16 };
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  Blob<TypeParam> a(1, 1, M, K);
+  Blob<TypeParam> b(1, 1, K, N);
+  filler.Fill(&a);
+  filler.Fill(&b);
+  for (int p = 0; p < 2; ++p) {
+    for (int trans = 0; trans < 2; ++trans) {
+      const CBLAS_TRANSPOSE trans_b = trans ? CblasTrans : CblasNoTrans;
+      std::vector<uint16_t> a_half(a.count());
+      std::vector<uint16_t> b_half(b.count());
+      caffe_cpu_narrow(precisions[p], a.count(), a.cpu_data(), &a_half[0]);
+      caffe_cpu_narrow(precisions[p], b.count(), b.cpu_data(), &b_half[0]);
+      Blob<TypeParam> a_wide(a.shape());
+      Blob<TypeParam> b_wide(b.shape());
+      caffe_cpu_widen(precisions[p], a.count(), &a_half[0],
+          a_wide.mutable_cpu_data());
+      caffe_cpu_widen(precisions[p], b.count(), &b_half[0],
+          b_wide.mutable_cpu_data());
+      Blob<TypeParam> expected(1, 1, M, N);
+      caffe_cpu_gemm<TypeParam>(CblasNoTrans, trans_b, M, N, K, 1,
+          a_wide.cpu_data(), b_wide.cpu_data(), 0, expected.mutable_cpu_data());
+      Blob<TypeParam> half_a(1, 1, M, N);
+      Blob<TypeParam> float_a(1, 1, M, N);
+      caffe_cpu_gemm_half(precisions[p], trans_b, M, N, K, &a_half[0],
+          &b_half[0], half_a.mutable_cpu_data());
+      caffe_cpu_gemm_half(precisions[p], trans_b, M, N, K, a_wide.cpu_data(),
+          &b_half[0], float_a.mutable_cpu_data());
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(expected.cpu_data()[i], half_a.cpu_data()[i], 1e-4);
+        EXPECT_NEAR(expected.cpu_data()[i], float_a.cpu_data()[i], 1e-4);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -133,4 +133,88 @@ TYPED_TEST(HDF5DataLayerTest, TestRead) {
   }
 }
 
+// Reading in chunks of 3 rows gives the same rows as reading whole files.
+TYPED_TEST(HDF5DataLayerTest, TestReadChunks) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 4;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_rows(3);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_data_->num(), batch_size);
+
+  // Go through both files twice (10 batches of 4 rows).
+  const int data_size = this->blob_top_data_->count(1);
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < batch_size; ++i) {
+      const int row = (iter * batch_size + i) % 20;
+      const int file_offset = row < 10 ? 0 : 2400;
+      // NB: label is 1-indexed
+      EXPECT_EQ(row % 10 + 1, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(row % 10 + 2, this->blob_top_label2_->cpu_data()[i]);
+      for (int j = 0; j < data_size; ++j) {
+        EXPECT_EQ(file_offset + (row % 10) * data_size + j,
+            this->blob_top_data_->cpu_data()[i * data_size + j])
+            << "debug: iter " << iter << " i " << i << " j " << j;
+      }
+    }
+  }
+}
+
+// Shuffled chunks still output every row of a file once before moving on
+// to the next file, with the rows of all the tops kept together.
+TYPED_TEST(HDF5DataLayerTest, TestShuffleChunks) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  param.add_top("label2");
+
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  int batch_size = 5;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_source(*(this->filename));
+  hdf5_data_param->set_chunk_rows(3);
+  hdf5_data_param->set_shuffle(true);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+
+  const int data_size = this->blob_top_data_->count(1);
+  for (int file = 0; file < 4; ++file) {
+    vector<int> seen(10, 0);
+    int file_offset = -1;
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < batch_size; ++i) {
+        const int label = this->blob_top_label_->cpu_data()[i];
+        ASSERT_GE(label, 1);
+        ASSERT_LE(label, 10);
+        ++seen[label - 1];
+        EXPECT_EQ(label + 1, this->blob_top_label2_->cpu_data()[i]);
+        const Dtype* data = this->blob_top_data_->cpu_data() + i * data_size;
+        const int offset = data[0] - (label - 1) * data_size;
+        EXPECT_TRUE(offset == 0 || offset == 2400);
+        if (file_offset < 0) {
+          file_offset = offset;
+        }
+        EXPECT_EQ(file_offset, offset);
+        for (int j = 0; j < data_size; ++j) {
+          EXPECT_EQ(offset + (label - 1) * data_size + j, data[j]);
+        }
+      }
+    }
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_EQ(1, seen[i]) << "debug: file " << file << " label " << i + 1;
+    }
+  }
+}
+
 }  // namespace caffe
@@ -0,0 +1,115 @@
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class PoolHostAllocatorTest : public ::testing::Test {
+ protected:
+  PoolHostAllocator pool_;
+};
+
+TEST_F(PoolHostAllocatorTest, TestSizeClasses) {
+  EXPECT_EQ(0, PoolHostAllocator::SizeClass(1));
+  EXPECT_EQ(64, PoolHostAllocator::ClassSize(0));
+  EXPECT_EQ(80, PoolHostAllocator::ClassSize(PoolHostAllocator::SizeClass(65)));
+  EXPECT_EQ(128,
+      PoolHostAllocator::ClassSize(PoolHostAllocator::SizeClass(128)));
+  EXPECT_EQ(160,
+      PoolHostAllocator::ClassSize(PoolHostAllocator::SizeClass(129)));
+  for (size_t size = 1; size < (64 << 20); size = size * 9 / 8 + 1) {
+    const int size_class = PoolHostAllocator::SizeClass(size);
+    const size_t class_size = PoolHostAllocator::ClassSize(size_class);
+    EXPECT_GE(class_size, size);
+    EXPECT_LE(class_size, std::max<size_t>(64, size + size / 4));
+    if (size_class > 0) {
+      EXPECT_LT(PoolHostAllocator::ClassSize(size_class - 1), size);
+    }
+  }
+}
+
+TEST_F(PoolHostAllocatorTest, TestReuse) {
+  void* small = pool_.Allocate(1000);
+  void* large = pool_.Allocate(3 << 20);
+  ASSERT_TRUE(small);
+  ASSERT_TRUE(large);
+  memset(small, 1, 1000);
+  memset(large, 1, 3 << 20);
+  EXPECT_EQ(0, reinterpret_cast<size_t>(large) % PoolHostAllocator::kSlabSize);
+  pool_.Free(small, 1000);
+  pool_.Free(large, 3 << 20);
+  // The same classes come back from the free lists.
+  EXPECT_EQ(small, pool_.Allocate(1010));
+  EXPECT_EQ(large, pool_.Allocate((3 << 20) - 100));
+  const HostAllocatorStats stats = pool_.stats();
+  EXPECT_EQ(4, stats.allocations);
+  EXPECT_EQ(2, stats.frees);
+  EXPECT_EQ(1010 + (3 << 20) - 100, stats.bytes_in_use);
+  EXPECT_EQ(1000 + (3 << 20), stats.high_water_mark);
+  pool_.Free(small, 1010);
+  pool_.Free(large, (3 << 20) - 100);
+}
+
+TEST_F(PoolHostAllocatorTest, TestTrim) {
+  const size_t large_size = PoolHostAllocator::kMaxSlabClass * 2;
+  void* small = pool_.Allocate(100);
+  void* large = pool_.Allocate(large_size);
+  const size_t reserved = pool_.stats().bytes_reserved;
+  EXPECT_EQ(PoolHostAllocator::kSlabSize + large_size, reserved);
+  pool_.Free(small, 100);
+  pool_.Free(large, large_size);
+  EXPECT_EQ(reserved, pool_.stats().bytes_reserved);
+  EXPECT_EQ(0, pool_.stats().bytes_in_use);
+  pool_.Trim();
+  EXPECT_EQ(PoolHostAllocator::kSlabSize, pool_.stats().bytes_reserved);
+}
+
+void AllocateAndFree(PoolHostAllocator* pool, int seed) {
+  std::vector<std::pair<void*, size_t> > blocks;
+  for (int i = 0; i < 1000; ++i) {
+    const size_t size = 1 + (i * 7919 + seed * 104729) % 20000;
+    void* ptr = pool->Allocate(size);
+    memset(ptr, seed, size);
+    blocks.push_back(std::make_pair(ptr, size));
+    if (i % 3 == 2) {
+      for (int j = 0; j < blocks.size(); ++j) {
+        const unsigned char* data =
+            static_cast<const unsigned char*>(blocks[j].first);
+        EXPECT_EQ(seed, data[0]);
+        EXPECT_EQ(seed, data[blocks[j].second - 1]);
+        pool->Free(blocks[j].first, blocks[j].second);
+      }
+      blocks.clear();
+    }
+  }
+  for (int j = 0; j < blocks.size(); ++j) {
+    pool->Free(blocks[j].first, blocks[j].second);
+  }
+}
+
+TEST_F(PoolHostAllocatorTest, TestThreads) {
+  const int kThreads = 4;
+  std::vector<shared_ptr<boost::thread> > threads;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.push_back(shared_ptr<boost::thread>(
+        new boost::thread(AllocateAndFree, &pool_, i + 1)));
+  }
+  for (int i = 0; i < kThreads; ++i) {
+    threads[i]->join();
+  }
+  const HostAllocatorStats stats = pool_.stats();
+  EXPECT_EQ(kThreads * 1000, stats.allocations);
+  EXPECT_EQ(kThreads * 1000, stats.frees);
+  EXPECT_EQ(0, stats.bytes_in_use);
+}
+
+}  // namespace caffe
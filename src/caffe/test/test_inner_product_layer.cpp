@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -9,6 +11,7 @@
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
+#include "caffe/test/test_precision_check_util.hpp"
 
 namespace caffe {
 
@@ -135,6 +138,57 @@ TYPED_TEST(InnerProductLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardInt8) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;  // The int8 forward pass is CPU only.
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->set_transpose(transpose);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    // Calibrate one range per channel on the bottom itself.
+    vector<Dtype> ranges(3, 0);
+    for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+      Dtype* range = &ranges[i / 20 % 3];
+      *range = std::max(*range, std::fabs(this->blob_bottom_->cpu_data()[i]));
+    }
+    LayerParameter int8_param(layer_param);
+    for (int c = 0; c < 3; ++c) {
+      int8_param.mutable_quantization_param()->add_input_range(ranges[c]);
+    }
+    CheckReducedPrecisionForward<InnerProductLayer>(layer_param, int8_param,
+        0.02, this->blob_bottom_vec_);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardHalf) {
+  if (Caffe::mode() != Caffe::CPU) {
+    return;  // The 16-bit forward pass is CPU only.
+  }
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  for (int test = 0; test < 4; ++test) {
+    LayerParameter layer_param;
+    InnerProductParameter* inner_product_param =
+        layer_param.mutable_inner_product_param();
+    inner_product_param->set_num_output(10);
+    inner_product_param->set_transpose(test % 2);
+    inner_product_param->mutable_weight_filler()->set_type("gaussian");
+    inner_product_param->mutable_bias_filler()->set_type("gaussian");
+    LayerParameter half_param(layer_param);
+    half_param.set_storage_precision(test < 2 ?
+        LayerParameter_StoragePrecision_FP16 :
+        LayerParameter_StoragePrecision_BF16);
+    CheckReducedPrecisionForward<InnerProductLayer>(layer_param, half_param,
+        test < 2 ? 0.005 : 0.03, this->blob_bottom_vec_);
+  }
+}
+
 /**
  * @brief Init. an IP layer without transpose + random weights,
  * run Forward, save the result.
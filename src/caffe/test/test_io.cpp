@@ -15,6 +15,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/video_frame_reader.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -529,5 +530,48 @@ TEST_F(IOTest, TestReadVideoToCVMatFromAviResizeAndGrayscale) {
   EXPECT_EQ(cv_imgs[0].cols, 100);
 }
 
+TEST_F(IOTest, TestVideoFrameReaderOverlappingClips) {
+  string path = CMAKE_SOURCE_DIR \
+                "caffe/test/test_data/UCF-101_Rowing_g16_c03.avi";
+  cv::VideoCapture cap(path);
+  std::vector<cv::Mat> expected(24);
+  for (int i = 0; i < expected.size(); ++i) {
+    ASSERT_TRUE(cap.read(expected[i]));
+  }
+  VideoFrameReader reader(0, 0, true, false);
+  ASSERT_TRUE(reader.Open(path));
+  const int starts[] = {0, 4, 8};
+  for (int s = 0; s < 3; ++s) {
+    std::vector<cv::Mat> frames;
+    ASSERT_TRUE(reader.Read(starts[s], 16, 1, &frames));
+    ASSERT_EQ(frames.size(), 16);
+    for (int i = 0; i < frames.size(); ++i) {
+      EXPECT_EQ(cv::norm(frames[i], expected[starts[s] + i], cv::NORM_L1), 0);
+    }
+  }
+  // Every frame is decoded once, without seeking.
+  EXPECT_EQ(reader.decoded_frames(), 24);
+  EXPECT_EQ(reader.seeks(), 0);
+}
+
+TEST_F(IOTest, TestGroupClipsByFile) {
+  std::vector<string> files;
+  std::vector<int> start_frames;
+  files.push_back("b.avi");
+  start_frames.push_back(9);
+  files.push_back("a.avi");
+  start_frames.push_back(1);
+  files.push_back("b.avi");
+  start_frames.push_back(1);
+  files.push_back("a.avi");
+  start_frames.push_back(9);
+  std::vector<int> order = GroupClipsByFile(files, start_frames);
+  ASSERT_EQ(order.size(), 4);
+  EXPECT_EQ(order[0], 2);
+  EXPECT_EQ(order[1], 0);
+  EXPECT_EQ(order[2], 1);
+  EXPECT_EQ(order[3], 3);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
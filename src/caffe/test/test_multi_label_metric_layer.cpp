@@ -0,0 +1,161 @@
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/multi_label_metric_layer.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Four samples of two classes. Class 0 ranks +, -, +, - (AP (1 + 2/3) / 2)
+// and class 1 ranks +, +, -, - (AP 1). At 0.5, class 0 has one true
+// positive, one false positive and one false negative (F1 0.5) and class 1
+// two true positives (F1 1), so micro F1 is 6 / 8.
+static const float kScores[] = {0.9, 0.2, 0.8, 0.6, 0.3, 0.7, 0.1, 0.05};
+static const float kLabels[] = {1, 0, 0, 1, 1, 1, 0, 0};
+
+template <typename Dtype>
+class MultiLabelMetricLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  MultiLabelMetricLayerTest()
+      : blob_bottom_score_(new Blob<Dtype>()),
+        blob_bottom_label_(new Blob<Dtype>()) {
+    blob_bottom_vec_.push_back(blob_bottom_score_);
+    blob_bottom_vec_.push_back(blob_bottom_label_);
+    for (int i = 0; i < 4; ++i) {
+      blob_top_vec_.push_back(new Blob<Dtype>());
+    }
+    layer_param_.mutable_multi_label_metric_param()->set_apply_sigmoid(false);
+    layer_param_.mutable_multi_label_metric_param()->set_num_bins(100);
+  }
+
+  virtual ~MultiLabelMetricLayerTest() {
+    delete blob_bottom_score_;
+    delete blob_bottom_label_;
+    for (int i = 0; i < blob_top_vec_.size(); ++i) {
+      delete blob_top_vec_[i];
+    }
+  }
+
+  // Fills the bottoms with num samples of kScores from sample begin.
+  void FillBottoms(int begin, int num, bool logits) {
+    vector<int> shape(2);
+    shape[0] = num;
+    shape[1] = 2;
+    blob_bottom_score_->Reshape(shape);
+    blob_bottom_label_->Reshape(shape);
+    for (int i = 0; i < num * 2; ++i) {
+      const Dtype p = kScores[begin * 2 + i];
+      blob_bottom_score_->mutable_cpu_data()[i] =
+          logits ? std::log(p / (1 - p)) : p;
+      blob_bottom_label_->mutable_cpu_data()[i] = kLabels[begin * 2 + i];
+    }
+  }
+
+  // Checks the means of the outputs of passes passes, summed in sums.
+  void CheckMetrics(const vector<Dtype>& sums, int passes) {
+    EXPECT_NEAR((1. + (1. + 2. / 3) / 2) / 2, sums[0] / passes, 1e-4);
+    EXPECT_NEAR(0.75, sums[1] / passes, 1e-4);
+    EXPECT_NEAR(0.75, sums[2] / passes, 1e-4);
+    EXPECT_NEAR((1. + 2. / 3) / 2, sums[3] / passes, 1e-4);
+    EXPECT_NEAR(1., sums[4] / passes, 1e-4);
+  }
+
+  // Adds the outputs of the last pass to sums.
+  void AddOutputs(vector<Dtype>* sums) {
+    sums->resize(5, 0);
+    for (int i = 0; i < 3; ++i) {
+      (*sums)[i] += blob_top_vec_[i]->cpu_data()[0];
+    }
+    for (int c = 0; c < 2; ++c) {
+      (*sums)[3 + c] += blob_top_vec_[3]->cpu_data()[c];
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_score_;
+  Blob<Dtype>* const blob_bottom_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  LayerParameter layer_param_;
+};
+
+TYPED_TEST_CASE(MultiLabelMetricLayerTest, TestDtypes);
+
+TYPED_TEST(MultiLabelMetricLayerTest, TestSetup) {
+  this->FillBottoms(0, 4, false);
+  MultiLabelMetricLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(0, this->blob_top_vec_[i]->num_axes());
+  }
+  EXPECT_EQ(1, this->blob_top_vec_[3]->num_axes());
+  EXPECT_EQ(2, this->blob_top_vec_[3]->shape(0));
+}
+
+TYPED_TEST(MultiLabelMetricLayerTest, TestForward) {
+  this->FillBottoms(0, 4, false);
+  MultiLabelMetricLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  vector<TypeParam> sums;
+  this->AddOutputs(&sums);
+  this->CheckMetrics(sums, 1);
+}
+
+TYPED_TEST(MultiLabelMetricLayerTest, TestForwardLogits) {
+  this->layer_param_.mutable_multi_label_metric_param()->set_apply_sigmoid(
+      true);
+  this->FillBottoms(0, 4, true);
+  MultiLabelMetricLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  vector<TypeParam> sums;
+  this->AddOutputs(&sums);
+  this->CheckMetrics(sums, 1);
+}
+
+// The mean of the outputs over the passes of a test is the metric over all
+// their samples, and a reset starts over.
+TYPED_TEST(MultiLabelMetricLayerTest, TestStreaming) {
+  this->FillBottoms(0, 1, false);
+  MultiLabelMetricLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int test = 0; test < 2; ++test) {
+    layer.ResetStatistics();
+    vector<TypeParam> sums;
+    const int begins[] = {0, 1, 3};
+    const int nums[] = {1, 2, 1};
+    for (int pass = 0; pass < 3; ++pass) {
+      this->FillBottoms(begins[pass], nums[pass], false);
+      layer.Reshape(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      this->AddOutputs(&sums);
+    }
+    this->CheckMetrics(sums, 3);
+  }
+}
+
+// Over a long test the outputs keep the precision of the metrics, though
+// each is the difference of two large multiples of them.
+TYPED_TEST(MultiLabelMetricLayerTest, TestManyPasses) {
+  this->FillBottoms(0, 4, false);
+  MultiLabelMetricLayer<TypeParam> layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The same samples every pass, so the metrics do not change.
+  for (int pass = 0; pass < 10000; ++pass) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  }
+  const vector<TypeParam> metrics = layer.Metrics();
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NEAR(metrics[i], this->blob_top_vec_[i]->cpu_data()[0], 1e-6);
+  }
+  for (int c = 0; c < 2; ++c) {
+    EXPECT_NEAR(metrics[3 + c], this->blob_top_vec_[3]->cpu_data()[c], 1e-6);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,122 @@
+#ifdef USE_OPENCV
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/multi_label_video_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class MultiLabelVideoDataLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  MultiLabelVideoDataLayerTest()
+      : seed_(1701),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    // Create test input file.
+    MakeTempFilename(&filename_);
+    std::ofstream outfile(filename_.c_str(), std::ofstream::out);
+    LOG(INFO) << "Using temporary file " << filename_;
+    for (int i = 0; i < 5; ++i) {
+      outfile <<
+        CMAKE_SOURCE_DIR "caffe/test/test_data/UCF-101_Rowing_g16_c03.avi " <<
+        2 * i << " " << i << "," << 4 - i << "\n";
+    }
+    outfile.close();
+  }
+
+  virtual ~MultiLabelVideoDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  // Loads num_batches batches with random crops and mirrors, decoding on
+  // num_workers threads, and appends their data and labels to data.
+  void LoadBatches(int num_workers, int num_batches, vector<Dtype>* data) {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    MultiLabelVideoDataParameter* video_param =
+        param.mutable_multi_label_video_data_param();
+    video_param->set_batch_size(3);
+    video_param->set_new_length(4);
+    video_param->set_new_height(48);
+    video_param->set_new_width(64);
+    video_param->set_source(filename_.c_str());
+    video_param->set_num_workers(num_workers);
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_crop_size(32);
+    transform_param->set_mirror(true);
+    Caffe::set_random_seed(seed_);
+    MultiLabelVideoDataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < num_batches; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      data->insert(data->end(), blob_top_data_->cpu_data(),
+          blob_top_data_->cpu_data() + blob_top_data_->count());
+      data->insert(data->end(), blob_top_label_->cpu_data(),
+          blob_top_label_->cpu_data() + blob_top_label_->count());
+    }
+  }
+
+  int seed_;
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(MultiLabelVideoDataLayerTest, TestDtypes);
+
+TYPED_TEST(MultiLabelVideoDataLayerTest, TestRead) {
+  LayerParameter param;
+  MultiLabelVideoDataParameter* video_param =
+      param.mutable_multi_label_video_data_param();
+  video_param->set_batch_size(5);
+  video_param->set_new_length(4);
+  video_param->set_source(this->filename_.c_str());
+  MultiLabelVideoDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_data_->shape(0), 5);
+  EXPECT_EQ(this->blob_top_data_->shape(1), 3);
+  EXPECT_EQ(this->blob_top_data_->shape(2), 4);
+  EXPECT_EQ(this->blob_top_data_->shape(3), 240);
+  EXPECT_EQ(this->blob_top_data_->shape(4), 320);
+  EXPECT_EQ(this->blob_top_label_->shape(0), 5);
+  EXPECT_EQ(this->blob_top_label_->shape(1), 2);
+  // Go through the data twice
+  for (int iter = 0; iter < 2; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(i, this->blob_top_label_->cpu_data()[2 * i]);
+      EXPECT_EQ(4 - i, this->blob_top_label_->cpu_data()[2 * i + 1]);
+    }
+  }
+}
+
+TYPED_TEST(MultiLabelVideoDataLayerTest, TestWorkersMatchSerial) {
+  // Batches of 3 from a list of 5, so the second batch wraps around.
+  vector<TypeParam> serial;
+  this->LoadBatches(1, 3, &serial);
+  vector<TypeParam> parallel;
+  this->LoadBatches(3, 3, &parallel);
+  ASSERT_EQ(serial.size(), parallel.size());
+  for (int i = 0; i < serial.size(); ++i) {
+    EXPECT_EQ(serial[i], parallel[i]);
+  }
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
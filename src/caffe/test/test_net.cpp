@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <string>
 #include <utility>
 #include <vector>
@@ -67,6 +70,207 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // A TEST chain of inner products, whose activations can share memory.
+  virtual void InitInferenceChainNet() {
+    string proto =
+        "name: 'InferenceChain' "
+        "state { phase: TEST } "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 10 } "
+        "    data_filler { type: 'gaussian' std: 1 } "
+        "  } "
+        "  top: 'data' "
+        "} "
+        "layer { "
+        "  name: 'ip1' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'ip1' "
+        "  top: 'ip1' "
+        "} "
+        "layer { "
+        "  name: 'ip2' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'ip1' "
+        "  top: 'ip2' "
+        "} "
+        "layer { "
+        "  name: 'ip3' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'ip2' "
+        "  top: 'ip3' "
+        "} "
+        "layer { "
+        "  name: 'ip4' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 10 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } "
+        "  } "
+        "  bottom: 'ip3' "
+        "  top: 'ip4' "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  // Two convolutions of type conv_type over a 5-D input: conv1 with a bias
+  // and BatchNorm, Scale and ReLU in place, conv2 without a bias and with
+  // BatchNorm and ReLU into their own blob bn2.
+  virtual void InitFusableNet(const string& conv_type, const bool fuse) {
+    const string conv_param = conv_type == "Convolution3D" ?
+        "  convolution3D_param { "
+        "    num_output: 4 kernel_size: 3 kernel_depth: 3 pad: 1 "
+        "    temporal_pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } " :
+        "  convolution_param { "
+        "    num_output: 4 kernel_size: 3 pad: 1 "
+        "    weight_filler { type: 'gaussian' std: 0.3 } "
+        "    bias_filler { type: 'gaussian' std: 0.3 } ";
+    const string proto =
+        "name: 'FusableNetwork' "
+        "state { phase: TEST } "
+        "fuse_layers: " + string(fuse ? "true " : "false ") +
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 dim: 5 } } "
+        "  top: 'data' "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: '" + conv_type + "' " + conv_param + "} "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'bn1' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'scale1' "
+        "  type: 'Scale' "
+        "  scale_param { bias_term: true } "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: '" + conv_type + "' " + conv_param + " bias_term: false } "
+        "  bottom: 'conv1' "
+        "  top: 'conv2' "
+        "} "
+        "layer { "
+        "  name: 'bn2' "
+        "  type: 'BatchNorm' "
+        "  bottom: 'conv2' "
+        "  top: 'bn2' "
+        "} "
+        "layer { "
+        "  name: 'relu2' "
+        "  type: 'ReLU' "
+        "  bottom: 'bn2' "
+        "  top: 'bn2' "
+        "} ";
+    InitNetFromProtoString(proto);
+  }
+
+  // Checks that the fused FusableNet computes what the unfused one does with
+  // the same trained weights, copied from a proto or an HDF5 file.
+  void TestFuseLayers(const string& conv_type, const bool hdf5) {
+    Caffe::set_random_seed(this->seed_);
+    InitFusableNet(conv_type, false);
+    FillerParameter filler_param;
+    filler_param.set_std(0.5);
+    GaussianFiller<Dtype> gaussian_filler(filler_param);
+    filler_param.set_min(0.5);
+    filler_param.set_max(2);
+    UniformFiller<Dtype> uniform_filler(filler_param);
+    const char* batch_norms[] = {"bn1", "bn2"};
+    for (int i = 0; i < 2; ++i) {
+      const vector<shared_ptr<Blob<Dtype> > >& blobs =
+          net_->layer_by_name(batch_norms[i])->blobs();
+      gaussian_filler.Fill(blobs[0].get());
+      uniform_filler.Fill(blobs[1].get());
+      blobs[2]->mutable_cpu_data()[0] = 2;
+    }
+    const vector<shared_ptr<Blob<Dtype> > >& scale_blobs =
+        net_->layer_by_name("scale1")->blobs();
+    gaussian_filler.Fill(scale_blobs[0].get());
+    gaussian_filler.Fill(scale_blobs[1].get());
+    Blob<Dtype> data(net_->blob_by_name("data")->shape());
+    gaussian_filler.Fill(&data);
+    net_->blob_by_name("data")->CopyFrom(data);
+    net_->Forward();
+    Blob<Dtype> expected;
+    expected.CopyFrom(*net_->blob_by_name("bn2"), false, true);
+    NetParameter trained;
+    net_->ToProto(&trained);
+    string filename;
+    if (hdf5) {
+      MakeTempFilename(&filename);
+      net_->ToHDF5(filename);
+    }
+
+    InitFusableNet(conv_type, true);
+    ASSERT_EQ(3, net_->layers().size());
+    EXPECT_EQ("conv2", net_->layer_names()[2]);
+    EXPECT_FALSE(net_->has_blob("conv2"));
+    if (hdf5) {
+      net_->CopyTrainedLayersFromHDF5(filename);
+    } else {
+      net_->CopyTrainedLayersFrom(trained);
+    }
+    net_->blob_by_name("data")->CopyFrom(data);
+    net_->Forward();
+    const Blob<Dtype>& output = *net_->blob_by_name("bn2");
+    ASSERT_EQ(expected.count(), output.count());
+    int num_zeros = 0;
+    for (int i = 0; i < output.count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], output.cpu_data()[i],
+          1e-4 * std::max(Dtype(1), std::fabs(expected.cpu_data()[i])));
+      num_zeros += output.cpu_data()[i] == 0;
+    }
+    // The ReLU had something to clamp.
+    EXPECT_GT(num_zeros, 0);
+    EXPECT_LT(num_zeros, output.count());
+    if (hdf5) {
+      remove(filename.c_str());
+    }
+  }
+
   virtual void InitTinyNet(const bool force_backward = false,
                            const bool accuracy_layer = false) {
     string proto =
@@ -2601,4 +2805,54 @@ TYPED_TEST(NetTest, TestAllInOneNetDeploy) {
   ASSERT_TRUE(found_data);
 }
 
+TYPED_TEST(NetTest, TestPlanInferenceMemory) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_random_seed(this->seed_);
+  this->InitInferenceChainNet();
+  this->net_->Forward();
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->net_->blob_by_name("ip4"), false, true);
+  // ip1 is dead once ip2 is computed, so ip3 can reuse its memory; the data
+  // and the output ip4 keep theirs.
+  const size_t saved = this->net_->PlanInferenceMemory(vector<string>());
+  EXPECT_EQ(20 * sizeof(Dtype), saved);
+  EXPECT_EQ(this->net_->blob_by_name("ip1")->data(),
+            this->net_->blob_by_name("ip3")->data());
+  EXPECT_NE(this->net_->blob_by_name("ip1")->data(),
+            this->net_->blob_by_name("ip2")->data());
+  EXPECT_NE(this->net_->blob_by_name("data")->data(),
+            this->net_->blob_by_name("ip3")->data());
+  // The DummyData refills data with the same seed.
+  Caffe::set_random_seed(this->seed_);
+  this->InitInferenceChainNet();
+  this->net_->PlanInferenceMemory(vector<string>());
+  this->net_->Forward();
+  const Blob<Dtype>& output = *this->net_->blob_by_name("ip4");
+  ASSERT_EQ(expected.count(), output.count());
+  for (int i = 0; i < output.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], output.cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestPlanInferenceMemoryPreserved) {
+  this->InitInferenceChainNet();
+  vector<string> preserved(1, "ip1");
+  EXPECT_EQ(0, this->net_->PlanInferenceMemory(preserved));
+  EXPECT_NE(this->net_->blob_by_name("ip1")->data(),
+            this->net_->blob_by_name("ip3")->data());
+  this->net_->Forward();
+}
+
+TYPED_TEST(NetTest, TestFuseLayers) {
+  this->TestFuseLayers("Convolution", false);
+}
+
+TYPED_TEST(NetTest, TestFuseLayers3D) {
+  this->TestFuseLayers("Convolution3D", false);
+}
+
+TYPED_TEST(NetTest, TestFuseLayersHDF5) {
+  this->TestFuseLayers("Convolution3D", true);
+}
+
 }  // namespace caffe
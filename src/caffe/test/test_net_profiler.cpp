@@ -0,0 +1,150 @@
+#include <cstdio>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_profiler.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class NetProfilerTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+ protected:
+  virtual void SetUp() {
+    const string proto =
+        "name: 'ProfiledNetwork' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'DummyData' "
+        "  dummy_data_param { "
+        "    shape { dim: 2 dim: 3 dim: 8 dim: 8 } "
+        "    shape { dim: 2 } "
+        "    data_filler { type: 'gaussian' std: 1 } "
+        "    data_filler { type: 'constant' value: 0 } "
+        "  } "
+        "  top: 'data' "
+        "  top: 'label' "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'pool' "
+        "  type: 'Pooling' "
+        "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+        "  bottom: 'conv' "
+        "  top: 'pool' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'pool' "
+        "  top: 'ip' "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'ip' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    net_.reset(new Net<Dtype>(param));
+    profiler_.reset(new NetProfiler<Dtype>(*net_));
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+  shared_ptr<NetProfiler<Dtype> > profiler_;
+};
+
+TYPED_TEST_CASE(NetProfilerTest, TestDtypesAndDevices);
+
+TYPED_TEST(NetProfilerTest, TestLayerFlops) {
+  // conv: 2x4x6x6 outputs of 3x3x3 multiply-adds, with the weight gradient
+  // only in backward since the data needs none.
+  EXPECT_EQ(2 * 288 * 27, this->profiler_->LayerFlops(1, false));
+  EXPECT_EQ(2 * 288 * 27, this->profiler_->LayerFlops(1, true));
+  // pool: 2x4x3x3 windows of 2x2.
+  EXPECT_EQ(72 * 4, this->profiler_->LayerFlops(2, false));
+  EXPECT_EQ(72 * 4, this->profiler_->LayerFlops(2, true));
+  // ip: 2x5 outputs of 36 multiply-adds, weights and data gradients.
+  EXPECT_EQ(2 * 10 * 36, this->profiler_->LayerFlops(3, false));
+  EXPECT_EQ(2 * 2 * 10 * 36, this->profiler_->LayerFlops(3, true));
+  EXPECT_EQ(0, this->profiler_->LayerFlops(4, false));
+}
+
+TYPED_TEST(NetProfilerTest, TestRecord) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->net_->set_profiler(this->profiler_.get());
+  const int kIterations = 3;
+  for (int i = 0; i < kIterations; ++i) {
+    this->net_->Forward();
+    this->net_->Backward();
+  }
+  this->net_->set_profiler(NULL);
+  this->net_->Forward();
+  for (int i = 0; i < this->net_->layers().size(); ++i) {
+    EXPECT_EQ(kIterations, this->profiler_->calls(i, false));
+    EXPECT_EQ(kIterations * this->profiler_->LayerFlops(i, false),
+        this->profiler_->flops(i, false));
+    EXPECT_LE(this->profiler_->Percentile(i, false, 50),
+        this->profiler_->Percentile(i, false, 100));
+  }
+  // The data layer needs no backward.
+  EXPECT_EQ(0, this->profiler_->calls(0, true));
+  EXPECT_EQ(kIterations, this->profiler_->calls(1, true));
+  // conv forward reads data and weights and writes its output.
+  EXPECT_EQ(kIterations * sizeof(Dtype) * (384 + 108 + 4),
+      this->profiler_->bytes_read(1, false));
+  EXPECT_EQ(kIterations * sizeof(Dtype) * 288,
+      this->profiler_->bytes_written(1, false));
+}
+
+TYPED_TEST(NetProfilerTest, TestWrite) {
+  this->net_->set_profiler(this->profiler_.get());
+  this->net_->Forward();
+  this->net_->Backward();
+  this->net_->set_profiler(NULL);
+  string filename;
+  MakeTempFilename(&filename);
+  this->profiler_->WriteJSON(filename);
+  std::stringstream json;
+  json << std::ifstream(filename.c_str()).rdbuf();
+  EXPECT_NE(string::npos, json.str().find("\"net\": \"ProfiledNetwork\""));
+  EXPECT_NE(string::npos, json.str().find("\"name\": \"conv\""));
+  EXPECT_NE(string::npos, json.str().find("\"p99_ms\""));
+  EXPECT_NE(string::npos, json.str().find("\"gflops_per_s\""));
+  this->profiler_->WriteChromeTrace(filename);
+  std::stringstream trace;
+  trace << std::ifstream(filename.c_str()).rdbuf();
+  EXPECT_NE(string::npos, trace.str().find("\"traceEvents\""));
+  EXPECT_NE(string::npos, trace.str().find(
+      "{\"name\": \"ip\", \"cat\": \"backward\", \"ph\": \"X\""));
+  remove(filename.c_str());
+}
+
+}  // namespace caffe
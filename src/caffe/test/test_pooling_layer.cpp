@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -403,6 +404,24 @@ TYPED_TEST(PoolingLayerTest, TestSetupPadded) {
   EXPECT_EQ(this->blob_top_->width(), 3);
 }
 
+TYPED_TEST(PoolingLayerTest, TestSetupPaddedOneAxis) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_h(3);
+  pooling_param->set_kernel_w(1);
+  pooling_param->set_stride_h(2);
+  pooling_param->set_stride_w(3);
+  pooling_param->set_pad_h(1);
+  pooling_param->set_pad_w(0);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  PoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->height(), 4);
+  // Padding the height also clips the last region of the width.
+  EXPECT_EQ(this->blob_top_->width(), 2);
+}
+
 TYPED_TEST(PoolingLayerTest, TestSetupGlobalPooling) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -609,6 +628,241 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForward5DPerFrame) {
+  typedef typename TypeParam::Dtype Dtype;
+  // 2-D parameters pool every frame of a 5-axis input on its own, which is
+  // the same as pooling the frames as extra channels of a 4-axis input.
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 3;
+  shape[2] = 4;
+  shape[3] = 6;
+  shape[4] = 5;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  Blob<Dtype> bottom_4d(shape[0], shape[1] * shape[2], shape[3], shape[4]);
+  caffe_copy(bottom_4d.count(), this->blob_bottom_->cpu_data(),
+      bottom_4d.mutable_cpu_data());
+  Blob<Dtype> top_4d;
+  vector<Blob<Dtype>*> bottom_vec_4d(1, &bottom_4d);
+  vector<Blob<Dtype>*> top_vec_4d(1, &top_4d);
+  for (int pool = 0; pool < 2; ++pool) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_kernel_size(3);
+    pooling_param->set_stride(2);
+    pooling_param->set_pad(1);
+    pooling_param->set_pool(pool == 0 ? PoolingParameter_PoolMethod_MAX :
+        PoolingParameter_PoolMethod_AVE);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(5, this->blob_top_->num_axes());
+    EXPECT_EQ(2, this->blob_top_->shape(0));
+    EXPECT_EQ(3, this->blob_top_->shape(1));
+    EXPECT_EQ(4, this->blob_top_->shape(2));
+    EXPECT_EQ(4, this->blob_top_->shape(3));
+    EXPECT_EQ(3, this->blob_top_->shape(4));
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    PoolingLayer<Dtype> layer_4d(layer_param);
+    layer_4d.SetUp(bottom_vec_4d, top_vec_4d);
+    layer_4d.Forward(bottom_vec_4d, top_vec_4d);
+    ASSERT_EQ(top_4d.count(), this->blob_top_->count());
+    for (int i = 0; i < top_4d.count(); ++i) {
+      EXPECT_EQ(top_4d.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestSetupNd) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->mutable_kernel_shape()->add_dim(1);
+  pooling_param->mutable_kernel_shape()->add_dim(3);
+  pooling_param->mutable_kernel_shape()->add_dim(3);
+  pooling_param->mutable_stride_shape()->add_dim(1);
+  pooling_param->mutable_stride_shape()->add_dim(2);
+  pooling_param->mutable_stride_shape()->add_dim(2);
+  NdPoolingLayer<Dtype> layer(layer_param);
+  EXPECT_STREQ("NdPooling", layer.type());
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), this->blob_bottom_->num());
+  EXPECT_EQ(this->blob_top_->channels(), this->blob_bottom_->channels());
+  EXPECT_EQ(this->blob_top_->length(), 1);
+  EXPECT_EQ(this->blob_top_->height(), 3);
+  EXPECT_EQ(this->blob_top_->width(), 2);
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 3;
+  shape[2] = 16;
+  shape[3] = 6;
+  shape[4] = 5;
+  this->blob_bottom_->Reshape(shape);
+  pooling_param->mutable_kernel_shape()->set_dim(0, 2);
+  pooling_param->mutable_stride_shape()->set_dim(0, 2);
+  for (int i = 0; i < 3; ++i) {
+    pooling_param->mutable_pad_shape()->add_dim(1);
+  }
+  NdPoolingLayer<Dtype> layer_3d(layer_param);
+  layer_3d.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(5, this->blob_top_->num_axes());
+  EXPECT_EQ(this->blob_top_->shape(0), 2);
+  EXPECT_EQ(this->blob_top_->shape(1), 3);
+  EXPECT_EQ(this->blob_top_->shape(2), 9);
+  EXPECT_EQ(this->blob_top_->shape(3), 4);
+  EXPECT_EQ(this->blob_top_->shape(4), 3);
+}
+
+TYPED_TEST(PoolingLayerTest, TestForwardMaxNd) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Max pooling is separable: 2x2x2 regions are the max of two consecutive
+  // frames pooled with 2x2 regions.
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 3;
+  shape[2] = 4;
+  shape[3] = 6;
+  shape[4] = 5;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(2);
+  pooling_param->set_stride(2);
+  Blob<Dtype> frame_top;
+  vector<Blob<Dtype>*> frame_top_vec(1, &frame_top);
+  PoolingLayer<Dtype> frame_layer(layer_param);
+  frame_layer.SetUp(this->blob_bottom_vec_, frame_top_vec);
+  frame_layer.Forward(this->blob_bottom_vec_, frame_top_vec);
+  layer_param.clear_pooling_param();
+  pooling_param = layer_param.mutable_pooling_param();
+  for (int i = 0; i < 3; ++i) {
+    pooling_param->mutable_kernel_shape()->add_dim(2);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+  }
+  this->blob_top_vec_.push_back(this->blob_top_mask_);
+  NdPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_EQ(2, this->blob_top_->shape(2));
+  ASSERT_EQ(frame_top.shape(3), this->blob_top_->shape(3));
+  ASSERT_EQ(frame_top.shape(4), this->blob_top_->shape(4));
+  const int frame_count = frame_top.count(3);
+  const int volume = this->blob_bottom_->count(2);
+  for (int nc = 0; nc < shape[0] * shape[1]; ++nc) {
+    for (int pl = 0; pl < 2; ++pl) {
+      for (int i = 0; i < frame_count; ++i) {
+        const Dtype* frames = frame_top.cpu_data() + (nc * 4 + pl * 2) *
+            frame_count;
+        const int index = (nc * 2 + pl) * frame_count + i;
+        const Dtype value = this->blob_top_->cpu_data()[index];
+        EXPECT_EQ(std::max(frames[i], frames[frame_count + i]), value);
+        const int mask = this->blob_top_mask_->cpu_data()[index];
+        EXPECT_EQ(value, this->blob_bottom_->cpu_data()[nc * volume + mask]);
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestForwardAvePaddedNd) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  for (int i = 0; i < 3; ++i) {
+    pooling_param->mutable_kernel_shape()->add_dim(3);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+  }
+  pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+  vector<int> shape(5, 1);
+  shape[2] = 3;
+  shape[3] = 3;
+  shape[4] = 3;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  filler_param.set_value(Dtype(2));
+  ConstantFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  NdPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->shape(), this->blob_bottom_->shape());
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Padding counts towards the region size, as with cuDNN.
+  Dtype epsilon = 1e-5;
+  EXPECT_NEAR(this->blob_top_->cpu_data()[0], 2.0 * 8 / 27, epsilon);
+  EXPECT_NEAR(this->blob_top_->cpu_data()[1], 2.0 * 12 / 27, epsilon);
+  EXPECT_NEAR(this->blob_top_->cpu_data()[4], 2.0 * 18 / 27, epsilon);
+  EXPECT_NEAR(this->blob_top_->cpu_data()[13], 2.0, epsilon);
+  EXPECT_NEAR(this->blob_top_->cpu_data()[26], 2.0 * 8 / 27, epsilon);
+}
+
+TYPED_TEST(PoolingLayerTest, TestGradientMaxNd) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 2;
+  shape[2] = 4;
+  shape[3] = 5;
+  shape[4] = 4;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  for (int kernel_l = 2; kernel_l <= 3; kernel_l++) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->mutable_kernel_shape()->add_dim(kernel_l);
+    pooling_param->mutable_kernel_shape()->add_dim(3);
+    pooling_param->mutable_kernel_shape()->add_dim(3);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+    NdPoolingLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-4, 1e-2);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestGradientAvePaddedNd) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> shape(5);
+  shape[0] = 2;
+  shape[1] = 2;
+  shape[2] = 4;
+  shape[3] = 5;
+  shape[4] = 4;
+  this->blob_bottom_->Reshape(shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  for (int kernel_l = 2; kernel_l <= 3; kernel_l++) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->mutable_kernel_shape()->add_dim(kernel_l);
+    pooling_param->mutable_kernel_shape()->add_dim(3);
+    pooling_param->mutable_kernel_shape()->add_dim(3);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_stride_shape()->add_dim(2);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->mutable_pad_shape()->add_dim(1);
+    pooling_param->set_pool(PoolingParameter_PoolMethod_AVE);
+    NdPoolingLayer<Dtype> layer(layer_param);
+    GradientChecker<Dtype> checker(1e-2, 1e-2);
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+        this->blob_top_vec_);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
@@ -5,6 +5,7 @@
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -517,4 +518,27 @@ TYPED_TEST(RandomNumberGeneratorTest, TestRngUniformTimesUniformGPU) {
 
 #endif
 
+TEST(CounterRngTest, TestStreams) {
+  const int kDraws = 10000;
+  CounterRng rng(1701, 42);
+  CounterRng same(1701, 42);
+  CounterRng other_stream(1701, 43);
+  CounterRng other_seed(1702, 42);
+  int differ_stream = 0;
+  int differ_seed = 0;
+  double sum = 0;
+  for (int i = 0; i < kDraws; ++i) {
+    const uint32_t value = rng();
+    EXPECT_EQ(value, same());
+    differ_stream += value != other_stream();
+    differ_seed += value != other_seed();
+    const uint32_t uniform = CounterRng(1701, i).Uniform(10);
+    EXPECT_LT(uniform, 10u);
+    sum += uniform;
+  }
+  EXPECT_GT(differ_stream, kDraws - 10);
+  EXPECT_GT(differ_seed, kDraws - 10);
+  EXPECT_NEAR(4.5, sum / kDraws, 0.1);
+}
+
 }  // namespace caffe
@@ -0,0 +1,116 @@
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/ring_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+namespace {
+
+// The queue holds pointers; these encode the integer i.
+Datum* Item(intptr_t i) {
+  return reinterpret_cast<Datum*>(i + 1);
+}
+
+intptr_t Value(Datum* item) {
+  return reinterpret_cast<intptr_t>(item) - 1;
+}
+
+void Produce(RingQueue<Datum*>* queue, int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    queue->push(Item(i));
+  }
+}
+
+void Consume(RingQueue<Datum*>* queue, int n, std::vector<int>* seen) {
+  for (int i = 0; i < n; ++i) {
+    ++(*seen)[Value(queue->pop())];
+  }
+}
+
+void PopInterrupted(RingQueue<Datum*>* queue, bool* interrupted) {
+  try {
+    queue->pop();
+  } catch (boost::thread_interrupted&) {
+    *interrupted = true;
+  }
+}
+
+}  // namespace
+
+TEST(RingQueueTest, TestFIFO) {
+  RingQueue<Datum*> queue(3);
+  EXPECT_EQ(4u, queue.capacity());
+  Datum* item;
+  EXPECT_FALSE(queue.try_pop(&item));
+  EXPECT_FALSE(queue.try_peek(&item));
+  // Go around the ring a few times.
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_TRUE(queue.try_push(Item(round * 4 + i)));
+    }
+    EXPECT_FALSE(queue.try_push(Item(-1)));
+    EXPECT_EQ(4u, queue.size());
+    ASSERT_TRUE(queue.try_peek(&item));
+    EXPECT_EQ(round * 4, Value(item));
+    EXPECT_EQ(round * 4, Value(queue.peek()));
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(round * 4 + i, Value(queue.pop()));
+    }
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_FALSE(queue.try_pop(&item));
+  }
+}
+
+// Producers and consumers outnumber the cells, so both sides park; every
+// element comes out exactly once.
+TEST(RingQueueTest, TestProducersConsumers) {
+  const int kThreads = 4;
+  const int kItems = 20000;
+  RingQueue<Datum*> queue(8);
+  std::vector<std::vector<int> > seen(kThreads, std::vector<int>(kItems));
+  std::vector<shared_ptr<boost::thread> > threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&Consume, &queue, kItems / kThreads, &seen[t]))));
+  }
+  for (int t = 0; t < kThreads; ++t) {
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&Produce, &queue, t * kItems / kThreads,
+            (t + 1) * kItems / kThreads))));
+  }
+  for (int t = 0; t < threads.size(); ++t) {
+    threads[t]->join();
+  }
+  for (int i = 0; i < kItems; ++i) {
+    int count = 0;
+    for (int t = 0; t < kThreads; ++t) {
+      count += seen[t][i];
+    }
+    EXPECT_EQ(1, count) << "Item " << i;
+  }
+  EXPECT_EQ(0u, queue.size());
+}
+
+// A thread parked on an empty queue can be stopped like one blocked on a
+// BlockingQueue.
+TEST(RingQueueTest, TestInterrupt) {
+  RingQueue<Datum*> queue(2);
+  bool interrupted = false;
+  boost::thread thread(boost::bind(&PopInterrupted, &queue, &interrupted));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  thread.interrupt();
+  thread.join();
+  EXPECT_TRUE(interrupted);
+}
+
+}  // namespace caffe
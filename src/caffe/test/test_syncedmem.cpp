@@ -50,6 +50,19 @@ TEST_F(SyncedMemoryTest, TestAllocationGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestCPUWriteForOverwrite) {
+  SyncedMemory mem(10);
+  void* cpu_data = mem.mutable_cpu_data_for_overwrite();
+  EXPECT_TRUE(cpu_data);
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+  caffe_memset(mem.size(), 1, cpu_data);
+  // Memory already allocated is kept as is.
+  EXPECT_EQ(cpu_data, mem.mutable_cpu_data_for_overwrite());
+  for (int i = 0; i < mem.size(); ++i) {
+    EXPECT_EQ((static_cast<char*>(cpu_data))[i], 1);
+  }
+}
+
 TEST_F(SyncedMemoryTest, TestCPUWrite) {
   SyncedMemory mem(10);
   void* cpu_data = mem.mutable_cpu_data();
@@ -67,6 +80,22 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  SyncedMemory other(10);
+  EXPECT_NE(mem.version(), other.version());
+  const uint64_t version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), version);
+  mem.mutable_cpu_data();
+  EXPECT_NE(mem.version(), version);
+  const uint64_t written = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), written);
+  mem.mutable_cpu_data_for_overwrite();
+  EXPECT_NE(mem.version(), written);
+}
+
 #ifndef CPU_ONLY  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
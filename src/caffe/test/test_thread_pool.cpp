@@ -0,0 +1,59 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+ public:
+  void Increment(vector<int>* counts, int i) {
+    ++(*counts)[i];
+  }
+  void RunNested(ThreadPool* pool, vector<int>* counts, int i) {
+    pool->Run(4, boost::bind(&ThreadPoolTest::Increment, this,
+        &counts[i], _1));
+  }
+};
+
+TEST_F(ThreadPoolTest, TestRunsEveryIterationOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.num_threads());
+  for (int n = 0; n < 100; n += 7) {
+    vector<int> counts(n, 0);
+    pool.Run(n, boost::bind(&ThreadPoolTest::Increment, this, &counts, _1));
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(1, counts[i]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedRun) {
+  ThreadPool pool(3);
+  vector<vector<int> > counts(10, vector<int>(4, 0));
+  pool.Run(counts.size(), boost::bind(&ThreadPoolTest::RunNested, this,
+      &pool, &counts[0], _1));
+  for (int i = 0; i < counts.size(); ++i) {
+    for (int j = 0; j < 4; ++j) {
+      EXPECT_EQ(1, counts[i][j]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  EXPECT_EQ(1, pool.num_threads());
+  vector<int> counts(5, 0);
+  pool.Run(counts.size(),
+      boost::bind(&ThreadPoolTest::Increment, this, &counts, _1));
+  for (int i = 0; i < counts.size(); ++i) {
+    EXPECT_EQ(1, counts[i]);
+  }
+  EXPECT_GE(ThreadPool::Get().num_threads(), 1);
+}
+
+}  // namespace caffe
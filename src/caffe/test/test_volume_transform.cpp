@@ -0,0 +1,113 @@
+#include <stdint.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/volume_transform.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class VolumeTransformTest : public ::testing::Test {
+ protected:
+  // Transforms a frame of channels x height x width pixels, stored planar or
+  // interleaved, with a crop at (h_off, w_off) and compares against the
+  // scalar definition.
+  void TestFrame(int channels, int height, int width, int h_off, int w_off,
+      int crop_height, int crop_width, bool interleaved, bool mirror,
+      bool use_mean) {
+    vector<uint8_t> data(channels * height * width);
+    for (int i = 0; i < data.size(); ++i) {
+      data[i] = static_cast<uint8_t>(i * 37 + 11);
+    }
+    vector<Dtype> mean(channels * height * width);
+    for (int i = 0; i < mean.size(); ++i) {
+      mean[i] = static_cast<Dtype>(i % 23) / 4;
+    }
+    vector<Dtype> mean_values(channels);
+    for (int c = 0; c < channels; ++c) {
+      mean_values[c] = 100 + c;
+    }
+    const Dtype scale = 0.5;
+    const int channel_stride = interleaved ? 1 : height * width;
+    const int row_stride = interleaved ? width * channels : width;
+    const int pixel_stride = interleaved ? channels : 1;
+    const int out_plane = crop_height * crop_width;
+    vector<Dtype> out(channels * out_plane);
+    transform_frame_cpu<Dtype>(&data[0] + h_off * row_stride
+        + w_off * pixel_stride, channels, crop_height, crop_width,
+        channel_stride, row_stride, pixel_stride, mirror,
+        use_mean ? &mean[h_off * width + w_off] : NULL, height * width, width,
+        use_mean ? NULL : &mean_values[0], scale, &out[0], out_plane);
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < crop_height; ++h) {
+        for (int w = 0; w < crop_width; ++w) {
+          const int y = h_off + h;
+          const int x = w_off + (mirror ? crop_width - 1 - w : w);
+          const Dtype pixel = data[c * channel_stride + y * row_stride
+              + x * pixel_stride];
+          const Dtype expected = (pixel - (use_mean ?
+              mean[(c * height + y) * width + x] : mean_values[c])) * scale;
+          EXPECT_EQ(expected, out[c * out_plane + h * crop_width + w]);
+        }
+      }
+    }
+  }
+};
+
+TYPED_TEST_CASE(VolumeTransformTest, TestDtypes);
+
+TYPED_TEST(VolumeTransformTest, TestPlanar) {
+  this->TestFrame(3, 9, 37, 0, 0, 9, 37, false, false, true);
+}
+
+TYPED_TEST(VolumeTransformTest, TestPlanarCropMirror) {
+  this->TestFrame(3, 9, 40, 2, 3, 5, 33, false, true, true);
+}
+
+TYPED_TEST(VolumeTransformTest, TestInterleavedMeanValues) {
+  this->TestFrame(3, 4, 21, 1, 2, 3, 17, true, false, false);
+}
+
+TYPED_TEST(VolumeTransformTest, TestInterleavedWideMirror) {
+  // Wider than the chunk interleaved rows are gathered in.
+  this->TestFrame(3, 2, 300, 0, 5, 2, 290, true, true, true);
+}
+
+TYPED_TEST(VolumeTransformTest, TestPlaneMeanAndScale) {
+  // One mean per channel and one std per frame of every channel.
+  C3DMultiLabelVideoDataParameter param;
+  param.set_scale(2);
+  for (int c = 0; c < 3; ++c) {
+    param.add_channel_mean(10 * (c + 1));
+  }
+  for (int i = 0; i < 3 * 2; ++i) {
+    param.add_channel_std(i + 1);
+  }
+  vector<TypeParam> plane_mean;
+  vector<TypeParam> plane_scale;
+  GetPlaneMeanAndScale(param, 3, 2, &plane_mean, &plane_scale);
+  ASSERT_EQ(6, plane_mean.size());
+  ASSERT_EQ(6, plane_scale.size());
+  for (int c = 0; c < 3; ++c) {
+    for (int l = 0; l < 2; ++l) {
+      EXPECT_EQ(10 * (c + 1), plane_mean[c * 2 + l]);
+      EXPECT_FLOAT_EQ(2. / (c * 2 + l + 1), plane_scale[c * 2 + l]);
+    }
+  }
+  // Without them, mean_value and scale apply to every plane.
+  param.clear_channel_mean();
+  param.clear_channel_std();
+  param.set_mean_value(100);
+  GetPlaneMeanAndScale(param, 3, 2, &plane_mean, &plane_scale);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(100, plane_mean[i]);
+    EXPECT_EQ(2, plane_scale[i]);
+  }
+}
+
+}  // namespace caffe
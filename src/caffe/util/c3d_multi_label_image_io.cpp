@@ -32,6 +32,10 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/c3d_multi_label_image_io.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/video_frame_reader.hpp"
 #include "caffe/proto/caffe.pb.h"
 
 using std::fstream;
@@ -99,7 +103,8 @@ void BufferToColorImage(const char* buffer, const int height, const int width, c
 
 
 bool ReadVideoToVolumeDatum(const char* filename, const int start_frm, const vector<int>& label,
-		const int length, const int height, const int width, const int sampling_rate, C3DMultiLabelVolumeDatum* datum){
+		const int length, const int height, const int width, const int sampling_rate, C3DMultiLabelVolumeDatum* datum,
+		CounterRng* rng){
 	cv::VideoCapture cap;
 	cv::Mat img, img_origin;
 	char *buffer;
@@ -127,7 +132,7 @@ bool ReadVideoToVolumeDatum(const char* filename, const int start_frm, const vec
 		return false;
 	}
 	if (start_frm < 0){
-		use_start_frm = rand()%(num_of_frames-length*sampling_rate+1);
+		use_start_frm = (rng ? (*rng)() : caffe_rng_rand())%(num_of_frames-length*sampling_rate+1);
 	}
 
 	offset = 0;
@@ -232,6 +237,49 @@ bool ReadImageSequenceToVolumeDatum(const char* img_dir, const int start_frm, co
  	return true;
 }
 
+bool ReadFramesToVolumeDatum(VideoFrameReader* reader, const char* filename, const int start_frm,
+		const vector<int>& label, const int length, const int sampling_rate, C3DMultiLabelVolumeDatum* datum){
+	vector<cv::Mat> frames;
+	unsigned long int channel_size, image_size;
+
+	if (!reader->Open(filename)){
+		return false;
+	}
+	if (reader->is_video_file()){
+		int num_of_frames = reader->num_frames();
+		if (num_of_frames<length*sampling_rate){
+			LOG(INFO) << "not enough frames; having " << num_of_frames;
+			return false;
+		}
+		CHECK_GE(start_frm, 0) << "start frame must be greater or equal to 0";
+		CHECK_LE(start_frm + length * sampling_rate, num_of_frames) << "end frame must less or equal to num of frames";
+	}
+	if (!reader->Read(start_frm, length, sampling_rate, &frames)){
+		LOG(ERROR) << "Could not read " << filename << " at frame " << start_frm;
+		return false;
+	}
+
+	datum->set_channels(3);
+	datum->set_length(length);
+	datum->clear_label();
+	for (int i=0; i < label.size(); ++i ){
+		datum->add_label(label[i]);
+	}
+	datum->clear_float_data();
+	datum->set_height(frames[0].rows);
+	datum->set_width(frames[0].cols);
+	image_size = frames[0].rows * frames[0].cols;
+	channel_size = image_size * length;
+	string* buffer = datum->mutable_data();
+	buffer->resize(channel_size * 3);
+	for (int l=0; l<length; l++){
+		for (int c=0; c<3; c++){
+			ImageChannelToBuffer(&frames[l], &(*buffer)[0] + c * channel_size + l * image_size, c);
+		}
+	}
+ 	return true;
+}
+
 template <>
 bool load_blob_from_binary<float>(const string fn_blob, Blob<float>* blob){
 	FILE *f;
@@ -360,6 +408,43 @@ bool load_blob_from_uint8_binary<double>(const string fn_blob, Blob<double>* blo
 	return true;
 }
 
+template <typename Dtype>
+bool load_blob_from_half_binary(const string fn_blob, Blob<Dtype>* blob,
+		LayerParameter_StoragePrecision precision){
+	FILE *f;
+	f = fopen(fn_blob.c_str(), "rb");
+	if (f==NULL)
+		return false;
+	int n, c, l, w, h;
+	fread(&n, sizeof(int), 1, f);
+	fread(&c, sizeof(int), 1, f);
+	fread(&l, sizeof(int), 1, f);
+	fread(&h, sizeof(int), 1, f);
+	fread(&w, sizeof(int), 1, f);
+
+    vector<int> shape(5);
+    shape[0] = n;
+    shape[1] = c;
+    shape[2] = l;
+    shape[3] = h;
+    shape[4] = w;
+    blob->Reshape(shape);
+
+	int count = n * c * l * h * w;
+	vector<uint16_t> half(count);
+	const bool complete = fread(&half[0], sizeof(uint16_t), count, f) == count;
+	fclose(f);
+	if (!complete)
+		return false;
+	caffe_cpu_widen(precision, count, &half[0], blob->mutable_cpu_data());
+	return true;
+}
+
+template bool load_blob_from_half_binary<float>(const string fn_blob,
+		Blob<float>* blob, LayerParameter_StoragePrecision precision);
+template bool load_blob_from_half_binary<double>(const string fn_blob,
+		Blob<double>* blob, LayerParameter_StoragePrecision precision);
+
 //
 //template <>
 //bool save_blob_to_binary<float>(Blob<float>* blob, const string fn_blob, int num_index) {
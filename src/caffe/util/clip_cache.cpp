@@ -0,0 +1,138 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "caffe/util/clip_cache.hpp"
+
+namespace caffe {
+
+namespace {
+
+const char kMagic[8] = {'C', '3', 'D', 'C', 'L', 'I', 'P', 'S'};
+
+struct ClipCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_clips;
+  uint64_t index_offset;
+};
+
+}  // namespace
+
+const uint32_t ClipCache::kVersion;
+const int ClipCache::kAlignment;
+
+ClipCacheWriter::ClipCacheWriter(const string& filename)
+    : filename_(filename), offset_(0) {
+  file_ = fopen(filename.c_str(), "wb");
+  CHECK(file_) << "Failed to open clip cache " << filename << " for writing";
+  // Placeholder, the real header is written by Close().
+  ClipCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  Write(&header, sizeof(header));
+}
+
+ClipCacheWriter::~ClipCacheWriter() {
+  if (file_) {
+    Close();
+  }
+}
+
+void ClipCacheWriter::Write(const void* data, size_t size) {
+  CHECK_EQ(fwrite(data, 1, size, file_), size)
+      << "Failed to write clip cache " << filename_;
+  offset_ += size;
+}
+
+void ClipCacheWriter::Add(const uint8_t* data, int channels, int length,
+    int height, int width, const vector<int>& labels) {
+  CHECK(file_) << "Clip cache " << filename_ << " is closed";
+  CHECK_GT(channels, 0);
+  CHECK_GT(length, 0);
+  CHECK_GT(height, 0);
+  CHECK_GT(width, 0);
+  const char padding[ClipCache::kAlignment] = {0};
+  Write(padding, (ClipCache::kAlignment - offset_ % ClipCache::kAlignment)
+      % ClipCache::kAlignment);
+
+  ClipCacheEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.offset = offset_;
+  entry.channels = channels;
+  entry.length = length;
+  entry.height = height;
+  entry.width = width;
+  entry.num_labels = labels.size();
+  index_.push_back(entry);
+
+  vector<int32_t> label_data(labels.begin(), labels.end());
+  if (!label_data.empty()) {
+    Write(&label_data[0], label_data.size() * sizeof(int32_t));
+  }
+  Write(data, static_cast<size_t>(channels) * length * height * width);
+}
+
+void ClipCacheWriter::Close() {
+  CHECK(file_) << "Clip cache " << filename_ << " is already closed";
+  const char padding[sizeof(uint64_t)] = {0};
+  Write(padding, (sizeof(uint64_t) - offset_ % sizeof(uint64_t))
+      % sizeof(uint64_t));
+  ClipCacheHeader header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = ClipCache::kVersion;
+  header.num_clips = index_.size();
+  header.index_offset = offset_;
+  if (!index_.empty()) {
+    Write(&index_[0], index_.size() * sizeof(ClipCacheEntry));
+  }
+  CHECK_EQ(fseek(file_, 0, SEEK_SET), 0);
+  CHECK_EQ(fwrite(&header, 1, sizeof(header), file_), sizeof(header))
+      << "Failed to write clip cache " << filename_;
+  CHECK_EQ(fclose(file_), 0) << "Failed to close clip cache " << filename_;
+  file_ = NULL;
+  LOG(INFO) << "Wrote " << index_.size() << " clips (" << offset_
+            << " bytes) to " << filename_;
+}
+
+ClipCache::ClipCache(const string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_GE(fd, 0) << "Failed to open clip cache " << filename;
+  struct stat st;
+  CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat clip cache " << filename;
+  size_ = st.st_size;
+  CHECK_GE(size_, sizeof(ClipCacheHeader)) << filename << " is truncated";
+  void* map = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  CHECK(map != MAP_FAILED) << "Failed to map clip cache " << filename;
+  data_ = static_cast<const uint8_t*>(map);
+
+  const ClipCacheHeader* header =
+      reinterpret_cast<const ClipCacheHeader*>(data_);
+  CHECK_EQ(memcmp(header->magic, kMagic, sizeof(kMagic)), 0)
+      << filename << " is not a clip cache";
+  CHECK_EQ(header->version, kVersion)
+      << "Unsupported clip cache version in " << filename;
+  num_clips_ = header->num_clips;
+  CHECK_LE(header->index_offset + num_clips_ * sizeof(ClipCacheEntry), size_)
+      << filename << " is truncated";
+  index_ = reinterpret_cast<const ClipCacheEntry*>(data_
+      + header->index_offset);
+  for (int i = 0; i < num_clips_; ++i) {
+    CHECK_LE(index_[i].offset + index_[i].num_labels * sizeof(int32_t)
+        + static_cast<uint64_t>(index_[i].channels) * index_[i].length
+        * index_[i].height * index_[i].width, header->index_offset)
+        << "Clip " << i << " of " << filename << " is out of bounds";
+  }
+  LOG(INFO) << "Mapped " << num_clips_ << " clips from " << filename;
+}
+
+ClipCache::~ClipCache() {
+  munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+}  // namespace caffe
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "caffe/util/half.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Columns of C and depth of the blocks of caffe_cpu_gemm_half.
+const int kHalfBlockN = 256;
+const int kHalfBlockK = 256;
+
+inline uint32_t float_bits(const float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline float bits_float(const uint32_t bits) {
+  float x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+template <typename Dtype>
+inline void widen(const StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y) {
+  if (precision == LayerParameter_StoragePrecision_BF16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = bits_float(static_cast<uint32_t>(x[i]) << 16);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = caffe_fp16_to_float(x[i]);
+    }
+  }
+}
+
+inline void gemm(const CBLAS_TRANSPOSE trans_b, const int M, const int N,
+    const int K, const float* A, const int lda, const float* B, const int ldb,
+    const float beta, float* C, const int ldc) {
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, trans_b, M, N, K, 1.f, A, lda, B,
+      ldb, beta, C, ldc);
+}
+
+inline void gemm(const CBLAS_TRANSPOSE trans_b, const int M, const int N,
+    const int K, const double* A, const int lda, const double* B,
+    const int ldb, const double beta, double* C, const int ldc) {
+  cblas_dgemm(CblasRowMajor, CblasNoTrans, trans_b, M, N, K, 1., A, lda, B,
+      ldb, beta, C, ldc);
+}
+
+// Columns [k_begin, k_begin + depth) of A, with their leading dimension.
+template <typename Dtype>
+inline const Dtype* panel(const StoragePrecision precision, const int M,
+    const int K, const int k_begin, const int depth, const Dtype* A,
+    vector<Dtype>* buffer, int* lda) {
+  *lda = K;
+  return A + k_begin;
+}
+
+template <typename Dtype>
+inline const Dtype* panel(const StoragePrecision precision, const int M,
+    const int K, const int k_begin, const int depth, const uint16_t* A,
+    vector<Dtype>* buffer, int* lda) {
+  buffer->resize(static_cast<size_t>(M) * depth);
+  for (int m = 0; m < M; ++m) {
+    widen(precision, depth, A + static_cast<size_t>(m) * K + k_begin,
+        &(*buffer)[static_cast<size_t>(m) * depth]);
+  }
+  *lda = depth;
+  return &(*buffer)[0];
+}
+
+template <typename Dtype, typename TA>
+struct GemmHalfBlock {
+  StoragePrecision precision;
+  CBLAS_TRANSPOSE trans_b;
+  int M, N, K;
+  const TA* A;
+  const uint16_t* B;
+  Dtype* C;
+
+  void operator()(int block) const {
+    const int n_begin = block * kHalfBlockN;
+    const int width = std::min(N, n_begin + kHalfBlockN) - n_begin;
+    vector<Dtype> a_buffer;
+    vector<Dtype> b_buffer(kHalfBlockK * kHalfBlockN);
+    for (int k_begin = 0; k_begin < K; k_begin += kHalfBlockK) {
+      const int depth = std::min(K, k_begin + kHalfBlockK) - k_begin;
+      int lda;
+      const Dtype* a = panel(precision, M, K, k_begin, depth, A, &a_buffer,
+          &lda);
+      if (trans_b == CblasNoTrans) {
+        for (int k = 0; k < depth; ++k) {
+          widen(precision, width,
+              B + static_cast<size_t>(k_begin + k) * N + n_begin,
+              &b_buffer[k * width]);
+        }
+      } else {
+        for (int n = 0; n < width; ++n) {
+          widen(precision, depth,
+              B + static_cast<size_t>(n_begin + n) * K + k_begin,
+              &b_buffer[n * depth]);
+        }
+      }
+      gemm(trans_b, M, width, depth, a, lda, &b_buffer[0],
+          trans_b == CblasNoTrans ? width : depth,
+          k_begin > 0 ? Dtype(1) : Dtype(0), C + n_begin, N);
+    }
+  }
+};
+
+}  // namespace
+
+// After "Half-precision float: branch-free conversions" (F. Giesen); the
+// float additions do the rounding of subnormal results.
+uint16_t caffe_float_to_fp16(const float x) {
+  uint32_t bits = float_bits(x);
+  const uint32_t sign = bits & 0x80000000u;
+  bits ^= sign;
+  uint32_t h;
+  if (bits >= (127 + 16) << 23) {
+    // Infinity, NaN, or too large for binary16.
+    h = bits > 0x7f800000u ? 0x7e00 : 0x7c00;
+  } else if (bits < (127 - 14) << 23) {
+    // A subnormal binary16 or zero.
+    const uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+    h = float_bits(bits_float(bits) + bits_float(magic)) - magic;
+  } else {
+    const uint32_t odd = (bits >> 13) & 1;
+    bits += ((15 - 127) << 23) + 0xfff + odd;
+    h = bits >> 13;
+  }
+  return static_cast<uint16_t>(h | (sign >> 16));
+}
+
+float caffe_fp16_to_float(const uint16_t h) {
+  const uint32_t exponent = 0x7c00u << 13;
+  uint32_t bits = (h & 0x7fffu) << 13;
+  const uint32_t e = bits & exponent;
+  bits += (127 - 15) << 23;
+  if (e == exponent) {
+    bits += (128 - 16) << 23;  // Infinity or NaN.
+  } else if (e == 0) {
+    // Subnormal: renormalize through a float subtraction.
+    bits += 1 << 23;
+    bits = float_bits(bits_float(bits) - bits_float(113 << 23));
+  }
+  return bits_float(bits | (static_cast<uint32_t>(h & 0x8000u) << 16));
+}
+
+uint16_t caffe_float_to_bf16(const float x) {
+  const uint32_t bits = float_bits(x);
+  if ((bits & 0x7fffffffu) > 0x7f800000u) {
+    return static_cast<uint16_t>((bits >> 16) | 0x40);  // Quiet NaN.
+  }
+  return static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+float caffe_bf16_to_float(const uint16_t h) {
+  return bits_float(static_cast<uint32_t>(h) << 16);
+}
+
+template <typename Dtype>
+void caffe_cpu_narrow(const StoragePrecision precision, const int n,
+    const Dtype* x, uint16_t* y) {
+  CHECK_NE(precision, LayerParameter_StoragePrecision_FLOAT);
+  if (precision == LayerParameter_StoragePrecision_BF16) {
+    for (int i = 0; i < n; ++i) {
+      y[i] = caffe_float_to_bf16(x[i]);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) {
+      y[i] = caffe_float_to_fp16(x[i]);
+    }
+  }
+}
+
+template void caffe_cpu_narrow<float>(const StoragePrecision precision,
+    const int n, const float* x, uint16_t* y);
+template void caffe_cpu_narrow<double>(const StoragePrecision precision,
+    const int n, const double* x, uint16_t* y);
+
+template <typename Dtype>
+void caffe_cpu_widen(const StoragePrecision precision, const int n,
+    const uint16_t* x, Dtype* y) {
+  CHECK_NE(precision, LayerParameter_StoragePrecision_FLOAT);
+  widen(precision, n, x, y);
+}
+
+template void caffe_cpu_widen<float>(const StoragePrecision precision,
+    const int n, const uint16_t* x, float* y);
+template void caffe_cpu_widen<double>(const StoragePrecision precision,
+    const int n, const uint16_t* x, double* y);
+
+template <typename Dtype, typename TA>
+void caffe_cpu_gemm_half(const StoragePrecision precision,
+    const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
+    const TA* A, const uint16_t* B, Dtype* C) {
+  CHECK_NE(precision, LayerParameter_StoragePrecision_FLOAT);
+  if (K == 0) {
+    caffe_set(M * N, Dtype(0), C);
+    return;
+  }
+  GemmHalfBlock<Dtype, TA> block = {precision, TransB, M, N, K, A, B, C};
+  ThreadPool::Get().Run((N + kHalfBlockN - 1) / kHalfBlockN, block);
+}
+
+template void caffe_cpu_gemm_half<float, uint16_t>(
+    const StoragePrecision precision, const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const uint16_t* A,
+    const uint16_t* B, float* C);
+template void caffe_cpu_gemm_half<double, uint16_t>(
+    const StoragePrecision precision, const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const uint16_t* A,
+    const uint16_t* B, double* C);
+template void caffe_cpu_gemm_half<float, float>(
+    const StoragePrecision precision, const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const float* A,
+    const uint16_t* B, float* C);
+template void caffe_cpu_gemm_half<double, double>(
+    const StoragePrecision precision, const CBLAS_TRANSPOSE TransB,
+    const int M, const int N, const int K, const double* A,
+    const uint16_t* B, double* C);
+
+}  // namespace caffe
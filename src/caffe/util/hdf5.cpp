@@ -5,11 +5,15 @@
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob) {
+boost::recursive_mutex& hdf5_mutex() {
+  static boost::recursive_mutex mutex;
+  return mutex;
+}
+
+// Verifies format of data stored in HDF5 file and returns its shape.
+vector<int> hdf5_get_nd_dataset_shape(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -60,12 +64,69 @@ void hdf5_load_nd_dataset_helper(
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
   }
-  blob->Reshape(blob_dims);
+  return blob_dims;
 }
 
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob) {
+  blob->Reshape(
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim));
+}
+
+namespace {
+
+hid_t hdf5_native_type(float) { return H5T_NATIVE_FLOAT; }
+hid_t hdf5_native_type(double) { return H5T_NATIVE_DOUBLE; }
+
+}  // namespace
+
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    int row_begin, int num_rows, Blob<Dtype>* blob) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  vector<int> shape =
+      hdf5_get_nd_dataset_shape(file_id, dataset_name_, min_dim, max_dim);
+  CHECK_GE(row_begin, 0);
+  CHECK_LE(row_begin + num_rows, shape[0])
+      << "Rows past the end of " << dataset_name_;
+  shape[0] = num_rows;
+  blob->Reshape(shape);
+  if (num_rows == 0) {
+    return;
+  }
+  vector<hsize_t> start(shape.size(), 0);
+  vector<hsize_t> count(shape.begin(), shape.end());
+  start[0] = row_begin;
+  hid_t dataset_id = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset_id, 0) << "Failed to open HDF5 dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset_id);
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start[0],
+      NULL, &count[0], NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of " << dataset_name_;
+  hid_t memory_space = H5Screate_simple(count.size(), &count[0], NULL);
+  status = H5Dread(dataset_id, hdf5_native_type(Dtype(0)), memory_space,
+      file_space, H5P_DEFAULT, blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of " << dataset_name_;
+  H5Sclose(memory_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset_id);
+}
+
+template void hdf5_load_nd_dataset_rows<float>(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    int row_begin, int num_rows, Blob<float>* blob);
+template void hdf5_load_nd_dataset_rows<double>(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    int row_begin, int num_rows, Blob<double>* blob);
+
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_float(
     file_id, dataset_name_, blob->mutable_cpu_data());
@@ -75,6 +136,7 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<double>* blob) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_double(
     file_id, dataset_name_, blob->mutable_cpu_data());
@@ -85,6 +147,7 @@ template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -106,6 +169,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -124,6 +188,7 @@ void hdf5_save_nd_dataset<double>(
 }
 
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -141,6 +206,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -148,6 +214,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -156,6 +223,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -164,6 +232,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -171,6 +240,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
@@ -0,0 +1,204 @@
+#include <boost/thread/mutex.hpp>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+static HostAllocator* host_allocator_ = NULL;
+
+HostAllocator::HostAllocator() : stats_mutex_(new boost::mutex()) {}
+
+HostAllocator::~HostAllocator() {}
+
+HostAllocatorStats HostAllocator::stats() const {
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  return stats_;
+}
+
+void HostAllocator::LogStats() const {
+  const HostAllocatorStats s = stats();
+  LOG(INFO) << "Host memory: " << s.allocations << " allocations, "
+      << s.frees << " frees, " << s.bytes_in_use / 1048576. << " MB in use, "
+      << s.high_water_mark / 1048576. << " MB high-water mark, "
+      << s.bytes_reserved / 1048576. << " MB reserved";
+}
+
+void HostAllocator::CountAllocation(size_t size, size_t reserved) {
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  ++stats_.allocations;
+  stats_.bytes_in_use += size;
+  stats_.high_water_mark = std::max(stats_.high_water_mark,
+      stats_.bytes_in_use);
+  stats_.bytes_reserved += reserved;
+}
+
+void HostAllocator::CountFree(size_t size, size_t released) {
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  ++stats_.frees;
+  stats_.bytes_in_use -= size;
+  stats_.bytes_reserved -= released;
+}
+
+HostAllocator* HostAllocator::Get() {
+  if (!host_allocator_) {
+    host_allocator_ = ByName("malloc");
+  }
+  return host_allocator_;
+}
+
+void HostAllocator::Set(HostAllocator* allocator) {
+  CHECK(allocator);
+  if (host_allocator_ && host_allocator_ != allocator) {
+    const HostAllocatorStats s = host_allocator_->stats();
+    CHECK_EQ(s.allocations, s.frees)
+        << "The host allocator can't be replaced while its memory is in use.";
+  }
+  host_allocator_ = allocator;
+}
+
+HostAllocator* HostAllocator::ByName(const string& name) {
+  // Never deleted, since static SyncedMemory may be freed at exit.
+  static HostAllocator* malloc_allocator = new MallocHostAllocator();
+  static HostAllocator* pool_allocator = new PoolHostAllocator();
+  if (name == "malloc") {
+    return malloc_allocator;
+  } else if (name == "pool") {
+    return pool_allocator;
+  }
+  LOG(FATAL) << "Unknown host allocator: " << name;
+  return NULL;
+}
+
+void* MallocHostAllocator::Allocate(size_t size) {
+  void* ptr = malloc(size);
+  if (ptr) {
+    CountAllocation(size, size);
+  }
+  return ptr;
+}
+
+void MallocHostAllocator::Free(void* ptr, size_t size) {
+  free(ptr);
+  CountFree(size, size);
+}
+
+const size_t PoolHostAllocator::kSlabSize;
+const size_t PoolHostAllocator::kMaxSlabClass;
+
+PoolHostAllocator::PoolHostAllocator() : mutex_(new boost::mutex()) {}
+
+PoolHostAllocator::~PoolHostAllocator() {
+  Trim();
+  for (int i = 0; i < slabs_.size(); ++i) {
+    free(slabs_[i]);
+  }
+}
+
+int PoolHostAllocator::SizeClass(size_t size) {
+  if (size <= 64) {
+    return 0;
+  }
+  // size is in (2^k, 2^(k + 1)], split in four steps of 2^(k - 2).
+  int k = 0;
+  while ((size - 1) >> (k + 1)) {
+    ++k;
+  }
+  const size_t step = size_t(1) << (k - 2);
+  const int q = ((size - (size_t(1) << k)) + step - 1) / step;
+  return (k - 6) * 4 + q;
+}
+
+size_t PoolHostAllocator::ClassSize(int size_class) {
+  if (size_class == 0) {
+    return 64;
+  }
+  const int k = 6 + (size_class - 1) / 4;
+  const int q = (size_class - 1) % 4 + 1;
+  return (size_t(1) << k) + q * (size_t(1) << (k - 2));
+}
+
+void* PoolHostAllocator::Allocate(size_t size) {
+  const int size_class = SizeClass(size);
+  const size_t class_size = ClassSize(size_class);
+  size_t reserved = 0;
+  void* ptr = NULL;
+  {
+    boost::mutex::scoped_lock lock(*mutex_);
+    if (free_lists_.size() <= size_class) {
+      free_lists_.resize(size_class + 1);
+    }
+    std::vector<void*>& free_list = free_lists_[size_class];
+    if (free_list.empty() && class_size <= kMaxSlabClass) {
+      // Carve a new slab into blocks of the class.
+      void* slab = NULL;
+      if (posix_memalign(&slab, kSlabSize, kSlabSize) != 0) {
+        return NULL;
+      }
+#ifdef MADV_HUGEPAGE
+      madvise(slab, kSlabSize, MADV_HUGEPAGE);
+#endif
+      slabs_.push_back(slab);
+      reserved = kSlabSize;
+      for (size_t offset = kSlabSize / class_size * class_size; offset > 0;
+           offset -= class_size) {
+        free_list.push_back(static_cast<char*>(slab) + offset - class_size);
+      }
+    }
+    if (!free_list.empty()) {
+      ptr = free_list.back();
+      free_list.pop_back();
+    }
+  }
+  if (!ptr) {
+    const size_t alignment = class_size >= kSlabSize ? kSlabSize : 4096;
+    if (posix_memalign(&ptr, alignment, class_size) != 0) {
+      return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    if (class_size >= kSlabSize) {
+      madvise(ptr, class_size, MADV_HUGEPAGE);
+    }
+#endif
+    reserved = class_size;
+  }
+  CountAllocation(size, reserved);
+  return ptr;
+}
+
+void PoolHostAllocator::Free(void* ptr, size_t size) {
+  const int size_class = SizeClass(size);
+  {
+    boost::mutex::scoped_lock lock(*mutex_);
+    CHECK_LT(size_class, free_lists_.size())
+        << "Memory freed with a different size than allocated.";
+    free_lists_[size_class].push_back(ptr);
+  }
+  CountFree(size, 0);
+}
+
+void PoolHostAllocator::Trim() {
+  size_t released = 0;
+  {
+    boost::mutex::scoped_lock lock(*mutex_);
+    for (int c = 0; c < free_lists_.size(); ++c) {
+      if (ClassSize(c) <= kMaxSlabClass) {
+        continue;
+      }
+      for (int i = 0; i < free_lists_[c].size(); ++i) {
+        free(free_lists_[c][i]);
+        released += ClassSize(c);
+      }
+      free_lists_[c].clear();
+    }
+  }
+  boost::mutex::scoped_lock lock(*stats_mutex_);
+  stats_.bytes_reserved -= released;
+}
+
+}  // namespace caffe
@@ -9,6 +9,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/half.hpp"
 #include "caffe/util/image_io.hpp"
 
 using std::fstream;
@@ -82,4 +83,46 @@ bool save_blob_to_binary<double>(Blob<double>* blob,
     return true;
 }
 
+template <typename Dtype>
+bool save_blob_to_half_binary(Blob<Dtype>* blob, const string fn_blob,
+    int num_index, LayerParameter_StoragePrecision precision) {
+    FILE *f;
+    const Dtype *buff;
+    int n, c, l, w, h;
+    f = fopen(fn_blob.c_str(), "wb");
+    if (f == NULL)
+        return false;
+
+    if (num_index < 0) {
+        n = blob->num();
+        buff = blob->cpu_data();
+    } else {
+        n = 1;
+        buff = blob->cpu_data() + blob->offset(num_index);
+    }
+    c = blob->channels();
+    l = blob->length();
+    h = blob->height();
+    w = blob->width();
+
+    const int count = n * c * l * h * w;
+    std::vector<uint16_t> half(count);
+    caffe_cpu_narrow(precision, count, buff, &half[0]);
+    fwrite(&n, sizeof(int), 1, f);
+    fwrite(&c, sizeof(int), 1, f);
+    fwrite(&l, sizeof(int), 1, f);
+    fwrite(&h, sizeof(int), 1, f);
+    fwrite(&w, sizeof(int), 1, f);
+    fwrite(&half[0], sizeof(uint16_t), count, f);
+    fclose(f);
+    return true;
+}
+
+template bool save_blob_to_half_binary<float>(Blob<float>* blob,
+    const string fn_blob, int num_index,
+    LayerParameter_StoragePrecision precision);
+template bool save_blob_to_half_binary<double>(Blob<double>* blob,
+    const string fn_blob, int num_index,
+    LayerParameter_StoragePrecision precision);
+
 }  // namespace caffe
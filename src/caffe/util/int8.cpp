@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "caffe/util/int8.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Columns of C computed by one job of caffe_cpu_gemm_s8.
+const int kGemmS8BlockN = 256;
+const int kGemmS8BlockNT = 16;
+
+struct GemmS8Block {
+  CBLAS_TRANSPOSE trans_b;
+  int M, N, K;
+  const int8_t* A;
+  const int8_t* B;
+  int32_t* C;
+
+  void operator()(int block) const {
+    if (trans_b == CblasNoTrans) {
+      NoTrans(block * kGemmS8BlockN,
+          std::min(N, (block + 1) * kGemmS8BlockN));
+    } else {
+      Trans(block * kGemmS8BlockNT,
+          std::min(N, (block + 1) * kGemmS8BlockNT));
+    }
+  }
+
+  // Rows of B are streamed once per four rows of A, which share the loads.
+  void NoTrans(const int n_begin, const int n_end) const {
+    const int width = n_end - n_begin;
+    int32_t sums[4][kGemmS8BlockN];
+    for (int m = 0; m < M; m += 4) {
+      const int rows = std::min(4, M - m);
+      memset(sums, 0, sizeof(sums));
+      for (int k = 0; k < K; ++k) {
+        const int8_t* b = B + static_cast<size_t>(k) * N + n_begin;
+        for (int r = 0; r < rows; ++r) {
+          const int32_t a = A[static_cast<size_t>(m + r) * K + k];
+          int32_t* sum = sums[r];
+          for (int j = 0; j < width; ++j) {
+            sum[j] += a * b[j];
+          }
+        }
+      }
+      for (int r = 0; r < rows; ++r) {
+        memcpy(C + static_cast<size_t>(m + r) * N + n_begin, sums[r],
+            sizeof(int32_t) * width);
+      }
+    }
+  }
+
+  // Every row of B stays in cache for the dot products with all rows of A.
+  void Trans(const int n_begin, const int n_end) const {
+    for (int n = n_begin; n < n_end; ++n) {
+      const int8_t* b = B + static_cast<size_t>(n) * K;
+      for (int m = 0; m < M; ++m) {
+        const int8_t* a = A + static_cast<size_t>(m) * K;
+        int32_t sum = 0;
+        for (int k = 0; k < K; ++k) {
+          sum += static_cast<int32_t>(a[k]) * b[k];
+        }
+        C[static_cast<size_t>(m) * N + n] = sum;
+      }
+    }
+  }
+};
+
+inline int8_t quantize(const float x) {
+  const float r = std::max(-127.f, std::min(127.f, x));
+  return static_cast<int8_t>(r >= 0 ? r + 0.5f : r - 0.5f);
+}
+
+}  // namespace
+
+void caffe_cpu_gemm_s8(const CBLAS_TRANSPOSE TransB, const int M, const int N,
+    const int K, const int8_t* A, const int8_t* B, int32_t* C) {
+  GemmS8Block block = {TransB, M, N, K, A, B, C};
+  const int block_n = TransB == CblasNoTrans ? kGemmS8BlockN : kGemmS8BlockNT;
+  ThreadPool::Get().Run((N + block_n - 1) / block_n, block);
+}
+
+template <typename Dtype>
+void Int8Weights<Dtype>::Quantize(const QuantizationParameter& param,
+    const int channels, const int num_output, const int dim,
+    const Dtype* weight, const bool transposed) {
+  CHECK(param.input_range_size() == 1 || param.input_range_size() == channels)
+      << "quantization_param needs one input_range or one per channel ("
+      << channels << ")";
+  CHECK_EQ(dim % channels, 0);
+  channels_ = channels;
+  num_output_ = num_output;
+  dim_ = dim;
+  input_multipliers_.resize(channels);
+  for (int c = 0; c < channels; ++c) {
+    const Dtype range =
+        param.input_range(param.input_range_size() == 1 ? 0 : c);
+    input_multipliers_[c] = range > 0 ? 127 / range : 0;
+  }
+  // Fold the input scales into the weights and quantize each output.
+  const int channel_dim = dim / channels;
+  weights_.resize(static_cast<size_t>(num_output) * dim);
+  weight_scales_.resize(num_output);
+  vector<Dtype> folded(dim);
+  for (int o = 0; o < num_output; ++o) {
+    Dtype max_abs = 0;
+    for (int k = 0; k < dim; ++k) {
+      const Dtype w = transposed ?
+          weight[static_cast<size_t>(k) * num_output + o] :
+          weight[static_cast<size_t>(o) * dim + k];
+      const Dtype multiplier = input_multipliers_[k / channel_dim];
+      folded[k] = multiplier > 0 ? w / multiplier : 0;
+      max_abs = std::max(max_abs, std::fabs(folded[k]));
+    }
+    weight_scales_[o] = max_abs / 127;
+    const Dtype inverse = max_abs > 0 ? 127 / max_abs : 0;
+    int8_t* w = &weights_[static_cast<size_t>(o) * dim];
+    for (int k = 0; k < dim; ++k) {
+      w[k] = quantize(folded[k] * inverse);
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8Weights<Dtype>::QuantizeInput(const int count, const int spatial,
+    const Dtype* x, int8_t* q) const {
+  for (int i = 0, c = 0; i < count; i += spatial, c = (c + 1) % channels_) {
+    const Dtype multiplier = input_multipliers_[c];
+    for (int j = 0; j < spatial; ++j) {
+      q[i + j] = quantize(x[i + j] * multiplier);
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8Weights<Dtype>::DequantizeChannels(const int spatial,
+    const int32_t* sums, const Dtype* bias, const bool relu, Dtype* y) const {
+  for (int o = 0; o < num_output_; ++o) {
+    const Dtype scale = weight_scales_[o];
+    const Dtype b = bias ? bias[o] : Dtype(0);
+    const int32_t* sum = sums + static_cast<size_t>(o) * spatial;
+    Dtype* y_o = y + static_cast<size_t>(o) * spatial;
+    if (relu) {
+      for (int j = 0; j < spatial; ++j) {
+        y_o[j] = std::max(scale * sum[j] + b, Dtype(0));
+      }
+    } else {
+      for (int j = 0; j < spatial; ++j) {
+        y_o[j] = scale * sum[j] + b;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Int8Weights<Dtype>::DequantizeRows(const int num, const int32_t* sums,
+    const Dtype* bias, Dtype* y) const {
+  for (int i = 0; i < num; ++i) {
+    for (int o = 0; o < num_output_; ++o) {
+      const size_t index = static_cast<size_t>(i) * num_output_ + o;
+      y[index] = weight_scales_[o] * sums[index] + (bias ? bias[o] : Dtype(0));
+    }
+  }
+}
+
+INSTANTIATE_CLASS(Int8Weights);
+
+}  // namespace caffe
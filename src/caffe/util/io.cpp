@@ -26,6 +26,7 @@
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/io.hpp"
+#include "caffe/util/video_frame_reader.hpp"
 
 // Check if a given path is a regular file or a path
 void check_path(const std::string& path, bool* is_file, bool* is_dir) {
@@ -255,6 +256,31 @@ bool ReadVideoToCVMat(const string& path,
   return true;
 }
 
+bool ReadVideoToCVMat(VideoFrameReader* reader, const string& path,
+    const int start_frame, const int length, std::vector<cv::Mat>* cv_imgs) {
+  if (!reader->Open(path)) {
+    return false;
+  }
+  if (!reader->is_video_file()) {
+    if (!reader->Read(start_frame, length, 1, cv_imgs)) {
+      cv_imgs->clear();
+      return false;
+    }
+    return true;
+  }
+  int num_frames = reader->num_frames() + 1;
+  int end_frame = start_frame + length - 1;
+  if (num_frames < end_frame) {
+    LOG(ERROR) << "not enough frames; num_frames=" << num_frames <<
+                  ", start_frame=" << start_frame <<
+                  ", length=" << length;
+    return false;
+  }
+  // Same frames as the seeking version, which positions the capture at
+  // start_frame - 2.
+  return reader->Read(std::max(start_frame - 2, 0), length, 1, cv_imgs);
+}
+
 #endif  // USE_OPENCV
 
 bool ReadFileToDatum(const string& filename, const int label,
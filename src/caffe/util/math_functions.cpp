@@ -1,6 +1,7 @@
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
+#include <algorithm>
 #include <limits>
 
 #include "caffe/common.hpp"
@@ -65,6 +66,9 @@ void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
 }
 
 template void caffe_set<int>(const int N, const int alpha, int* Y);
+template void caffe_set<int8_t>(const int N, const int8_t alpha, int8_t* Y);
+template void caffe_set<uint16_t>(const int N, const uint16_t alpha,
+    uint16_t* Y);
 template void caffe_set<float>(const int N, const float alpha, float* Y);
 template void caffe_set<double>(const int N, const double alpha, double* Y);
 
@@ -372,4 +376,24 @@ void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
   cblas_dscal(n, alpha, y, 1);
 }
 
+template <typename Dtype>
+void caffe_cpu_bias_relu(const int channels, const int dim, const Dtype* bias,
+    Dtype* y) {
+  for (int c = 0; c < channels; ++c) {
+    const Dtype b = bias ? bias[c] : Dtype(0);
+    Dtype* y_c = y + static_cast<size_t>(c) * dim;
+    for (int i = 0; i < dim; ++i) {
+      y_c[i] = std::max(y_c[i] + b, Dtype(0));
+    }
+  }
+}
+
+template
+void caffe_cpu_bias_relu<float>(const int channels, const int dim,
+    const float* bias, float* y);
+
+template
+void caffe_cpu_bias_relu<double>(const int channels, const int dim,
+    const double* bias, double* y);
+
 }  // namespace caffe
@@ -140,6 +140,29 @@ void caffe_gpu_scale<double>(const int n, const double alpha, const double *x,
   CUBLAS_CHECK(cublasDscal(Caffe::cublas_handle(), n, &alpha, y, 1));
 }
 
+template <typename Dtype>
+__global__ void bias_relu_kernel(const int n, const int dim,
+    const Dtype* bias, Dtype* y) {
+  CUDA_KERNEL_LOOP(index, n) {
+    const Dtype v = y[index] + (bias ? bias[index / dim] : Dtype(0));
+    y[index] = v > 0 ? v : Dtype(0);
+  }
+}
+
+template <typename Dtype>
+void caffe_gpu_bias_relu(const int channels, const int dim, const Dtype* bias,
+    Dtype* y) {
+  const int n = channels * dim;
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  bias_relu_kernel<Dtype><<<CAFFE_GET_BLOCKS(n), CAFFE_CUDA_NUM_THREADS>>>(
+      n, dim, bias, y);
+}
+
+template void caffe_gpu_bias_relu<float>(const int channels, const int dim,
+    const float* bias, float* y);
+template void caffe_gpu_bias_relu<double>(const int channels, const int dim,
+    const double* bias, double* y);
+
 template <typename Dtype>
 __global__ void set_kernel(const int n, const Dtype alpha, Dtype* y) {
   CUDA_KERNEL_LOOP(index, n) {
@@ -0,0 +1,272 @@
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <string>
+
+#include "caffe/data_reader.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/hdf5_data_layer.hpp"
+#include "caffe/util/ring_queue.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Failed attempts before a waiting thread parks; it yields its core after
+// the first kBusySpins of them.
+const int kSpins = 256;
+const int kBusySpins = 32;
+
+const size_t kCacheLine = 64;
+
+inline void Relax(int spin) {
+  if (spin >= kBusySpins) {
+    boost::this_thread::yield();
+  }
+}
+
+}  // namespace
+
+template<typename T>
+class RingQueue<T>::sync {
+ public:
+  struct Cell {
+    boost::atomic<size_t> sequence;
+    boost::atomic<T> data;
+  };
+
+  explicit sync(size_t capacity)
+      : waiting_producers_(0), waiting_consumers_(0) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    cells_ = new Cell[size];
+    for (size_t i = 0; i < size; ++i) {
+      cells_[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+    enqueue_pos_.store(0, boost::memory_order_relaxed);
+    dequeue_pos_.store(0, boost::memory_order_relaxed);
+  }
+
+  ~sync() {
+    delete[] cells_;
+  }
+
+  // A cell is free for the push at pos when its sequence is pos, and holds
+  // the element of the pop at pos once its sequence is pos + 1.
+  bool try_push(const T& t) {
+    size_t pos = enqueue_pos_.load(boost::memory_order_relaxed);
+    while (true) {
+      Cell* cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(boost::memory_order_acquire);
+      const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+            boost::memory_order_relaxed)) {
+          cell->data.store(t, boost::memory_order_relaxed);
+          cell->sequence.store(pos + 1, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // Full.
+      } else {
+        pos = enqueue_pos_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T* t) {
+    size_t pos = dequeue_pos_.load(boost::memory_order_relaxed);
+    while (true) {
+      Cell* cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(boost::memory_order_acquire);
+      const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+            boost::memory_order_relaxed)) {
+          *t = cell->data.load(boost::memory_order_relaxed);
+          cell->sequence.store(pos + mask_ + 1, boost::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // Empty.
+      } else {
+        pos = dequeue_pos_.load(boost::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Reads the front element like a seqlock: it is only returned if its cell
+  // was not popped while being read.
+  bool try_peek(T* t) {
+    size_t pos = dequeue_pos_.load(boost::memory_order_acquire);
+    while (true) {
+      Cell* cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(boost::memory_order_acquire);
+      const ptrdiff_t diff = static_cast<ptrdiff_t>(sequence - (pos + 1));
+      if (diff < 0) {
+        return false;
+      }
+      if (diff == 0) {
+        const T value = cell->data.load(boost::memory_order_relaxed);
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        if (cell->sequence.load(boost::memory_order_relaxed) == sequence) {
+          *t = value;
+          return true;
+        }
+      }
+      pos = dequeue_pos_.load(boost::memory_order_acquire);
+    }
+  }
+
+  size_t size() const {
+    // Read the consumer side first so the difference can't go negative
+    // because of pushes in between; it can still exceed the capacity.
+    const size_t dequeued = dequeue_pos_.load(boost::memory_order_acquire);
+    const size_t enqueued = enqueue_pos_.load(boost::memory_order_acquire);
+    const size_t size = enqueued - dequeued;
+    return size > mask_ + 1 ? mask_ + 1 : size;
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  // Calls try_fn(t) until it succeeds, spinning first and then parking on
+  // condition until another thread makes progress.
+  template<typename Try, typename Arg>
+  void Wait(Try try_fn, Arg t, boost::atomic<int>* waiting,
+      boost::condition_variable* condition, const string& log_on_wait) {
+    for (int spin = 0; spin < kSpins; ++spin) {
+      if ((this->*try_fn)(t)) {
+        return;
+      }
+      Relax(spin);
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    Parked parked(waiting);
+    while (!(this->*try_fn)(t)) {
+      if (!log_on_wait.empty()) {
+        LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+      }
+      condition->wait(lock);
+    }
+  }
+
+  // Wakes the threads parked on condition, if any. A thread that parks
+  // counts itself before its last attempt, under the lock, so either it
+  // sees the change just made or the fence makes this see its count and
+  // notify it once it waits. Must not be called with the lock held.
+  void Wake(boost::atomic<int>* waiting, boost::condition_variable* condition) {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (waiting->load(boost::memory_order_relaxed) > 0) {
+      boost::mutex::scoped_lock lock(mutex_);
+      lock.unlock();
+      condition->notify_all();
+    }
+  }
+
+  boost::atomic<int> waiting_producers_;
+  boost::atomic<int> waiting_consumers_;
+  boost::condition_variable not_full_;
+  boost::condition_variable not_empty_;
+
+ protected:
+  // Counts a thread as parked while it holds the lock or waits, including
+  // when the wait is interrupted.
+  class Parked {
+   public:
+    explicit Parked(boost::atomic<int>* waiting) : waiting_(waiting) {
+      waiting_->fetch_add(1, boost::memory_order_seq_cst);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    }
+    ~Parked() {
+      waiting_->fetch_sub(1, boost::memory_order_relaxed);
+    }
+
+   private:
+    boost::atomic<int>* waiting_;
+  };
+
+  // The producer and consumer positions sit on their own cache lines.
+  char pad0_[kCacheLine];
+  boost::atomic<size_t> enqueue_pos_;
+  char pad1_[kCacheLine - sizeof(boost::atomic<size_t>)];
+  boost::atomic<size_t> dequeue_pos_;
+  char pad2_[kCacheLine - sizeof(boost::atomic<size_t>)];
+  Cell* cells_;
+  size_t mask_;
+  boost::mutex mutex_;
+};
+
+template<typename T>
+RingQueue<T>::RingQueue(size_t capacity)
+    : sync_(new sync(capacity)) {
+  CHECK_GT(capacity, 0);
+}
+
+template<typename T>
+void RingQueue<T>::push(const T& t) {
+  sync_->Wait(&sync::try_push, t, &sync_->waiting_producers_,
+      &sync_->not_full_, "");
+  sync_->Wake(&sync_->waiting_consumers_, &sync_->not_empty_);
+}
+
+template<typename T>
+bool RingQueue<T>::try_push(const T& t) {
+  if (!sync_->try_push(t)) {
+    return false;
+  }
+  sync_->Wake(&sync_->waiting_consumers_, &sync_->not_empty_);
+  return true;
+}
+
+template<typename T>
+bool RingQueue<T>::try_pop(T* t) {
+  if (!sync_->try_pop(t)) {
+    return false;
+  }
+  sync_->Wake(&sync_->waiting_producers_, &sync_->not_full_);
+  return true;
+}
+
+template<typename T>
+T RingQueue<T>::pop(const string& log_on_wait) {
+  T t;
+  sync_->Wait(&sync::try_pop, &t, &sync_->waiting_consumers_,
+      &sync_->not_empty_, log_on_wait);
+  sync_->Wake(&sync_->waiting_producers_, &sync_->not_full_);
+  return t;
+}
+
+template<typename T>
+bool RingQueue<T>::try_peek(T* t) {
+  return sync_->try_peek(t);
+}
+
+template<typename T>
+T RingQueue<T>::peek() {
+  T t;
+  sync_->Wait(&sync::try_peek, &t, &sync_->waiting_consumers_,
+      &sync_->not_empty_, "");
+  return t;
+}
+
+template<typename T>
+size_t RingQueue<T>::size() const {
+  return sync_->size();
+}
+
+template<typename T>
+size_t RingQueue<T>::capacity() const {
+  return sync_->capacity();
+}
+
+template class RingQueue<Batch<float>*>;
+template class RingQueue<Batch<double>*>;
+template class RingQueue<Datum*>;
+template class RingQueue<HDF5Batch<float>*>;
+template class RingQueue<HDF5Batch<double>*>;
+
+}  // namespace caffe
@@ -0,0 +1,126 @@
+#include <boost/thread.hpp>
+#include <algorithm>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+class ThreadPool::sync {
+ public:
+  // Held by the thread that owns the current job.
+  boost::mutex run_mutex_;
+  // Guards everything below.
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  boost::function<void(int)> fn_;
+  int n_;
+  int next_;
+  int chunk_;
+  int generation_;
+  // Workers that have not finished the current job yet.
+  int busy_;
+  bool stop_;
+};
+
+ThreadPool::ThreadPool(int num_threads)
+    : sync_(new sync()) {
+  sync_->n_ = 0;
+  sync_->next_ = 0;
+  sync_->chunk_ = 1;
+  sync_->generation_ = 0;
+  sync_->busy_ = 0;
+  sync_->stop_ = false;
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.push_back(shared_ptr<boost::thread>(
+        new boost::thread(&ThreadPool::WorkerEntry, this)));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->start_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i]->join();
+  }
+}
+
+void ThreadPool::WorkerEntry() {
+  int generation = 0;
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (!sync_->stop_ && sync_->generation_ == generation) {
+      sync_->start_.wait(lock);
+    }
+    if (sync_->stop_) {
+      return;
+    }
+    generation = sync_->generation_;
+    lock.unlock();
+    RunChunks();
+    lock.lock();
+    if (--sync_->busy_ == 0) {
+      sync_->done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::RunChunks() {
+  while (true) {
+    int begin;
+    {
+      boost::mutex::scoped_lock lock(sync_->mutex_);
+      begin = sync_->next_;
+      sync_->next_ += sync_->chunk_;
+    }
+    if (begin >= sync_->n_) {
+      return;
+    }
+    const int end = std::min(begin + sync_->chunk_, sync_->n_);
+    for (int i = begin; i < end; ++i) {
+      sync_->fn_(i);
+    }
+  }
+}
+
+void ThreadPool::Run(int n, const boost::function<void(int)>& fn) {
+  // A nested call, or a call made while another thread owns the pool, fails
+  // to take run_mutex_ and simply runs in the calling thread.
+  boost::unique_lock<boost::mutex> run_lock(sync_->run_mutex_,
+      boost::try_to_lock);
+  if (workers_.empty() || n < 2 || !run_lock.owns_lock()) {
+    for (int i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->fn_ = fn;
+    sync_->n_ = n;
+    sync_->next_ = 0;
+    // A few chunks per thread balance uneven iterations without paying for
+    // the lock on every single one.
+    sync_->chunk_ = std::max(1, n / (4 * num_threads()));
+    sync_->busy_ = workers_.size();
+    ++sync_->generation_;
+  }
+  sync_->start_.notify_all();
+  RunChunks();
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (sync_->busy_ > 0) {
+    sync_->done_.wait(lock);
+  }
+  sync_->fn_.clear();
+}
+
+ThreadPool& ThreadPool::Get() {
+  static ThreadPool pool(
+      std::max(1, static_cast<int>(boost::thread::hardware_concurrency())));
+  return pool;
+}
+
+}  // namespace caffe
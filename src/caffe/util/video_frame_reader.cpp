@@ -0,0 +1,207 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/version.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/highgui/highgui_c.h>
+#include <opencv2/imgproc/imgproc.hpp>
+#if CV_MAJOR_VERSION == 3
+#include <opencv2/videoio/videoio.hpp>
+#endif
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/util/video_frame_reader.hpp"
+
+namespace caffe {
+
+VideoFrameReader::VideoFrameReader(int height, int width, bool is_color,
+    bool pad_with_last)
+    : height_(height), width_(width), is_color_(is_color),
+      pad_with_last_(pad_with_last), is_video_file_(false), num_frames_(0),
+      position_(0), end_of_stream_(INT_MAX), decoded_frames_(0), seeks_(0) {}
+
+bool VideoFrameReader::Open(const string& path) {
+  if (path == path_) {
+    return true;
+  }
+  cap_.release();
+  path_.clear();
+  num_frames_ = 0;
+  position_ = 0;
+  end_of_stream_ = INT_MAX;
+  last_frame_.release();
+  std::fill(ring_frame_.begin(), ring_frame_.end(), -1);
+
+  struct stat path_stat;
+  if (stat(path.c_str(), &path_stat) != 0) {
+    LOG(ERROR) << "Could not open or find file " << path;
+    return false;
+  }
+  is_video_file_ = S_ISREG(path_stat.st_mode);
+  if (is_video_file_) {
+    cap_.open(path);
+    if (!cap_.isOpened()) {
+      LOG(ERROR) << "Cannot open a video file=" << path;
+      return false;
+    }
+    num_frames_ = cap_.get(CV_CAP_PROP_FRAME_COUNT);
+  } else if (!S_ISDIR(path_stat.st_mode)) {
+    LOG(ERROR) << "Could not open or find file " << path;
+    return false;
+  }
+  path_ = path;
+  return true;
+}
+
+bool VideoFrameReader::Read(int start, int length, int step,
+    std::vector<cv::Mat>* frames) {
+  CHECK(!path_.empty()) << "No video open";
+  CHECK_GE(start, 0);
+  CHECK_GT(length, 0);
+  CHECK_GT(step, 0);
+  // The buffer spans at least one clip, so overlapping clips never evict
+  // the frames they share.
+  const int span = (length - 1) * step + 1;
+  if (ring_.size() < span) {
+    ring_.assign(span, cv::Mat());
+    ring_frame_.assign(span, -1);
+  }
+  for (int i = 0; i < length; ++i) {
+    cv::Mat img;
+    if (!ReadFrame(start + i * step, &img)) {
+      return false;
+    }
+    frames->push_back(img);
+  }
+  return true;
+}
+
+bool VideoFrameReader::ReadFrame(int frame, cv::Mat* img) {
+  const int slot = frame % ring_.size();
+  if (ring_frame_[slot] == frame) {
+    *img = ring_[slot];
+    return true;
+  }
+  if (!DecodeFrame(frame, img)) {
+    return false;
+  }
+  ring_[slot] = *img;
+  ring_frame_[slot] = frame;
+  return true;
+}
+
+bool VideoFrameReader::DecodeFrame(int frame, cv::Mat* img) {
+  cv::Mat origin;
+  if (!is_video_file_) {
+    char image_filename[256];
+    snprintf(image_filename, sizeof(image_filename), "%s/images%04d.png",
+             path_.c_str(), frame);
+    origin = cv::imread(image_filename,
+        is_color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+    if (!origin.data) {
+      LOG(ERROR) << "Could not read frame=" << frame <<
+                    " from an image file=" << image_filename;
+      return false;
+    }
+    Convert(origin, img);
+    ++decoded_frames_;
+    return true;
+  }
+
+  // Decoding forward is cheaper than seeking as long as the gap is shorter
+  // than a clip.
+  if (frame < position_ || frame - position_ > ring_.size()) {
+    cap_.set(CV_CAP_PROP_POS_FRAMES, frame);
+    position_ = frame;
+    end_of_stream_ = INT_MAX;
+    ++seeks_;
+  }
+  while (position_ < frame && position_ < end_of_stream_) {
+    if (!cap_.grab()) {
+      end_of_stream_ = position_;
+    }
+    ++position_;
+  }
+  if (position_ < end_of_stream_) {
+    cap_.read(origin);
+    if (origin.data) {
+      ++position_;
+      Convert(origin, img);
+      last_frame_ = *img;
+      ++decoded_frames_;
+      return true;
+    }
+    end_of_stream_ = position_;
+  }
+  if (!pad_with_last_ || !last_frame_.data) {
+    LOG(ERROR) << "Could not read frame=" << frame <<
+                  " from a video file=" << path_ <<
+                  ", where num of frames=" << num_frames_;
+    return false;
+  }
+  LOG(INFO) << "Could not read frame=" << frame <<
+                " from a video file=" << path_ <<
+                ", where num of frames=" << num_frames_ <<
+                ". Use previous frame.";
+  *img = last_frame_;
+  return true;
+}
+
+void VideoFrameReader::Convert(const cv::Mat& origin, cv::Mat* img) {
+  cv::Mat converted = origin;
+  // Force color
+  if (is_color_ && origin.channels() == 1) {
+    cv::cvtColor(origin, converted, CV_GRAY2BGR);
+  // Force grayscale
+  } else if (!is_color_ && origin.channels() == 3) {
+    cv::cvtColor(origin, converted, CV_BGR2GRAY);
+  }
+  if (height_ > 0 && width_ > 0) {
+    cv::resize(converted, *img, cv::Size(width_, height_));
+  } else {
+    *img = converted;
+  }
+}
+
+namespace {
+
+// Orders clips by the first appearance of their file, then by start frame.
+struct ClipGroupOrder {
+  ClipGroupOrder(const std::vector<int>& file_rank,
+      const std::vector<int>& start_frames)
+      : file_rank_(file_rank), start_frames_(start_frames) {}
+  bool operator()(int a, int b) const {
+    if (file_rank_[a] != file_rank_[b]) {
+      return file_rank_[a] < file_rank_[b];
+    }
+    return start_frames_[a] < start_frames_[b];
+  }
+  const std::vector<int>& file_rank_;
+  const std::vector<int>& start_frames_;
+};
+
+}  // namespace
+
+std::vector<int> GroupClipsByFile(const std::vector<string>& files,
+    const std::vector<int>& start_frames) {
+  CHECK_EQ(files.size(), start_frames.size());
+  std::map<string, int> first_clip;
+  std::vector<int> file_rank(files.size());
+  std::vector<int> order(files.size());
+  for (int i = 0; i < files.size(); ++i) {
+    file_rank[i] = first_clip.insert(std::make_pair(files[i], i)).first->second;
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(),
+      ClipGroupOrder(file_rank, start_frames));
+  return order;
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -14,6 +14,9 @@
  *
  */
 
+#include <stdint.h>
+
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
@@ -22,39 +25,119 @@
 
 namespace caffe {
 
-template <typename Dtype>
-void vol2col_cpu(const Dtype* data_im, const int channels, const int length,
-	    const int height, const int width, const int ksize, const int kdepth, const int pad,
-	    const int temporal_pad, const int stride, const int temporal_stride, Dtype* data_col) {
-  int length_col = (length + 2 * temporal_pad - kdepth) / temporal_stride + 1;
-  int height_col = (height + 2 * pad - ksize) / stride + 1;
-  int width_col = (width + 2 * pad - ksize) / stride + 1;
+// Same trick as in im2col.cpp: a single unsigned comparison checks
+// 0 <= a < b for a positive b.
+inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
+  return static_cast<unsigned>(a) < static_cast<unsigned>(b);
+}
 
-  int channels_col = channels * kdepth * ksize * ksize;
-  for (int c = 0; c < channels_col; ++c) {
-    int w_offset = c % ksize;
-    int h_offset = (c / ksize) % ksize;
-    int l_offset = (c / ksize / ksize) % kdepth;
-    int c_im = c / ksize / ksize / kdepth;
-    for (int l=0; l < length_col; ++l) {
-      for (int h = 0; h < height_col; ++h) {
-        for (int w = 0; w < width_col; ++w) {
-          int l_pad = l * temporal_stride - temporal_pad + l_offset;
-          int h_pad = h * stride - pad + h_offset;
-          int w_pad = w * stride - pad + w_offset;
+// Range [*begin, *end) of output columns whose input column
+// input_col + i * stride falls inside [0, width).
+inline void valid_output_range(const int input_col, const int stride,
+    const int width, const int output_w, int* begin, int* end) {
+  *begin = input_col < 0 ? (-input_col + stride - 1) / stride : 0;
+  *end = input_col < width ? (width - input_col + stride - 1) / stride : 0;
+  *begin = std::min(*begin, output_w);
+  *end = std::max(std::min(*end, output_w), *begin);
+}
 
-          if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width
-        		  && l_pad >=0 && l_pad < length)
-            data_col[((c * length_col + l) * height_col + h) * width_col + w] =
-              data_im[((c_im * length + l_pad) * height + h_pad) * width + w_pad];
-          else
-            data_col[((c * length_col + l) * height_col + h) * width_col + w] = 0;
+template <typename Dtype>
+void vol2col_cpu(const Dtype* data_im, const int channels, const int length,
+    const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    Dtype* data_col) {
+  const int length_col = (length + 2 * pad_l -
+      (dilation_l * (kernel_l - 1) + 1)) / stride_l + 1;
+  const int height_col = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int width_col = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int frame_size = height * width;
+  const int channel_size = length * frame_size;
+  for (int channel = channels; channel--; data_im += channel_size) {
+    for (int kl = 0; kl < kernel_l; ++kl) {
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          // The valid output columns only depend on kw, so the row copy below
+          // is a zero prefix, a contiguous (memcpy) or strided middle, and a
+          // zero suffix.
+          const int input_col_start = -pad_w + kw * dilation_w;
+          int w_begin, w_end;
+          valid_output_range(input_col_start, stride_w, width, width_col,
+              &w_begin, &w_end);
+          int input_frame = -pad_l + kl * dilation_l;
+          for (int l = 0; l < length_col; ++l) {
+            if (!is_a_ge_zero_and_a_lt_b(input_frame, length)) {
+              memset(data_col, 0, sizeof(Dtype) * height_col * width_col);
+              data_col += height_col * width_col;
+              input_frame += stride_l;
+              continue;
+            }
+            const Dtype* frame = data_im + input_frame * frame_size;
+            int input_row = -pad_h + kh * dilation_h;
+            for (int h = 0; h < height_col; ++h) {
+              if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+                memset(data_col, 0, sizeof(Dtype) * width_col);
+              } else {
+                const Dtype* row = frame + input_row * width + input_col_start;
+                memset(data_col, 0, sizeof(Dtype) * w_begin);
+                if (stride_w == 1) {
+                  memcpy(data_col + w_begin, row + w_begin,
+                      sizeof(Dtype) * (w_end - w_begin));
+                } else {
+                  for (int w = w_begin; w < w_end; ++w) {
+                    data_col[w] = row[w * stride_w];
+                  }
+                }
+                memset(data_col + w_end, 0, sizeof(Dtype) * (width_col - w_end));
+              }
+              data_col += width_col;
+              input_row += stride_h;
+            }
+            input_frame += stride_l;
+          }
         }
       }
     }
   }
 }
 
+// Explicit instantiation
+template void vol2col_cpu<float>(const float* data_im, const int channels,
+    const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    float* data_col);
+template void vol2col_cpu<double>(const double* data_im, const int channels,
+    const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    double* data_col);
+// For the int8 forward pass (see caffe/util/int8.hpp).
+template void vol2col_cpu<int8_t>(const int8_t* data_im, const int channels,
+    const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    int8_t* data_col);
+
+template <typename Dtype>
+void vol2col_cpu(const Dtype* data_im, const int channels, const int length,
+	    const int height, const int width, const int ksize, const int kdepth, const int pad,
+	    const int temporal_pad, const int stride, const int temporal_stride, Dtype* data_col) {
+  vol2col_cpu(data_im, channels, length, height, width,
+      kdepth, ksize, ksize, temporal_pad, pad, pad,
+      temporal_stride, stride, stride, 1, 1, 1, data_col);
+}
+
 // Explicit instantiation
 template void vol2col_cpu<float>(const float* data_im, const int channels, const int length,
     const int height, const int width, const int ksize, const int kdepth, const int pad,
@@ -62,37 +145,101 @@ template void vol2col_cpu<float>(const float* data_im, const int channels, const
 template void vol2col_cpu<double>(const double* data_im, const int channels,const int length,
 	    const int height, const int width, const int ksize, const int kdepth, const int pad,
 	    const int temporal_pad, const int stride, const int temporal_stride, double* data_col);
+template void vol2col_cpu<int8_t>(const int8_t* data_im, const int channels,
+    const int length, const int height, const int width, const int ksize,
+    const int kdepth, const int pad, const int temporal_pad, const int stride,
+    const int temporal_stride, int8_t* data_col);
+// For the fp16/bf16 forward pass (see caffe/util/half.hpp), which moves
+// the 16-bit values untouched.
+template void vol2col_cpu<uint16_t>(const uint16_t* data_im,
+    const int channels, const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    uint16_t* data_col);
+template void vol2col_cpu<uint16_t>(const uint16_t* data_im,
+    const int channels, const int length, const int height, const int width,
+    const int ksize, const int kdepth, const int pad, const int temporal_pad,
+    const int stride, const int temporal_stride, uint16_t* data_col);
 
 template <typename Dtype>
 void col2vol_cpu(const Dtype* data_col, const int channels, const int length,
-    const int height, const int width, const int ksize, const int kdepth, const int pad,
-    const int temporal_pad, const int stride, const int temporal_stride, Dtype* data_im) {
+    const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    Dtype* data_im) {
   memset(data_im, 0, sizeof(Dtype) * length * height * width * channels);
-  int length_col = (length + 2* temporal_pad - kdepth) / temporal_stride + 1;
-  int height_col = (height + 2 * pad - ksize) / stride + 1;
-  int width_col = (width + 2 * pad - ksize) / stride + 1;
-  int channels_col = channels * kdepth * ksize * ksize;
-  for (int c = 0; c < channels_col; ++c) {
-    int w_offset = c % ksize;
-    int h_offset = (c / ksize) % ksize;
-    int l_offset = (c / ksize / ksize) % kdepth;
-    int c_im = c / ksize / ksize / kdepth;
-    for (int l=0; l < length_col; ++l) {
-      for (int h = 0; h < height_col; ++h) {
-        for (int w = 0; w < width_col; ++w) {
-          int l_pad = l * temporal_stride - temporal_pad + l_offset;
-          int h_pad = h * stride - pad + h_offset;
-          int w_pad = w * stride - pad + w_offset;
-          if (h_pad >= 0 && h_pad < height && w_pad >= 0 && w_pad < width
-        		  && l_pad >= 0 && l_pad < length)
-            data_im[((c_im * length + l_pad) * height + h_pad) * width + w_pad] +=
-                data_col[((c * length_col + l) * height_col + h) * width_col + w];
+  const int length_col = (length + 2 * pad_l -
+      (dilation_l * (kernel_l - 1) + 1)) / stride_l + 1;
+  const int height_col = (height + 2 * pad_h -
+      (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
+  const int width_col = (width + 2 * pad_w -
+      (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
+  const int frame_size = height * width;
+  const int channel_size = length * frame_size;
+  for (int channel = channels; channel--; data_im += channel_size) {
+    for (int kl = 0; kl < kernel_l; ++kl) {
+      for (int kh = 0; kh < kernel_h; ++kh) {
+        for (int kw = 0; kw < kernel_w; ++kw) {
+          const int input_col_start = -pad_w + kw * dilation_w;
+          int w_begin, w_end;
+          valid_output_range(input_col_start, stride_w, width, width_col,
+              &w_begin, &w_end);
+          int input_frame = -pad_l + kl * dilation_l;
+          for (int l = 0; l < length_col; ++l) {
+            if (!is_a_ge_zero_and_a_lt_b(input_frame, length)) {
+              data_col += height_col * width_col;
+              input_frame += stride_l;
+              continue;
+            }
+            Dtype* frame = data_im + input_frame * frame_size;
+            int input_row = -pad_h + kh * dilation_h;
+            for (int h = 0; h < height_col; ++h) {
+              if (is_a_ge_zero_and_a_lt_b(input_row, height)) {
+                Dtype* row = frame + input_row * width + input_col_start;
+                for (int w = w_begin; w < w_end; ++w) {
+                  row[w * stride_w] += data_col[w];
+                }
+              }
+              data_col += width_col;
+              input_row += stride_h;
+            }
+            input_frame += stride_l;
+          }
         }
       }
     }
   }
 }
 
+// Explicit instantiation
+template void col2vol_cpu<float>(const float* data_col, const int channels,
+    const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    float* data_im);
+template void col2vol_cpu<double>(const double* data_col, const int channels,
+    const int length, const int height, const int width,
+    const int kernel_l, const int kernel_h, const int kernel_w,
+    const int pad_l, const int pad_h, const int pad_w,
+    const int stride_l, const int stride_h, const int stride_w,
+    const int dilation_l, const int dilation_h, const int dilation_w,
+    double* data_im);
+
+template <typename Dtype>
+void col2vol_cpu(const Dtype* data_col, const int channels, const int length,
+    const int height, const int width, const int ksize, const int kdepth, const int pad,
+    const int temporal_pad, const int stride, const int temporal_stride, Dtype* data_im) {
+  col2vol_cpu(data_col, channels, length, height, width,
+      kdepth, ksize, ksize, temporal_pad, pad, pad,
+      temporal_stride, stride, stride, 1, 1, 1, data_im);
+}
+
 // Explicit instantiation
 template void col2vol_cpu<float>(const float* data_col, const int channels, const int length,
 	    const int height, const int width, const int ksize, const int kdepth, const int pad,
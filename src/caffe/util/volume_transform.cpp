@@ -0,0 +1,170 @@
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/volume_transform.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Pixels gathered at a time from interleaved rows.
+const int kRowChunk = 256;
+
+// Expands values given for all channels, per channel, or per channel and
+// frame to one per frame of every channel, channel-major.
+void ExpandPlaneValues(const google::protobuf::RepeatedField<float>& values,
+    const int channels, const int length, const char* name,
+    std::vector<float>* planes) {
+  const int size = values.size();
+  CHECK(size == 1 || size == channels || size == channels * length)
+      << "Specify 1, " << channels << " or " << channels * length << " "
+      << name << " values, not " << size;
+  planes->resize(channels * length);
+  for (int c = 0; c < channels; ++c) {
+    for (int l = 0; l < length; ++l) {
+      const int i = size == 1 ? 0 : (size == channels ? c : c * length + l);
+      (*planes)[c * length + l] = values.Get(i);
+    }
+  }
+}
+
+// out[i] (or out[n-1-i] with mirror) = (in[i] - mean[i] or mean_value) * scale
+template <typename Dtype>
+void transform_row(const uint8_t* in, const int n, const Dtype* mean,
+    const Dtype mean_value, const Dtype scale, const bool mirror, Dtype* out) {
+  for (int i = 0; i < n; ++i) {
+    const Dtype pixel = static_cast<Dtype>(in[i]);
+    out[mirror ? n - 1 - i : i] = (pixel - (mean ? mean[i] : mean_value))
+        * scale;
+  }
+}
+
+#ifdef __SSE2__
+template <>
+void transform_row<float>(const uint8_t* in, const int n, const float* mean,
+    const float mean_value, const float scale, const bool mirror, float* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale_v = _mm_set1_ps(scale);
+  const __m128 mean_value_v = _mm_set1_ps(mean_value);
+  int i = 0;
+  for (; i + 16 <= n; i += 16) {
+    // Widen 16 bytes to four vectors of four floats.
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128 pixels[4];
+    pixels[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+    pixels[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+    pixels[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+    pixels[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+    for (int k = 0; k < 4; ++k) {
+      const __m128 mean_v = mean ? _mm_loadu_ps(mean + i + 4 * k)
+                                 : mean_value_v;
+      const __m128 value = _mm_mul_ps(_mm_sub_ps(pixels[k], mean_v), scale_v);
+      if (mirror) {
+        _mm_storeu_ps(out + n - i - 4 * (k + 1),
+            _mm_shuffle_ps(value, value, _MM_SHUFFLE(0, 1, 2, 3)));
+      } else {
+        _mm_storeu_ps(out + i + 4 * k, value);
+      }
+    }
+  }
+  for (; i < n; ++i) {
+    const float pixel = static_cast<float>(in[i]);
+    out[mirror ? n - 1 - i : i] = (pixel - (mean ? mean[i] : mean_value))
+        * scale;
+  }
+}
+#endif  // __SSE2__
+
+}  // namespace
+
+template <typename Dtype>
+void transform_frame_cpu(const uint8_t* data, const int channels,
+    const int height, const int width, const int channel_stride,
+    const int row_stride, const int pixel_stride, const bool mirror,
+    const Dtype* mean, const int mean_channel_stride,
+    const int mean_row_stride, const Dtype* mean_values, const Dtype scale,
+    Dtype* out, const int out_channel_stride) {
+  uint8_t row[kRowChunk];
+  for (int c = 0; c < channels; ++c) {
+    const Dtype mean_value = mean_values ? mean_values[c] : Dtype(0);
+    for (int h = 0; h < height; ++h) {
+      const uint8_t* in_row = data + c * channel_stride + h * row_stride;
+      const Dtype* mean_row =
+          mean ? mean + c * mean_channel_stride + h * mean_row_stride : NULL;
+      Dtype* out_row = out + c * out_channel_stride + h * width;
+      if (pixel_stride == 1) {
+        transform_row(in_row, width, mean_row, mean_value, scale, mirror,
+            out_row);
+        continue;
+      }
+      // Gather the channel out of interleaved pixels a chunk at a time.
+      for (int w = 0; w < width; w += kRowChunk) {
+        const int n = std::min(kRowChunk, width - w);
+        for (int i = 0; i < n; ++i) {
+          row[i] = in_row[(w + i) * pixel_stride];
+        }
+        transform_row(row, n, mean_row ? mean_row + w : NULL, mean_value,
+            scale, mirror, out_row + (mirror ? width - w - n : w));
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void GetPlaneMeanAndScale(const C3DMultiLabelVideoDataParameter& param,
+    const int channels, const int length, std::vector<Dtype>* plane_mean,
+    std::vector<Dtype>* plane_scale) {
+  const int planes = channels * length;
+  std::vector<float> values;
+  plane_mean->assign(planes, param.mean_value());
+  if (param.channel_mean_size()) {
+    CHECK(!param.has_mean_file())
+        << "Cannot specify mean_file and channel_mean at the same time";
+    CHECK(!param.has_mean_value())
+        << "Cannot specify mean_value and channel_mean at the same time";
+    ExpandPlaneValues(param.channel_mean(), channels, length, "channel_mean",
+        &values);
+    plane_mean->assign(values.begin(), values.end());
+  }
+  plane_scale->assign(planes, param.scale());
+  if (param.channel_std_size()) {
+    ExpandPlaneValues(param.channel_std(), channels, length, "channel_std",
+        &values);
+    for (int i = 0; i < planes; ++i) {
+      CHECK_GT(values[i], 0) << "channel_std must be positive";
+      (*plane_scale)[i] = param.scale() / values[i];
+    }
+  }
+}
+
+template void GetPlaneMeanAndScale<float>(
+    const C3DMultiLabelVideoDataParameter& param, const int channels,
+    const int length, std::vector<float>* plane_mean,
+    std::vector<float>* plane_scale);
+template void GetPlaneMeanAndScale<double>(
+    const C3DMultiLabelVideoDataParameter& param, const int channels,
+    const int length, std::vector<double>* plane_mean,
+    std::vector<double>* plane_scale);
+
+template void transform_frame_cpu<float>(const uint8_t* data,
+    const int channels, const int height, const int width,
+    const int channel_stride, const int row_stride, const int pixel_stride,
+    const bool mirror, const float* mean, const int mean_channel_stride,
+    const int mean_row_stride, const float* mean_values, const float scale,
+    float* out, const int out_channel_stride);
+template void transform_frame_cpu<double>(const uint8_t* data,
+    const int channels, const int height, const int width,
+    const int channel_stride, const int row_stride, const int pixel_stride,
+    const bool mirror, const double* mean, const int mean_channel_stride,
+    const int mean_row_stride, const double* mean_values, const double scale,
+    double* out, const int out_channel_stride);
+
+}  // namespace caffe
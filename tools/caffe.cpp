@@ -18,6 +18,7 @@ namespace bp = boost::python;
 using caffe::Blob;
 using caffe::Caffe;
 using caffe::Net;
+using caffe::NetProfiler;
 using caffe::Layer;
 using caffe::Solver;
 using caffe::shared_ptr;
@@ -46,8 +47,22 @@ DEFINE_string(snapshot, "",
 DEFINE_string(weights, "",
     "Optional; the pretrained weights to initialize finetuning, "
     "separated by ','. Cannot be set simultaneously with snapshot.");
+DEFINE_int32(cpu_workers, 1,
+    "Optional; train in CPU mode with this many solvers on worker threads, "
+    "each taking its own batches from the data layers. The effective "
+    "training batch size is multiplied by the number of workers. Consider "
+    "limiting the BLAS threads (e.g. OPENBLAS_NUM_THREADS) accordingly.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(profile_json, "",
+    "Optional; for 'time', profile the net passes and write per-layer time "
+    "percentiles, FLOPs, bytes and throughput to this JSON file.");
+DEFINE_string(profile_trace, "",
+    "Optional; for 'time', profile the net passes and write the layer calls "
+    "to this Chrome trace file (chrome://tracing).");
+DEFINE_string(host_allocator, "malloc",
+    "Optional; the allocator of host memory: malloc, or pool to cache freed "
+    "blocks in size classes (huge-page backed) for reuse.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -206,10 +221,13 @@ int train() {
 
   vector<int> gpus;
   get_gpus(&gpus);
+  CHECK_GE(FLAGS_cpu_workers, 1);
   if (gpus.size() == 0) {
     LOG(INFO) << "Use CPU.";
     Caffe::set_mode(Caffe::CPU);
+    Caffe::set_solver_count(FLAGS_cpu_workers);
   } else {
+    CHECK_EQ(FLAGS_cpu_workers, 1) << "cpu_workers is for CPU training only";
     ostringstream s;
     for (int i = 0; i < gpus.size(); ++i) {
       s << (i ? ", " : "") << gpus[i];
@@ -245,6 +263,9 @@ int train() {
   if (gpus.size() > 1) {
     caffe::P2PSync<float> sync(solver, NULL, solver->param());
     sync.Run(gpus);
+  } else if (FLAGS_cpu_workers > 1) {
+    caffe::CPUSync<float> sync(solver);
+    sync.Run();
   } else {
     LOG(INFO) << "Starting Optimization";
     solver->Solve();
@@ -328,6 +349,30 @@ int test() {
 RegisterBrewFunction(test);
 
 
+// Profile the passes of a net through its profiler, for time.
+int profile(Net<float>* caffe_net) {
+  NetProfiler<float> profiler(*caffe_net);
+  caffe_net->set_profiler(&profiler);
+  LOG(INFO) << "*** Profiling begins ***";
+  LOG(INFO) << "Profiling for " << FLAGS_iterations << " iterations.";
+  for (int j = 0; j < FLAGS_iterations; ++j) {
+    caffe_net->Forward();
+    caffe_net->Backward();
+  }
+  caffe_net->set_profiler(NULL);
+  profiler.LogSummary();
+  if (FLAGS_profile_json.size()) {
+    profiler.WriteJSON(FLAGS_profile_json);
+    LOG(INFO) << "Wrote " << FLAGS_profile_json;
+  }
+  if (FLAGS_profile_trace.size()) {
+    profiler.WriteChromeTrace(FLAGS_profile_trace);
+    LOG(INFO) << "Wrote " << FLAGS_profile_trace;
+  }
+  LOG(INFO) << "*** Profiling ends ***";
+  return 0;
+}
+
 // Time: benchmark the execution time of a model.
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
@@ -359,6 +404,10 @@ int time() {
   LOG(INFO) << "Performing Backward";
   caffe_net.Backward();
 
+  if (FLAGS_profile_json.size() || FLAGS_profile_trace.size()) {
+    return profile(&caffe_net);
+  }
+
   const vector<shared_ptr<Layer<float> > >& layers = caffe_net.layers();
   const vector<vector<Blob<float>*> >& bottom_vecs = caffe_net.bottom_vecs();
   const vector<vector<Blob<float>*> >& top_vecs = caffe_net.top_vecs();
@@ -434,11 +483,15 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  caffe::HostAllocator::Set(
+      caffe::HostAllocator::ByName(FLAGS_host_allocator));
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
 #endif
-      return GetBrewFunction(caffe::string(argv[1]))();
+      const int result = GetBrewFunction(caffe::string(argv[1]))();
+      caffe::HostAllocator::Get()->LogStats();
+      return result;
 #ifdef WITH_PYTHON_LAYER
     } catch (bp::error_already_set) {
       PyErr_Print();
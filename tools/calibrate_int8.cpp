@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(iterations, 20,
+    "Batches run to record the input ranges of the quantized layers.");
+DEFINE_int32(test_iterations, 20,
+    "Batches run by the float and the int8 net to compare them; 0 to skip.");
+DEFINE_string(float_layers, "",
+    "Optional; comma-separated names of layers to keep in float, e.g. the "
+    "first convolution and the classifier.");
+DEFINE_string(compare_blobs, "",
+    "Optional; comma-separated blobs whose relative L2 error and top-1 "
+    "agreement between the float and the int8 net are reported.");
+DEFINE_bool(per_channel, true,
+    "Record one input range per channel instead of one per layer.");
+
+namespace {
+
+bool IsQuantizable(const LayerParameter& layer) {
+  const string& type = layer.type();
+  return type == "Convolution" || type == "NdConvolution" ||
+      type == "Convolution3D" || type == "InnerProduct";
+}
+
+// Axis of the channels whose ranges are recorded for a layer.
+int ChannelAxis(const Layer<float>& layer, const Blob<float>& bottom) {
+  if (layer.layer_param().type() == "InnerProduct") {
+    return bottom.CanonicalAxisIndex(layer.layer_param().inner_product_param()
+        .axis());
+  }
+  return 1;
+}
+
+vector<string> SplitNames(const string& names) {
+  vector<string> result;
+  std::stringstream stream(names);
+  string name;
+  while (std::getline(stream, name, ',')) {
+    if (!name.empty()) {
+      result.push_back(name);
+    }
+  }
+  return result;
+}
+
+// Forward pass timing the quantizable layers; returns their time in ms.
+double TimedForward(Net<float>* net) {
+  const vector<shared_ptr<Layer<float> > >& layers = net->layers();
+  double compute_ms = 0;
+  Timer timer;
+  for (int i = 0; i < layers.size(); ++i) {
+    const bool quantizable = IsQuantizable(layers[i]->layer_param());
+    if (quantizable) {
+      timer.Start();
+    }
+    layers[i]->Forward(net->bottom_vecs()[i], net->top_vecs()[i]);
+    if (quantizable) {
+      compute_ms += timer.MilliSeconds();
+    }
+  }
+  return compute_ms;
+}
+
+double Mean(const Blob<float>& blob) {
+  double sum = 0;
+  for (int i = 0; i < blob.count(); ++i) {
+    sum += blob.cpu_data()[i];
+  }
+  return sum / blob.count();
+}
+
+int ArgMax(const float* x, const int n) {
+  return std::max_element(x, x + n) - x;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Calibrate the int8 inference of a net.\n"
+      "Usage:\n"
+      "    calibrate_int8 [FLAGS] net_proto pretrained_model output_proto\n"
+      "Runs the TEST net on CPU to record the input range of every "
+      "convolution and inner product layer, writes net_proto with their "
+      "quantization_param to output_proto, and reports the outputs, "
+      "accuracy and speed of the float and the int8 net.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  GlobalInit(&argc, &argv);
+  if (argc != 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/calibrate_int8");
+    return 1;
+  }
+  Caffe::set_mode(Caffe::CPU);
+  const string pretrained_model(argv[2]);
+
+  NetParameter float_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &float_param);
+  for (int i = 0; i < float_param.layer_size(); ++i) {
+    float_param.mutable_layer(i)->clear_quantization_param();
+  }
+  NetParameter net_param(float_param);
+  net_param.mutable_state()->set_phase(TEST);
+  const vector<string> float_layer_names = SplitNames(FLAGS_float_layers);
+  const std::set<string> float_layers(float_layer_names.begin(),
+      float_layer_names.end());
+
+  // Record the maximum magnitude of every input channel.
+  Net<float> net(net_param);
+  net.CopyTrainedLayersFrom(pretrained_model);
+  std::map<string, vector<float> > ranges;
+  for (int iter = 0; iter < FLAGS_iterations; ++iter) {
+    for (int i = 0; i < net.layers().size(); ++i) {
+      const Layer<float>& layer = *net.layers()[i];
+      const string& name = layer.layer_param().name();
+      if (IsQuantizable(layer.layer_param()) && !float_layers.count(name)) {
+        const Blob<float>& bottom = *net.bottom_vecs()[i][0];
+        const int axis = ChannelAxis(layer, bottom);
+        const int channels = bottom.shape(axis);
+        const int inner = bottom.count(axis + 1);
+        vector<float>& range = ranges[name];
+        range.resize(channels, 0);
+        const float* data = bottom.cpu_data();
+        for (int j = 0; j < bottom.count(); ++j) {
+          float* r = &range[j / inner % channels];
+          *r = std::max(*r, std::fabs(data[j]));
+        }
+      }
+      net.ForwardFromTo(i, i);
+    }
+  }
+
+  NetParameter int8_param(float_param);
+  for (int i = 0; i < int8_param.layer_size(); ++i) {
+    LayerParameter* layer = int8_param.mutable_layer(i);
+    std::map<string, vector<float> >::const_iterator range =
+        ranges.find(layer->name());
+    if (range == ranges.end()) {
+      continue;
+    }
+    QuantizationParameter* quantization = layer->mutable_quantization_param();
+    if (FLAGS_per_channel) {
+      for (int c = 0; c < range->second.size(); ++c) {
+        quantization->add_input_range(range->second[c]);
+      }
+    } else {
+      quantization->add_input_range(*std::max_element(range->second.begin(),
+          range->second.end()));
+    }
+    LOG(INFO) << "Quantized " << layer->name() << " with "
+        << range->second.size() << " input channels";
+  }
+  WriteProtoToTextFile(int8_param, argv[3]);
+  LOG(INFO) << "Wrote " << argv[3];
+  if (FLAGS_test_iterations <= 0) {
+    return 0;
+  }
+
+  // Both nets read the same batches if the data layers don't shuffle.
+  int8_param.mutable_state()->set_phase(TEST);
+  Net<float> float_net(net_param);
+  Net<float> int8_net(int8_param);
+  float_net.CopyTrainedLayersFrom(pretrained_model);
+  int8_net.CopyTrainedLayersFrom(pretrained_model);
+  const vector<string> compare_blobs = SplitNames(FLAGS_compare_blobs);
+  for (int k = 0; k < compare_blobs.size(); ++k) {
+    CHECK(float_net.has_blob(compare_blobs[k]))
+        << "Unknown blob " << compare_blobs[k];
+  }
+  const int num_outputs = float_net.num_outputs();
+  vector<double> float_outputs(num_outputs, 0);
+  vector<double> int8_outputs(num_outputs, 0);
+  vector<double> error_norms(compare_blobs.size(), 0);
+  vector<double> norms(compare_blobs.size(), 0);
+  vector<int> agreements(compare_blobs.size(), 0);
+  vector<int> rows(compare_blobs.size(), 0);
+  double float_ms = 0;
+  double int8_ms = 0;
+  int clips = 0;
+  int batch_size = 1;
+  for (int i = 0; i < float_net.layers().size(); ++i) {
+    if (IsQuantizable(float_net.layers()[i]->layer_param())) {
+      batch_size = float_net.bottom_vecs()[i][0]->shape(0);
+      break;
+    }
+  }
+  for (int iter = 0; iter < FLAGS_test_iterations; ++iter) {
+    float_ms += TimedForward(&float_net);
+    int8_ms += TimedForward(&int8_net);
+    clips += batch_size;
+    for (int j = 0; j < num_outputs; ++j) {
+      const Blob<float>& f = *float_net.output_blobs()[j];
+      const Blob<float>& q = *int8_net.output_blobs()[j];
+      float_outputs[j] += Mean(f);
+      int8_outputs[j] += Mean(q);
+    }
+    for (int k = 0; k < compare_blobs.size(); ++k) {
+      const Blob<float>& f = *float_net.blob_by_name(compare_blobs[k]);
+      const Blob<float>& q = *int8_net.blob_by_name(compare_blobs[k]);
+      for (int j = 0; j < f.count(); ++j) {
+        const double d = f.cpu_data()[j] - q.cpu_data()[j];
+        error_norms[k] += d * d;
+        norms[k] += static_cast<double>(f.cpu_data()[j]) * f.cpu_data()[j];
+      }
+      const int num = f.shape(0);
+      const int dim = f.count() / num;
+      for (int n = 0; n < num; ++n) {
+        agreements[k] += ArgMax(f.cpu_data() + n * dim, dim) ==
+            ArgMax(q.cpu_data() + n * dim, dim);
+      }
+      rows[k] += num;
+    }
+  }
+  for (int j = 0; j < num_outputs; ++j) {
+    const string& name =
+        float_net.blob_names()[float_net.output_blob_indices()[j]];
+    const double f = float_outputs[j] / FLAGS_test_iterations;
+    const double q = int8_outputs[j] / FLAGS_test_iterations;
+    LOG(INFO) << "Output " << name << ": float " << f << ", int8 " << q
+        << " (" << q - f << ")";
+  }
+  for (int k = 0; k < compare_blobs.size(); ++k) {
+    LOG(INFO) << "Blob " << compare_blobs[k] << ": relative L2 error "
+        << std::sqrt(error_norms[k] / std::max(norms[k], 1e-30))
+        << ", top-1 agreement " << 100. * agreements[k] / rows[k] << "%";
+  }
+  LOG(INFO) << "Convolution and inner product layers: float "
+      << clips * 1000. / float_ms << " clips/s, int8 "
+      << clips * 1000. / int8_ms << " clips/s ("
+      << float_ms / int8_ms << "x)";
+  return 0;
+}
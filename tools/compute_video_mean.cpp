@@ -0,0 +1,212 @@
+// This program computes the mean clip of a list of videos, or of folders of
+// frames with --use_image, as the 1 x C x L x H x W mean_file of
+// c3d_multi_label_video_data_param. The list has the "path start_frm labels"
+// lines of the data layer; clips are decoded on --threads threads, each
+// adding its clips up in its own int64 sums, and --sample_fraction of the
+// lines picked at random (but reproducibly with --seed) are enough for a
+// good estimate on large lists. tools/mean_cube_to_channels reduces the
+// result to per-channel means.
+// Usage:
+//    compute_video_mean [FLAGS] LIST_FILE [OUTPUT_FILE]
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
+#ifdef USE_OPENCV
+#include "caffe/util/c3d_multi_label_image_io.hpp"
+#endif  // USE_OPENCV
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+using std::string;
+using std::vector;
+
+DEFINE_bool(use_image, false,
+    "The paths are folders of frames instead of video files");
+DEFINE_int32(new_length, 16, "Frames per clip");
+DEFINE_int32(new_height, 0, "Resize the frames to this height, if not 0");
+DEFINE_int32(new_width, 0, "Resize the frames to this width, if not 0");
+DEFINE_int32(sampling_rate, 1, "Take every sampling_rate-th frame");
+DEFINE_double(sample_fraction, 1.,
+    "Fraction of the lines of the list to average");
+DEFINE_int32(seed, 1701, "Seed of the choice of the lines to average");
+DEFINE_int32(threads, 0, "Decoding threads; 0 for one per hardware thread");
+
+#ifdef USE_OPENCV
+namespace {
+
+struct Clip {
+  string path;
+  int start_frm;
+  vector<int> label;
+};
+
+// The running sums of one worker.
+struct Sums {
+  Sums() : count(0), failed(0) {}
+  vector<int64_t> data;
+  int count;
+  int failed;
+};
+
+bool ReadClip(const Clip& clip, C3DMultiLabelVolumeDatum* datum) {
+  if (FLAGS_use_image) {
+    return ReadImageSequenceToVolumeDatum(clip.path.c_str(), clip.start_frm,
+        clip.label, FLAGS_new_length, FLAGS_new_height, FLAGS_new_width,
+        FLAGS_sampling_rate, datum);
+  }
+  return ReadVideoToVolumeDatum(clip.path.c_str(), clip.start_frm,
+      clip.label, FLAGS_new_length, FLAGS_new_height, FLAGS_new_width,
+      FLAGS_sampling_rate, datum);
+}
+
+// Adds up the clips handed out by next until there are none left.
+void SumClips(const vector<Clip>* clips, int size, boost::atomic<int>* next,
+    vector<Sums>* sums, int worker) {
+  Sums& own = (*sums)[worker];
+  own.data.assign(size, 0);
+  C3DMultiLabelVolumeDatum datum;
+  const int num_clips = clips->size();
+  for (int i = next->fetch_add(1); i < num_clips; i = next->fetch_add(1)) {
+    if (!ReadClip((*clips)[i], &datum)) {
+      LOG(WARNING) << "Could not read " << (*clips)[i].path << " from frame "
+          << (*clips)[i].start_frm;
+      ++own.failed;
+      continue;
+    }
+    const string& data = datum.data();
+    CHECK_EQ(static_cast<int>(data.size()), size) << "Clips of "
+        << (*clips)[i].path << " differ in size from the first one";
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(data.data());
+    for (int j = 0; j < size; ++j) {
+      own.data[j] += pixels[j];
+    }
+    if (++own.count % 10000 == 0) {
+      LOG(INFO) << "Worker " << worker << " processed " << own.count
+          << " clips.";
+    }
+  }
+}
+
+}  // namespace
+#endif  // USE_OPENCV
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+
+#ifdef USE_OPENCV
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Compute the mean clip of a list of videos\n"
+        "Usage:\n"
+        "    compute_video_mean [FLAGS] LIST_FILE [OUTPUT_FILE]\n");
+
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 2 || argc > 3) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_video_mean");
+    return 1;
+  }
+  CHECK_GT(FLAGS_sample_fraction, 0);
+  CHECK_LE(FLAGS_sample_fraction, 1);
+
+  vector<Clip> clips;
+  std::ifstream infile(argv[1]);
+  CHECK(infile.good()) << "Failed to open list file " << argv[1];
+  Clip clip;
+  string label;
+  while (infile >> clip.path >> clip.start_frm >> label) {
+    std::istringstream iss(label);
+    string l;
+    clip.label.clear();
+    while (std::getline(iss, l, ',')) {
+      clip.label.push_back(atoi(l.c_str()));
+    }
+    clips.push_back(clip);
+  }
+  CHECK(!clips.empty()) << "No clips in " << argv[1];
+  if (FLAGS_sample_fraction < 1) {
+    rng_t rng(FLAGS_seed);
+    shuffle(clips.begin(), clips.end(), &rng);
+    clips.resize(std::max<int>(1, clips.size() * FLAGS_sample_fraction));
+  }
+  LOG(INFO) << "Averaging " << clips.size() << " clips.";
+
+  // The first readable clip gives the shape of the mean.
+  C3DMultiLabelVolumeDatum datum;
+  const int num_clips = clips.size();
+  int first = 0;
+  while (first < num_clips && !ReadClip(clips[first], &datum)) {
+    ++first;
+  }
+  CHECK_LT(first, num_clips) << "Could not read any clip";
+  CHECK(datum.data().size()) << "Expected uint8 clips";
+  const int size = datum.data().size();
+
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads :
+      ThreadPool::Get().num_threads();
+  ThreadPool pool(threads);
+  vector<Sums> sums(threads);
+  boost::atomic<int> next(first);
+  LOG(INFO) << "Starting " << threads << " workers";
+  pool.Run(threads, boost::bind(&SumClips, &clips, size, &next, &sums, _1));
+
+  Sums total;
+  total.data.assign(size, 0);
+  total.failed = first;
+  for (int t = 0; t < threads; ++t) {
+    for (int j = 0; j < size; ++j) {
+      total.data[j] += sums[t].data[j];
+    }
+    total.count += sums[t].count;
+    total.failed += sums[t].failed;
+  }
+  LOG(INFO) << "Processed " << total.count << " clips, could not read "
+      << total.failed << ".";
+
+  BlobProto mean_blob;
+  mean_blob.mutable_shape()->add_dim(1);
+  mean_blob.mutable_shape()->add_dim(datum.channels());
+  mean_blob.mutable_shape()->add_dim(datum.length());
+  mean_blob.mutable_shape()->add_dim(datum.height());
+  mean_blob.mutable_shape()->add_dim(datum.width());
+  for (int j = 0; j < size; ++j) {
+    mean_blob.add_data(static_cast<double>(total.data[j]) / total.count);
+  }
+  // Write to disk
+  if (argc == 3) {
+    LOG(INFO) << "Write to " << argv[2];
+    WriteProtoToBinaryFile(mean_blob, argv[2]);
+  }
+  const int channels = datum.channels();
+  const int dim = size / channels;
+  LOG(INFO) << "Number of channels: " << channels;
+  for (int c = 0; c < channels; ++c) {
+    double mean_value = 0;
+    for (int i = 0; i < dim; ++i) {
+      mean_value += mean_blob.data(dim * c + i);
+    }
+    LOG(INFO) << "mean_value channel [" << c << "]:" << mean_value / dim;
+  }
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
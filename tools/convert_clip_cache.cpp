@@ -0,0 +1,126 @@
+// This program decodes the clips of a video list once and stores them,
+// resized, as raw uint8 volumes in a clip cache that MultiLabelVideoData
+// layers read memory-mapped (see MultiLabelVideoDataParameter.clip_cache).
+// Usage:
+//   convert_clip_cache [FLAGS] ROOTFOLDER/ LISTFILE CACHE_FILE
+//
+// where ROOTFOLDER is the root folder that holds all the videos (or folders
+// of extracted frames), and LISTFILE is in the format of the
+// MultiLabelVideoData source, one clip per line:
+//   subfolder1/video1.avi 1 0,1,0,0
+//   ....
+// giving the video, its 1-based start frame and the comma separated labels.
+
+#include <stdint.h>
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/util/clip_cache.hpp"
+#include "caffe/util/io.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_bool(gray, false,
+    "When this option is on, treat videos as grayscale ones");
+DEFINE_int32(new_length, 16, "Number of frames per clip");
+DEFINE_int32(resize_width, 0, "Width frames are resized to");
+DEFINE_int32(resize_height, 0, "Height frames are resized to");
+
+int main(int argc, char** argv) {
+#ifdef USE_OPENCV
+  ::google::InitGoogleLogging(argv[0]);
+  // Print output to stderr (while still logging)
+  FLAGS_alsologtostderr = 1;
+
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+
+  gflags::SetUsageMessage("Decode the clips of a video list into a clip\n"
+        "cache read by MultiLabelVideoData layers.\n"
+        "Usage:\n"
+        "    convert_clip_cache [FLAGS] ROOTFOLDER/ LISTFILE CACHE_FILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 4) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_clip_cache");
+    return 1;
+  }
+
+  const bool is_color = !FLAGS_gray;
+  const int new_length = FLAGS_new_length;
+  const int resize_height = std::max<int>(0, FLAGS_resize_height);
+  const int resize_width = std::max<int>(0, FLAGS_resize_width);
+  CHECK_GT(new_length, 0);
+  CHECK((resize_height == 0 && resize_width == 0) ||
+      (resize_height > 0 && resize_width > 0))
+      << "resize_height and resize_width must be set at the same time.";
+
+  std::ifstream infile(argv[2]);
+  CHECK(infile.good()) << "Failed to open " << argv[2];
+  const std::string root_folder(argv[1]);
+  ClipCacheWriter writer(argv[3]);
+
+  std::string filename, multilabel;
+  int start_frame;
+  int line_id = 0;
+  std::vector<uint8_t> volume;
+  while (infile >> filename >> start_frame >> multilabel) {
+    std::vector<int> labels;
+    std::istringstream iss(multilabel);
+    std::string l;
+    while (std::getline(iss, l, ',')) {
+      labels.push_back(atoi(l.c_str()));
+    }
+
+    std::vector<cv::Mat> cv_imgs;
+    // Every list line must become one clip, the layer addresses clips by
+    // their position in the list.
+    CHECK(ReadVideoToCVMat(root_folder + filename, start_frame, new_length,
+        resize_height, resize_width, is_color, &cv_imgs))
+        << "Could not load " << filename << " at frame " << start_frame;
+    CHECK_EQ(cv_imgs.size(), new_length) << "Could not load " << filename
+        << " at frame " << start_frame << " correctly.";
+
+    // Interleaved H x W x C frames to a planar C x L x H x W volume.
+    const int channels = cv_imgs[0].channels();
+    const int height = cv_imgs[0].rows;
+    const int width = cv_imgs[0].cols;
+    volume.resize(static_cast<size_t>(channels) * new_length * height * width);
+    for (int t = 0; t < new_length; ++t) {
+      const cv::Mat& frame = cv_imgs[t];
+      CHECK_EQ(frame.channels(), channels);
+      CHECK_EQ(frame.rows, height);
+      CHECK_EQ(frame.cols, width);
+      for (int h = 0; h < height; ++h) {
+        const uchar* ptr = frame.ptr<uchar>(h);
+        for (int w = 0; w < width; ++w) {
+          for (int c = 0; c < channels; ++c) {
+            volume[((c * new_length + t) * height + h) * width + w] = *ptr++;
+          }
+        }
+      }
+    }
+    writer.Add(&volume[0], channels, new_length, height, width, labels);
+
+    if (++line_id % 1000 == 0) {
+      LOG(INFO) << "Processed " << line_id << " clips.";
+    }
+  }
+  writer.Close();
+  LOG(INFO) << "Processed " << line_id << " clips.";
+#else
+  LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  return 0;
+}
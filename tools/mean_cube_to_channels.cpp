@@ -0,0 +1,71 @@
+// This program reduces a mean file (a 1 x C x L x H x W or 1 x C x H x W
+// .binaryproto) to the mean of every channel, or of every frame of every
+// channel with --per_frame, and prints them as the channel_mean lines of
+// c3d_multi_label_video_data_param, so the layer subtracts constants instead
+// of reading the cube.
+// Usage:
+//    mean_cube_to_channels [FLAGS] MEAN_FILE
+
+#include <cstdio>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+
+using caffe::Blob;
+using caffe::BlobProto;
+using std::vector;
+
+DEFINE_bool(per_frame, false,
+    "Print the mean of every frame of every channel (channel-major) instead "
+    "of one per channel");
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Reduce a mean file to per-channel means.\n"
+        "Usage:\n"
+        "    mean_cube_to_channels [FLAGS] MEAN_FILE\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc != 2) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/mean_cube_to_channels");
+    return 1;
+  }
+
+  BlobProto blob_proto;
+  caffe::ReadProtoFromBinaryFileOrDie(argv[1], &blob_proto);
+  Blob<float> mean;
+  mean.FromProto(blob_proto);
+  CHECK(mean.num_axes() == 4 || mean.num_axes() == 5)
+      << "Expected a 4-D or 5-D mean, got " << mean.shape_string();
+  CHECK_EQ(mean.shape(0), 1);
+  const int channels = mean.shape(1);
+  const int length = mean.num_axes() == 5 ? mean.shape(2) : 1;
+  const int plane = mean.count(mean.num_axes() - 2);
+  LOG(INFO) << "Mean of " << channels << " channels of " << length
+      << " frames of " << plane << " pixels";
+
+  // Sum in double: a frame has up to millions of pixels.
+  const int frames = FLAGS_per_frame ? length : 1;
+  const float* data = mean.cpu_data();
+  vector<double> sums(channels * frames, 0);
+  for (int c = 0; c < channels; ++c) {
+    for (int l = 0; l < length; ++l) {
+      double& sum = sums[c * frames + (FLAGS_per_frame ? l : 0)];
+      for (int i = 0; i < plane; ++i) {
+        sum += data[(c * length + l) * plane + i];
+      }
+    }
+  }
+  const double pixels = static_cast<double>(plane) * (length / frames);
+  for (int i = 0; i < sums.size(); ++i) {
+    printf("channel_mean: %g\n", sums[i] / pixels);
+  }
+  return 0;
+}
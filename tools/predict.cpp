@@ -1,25 +1,111 @@
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>  // for snprintf
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 // #include <cuda_runtime.h>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "gflags/gflags.h"
+
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/net.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/c3d_multi_label_image_io.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/image_io.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+#include "caffe/util/video_frame_reader.hpp"
+#include "caffe/util/volume_transform.hpp"
 #include "google/protobuf/text_format.h"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
+DEFINE_bool(serve, false,
+    "Run as a long-lived server that extracts features for clips requested "
+    "on stdin or --socket instead of walking the data layer's list.");
+DEFINE_string(socket, "",
+    "Optional; with --serve, the path of a Unix domain socket to accept "
+    "requests on. Requests are read from stdin if empty.");
+DEFINE_string(output, "",
+    "Optional; with --serve, append the features to this file and their "
+    "offsets to <output>.index instead of sending them back.");
+DEFINE_int32(max_wait_ms, 20,
+    "With --serve, how long a request may wait for others to fill a batch.");
+DEFINE_bool(share_activations, true,
+    "Let the intermediate blobs whose lifetimes do not overlap share memory; "
+    "only the extracted blobs and the net outputs are kept.");
+DEFINE_bool(fuse_layers, true,
+    "Fold BatchNorm and Scale layers into the convolutions before them and "
+    "fuse following ReLUs into their output pass. The intermediate blobs "
+    "that are not computed in place disappear, so disable it to extract "
+    "them.");
+DEFINE_string(storage_precision, "float",
+    "On CPU, keep the weights and column buffers of the convolution and "
+    "inner product layers in float, fp16 or bf16 (see "
+    "LayerParameter.storage_precision); the float weights are then freed. "
+    "Activations stay in float.");
+DEFINE_string(feature_precision, "float",
+    "Write the features as float, or as fp16 or bf16 at half the size "
+    "(see load_blob_from_half_binary).");
+DEFINE_int32(decode_threads, 0,
+    "With --serve, threads decoding the clips of a batch; 0 for one per "
+    "hardware thread.");
+
+// The StoragePrecision named by a --*_precision flag.
+StoragePrecision ParsePrecision(const string& name) {
+  string upper(name);
+  std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+  StoragePrecision precision;
+  CHECK(LayerParameter_StoragePrecision_Parse(upper, &precision))
+      << "Unknown precision " << name << "; use float, fp16 or bf16";
+  return precision;
+}
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
+template<typename Dtype>
+int feature_extraction_server(int argc, char** argv);
 
 int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Extract features of video clips.\n"
+      "Usage:\n"
+      "    predict net_proto pretrained_model device_id batch_size "
+      "num_mini_batches prefix_file blob_name1 [blob_name2 ...]\n"
+      "    predict --serve [--socket=path] [--output=file] net_proto "
+      "pretrained_model device_id blob_name1 [blob_name2 ...]\n"
+      "In server mode every request is a line \"path start_frame [id]\"; "
+      "the clip is read and transformed as the net's "
+      "C3DMultiLabelVideoData layer would at test time.");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_serve) {
+    if (argc < 5) {
+      gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/predict");
+      return 1;
+    }
+    return feature_extraction_server<float>(argc, argv);
+  }
+  if (argc < 8) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/predict");
+    return 1;
+  }
   return feature_extraction_pipeline<float>(argc, argv);
 }
 
@@ -42,15 +128,29 @@ int feature_extraction_pipeline(int argc, char** argv) {
       LOG(ERROR) << "Using CPU";
   }
 
-  shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(string(net_proto), caffe::TEST));
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(net_proto), &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  net_param.set_fuse_layers(FLAGS_fuse_layers);
+  net_param.set_storage_precision(ParsePrecision(FLAGS_storage_precision));
+  const StoragePrecision feature_precision =
+      ParsePrecision(FLAGS_feature_precision);
+  shared_ptr<Net<Dtype> > feature_extraction_net(new Net<Dtype>(net_param));
   feature_extraction_net->CopyTrainedLayersFrom(string(pretrained_model));
+  if (Caffe::mode() == Caffe::CPU) {
+    LOG(INFO) << "Released " << feature_extraction_net->ReleaseFloatWeights()
+        << " bytes of float weights.";
+  }
 
   for (int i = 7; i < argc; i++) {
   CHECK(feature_extraction_net->has_blob(string(argv[i])))
       << "Unknown feature blob name " << string(argv[i])
       << " in the network " << string(net_proto);
   }
+  if (FLAGS_share_activations) {
+    feature_extraction_net->PlanInferenceMemory(
+        vector<string>(argv + 7, argv + argc));
+  }
 
   LOG(ERROR)<< "Extracting features for " << num_mini_batches << " batches";
   std::ifstream infile(fn_feat);
@@ -82,7 +182,12 @@ int feature_extraction_pipeline(int argc, char** argv) {
         for (int n = 0; n < num_features; ++n) {
           if (list_prefix.size() > n) {
               string fn_feat = list_prefix[n] + string(".") + string(argv[k]);
-              save_blob_to_binary(feature_blob.get(), fn_feat, n);
+              if (feature_precision == LayerParameter_StoragePrecision_FLOAT) {
+                save_blob_to_binary(feature_blob.get(), fn_feat, n);
+              } else {
+                save_blob_to_half_binary(feature_blob.get(), fn_feat, n,
+                    feature_precision);
+              }
           }
         }
     }
@@ -97,3 +202,478 @@ int feature_extraction_pipeline(int argc, char** argv) {
   return 0;
 }
 
+// Where the answers to a request go: a socket connection or stdout.
+class Client {
+ public:
+  Client(int fd, bool owns_fd) : fd_(fd), owns_fd_(owns_fd) {}
+  ~Client() {
+    if (owns_fd_) {
+      close(fd_);
+    }
+  }
+
+  // Answers are written whole, even if several threads reply at once.
+  void Write(const string& bytes) {
+    boost::mutex::scoped_lock lock(mutex_);
+    size_t written = 0;
+    while (written < bytes.size()) {
+      ssize_t n = write(fd_, bytes.data() + written, bytes.size() - written);
+      if (n <= 0) {
+        LOG(WARNING) << "Dropping an answer to a closed client";
+        return;
+      }
+      written += n;
+    }
+  }
+
+ private:
+  int fd_;
+  bool owns_fd_;
+  boost::mutex mutex_;
+};
+
+struct ClipRequest {
+  string id;
+  string path;
+  int start_frame;
+  shared_ptr<Client> client;
+  boost::system_time arrival;
+};
+
+// Pending requests, handed out in batches that fill up to a size or until the
+// oldest request has waited long enough.
+class RequestQueue {
+ public:
+  RequestQueue() : closed_(false) {}
+
+  void Push(const ClipRequest& request) {
+    boost::mutex::scoped_lock lock(mutex_);
+    queue_.push_back(request);
+    lock.unlock();
+    condition_.notify_one();
+  }
+
+  // No more requests will come; PopBatch drains the queue and then fails.
+  void Close() {
+    boost::mutex::scoped_lock lock(mutex_);
+    closed_ = true;
+    lock.unlock();
+    condition_.notify_one();
+  }
+
+  bool PopBatch(int max_size, int max_wait_ms, vector<ClipRequest>* batch) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.empty() && !closed_) {
+      condition_.wait(lock);
+    }
+    if (queue_.empty()) {
+      return false;
+    }
+    // The deadline counts from the arrival of the oldest request, which may
+    // have waited for the previous batch already.
+    const boost::system_time deadline = queue_.front().arrival +
+        boost::posix_time::milliseconds(max_wait_ms);
+    while (queue_.size() < max_size && !closed_ &&
+        condition_.timed_wait(lock, deadline)) {
+    }
+    batch->clear();
+    while (!queue_.empty() && batch->size() < max_size) {
+      batch->push_back(queue_.front());
+      queue_.pop_front();
+    }
+    return true;
+  }
+
+ private:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  std::deque<ClipRequest> queue_;
+  bool closed_;
+};
+
+// Parses "path start_frame [id]" lines from in until it ends.
+void ReadRequests(FILE* in, shared_ptr<Client> client, RequestQueue* queue) {
+  char line[4096];
+  while (fgets(line, sizeof(line), in)) {
+    std::istringstream iss(line);
+    ClipRequest request;
+    if (!(iss >> request.path)) {
+      continue;
+    }
+    if (!(iss >> request.start_frame) || request.start_frame < 0) {
+      LOG(ERROR) << "Malformed request: " << line;
+      client->Write(request.path + " ERROR\n");
+      continue;
+    }
+    if (!(iss >> request.id)) {
+      std::ostringstream id;
+      id << request.path << ":" << request.start_frame;
+      request.id = id.str();
+    }
+    request.client = client;
+    request.arrival = boost::get_system_time();
+    queue->Push(request);
+  }
+}
+
+// Serves the requests of in, which are the last ones.
+void ReadRequestsUntilEnd(FILE* in, shared_ptr<Client> client,
+    RequestQueue* queue) {
+  ReadRequests(in, client, queue);
+  queue->Close();
+}
+
+void ReadConnection(FILE* in, shared_ptr<Client> client,
+    RequestQueue* queue) {
+  ReadRequests(in, client, queue);
+  fclose(in);
+}
+
+// Accepts connections on a Unix domain socket, reading each on its own thread.
+void AcceptClients(int listen_fd, RequestQueue* queue) {
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      PLOG(ERROR) << "accept";
+      continue;
+    }
+    FILE* in = fdopen(dup(fd), "r");
+    CHECK(in);
+    shared_ptr<Client> client(new Client(fd, true));
+    boost::thread reader(&ReadConnection, in, client, queue);
+    reader.detach();
+  }
+}
+
+// Reads clips and transforms them as C3DMultiLabelVideoDataLayer does in the
+// TEST phase: resized to new_height x new_width, center cropped, mean
+// subtracted and scaled, with the mean cube or the mean and scale of every
+// frame of every channel (see GetPlaneMeanAndScale).
+template <typename Dtype>
+class ClipLoader {
+ public:
+  ClipLoader(const C3DMultiLabelVideoDataParameter& param, int num_threads)
+      : param_(param), pool_(num_threads) {
+    CHECK_GT(param_.new_length(), 0);
+    CHECK(param_.new_height() > 0 && param_.new_width() > 0)
+        << "Serving needs new_height and new_width to size the clips";
+    CHECK(!param_.mirror()) << "Mirroring is not supported at test time";
+    channels_ = 3;
+    length_ = param_.new_length();
+    height_ = param_.new_height();
+    width_ = param_.new_width();
+    crop_size_ = param_.crop_size();
+    if (crop_size_) {
+      CHECK_GE(height_, crop_size_);
+      CHECK_GE(width_, crop_size_);
+    }
+    if (param_.has_mean_file()) {
+      vector<int> mean_shape(5);
+      mean_shape[0] = 1;
+      mean_shape[1] = channels_;
+      mean_shape[2] = length_;
+      mean_shape[3] = height_;
+      mean_shape[4] = width_;
+      BlobProto blob_proto;
+      ReadProtoFromBinaryFileOrDie(param_.mean_file().c_str(), &blob_proto);
+      mean_.FromProto(blob_proto);
+      CHECK(mean_.shape() == mean_shape) << "Mean " << mean_.shape_string()
+          << " does not match the clips";
+      // The threads only read it.
+      mean_.cpu_data();
+    }
+    GetPlaneMeanAndScale(param_, channels_, length_, &plane_mean_,
+        &plane_scale_);
+    // Each thread keeps its video open, so clips of the same video requested
+    // one after the other are decoded once.
+    readers_.resize(pool_.num_threads());
+    for (int i = 0; i < readers_.size(); ++i) {
+      readers_[i].reset(new VideoFrameReader(height_, width_, true, false));
+    }
+  }
+
+  // Shape of a batch of n transformed clips.
+  vector<int> shape(int n) const {
+    vector<int> shape(5);
+    shape[0] = n;
+    shape[1] = channels_;
+    shape[2] = length_;
+    shape[3] = crop_size_ ? crop_size_ : height_;
+    shape[4] = crop_size_ ? crop_size_ : width_;
+    return shape;
+  }
+
+  // Loads clip i of requests into item i of data, which has shape(n).
+  // Requests spread over threads in contiguous runs; ok[i] tells if clip i
+  // could be read. Flags are chars, not vector<bool> bits, which threads
+  // could not set concurrently.
+  void Load(const vector<ClipRequest>& requests, Blob<Dtype>* data,
+      vector<char>* ok) {
+    ok->assign(requests.size(), false);
+    requests_ = &requests;
+    // Allocated here: the threads only write their own clips.
+    data_ = data->mutable_cpu_data();
+    clip_size_ = data->count(1);
+    ok_ = ok;
+    pool_.Run(pool_.num_threads(),
+        boost::bind(&ClipLoader<Dtype>::LoadRun, this, _1));
+  }
+
+ private:
+  void LoadRun(int thread) {
+    const int n = requests_->size();
+    const int per_thread = (n + pool_.num_threads() - 1) / pool_.num_threads();
+    const int end = std::min(n, (thread + 1) * per_thread);
+    for (int i = thread * per_thread; i < end; ++i) {
+      (*ok_)[i] = LoadClip((*requests_)[i], readers_[thread].get(),
+          data_ + i * clip_size_);
+    }
+  }
+
+  bool LoadClip(const ClipRequest& request, VideoFrameReader* reader,
+      Dtype* out) {
+    const int sampling_rate = param_.sampling_rate();
+    if (!reader->Open(request.path)) {
+      return false;
+    }
+    if (reader->is_video_file() && request.start_frame +
+        length_ * sampling_rate > reader->num_frames()) {
+      LOG(ERROR) << "Clip " << request.id << " ends after the "
+          << reader->num_frames() << " frames of " << request.path;
+      return false;
+    }
+    C3DMultiLabelVolumeDatum datum;
+    if (!ReadFramesToVolumeDatum(reader, request.path.c_str(),
+        request.start_frame, vector<int>(), length_, sampling_rate, &datum)) {
+      return false;
+    }
+    int h_off = 0;
+    int w_off = 0;
+    int out_height = height_;
+    int out_width = width_;
+    if (crop_size_) {
+      h_off = (height_ - crop_size_) / 2;
+      w_off = (width_ - crop_size_) / 2;
+      out_height = crop_size_;
+      out_width = crop_size_;
+    }
+    const uint8_t* pixels =
+        reinterpret_cast<const uint8_t*>(datum.data().data());
+    const Dtype* mean = mean_.count() ? mean_.cpu_data() : NULL;
+    const int frame_size = height_ * width_;
+    const int out_size = out_height * out_width;
+    const int crop_offset = h_off * width_ + w_off;
+    for (int plane = 0; plane < channels_ * length_; ++plane) {
+      transform_frame_cpu<Dtype>(pixels + plane * frame_size + crop_offset,
+          1, out_height, out_width, 0, width_, 1, false,
+          mean ? mean + plane * frame_size + crop_offset : NULL, 0, width_,
+          &plane_mean_[plane], plane_scale_[plane], out + plane * out_size, 0);
+    }
+    return true;
+  }
+
+  const C3DMultiLabelVideoDataParameter param_;
+  ThreadPool pool_;
+  vector<shared_ptr<VideoFrameReader> > readers_;
+  // The mean cube, if any, else the mean of every frame of every channel,
+  // and the scale of every frame of every channel.
+  Blob<Dtype> mean_;
+  vector<Dtype> plane_mean_;
+  vector<Dtype> plane_scale_;
+  int channels_, length_, height_, width_, crop_size_;
+  // The batch being loaded.
+  const vector<ClipRequest>* requests_;
+  Dtype* data_;
+  int clip_size_;
+  vector<char>* ok_;
+};
+
+// Appends item n of each blob as save_blob_to_binary (or
+// save_blob_to_half_binary) writes a single item: five int32 dimensions
+// (1, channels, length, height, width), then the data.
+template <typename Dtype>
+void AppendFeatures(const vector<Blob<Dtype>*>& blobs, int n,
+    StoragePrecision precision, string* out) {
+  for (int i = 0; i < blobs.size(); ++i) {
+    const Blob<Dtype>* blob = blobs[i];
+    int dims[5] = { 1, blob->channels(), blob->length(), blob->height(),
+        blob->width() };
+    const int count = blob->count() / blob->num();
+    out->append(reinterpret_cast<const char*>(dims), sizeof(dims));
+    if (precision == LayerParameter_StoragePrecision_FLOAT) {
+      out->append(reinterpret_cast<const char*>(blob->cpu_data() +
+          n * count), count * sizeof(Dtype));
+    } else {
+      vector<uint16_t> half(count);
+      caffe_cpu_narrow(precision, count, blob->cpu_data() + n * count,
+          &half[0]);
+      out->append(reinterpret_cast<const char*>(&half[0]),
+          count * sizeof(uint16_t));
+    }
+  }
+}
+
+template<typename Dtype>
+int feature_extraction_server(int argc, char** argv) {
+  const string net_proto = argv[1];
+  const string pretrained_model = argv[2];
+  const int device_id = atoi(argv[3]);
+  if (device_id >= 0) {
+    Caffe::set_mode(Caffe::GPU);
+    Caffe::SetDevice(device_id);
+    LOG(INFO) << "Using GPU #" << device_id;
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+    LOG(INFO) << "Using CPU";
+  }
+
+  // The net's C3DMultiLabelVideoData layer becomes an Input layer, which the
+  // server fills with the requested clips transformed the same way.
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(net_proto, &param);
+  param.mutable_state()->set_phase(caffe::TEST);
+  param.set_fuse_layers(FLAGS_fuse_layers);
+  param.set_storage_precision(ParsePrecision(FLAGS_storage_precision));
+  const StoragePrecision feature_precision =
+      ParsePrecision(FLAGS_feature_precision);
+  NetParameter filtered_param;
+  Net<Dtype>::FilterNet(param, &filtered_param);
+  LayerParameter* data_layer = NULL;
+  for (int i = 0; i < filtered_param.layer_size(); ++i) {
+    if (filtered_param.layer(i).type() == "C3DMultiLabelVideoData") {
+      data_layer = filtered_param.mutable_layer(i);
+      break;
+    }
+  }
+  CHECK(data_layer) << "Serving needs a C3DMultiLabelVideoData layer in "
+      << net_proto;
+  const C3DMultiLabelVideoDataParameter data_param =
+      data_layer->c3d_multi_label_video_data_param();
+  const int batch_size = data_param.batch_size();
+  CHECK_GT(batch_size, 0);
+  const int decode_threads = FLAGS_decode_threads > 0 ?
+      FLAGS_decode_threads : ThreadPool::Get().num_threads();
+  ClipLoader<Dtype> loader(data_param, decode_threads);
+  data_layer->clear_c3d_multi_label_video_data_param();
+  data_layer->set_type("Input");
+  vector<int> data_shape = loader.shape(batch_size);
+  BlobShape* shape = data_layer->mutable_input_param()->add_shape();
+  for (int i = 0; i < data_shape.size(); ++i) {
+    shape->add_dim(data_shape[i]);
+  }
+  if (data_layer->top_size() > 1) {
+    // Placeholder labels for layers that consume them.
+    shape = data_layer->mutable_input_param()->add_shape();
+    shape->add_dim(batch_size);
+    shape->add_dim(1);
+  }
+  Net<Dtype> net(filtered_param);
+  net.CopyTrainedLayersFrom(pretrained_model);
+  if (Caffe::mode() == Caffe::CPU) {
+    LOG(INFO) << "Released " << net.ReleaseFloatWeights()
+        << " bytes of float weights.";
+  }
+  Blob<Dtype>* data = net.blob_by_name(data_layer->top(0)).get();
+  Blob<Dtype>* label = data_layer->top_size() > 1 ?
+      net.blob_by_name(data_layer->top(1)).get() : NULL;
+  vector<Blob<Dtype>*> feature_blobs;
+  for (int i = 4; i < argc; ++i) {
+    CHECK(net.has_blob(argv[i])) << "Unknown feature blob name " << argv[i]
+        << " in the network " << net_proto;
+    feature_blobs.push_back(net.blob_by_name(argv[i]).get());
+  }
+  if (FLAGS_share_activations) {
+    net.PlanInferenceMemory(vector<string>(argv + 4, argv + argc));
+  }
+
+  FILE* feature_file = NULL;
+  FILE* index_file = NULL;
+  long offset = 0;  // NOLINT(runtime/int)
+  if (!FLAGS_output.empty()) {
+    feature_file = fopen(FLAGS_output.c_str(), "ab");
+    CHECK(feature_file) << "Cannot open " << FLAGS_output;
+    const string index_name = FLAGS_output + ".index";
+    index_file = fopen(index_name.c_str(), "a");
+    CHECK(index_file) << "Cannot open " << index_name;
+    fseek(feature_file, 0, SEEK_END);
+    offset = ftell(feature_file);
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  RequestQueue queue;
+  if (FLAGS_socket.empty()) {
+    shared_ptr<Client> out(new Client(STDOUT_FILENO, false));
+    boost::thread reader(&ReadRequestsUntilEnd, stdin, out, &queue);
+    reader.detach();
+  } else {
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    PCHECK(listen_fd >= 0) << "socket";
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path));
+    strncpy(address.sun_path, FLAGS_socket.c_str(),
+        sizeof(address.sun_path) - 1);
+    unlink(FLAGS_socket.c_str());
+    PCHECK(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address),
+        sizeof(address)) == 0) << "bind " << FLAGS_socket;
+    PCHECK(listen(listen_fd, 16) == 0) << "listen";
+    boost::thread acceptor(&AcceptClients, listen_fd, &queue);
+    acceptor.detach();
+  }
+  LOG(INFO) << "Serving " << feature_blobs.size() << " blobs in batches of up "
+      << "to " << batch_size << " clips";
+
+  vector<ClipRequest> batch;
+  vector<char> ok;
+  int num_served = 0;
+  while (queue.PopBatch(batch_size, FLAGS_max_wait_ms, &batch)) {
+    // Partial batches run a smaller net rather than padding.
+    data_shape[0] = batch.size();
+    data->Reshape(data_shape);
+    if (label) {
+      vector<int> label_shape = label->shape();
+      label_shape[0] = batch.size();
+      label->Reshape(label_shape);
+    }
+    net.Reshape();
+    loader.Load(batch, data, &ok);
+    net.Forward();
+    vector<string> replies(batch.size());
+    for (int n = 0; n < batch.size(); ++n) {
+      if (!ok[n]) {
+        replies[n] = batch[n].id + " ERROR\n";
+        continue;
+      }
+      string features;
+      AppendFeatures(feature_blobs, n, feature_precision, &features);
+      std::ostringstream reply;
+      if (feature_file) {
+        fwrite(features.data(), 1, features.size(), feature_file);
+        fprintf(index_file, "%s %ld\n", batch[n].id.c_str(), offset);
+        reply << batch[n].id << " " << offset << "\n";
+        offset += features.size();
+        replies[n] = reply.str();
+      } else {
+        reply << batch[n].id << " " << features.size() << "\n";
+        replies[n] = reply.str() + features;
+      }
+    }
+    if (feature_file) {
+      // Offsets are only acknowledged once their features are in the file.
+      fflush(feature_file);
+      fflush(index_file);
+    }
+    for (int n = 0; n < batch.size(); ++n) {
+      batch[n].client->Write(replies[n]);
+    }
+    num_served += batch.size();
+    LOG_EVERY_N(INFO, 100) << "Served " << num_served << " clips";
+  }
+  if (feature_file) {
+    fclose(feature_file);
+    fclose(index_file);
+  }
+  LOG(INFO) << "Served " << num_served << " clips";
+  return 0;
+}
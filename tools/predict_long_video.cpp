@@ -0,0 +1,200 @@
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/c3d_multi_label_video_data_layer.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(clip_stride, 0,
+    "Frames between the starts of consecutive clips; 0 keeps the "
+    "clip_stride of the net's C3DMultiLabelVideoData layer.");
+DEFINE_string(pooling, "mean,max",
+    "How the clip outputs are pooled into video scores: mean, max or both "
+    "(mean,max).");
+DEFINE_bool(share_activations, true,
+    "Let the intermediate blobs whose lifetimes do not overlap share memory; "
+    "only the pooled blobs and the net outputs are kept.");
+DEFINE_bool(fuse_layers, true,
+    "Fold BatchNorm and Scale layers into the convolutions before them and "
+    "fuse following ReLUs into their output pass.");
+
+// Mean and max of the clip outputs of one blob over the current video.
+template <typename Dtype>
+struct Pool {
+  int clips;
+  vector<double> sum;
+  vector<Dtype> max;
+
+  void Reset(int dim) {
+    clips = 0;
+    sum.assign(dim, 0);
+    max.assign(dim, 0);
+  }
+
+  void Add(const Dtype* x) {
+    for (int i = 0; i < sum.size(); ++i) {
+      sum[i] += x[i];
+      max[i] = clips ? std::max(max[i], x[i]) : x[i];
+    }
+    ++clips;
+  }
+};
+
+// Writes "video blob pooling value..." lines for the pools of a video.
+template <typename Dtype>
+void WritePools(FILE* out, const string& video, const vector<string>& names,
+    const vector<Pool<Dtype> >& pools, bool mean, bool max) {
+  for (int b = 0; b < pools.size(); ++b) {
+    const Pool<Dtype>& pool = pools[b];
+    if (mean) {
+      fprintf(out, "%s %s mean", video.c_str(), names[b].c_str());
+      for (int i = 0; i < pool.sum.size(); ++i) {
+        fprintf(out, " %g", pool.sum[i] / pool.clips);
+      }
+      fprintf(out, "\n");
+    }
+    if (max) {
+      fprintf(out, "%s %s max", video.c_str(), names[b].c_str());
+      for (int i = 0; i < pool.max.size(); ++i) {
+        fprintf(out, " %g", static_cast<double>(pool.max[i]));
+      }
+      fprintf(out, "\n");
+    }
+  }
+}
+
+template <typename Dtype>
+int predict_long_video(int argc, char** argv) {
+  const string net_proto = argv[1];
+  const string pretrained_model = argv[2];
+  const int device_id = atoi(argv[3]);
+  const string output = argv[4];
+  if (device_id >= 0) {
+    Caffe::set_mode(Caffe::GPU);
+    Caffe::SetDevice(device_id);
+    LOG(INFO) << "Using GPU #" << device_id;
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+    LOG(INFO) << "Using CPU";
+  }
+  const bool mean = FLAGS_pooling.find("mean") != string::npos;
+  const bool max = FLAGS_pooling.find("max") != string::npos;
+  CHECK(mean || max) << "Unknown pooling " << FLAGS_pooling;
+
+  // The data layer covers every video of its list with clips and loads them
+  // in list order, so clip k of the first epoch is clip k of the list.
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(net_proto, &param);
+  param.mutable_state()->set_phase(caffe::TEST);
+  param.set_fuse_layers(FLAGS_fuse_layers);
+  NetParameter filtered_param;
+  Net<Dtype>::FilterNet(param, &filtered_param);
+  string data_layer_name;
+  for (int i = 0; i < filtered_param.layer_size(); ++i) {
+    LayerParameter* layer = filtered_param.mutable_layer(i);
+    if (layer->type() == "C3DMultiLabelVideoData") {
+      C3DMultiLabelVideoDataParameter* data_param =
+          layer->mutable_c3d_multi_label_video_data_param();
+      if (FLAGS_clip_stride > 0) {
+        data_param->set_clip_stride(FLAGS_clip_stride);
+      }
+      CHECK_GT(data_param->clip_stride(), 0) << "Set --clip_stride or the "
+          << "clip_stride of the data layer of " << net_proto;
+      data_param->set_shuffle(false);
+      data_param->set_rand_skip(0);
+      data_layer_name = layer->name();
+      break;
+    }
+  }
+  CHECK(!data_layer_name.empty()) << "No C3DMultiLabelVideoData layer in "
+      << net_proto;
+  Net<Dtype> net(filtered_param);
+  net.CopyTrainedLayersFrom(pretrained_model);
+  const C3DMultiLabelVideoDataLayer<Dtype>* data_layer =
+      dynamic_cast<const C3DMultiLabelVideoDataLayer<Dtype>*>(
+          net.layer_by_name(data_layer_name).get());
+  CHECK(data_layer);
+  const vector<string>& videos = data_layer->video_list();
+  const vector<int>& clip_video = data_layer->clip_video();
+
+  vector<string> names(argv + 5, argv + argc);
+  vector<Blob<Dtype>*> blobs;
+  for (int i = 0; i < names.size(); ++i) {
+    CHECK(net.has_blob(names[i])) << "Unknown blob name " << names[i]
+        << " in the network " << net_proto;
+    blobs.push_back(net.blob_by_name(names[i]).get());
+  }
+  if (FLAGS_share_activations) {
+    net.PlanInferenceMemory(names);
+  }
+
+  FILE* out = fopen(output.c_str(), "w");
+  CHECK(out) << "Cannot open " << output;
+  const int num_clips = clip_video.size();
+  const int batch_size = blobs.empty() ? 0 : blobs[0]->shape(0);
+  LOG(INFO) << "Scoring " << videos.size() << " videos with " << num_clips
+      << " clips";
+  vector<Pool<Dtype> > pools(blobs.size());
+  int video = -1;
+  int num_videos = 0;
+  // The last batch wraps around to the first clips, which are dropped.
+  for (int k = 0; k < num_clips; k += batch_size) {
+    net.Forward();
+    for (int n = 0; n < batch_size && k + n < num_clips; ++n) {
+      if (clip_video[k + n] != video) {
+        if (video >= 0) {
+          WritePools(out, videos[video], names, pools, mean, max);
+          ++num_videos;
+        }
+        video = clip_video[k + n];
+        for (int b = 0; b < blobs.size(); ++b) {
+          pools[b].Reset(blobs[b]->count(1));
+        }
+      }
+      for (int b = 0; b < blobs.size(); ++b) {
+        pools[b].Add(blobs[b]->cpu_data() + blobs[b]->offset(n));
+      }
+    }
+    LOG_EVERY_N(INFO, 100) << "Scored " << std::min(k + batch_size, num_clips)
+        << " clips";
+  }
+  if (video >= 0) {
+    WritePools(out, videos[video], names, pools, mean, max);
+    ++num_videos;
+  }
+  fclose(out);
+  LOG(INFO) << "Wrote the scores of " << num_videos << " videos to " << output;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Score whole videos by pooling the outputs of "
+      "strided clips.\n"
+      "Usage:\n"
+      "    predict_long_video [--clip_stride=n] [--pooling=mean,max] "
+      "net_proto pretrained_model device_id output_file blob_name1 "
+      "[blob_name2 ...]\n"
+      "The source of the net's C3DMultiLabelVideoData layer lists one video "
+      "per line (see clip_stride); every line of output_file is "
+      "\"video blob mean|max value...\".");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (argc < 6) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/predict_long_video");
+    return 1;
+  }
+  return predict_long_video<float>(argc, argv);
+}
@@ -0,0 +1,103 @@
+// This program compares the queues between the data threads and the layers:
+// BlockingQueue (mutex and condition variable) against RingQueue (lock-free
+// ring, spin-then-park), with 1 to --max_producers threads pushing into one
+// queue and --consumers threads popping from it. Throughput is the elements
+// passed through the queue per second.
+// Usage:
+//    queue_benchmark [FLAGS]
+
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <cstdio>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/ring_queue.hpp"
+
+using caffe::BlockingQueue;
+using caffe::CPUTimer;
+using caffe::Datum;
+using caffe::RingQueue;
+using caffe::shared_ptr;
+using std::vector;
+
+DEFINE_int32(max_producers, 32, "Largest number of producer threads");
+DEFINE_int32(consumers, 1, "Consumer threads");
+DEFINE_int32(items, 1000000, "Elements passed through the queue per run");
+DEFINE_int32(capacity, 1024, "Capacity of the RingQueue");
+
+namespace {
+
+template <typename Queue>
+void Produce(Queue* queue, int n) {
+  for (int i = 0; i < n; ++i) {
+    queue->push(reinterpret_cast<Datum*>(static_cast<intptr_t>(i + 1)));
+  }
+}
+
+template <typename Queue>
+void Consume(Queue* queue, int n) {
+  for (int i = 0; i < n; ++i) {
+    queue->pop();
+  }
+}
+
+// Passes about FLAGS_items elements from producers to consumers threads and
+// returns the elements per second.
+template <typename Queue>
+double Run(Queue* queue, int producers, int consumers) {
+  const int per_producer = FLAGS_items / producers;
+  const int total = per_producer * producers;
+  vector<shared_ptr<boost::thread> > threads;
+  CPUTimer timer;
+  timer.Start();
+  for (int c = 0; c < consumers; ++c) {
+    const int n = total / consumers + (c < total % consumers);
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&Consume<Queue>, queue, n))));
+  }
+  for (int p = 0; p < producers; ++p) {
+    threads.push_back(shared_ptr<boost::thread>(new boost::thread(
+        boost::bind(&Produce<Queue>, queue, per_producer))));
+  }
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i]->join();
+  }
+  return total / (timer.MicroSeconds() / 1e6);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Time BlockingQueue against RingQueue.\n"
+        "Usage:\n"
+        "    queue_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  CHECK_GT(FLAGS_max_producers, 0);
+  CHECK_GT(FLAGS_consumers, 0);
+  CHECK_GE(FLAGS_items, FLAGS_max_producers);
+
+  printf("%9s %9s %16s %16s %8s\n", "producers", "consumers",
+      "BlockingQueue/s", "RingQueue/s", "speedup");
+  for (int producers = 1; producers <= FLAGS_max_producers; producers *= 2) {
+    BlockingQueue<Datum*> blocking_queue;
+    RingQueue<Datum*> ring_queue(FLAGS_capacity);
+    const double blocking = Run(&blocking_queue, producers, FLAGS_consumers);
+    const double ring = Run(&ring_queue, producers, FLAGS_consumers);
+    printf("%9d %9d %16.0f %16.0f %7.2fx\n", producers, FLAGS_consumers,
+        blocking, ring, ring / blocking);
+  }
+  return 0;
+}
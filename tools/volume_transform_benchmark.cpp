@@ -0,0 +1,192 @@
+// This program times the crop/mirror/mean/scale step of the video data
+// layers: transform_frame_cpu against the per-element loops it replaced, for
+// planar clips (C3DMultiLabelVideoData, clip caches) and interleaved frames
+// (MultiLabelVideoData). Throughput is the float output written per second.
+// Usage:
+//    volume_transform_benchmark [FLAGS]
+
+#include <stdint.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/volume_transform.hpp"
+
+using caffe::CPUTimer;
+using std::vector;
+
+DEFINE_int32(channels, 3, "Channels of a clip");
+DEFINE_int32(length, 16, "Frames of a clip");
+DEFINE_int32(height, 128, "Frame height");
+DEFINE_int32(width, 171, "Frame width");
+DEFINE_int32(crop_size, 112, "Crop size");
+DEFINE_bool(mirror, false, "Mirror the crops");
+DEFINE_int32(iterations, 200, "Clips transformed per measurement");
+
+namespace {
+
+// The C3DMultiLabelVideoData loop: 4-D indices recomputed per element.
+void PlanarPerElement(const uint8_t* data, const float* mean, int channels,
+    int length, int height, int width, int crop_size, int h_off, int w_off,
+    bool mirror, float scale, float* top_data) {
+  for (int c = 0; c < channels; ++c) {
+    for (int l = 0; l < length; ++l) {
+      for (int h = 0; h < crop_size; ++h) {
+        for (int w = 0; w < crop_size; ++w) {
+          int top_index = ((c * length + l) * crop_size + h) * crop_size
+              + (mirror ? crop_size - 1 - w : w);
+          int data_index =
+              ((c * length + l) * height + h + h_off) * width + w + w_off;
+          float datum_element = static_cast<float>(data[data_index]);
+          top_data[top_index] = (datum_element - mean[data_index]) * scale;
+        }
+      }
+    }
+  }
+}
+
+void PlanarKernel(const uint8_t* data, const float* mean, int channels,
+    int length, int height, int width, int crop_size, int h_off, int w_off,
+    bool mirror, float scale, float* top_data) {
+  const int frame_size = height * width;
+  const int out_size = crop_size * crop_size;
+  const int crop_offset = h_off * width + w_off;
+  for (int l = 0; l < length; ++l) {
+    caffe::transform_frame_cpu<float>(data + l * frame_size + crop_offset,
+        channels, crop_size, crop_size, length * frame_size, width, 1, mirror,
+        mean + l * frame_size + crop_offset, length * frame_size, width, NULL,
+        scale, top_data + l * out_size, length * out_size);
+  }
+}
+
+// The DataTransformer video loop: each interleaved frame is transformed
+// per pixel and channel into a frame blob, then copied into the clip.
+void InterleavedPerElement(const vector<vector<uint8_t> >& frames,
+    const float* mean, int channels, int length, int height, int width,
+    int crop_size, int h_off, int w_off, bool mirror, float scale,
+    float* frame_data, float* top_data) {
+  for (int l = 0; l < length; ++l) {
+    for (int h = 0; h < crop_size; ++h) {
+      const uint8_t* ptr = &frames[l][((h_off + h) * width + w_off) * channels];
+      int img_index = 0;
+      for (int w = 0; w < crop_size; ++w) {
+        for (int c = 0; c < channels; ++c) {
+          int top_index = (c * crop_size + h) * crop_size
+              + (mirror ? crop_size - 1 - w : w);
+          float pixel = static_cast<float>(ptr[img_index++]);
+          int mean_index =
+              ((c * length + l) * height + h_off + h) * width + w_off + w;
+          frame_data[top_index] = (pixel - mean[mean_index]) * scale;
+        }
+      }
+    }
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < crop_size; ++h) {
+        for (int w = 0; w < crop_size; ++w) {
+          top_data[((c * length + l) * crop_size + h) * crop_size + w] =
+              frame_data[(c * crop_size + h) * crop_size + w];
+        }
+      }
+    }
+  }
+}
+
+void InterleavedKernel(const vector<vector<uint8_t> >& frames,
+    const float* mean, int channels, int length, int height, int width,
+    int crop_size, int h_off, int w_off, bool mirror, float scale,
+    float* top_data) {
+  const int out_size = crop_size * crop_size;
+  for (int l = 0; l < length; ++l) {
+    caffe::transform_frame_cpu<float>(
+        &frames[l][(h_off * width + w_off) * channels], channels, crop_size,
+        crop_size, 1, width * channels, channels, mirror,
+        mean + (l * height + h_off) * width + w_off, length * height * width,
+        width, NULL, scale, top_data + l * out_size, length * out_size);
+  }
+}
+
+void Report(const char* name, double milliseconds, double bytes) {
+  printf("%-32s %9.3f ms/clip %8.2f GB/s\n", name, milliseconds,
+      bytes / milliseconds / 1e6);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+#ifndef GFLAGS_GFLAGS_H_
+  namespace gflags = google;
+#endif
+  gflags::SetUsageMessage("Time the volumetric crop/mirror/mean transform.\n"
+        "Usage:\n"
+        "    volume_transform_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  const int channels = FLAGS_channels;
+  const int length = FLAGS_length;
+  const int height = FLAGS_height;
+  const int width = FLAGS_width;
+  const int crop_size = FLAGS_crop_size;
+  CHECK_GT(crop_size, 0);
+  CHECK_GE(height, crop_size);
+  CHECK_GE(width, crop_size);
+  const int h_off = (height - crop_size) / 2;
+  const int w_off = (width - crop_size) / 2;
+  const float scale = 0.5;
+
+  const int clip_size = channels * length * height * width;
+  vector<uint8_t> clip(clip_size);
+  vector<float> mean(clip_size);
+  for (int i = 0; i < clip_size; ++i) {
+    clip[i] = static_cast<uint8_t>(i * 37 + 11);
+    mean[i] = static_cast<float>(i % 251);
+  }
+  vector<vector<uint8_t> > frames(length,
+      vector<uint8_t>(height * width * channels));
+  for (int l = 0; l < length; ++l) {
+    for (int i = 0; i < frames[l].size(); ++i) {
+      frames[l][i] = static_cast<uint8_t>(i * 13 + l);
+    }
+  }
+  const int out_count = channels * length * crop_size * crop_size;
+  vector<float> top(out_count);
+  vector<float> frame_data(channels * crop_size * crop_size);
+  const double bytes = sizeof(float) * static_cast<double>(out_count);
+
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    PlanarPerElement(&clip[0], &mean[0], channels, length, height, width,
+        crop_size, h_off, w_off, FLAGS_mirror, scale, &top[0]);
+  }
+  Report("planar per-element", timer.MilliSeconds() / FLAGS_iterations,
+      bytes);
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    PlanarKernel(&clip[0], &mean[0], channels, length, height, width,
+        crop_size, h_off, w_off, FLAGS_mirror, scale, &top[0]);
+  }
+  Report("planar transform_frame_cpu", timer.MilliSeconds() / FLAGS_iterations,
+      bytes);
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    InterleavedPerElement(frames, &mean[0], channels, length, height, width,
+        crop_size, h_off, w_off, FLAGS_mirror, scale, &frame_data[0],
+        &top[0]);
+  }
+  Report("interleaved per-element",
+      timer.MilliSeconds() / FLAGS_iterations, bytes);
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    InterleavedKernel(frames, &mean[0], channels, length, height, width,
+        crop_size, h_off, w_off, FLAGS_mirror, scale, &top[0]);
+  }
+  Report("interleaved transform_frame_cpu",
+      timer.MilliSeconds() / FLAGS_iterations, bytes);
+  return 0;
+}